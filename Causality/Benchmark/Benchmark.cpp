@@ -0,0 +1,146 @@
+#include "Benchmark.h"
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+using namespace Causality::Benchmark;
+
+std::atomic<size_t> AllocationCounter::Count(0);
+std::atomic<size_t> AllocationCounter::Bytes(0);
+
+Causality::Benchmark::Options::Options()
+	: Iterations(200), Warmup(20), Label("current")
+{
+}
+
+Causality::Benchmark::Runner::Runner(size_t iterations, size_t warmup)
+	: m_Iterations(std::max<size_t>(1, iterations)), m_Warmup(warmup)
+{
+}
+
+void Causality::Benchmark::Runner::Add(Stage && stage)
+{
+	m_Stages.push_back(std::move(stage));
+}
+
+std::vector<StageResult> Causality::Benchmark::Runner::Run(const std::string & filter) const
+{
+	std::vector<StageResult> results;
+	for (const auto& stage : m_Stages)
+	{
+		if (!filter.empty() && stage.Name.find(filter) == std::string::npos)
+			continue;
+		results.push_back(RunStage(stage));
+	}
+	return results;
+}
+
+// Nearest-rank percentile of sorted samples
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+	size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+	rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+	return sorted[rank - 1];
+}
+
+StageResult Causality::Benchmark::Runner::RunStage(const Stage & stage) const
+{
+	typedef std::chrono::high_resolution_clock clock;
+
+	size_t items = stage.Setup ? stage.Setup() : 1;
+	for (size_t i = 0; i < m_Warmup; i++)
+		stage.Run(i);
+
+	std::vector<double> samples(m_Iterations);
+	size_t allocs = AllocationCounter::Count.load();
+	size_t bytes = AllocationCounter::Bytes.load();
+	for (size_t i = 0; i < m_Iterations; i++)
+	{
+		auto start = clock::now();
+		stage.Run(m_Warmup + i);
+		samples[i] = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+	}
+	allocs = AllocationCounter::Count.load() - allocs;
+	bytes = AllocationCounter::Bytes.load() - bytes;
+
+	StageResult result;
+	result.Name = stage.Name;
+	result.Iterations = m_Iterations;
+	result.ItemsPerIteration = items;
+	double total = 0;
+	for (auto t : samples)
+		total += t;
+	std::sort(samples.begin(), samples.end());
+	result.TotalMs = total / 1000.0;
+	result.MeanUs = total / m_Iterations;
+	result.P50Us = Percentile(samples, 0.50);
+	result.P99Us = Percentile(samples, 0.99);
+	result.MaxUs = samples.back();
+	result.Throughput = total > 0 ? items * m_Iterations / (total * 1e-6) : 0;
+	result.AllocationsPerIteration = double(allocs) / m_Iterations;
+	result.BytesPerIteration = double(bytes) / m_Iterations;
+	return result;
+}
+
+// Quoted JSON string, labels come from the command line and may hold quotes or Windows paths
+static std::string JsonString(const std::string& value)
+{
+	std::string quoted = "\"";
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			quoted += '\\';
+			quoted += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			static const char hex[] = "0123456789abcdef";
+			quoted += "\\u00";
+			quoted += hex[(c >> 4) & 0xf];
+			quoted += hex[c & 0xf];
+		}
+		else
+			quoted += c;
+	}
+	quoted += '"';
+	return quoted;
+}
+
+void Causality::Benchmark::Runner::WriteJson(std::ostream & os, const std::string & label, const std::vector<StageResult>& results)
+{
+	os << std::fixed << std::setprecision(3);
+	os << "{\n  \"label\": " << JsonString(label) << ",\n  \"stages\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const auto& r = results[i];
+		os << "    { \"name\": " << JsonString(r.Name)
+			<< ", \"iterations\": " << r.Iterations
+			<< ", \"items_per_iteration\": " << r.ItemsPerIteration
+			<< ", \"total_ms\": " << r.TotalMs
+			<< ", \"mean_us\": " << r.MeanUs
+			<< ", \"p50_us\": " << r.P50Us
+			<< ", \"p99_us\": " << r.P99Us
+			<< ", \"max_us\": " << r.MaxUs
+			<< ", \"throughput_per_s\": " << r.Throughput
+			<< ", \"allocations_per_iteration\": " << r.AllocationsPerIteration
+			<< ", \"bytes_per_iteration\": " << r.BytesPerIteration
+			<< " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	os << "  ]\n}\n";
+}
+
+void Causality::Benchmark::Runner::WriteTable(std::ostream & os, const std::vector<StageResult>& results)
+{
+	os << std::left << std::setw(26) << "stage"
+		<< std::right << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)"
+		<< std::setw(16) << "items/s" << std::setw(12) << "allocs/it" << std::setw(14) << "bytes/it" << "\n";
+	os << std::fixed << std::setprecision(1);
+	for (const auto& r : results)
+	{
+		os << std::left << std::setw(26) << r.Name
+			<< std::right << std::setw(12) << r.P50Us << std::setw(12) << r.P99Us
+			<< std::setw(16) << r.Throughput << std::setw(12) << r.AllocationsPerIteration << std::setw(14) << r.BytesPerIteration << "\n";
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <ostream>
+
+namespace Causality
+{
+	namespace Benchmark
+	{
+		// Global operator new calls, counted by the overloads in main.cpp
+		struct AllocationCounter
+		{
+			static std::atomic<size_t> Count;
+			static std::atomic<size_t> Bytes;
+		};
+
+		struct Stage
+		{
+			std::string								Name;
+			// Called once before warm-up, not timed
+			// Returns work items processed per iteration (branches, points, vertices...), for throughput
+			std::function<size_t()>					Setup;
+			// One timed iteration
+			std::function<void(size_t iteration)>	Run;
+		};
+
+		struct StageResult
+		{
+			std::string	Name;
+			size_t		Iterations;
+			size_t		ItemsPerIteration;
+			double		TotalMs;
+			double		MeanUs;
+			double		P50Us;
+			double		P99Us;
+			double		MaxUs;
+			// Items per second
+			double		Throughput;
+			double		AllocationsPerIteration;
+			double		BytesPerIteration;
+		};
+
+		class Runner
+		{
+		public:
+			Runner(size_t iterations, size_t warmup);
+
+			void Add(Stage&& stage);
+
+			// Run every stage whose name contains filter (all if empty), in registration order
+			std::vector<StageResult> Run(const std::string& filter) const;
+
+			// Stable, line-oriented JSON so results from two commits can be diffed directly
+			static void WriteJson(std::ostream& os, const std::string& label, const std::vector<StageResult>& results);
+			static void WriteTable(std::ostream& os, const std::vector<StageResult>& results);
+
+		private:
+			StageResult RunStage(const Stage& stage) const;
+
+			size_t				m_Iterations;
+			size_t				m_Warmup;
+			std::vector<Stage>	m_Stages;
+		};
+
+		struct Options
+		{
+			Options();
+
+			size_t		Iterations;
+			size_t		Warmup;
+			std::string	Filter;
+			std::string	Label;
+			// Recorded HandFrame session (HandFrameRecorder), synthetic hands if empty
+			std::string	ReplayFile;
+			// OBJ model to load, a generated sphere if empty
+			std::string	ObjFile;
+			// Write JSON here, "-" for stdout
+			std::string	JsonFile;
+		};
+
+		// Register the simulation core stages
+		void RegisterStages(Runner& runner, const Options& options);
+	}
+}
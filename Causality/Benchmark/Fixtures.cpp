@@ -0,0 +1,279 @@
+#include "Fixtures.h"
+#include <fstream>
+#include <random>
+
+using namespace Causality;
+using namespace Causality::Benchmark;
+using namespace DirectX;
+using namespace Platform;
+using namespace std;
+
+// Same as LeapMotion's default coordinate : millimeter to meter, device 20cm below and 50cm in front of the eye
+static XMMATRIX DefaultLeapTransform()
+{
+	return XMMatrixScalingFromVector(XMVectorReplicate(0.001f)) * XMMatrixTranslation(0, -0.20f, -0.50f);
+}
+
+HandFrame Causality::Benchmark::SyntheticHandFrame(size_t index)
+{
+	HandFrame frame;
+	frame.Id = static_cast<int64_t>(index);
+	frame.Timestamp = static_cast<int64_t>(index * 1000000 / 60);
+	XMStoreFloat4x4(&frame.ToWorld, DefaultLeapTransform());
+	frame.HandCount = 1;
+
+	float t = index * StepTime;
+	auto& hand = frame.HandStates[0];
+	hand.Id = 1;
+	hand.IsLeft = 0;
+	hand.Confidence = 1.0f;
+	hand.GrabStrength = 0.5f + 0.5f * sinf(t);
+	hand.PalmPosition = XMFLOAT3(60.0f * cosf(t), 175.0f + 25.0f * sinf(2 * t), 60.0f * sinf(t));
+	hand.PalmNormal = XMFLOAT3(0, -1, 0);
+	hand.PalmVelocity = XMFLOAT3(-60.0f * sinf(t), 50.0f * cosf(2 * t), 60.0f * cosf(t));
+	hand.Direction = XMFLOAT3(0, 0, -1);
+
+	float curl = 0.4f + 0.3f * sinf(1.5f * t);
+	for (int f = 0; f < HandState::FingerCount; f++)
+	{
+		XMFLOAT3 joint(hand.PalmPosition.x + (f - 2) * 18.0f, hand.PalmPosition.y, hand.PalmPosition.z + 10.0f);
+		float pitch = 0;
+		for (int b = 0; b < HandState::BonePerFinger; b++)
+		{
+			// Thumb's metacarpal has zero length, as Leap reports
+			float length = (f == 0 && b == 0) ? 0.0f : 40.0f - 8.0f * b;
+			auto& bone = hand.Bones[f * HandState::BonePerFinger + b];
+			bone.PrevJoint = joint;
+			joint.y -= length * sinf(pitch);
+			joint.z -= length * cosf(pitch);
+			bone.NextJoint = joint;
+			pitch += curl;
+		}
+	}
+	return frame;
+}
+
+std::unique_ptr<WorldBranch> Causality::Benchmark::CreateBranchTree(const HandFrame& firstFrame)
+{
+	static bool poolInitialized = false;
+	if (!poolInitialized)
+	{
+		WorldBranch::InitializeBranchPool(30);
+		poolInitialized = true;
+	}
+
+	auto pRoot = WorldBranch::DemandCreate("Root");
+	std::shared_ptr<btCollisionShape> pFloor(new btBoxShape(btVector3(1.0f, 0.01f, 1.0f)));
+	pRoot->AddDynamicObject(0, pFloor, 0, Vector3(0, -0.30f, -0.50f), Quaternion::Identity);
+	std::shared_ptr<btCollisionShape> pCube(new btBoxShape(btVector3(0.025f, 0.025f, 0.025f)));
+	unsigned id = 1;
+	for (int y = 0; y < 2; y++)
+		for (int x = 0; x < 4; x++)
+			for (int z = 0; z < 4; z++)
+				pRoot->AddDynamicObject(id++, pCube, 1.0f, Vector3(-0.09f + 0.06f * x, -0.26f + 0.06f * y, -0.59f + 0.06f * z), Quaternion::Identity);
+
+	std::vector<AffineTransform> subjectTrans(20);
+	for (size_t i = 0; i < subjectTrans.size(); i++)
+		subjectTrans[i].Scale = XMVectorReplicate(1.1f + 0.15f * i);
+	pRoot->Fork(subjectTrans);
+	pRoot->Enable(AffineTransform::Identity());
+
+	Matrix4x4 toWorld = XMLoadFloat4x4(&firstFrame.ToWorld);
+	for (auto& branch : pRoot->leaves())
+		for (const auto& hand : firstFrame.hands())
+			branch.AddSubjectiveObject(hand, toWorld);
+	return pRoot;
+}
+
+size_t Causality::Benchmark::LeafCount(WorldBranch& tree)
+{
+	size_t count = 0;
+	for (auto& leaf : tree.leaves())
+		count++;
+	return count;
+}
+
+// Thumb's base, then the next joint of every bone, finger by finger
+static void XM_CALLCONV HandJoints(TraceJoints& joints, const HandState& hand, FXMMATRIX leap2world)
+{
+	for (int f = 0; f < HandState::FingerCount; f++)
+	{
+		joints[f * 5] = XMVector3Transform(XMLoadFloat3(&hand.Bone(f, 0).PrevJoint), leap2world);
+		for (int b = 0; b < HandState::BonePerFinger; b++)
+			joints[f * 5 + b + 1] = XMVector3Transform(XMLoadFloat3(&hand.Bone(f, b).NextJoint), leap2world);
+	}
+}
+
+void XM_CALLCONV Causality::Benchmark::PushTrace(std::deque<TraceJoints>& trace, const HandFrame& frame)
+{
+	XMMATRIX leap2world = XMLoadFloat4x4(&frame.ToWorld);
+	for (const auto& hand : frame.hands())
+	{
+		trace.emplace_back();
+		HandJoints(trace.back(), hand, leap2world);
+	}
+	while (trace.size() > TraceLength)
+		trace.pop_front();
+}
+
+void XM_CALLCONV Causality::Benchmark::PushTrace(TraceWindow& trace, StreamingOrientedBox& estimator, const HandFrame& frame)
+{
+	XMMATRIX leap2world = XMLoadFloat4x4(&frame.ToWorld);
+	for (const auto& hand : frame.hands())
+	{
+		if (trace.full())
+			estimator.Remove(trace.front().data(), trace.front().size());
+		auto& joints = trace.push_back();
+		HandJoints(joints, hand, leap2world);
+		estimator.Add(joints.data(), joints.size());
+	}
+}
+
+std::vector<std::pair<Vector3, Vector3>> Causality::Benchmark::HandSegments(const HandFrame& frame)
+{
+	std::vector<std::pair<Vector3, Vector3>> segments;
+	XMMATRIX leap2world = XMLoadFloat4x4(&frame.ToWorld);
+	for (const auto& bone : frame.HandStates[0].Bones)
+		segments.emplace_back(XMVector3Transform(XMLoadFloat3(&bone.PrevJoint), leap2world), XMVector3Transform(XMLoadFloat3(&bone.NextJoint), leap2world));
+	return segments;
+}
+
+std::vector<Vector3> Causality::Benchmark::FieldSamplePoints(const HandFrame& frame)
+{
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&frame.HandStates[0].PalmPosition), XMLoadFloat4x4(&frame.ToWorld));
+	std::vector<Vector3> points;
+	for (int x = 0; x < FieldGridSize; x++)
+		for (int y = 0; y < FieldGridSize; y++)
+			for (int z = 0; z < FieldGridSize; z++)
+			{
+				XMVECTOR offset = XMVectorSet(x + 0.5f, y + 0.5f, z + 0.5f, 0) * (0.4f / FieldGridSize) - XMVectorReplicate(0.2f);
+				points.push_back(center + offset);
+			}
+	return points;
+}
+
+void Causality::Benchmark::SyntheticSuperposition(SuperpositionTable& table, std::vector<BoundingOrientedBox>& bounds, std::vector<uint32_t>& batchKeys)
+{
+	std::mt19937 gen(11);
+	std::uniform_real_distribution<float> position(-3.0f, 3.0f), unit(0.0f, 1.0f), extent(0.02f, 0.2f);
+	std::vector<uint32_t> counts(DrawObjectCount);
+	size_t stateCount = 0;
+	for (auto& count : counts)
+		stateCount += count = 1 + gen() % 4;
+	table.Resize(DrawObjectCount, stateCount);
+	bounds.resize(DrawObjectCount);
+	batchKeys.resize(DrawObjectCount);
+
+	uint32_t offset = 0;
+	for (size_t id = 0; id < DrawObjectCount; id++)
+	{
+		table.Objects[id].Offset = offset;
+		table.Objects[id].Count = counts[id];
+		bounds[id] = BoundingOrientedBox(XMFLOAT3(0, 0, 0), XMFLOAT3(extent(gen), extent(gen), extent(gen)), XMFLOAT4(0, 0, 0, 1));
+		batchKeys[id] = gen() % 16;
+		for (uint32_t state = offset; state < offset + counts[id]; state++)
+		{
+			table.Positions[state] = Vector3(position(gen), position(gen), position(gen));
+			table.Orientations[state] = XMQuaternionNormalize(XMVectorSet(unit(gen), unit(gen), unit(gen), unit(gen)));
+			table.Scales[state] = Vector3(1.0f);
+			table.Probabilities[state] = counts[id] == 1 ? 1.0f : unit(gen);
+		}
+		offset += counts[id];
+	}
+}
+
+void Causality::Benchmark::StereoFrustums(BoundingFrustum frustums[2])
+{
+	XMMATRIX projection = XMMatrixPerspectiveFovRH(XM_PIDIV2, 0.9f, 0.01f, 100.0f);
+	for (int eye = 0; eye < 2; eye++)
+	{
+		BoundingFrustumExtension::CreateFromMatrixRH(frustums[eye], projection);
+		frustums[eye].Transform(frustums[eye], XMMatrixTranslation(eye ? 0.032f : -0.032f, 0, 0));
+	}
+}
+
+std::vector<Vector3> Causality::Benchmark::ElongatedCloud(size_t count)
+{
+	std::mt19937 gen(11);
+	std::normal_distribution<float> normal;
+	XMMATRIX transform = XMMatrixRotationRollPitchYaw(0.3f, 0.6f, 0.9f) * XMMatrixTranslation(1000.0f, -300.0f, 50.0f);
+	std::vector<Vector3> points(count);
+	for (auto& p : points)
+		p = XMVector3Transform(XMVectorSet(normal(gen) * 5.0f, normal(gen) * 2.0f, normal(gen) * 0.5f, 1.0f), transform);
+	return points;
+}
+
+void Causality::Benchmark::WriteSphereObj(const std::string& path, int slices, int stacks, int parts)
+{
+	std::ofstream obj(path);
+	int base = 0;
+	for (int part = 0; part < parts; part++)
+	{
+		obj << "o Sphere" << part << "\n";
+		for (int i = 0; i <= stacks; i++)
+		{
+			float phi = XM_PI * i / stacks;
+			for (int j = 0; j < slices; j++)
+			{
+				float theta = XM_2PI * j / slices;
+				obj << "v " << 2.5f * part + sinf(phi) * cosf(theta) << ' ' << cosf(phi) << ' ' << sinf(phi) * sinf(theta) << "\n";
+			}
+		}
+		for (int i = 0; i < stacks; i++)
+		{
+			for (int j = 0; j < slices; j++)
+			{
+				int a = base + i * slices + j + 1, b = base + i * slices + (j + 1) % slices + 1;
+				int c = a + slices, d = b + slices;
+				obj << "f " << a << ' ' << c << ' ' << d << "\n";
+				obj << "f " << a << ' ' << d << ' ' << b << "\n";
+			}
+		}
+		base += (stacks + 1) * slices;
+	}
+}
+
+// The seam column is repeated with u = 1, as a texture seam would be
+void Causality::Benchmark::WriteTexturedSphereObj(const std::string& path, int slices, int stacks)
+{
+	std::ofstream obj(path);
+	obj << "o Sphere\n";
+	for (int i = 0; i <= stacks; i++)
+	{
+		float phi = XM_PI * i / stacks;
+		for (int j = 0; j <= slices; j++)
+		{
+			float theta = XM_2PI * j / slices;
+			obj << "v " << sinf(phi) * cosf(theta) << ' ' << cosf(phi) << ' ' << sinf(phi) * sinf(theta) << "\n";
+			obj << "vt " << float(j) / slices << ' ' << float(i) / stacks << "\n";
+		}
+	}
+	for (int i = 0; i < stacks; i++)
+	{
+		for (int j = 0; j < slices; j++)
+		{
+			int a = i * (slices + 1) + j + 1, b = a + 1;
+			int c = a + slices + 1, d = b + slices + 1;
+			obj << "f " << a << '/' << a << ' ' << c << '/' << c << ' ' << d << '/' << d << "\n";
+			obj << "f " << a << '/' << a << ' ' << d << '/' << d << ' ' << b << '/' << b << "\n";
+		}
+	}
+}
+
+boost::filesystem::path Causality::Benchmark::CacheFileFor(const boost::filesystem::path& file)
+{
+	auto dir = boost::filesystem::temp_directory_path() / "causality_benchmark";
+	boost::filesystem::create_directories(dir);
+	return dir / file.filename().replace_extension(".meshcache");
+}
+
+void Causality::Benchmark::LoadObj(DirectX::Scene::GeometryModel& model, const boost::filesystem::path& file, unsigned loadFlags)
+{
+	DirectX::Scene::GeometryModel::CreateFromObjFile(&model, nullptr, file.wstring(), file.parent_path().wstring(), loadFlags, CacheFileFor(file).wstring());
+}
+
+void Causality::Benchmark::LoadObjUncached(DirectX::Scene::GeometryModel& model, const boost::filesystem::path& file, unsigned loadFlags)
+{
+	boost::filesystem::remove(CacheFileFor(file));
+	LoadObj(model, file, loadFlags);
+}
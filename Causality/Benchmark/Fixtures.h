@@ -0,0 +1,66 @@
+#pragma once
+#include "..\pch_bullet.h"
+#include "..\WorldBranch.h"
+#include "..\Common\Model.h"
+#include "..\Common\RingBuffer.h"
+#include "..\Common\StreamingOrientedBox.h"
+#include <boost\filesystem.hpp>
+#include <deque>
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace Causality
+{
+	// Workloads shared by the benchmark stages and the unit tests, deterministic so runs can be compared
+	namespace Benchmark
+	{
+		// One device frame at 60Hz
+		const float		StepTime = 1.0f / 60.0f;
+		const size_t	TraceLength = 60;
+		const size_t	TracePlotSize = 45;
+		const int		FieldGridSize = 10;
+		const size_t	DrawObjectCount = 4000;
+
+		// Joints of one hand per frame, as WorldScene traces them
+		typedef std::array<DirectX::Vector3, 25>				TraceJoints;
+		typedef RingBuffer<TraceJoints, TracePlotSize>			TraceWindow;
+
+		// Deterministic right hand circling above the device with slowly curling fingers
+		Platform::HandFrame SyntheticHandFrame(size_t index);
+
+		// The branch tree WorldScene builds : a floor, a pile of cubes under the hand and 20 forked hand scales
+		std::unique_ptr<WorldBranch> CreateBranchTree(const Platform::HandFrame& firstFrame);
+		size_t LeafCount(WorldBranch& tree);
+
+		// Keeps the last TraceLength hands
+		void XM_CALLCONV PushTrace(std::deque<TraceJoints>& trace, const Platform::HandFrame& frame);
+		// Keeps the estimator in step with the window
+		void XM_CALLCONV PushTrace(TraceWindow& trace, StreamingOrientedBox& estimator, const Platform::HandFrame& frame);
+
+		// Bones of the frame's first hand in world space, as HandPhysicalModel keeps them
+		std::vector<std::pair<DirectX::Vector3, DirectX::Vector3>> HandSegments(const Platform::HandFrame& frame);
+		// Grid of field sample points in a 40cm box around the hand
+		std::vector<DirectX::Vector3> FieldSamplePoints(const Platform::HandFrame& frame);
+
+		// DrawObjectCount objects scattered around the viewer with 1 to 4 states each, single state ones opaque
+		void SyntheticSuperposition(SuperpositionTable& table, std::vector<DirectX::BoundingOrientedBox>& bounds, std::vector<uint32_t>& batchKeys);
+		// Two eyes 6.4cm apart looking down -z, as a stereo camera's views
+		void StereoFrustums(DirectX::BoundingFrustum frustums[2]);
+
+		// Rotated, elongated gaussian cloud far from the origin
+		std::vector<DirectX::Vector3> ElongatedCloud(size_t count);
+
+		// Tessellated unit spheres, one OBJ object each and spaced along x
+		void WriteSphereObj(const std::string& path, int slices, int stacks, int parts = 1);
+		// Unit sphere with texture coordinates and no normals, u around y and v from pole to pole
+		void WriteTexturedSphereObj(const std::string& path, int slices, int stacks);
+
+		// Mesh caches live in the temp directory, the one next to a user's model is never read, written or removed
+		boost::filesystem::path CacheFileFor(const boost::filesystem::path& file);
+		// From the mesh cache when it is up to date, without device resources
+		void LoadObj(DirectX::Scene::GeometryModel& model, const boost::filesystem::path& file, unsigned loadFlags = DirectX::Scene::ModelLoad_Default);
+		// First load : the mesh cache is removed, so the OBJ is parsed, processed and the cache written again
+		void LoadObjUncached(DirectX::Scene::GeometryModel& model, const boost::filesystem::path& file, unsigned loadFlags = DirectX::Scene::ModelLoad_Default);
+	}
+}
@@ -0,0 +1,490 @@
+#include "Benchmark.h"
+#include "Fixtures.h"
+#include "..\ShapeDescriptorIndex.h"
+#include "..\DrawListBuilder.h"
+#include "..\HandFrameStream.h"
+#include "..\Common\MetaBallModel.h"
+#include "..\Common\SpaceCurve.h"
+#include "..\Common\ObjParser.h"
+#include "..\Common\TangentFrame.h"
+#include "..\Common\BoundsFitter.h"
+#include "..\Common\Logger.h"
+#include <VertexTypes.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using namespace Causality;
+using namespace Causality::Benchmark;
+using namespace DirectX;
+using namespace Platform;
+using namespace Platform::Devices;
+using namespace std;
+
+static const size_t	SyntheticFrameCount = 600;
+static const size_t	CandidateShapeCount = 500;
+static const size_t	LogCallsPerFrame = 64;
+static const size_t	BoundsPointCount = 1 << 20;
+
+static std::vector<HandFrame> LoadFrames(const Options& options)
+{
+	std::vector<HandFrame> frames;
+	if (!options.ReplayFile.empty())
+	{
+		HandFrameReplay replay;
+		if (replay.Open(options.ReplayFile))
+		{
+			frames.resize(replay.FrameCount());
+			for (size_t i = 0; i < frames.size(); i++)
+				replay.ReadFrame(i, frames[i]);
+		}
+		else
+			std::cerr << "Can not open replay " << options.ReplayFile << ", using synthetic hands." << std::endl;
+	}
+	if (frames.empty())
+	{
+		frames.resize(SyntheticFrameCount);
+		for (size_t i = 0; i < frames.size(); i++)
+			frames[i] = SyntheticHandFrame(i);
+	}
+	return frames;
+}
+
+// The --obj model, or a sphere written to the temp directory
+static boost::filesystem::path ObjFileOrSphere(const Options& options)
+{
+	if (!options.ObjFile.empty())
+		return options.ObjFile;
+	auto file = boost::filesystem::temp_directory_path() / "causality_benchmark_sphere.obj";
+	WriteSphereObj(file.string(), 128, 64);
+	return file;
+}
+
+void Causality::Benchmark::RegisterStages(Runner & runner, const Options & options)
+{
+	auto pFrames = std::make_shared<std::vector<HandFrame>>(LoadFrames(options));
+
+	// WorldBranch::Evolution over all leaves, one device frame per iteration
+	{
+		auto pTree = std::make_shared<std::unique_ptr<WorldBranch>>();
+		runner.Add(Stage{ "branch_evolution",
+			[=]() -> size_t {
+				*pTree = CreateBranchTree(pFrames->front());
+				return LeafCount(**pTree);
+			},
+			[=](size_t i) {
+				const auto& frame = (*pFrames)[i % pFrames->size()];
+				(*pTree)->Evolution(StepTime, frame, XMLoadFloat4x4(&frame.ToWorld));
+			} });
+	}
+
+	// Same without the shared object world, every leaf simulates every cube
+	{
+		auto pTree = std::make_shared<std::unique_ptr<WorldBranch>>();
+		runner.Add(Stage{ "branch_evolution_unshared",
+			[=]() -> size_t {
+				WorldBranch::ShareUntouchedObjects = false;
+				*pTree = CreateBranchTree(pFrames->front());
+				WorldBranch::ShareUntouchedObjects = true;
+				return LeafCount(**pTree);
+			},
+			[=](size_t i) {
+				const auto& frame = (*pFrames)[i % pFrames->size()];
+				(*pTree)->Evolution(StepTime, frame, XMLoadFloat4x4(&frame.ToWorld));
+			} });
+	}
+
+	// Superposition clustering of every object across all leaves
+	{
+		auto pTree = std::make_shared<std::unique_ptr<WorldBranch>>();
+		auto pTable = std::make_shared<SuperpositionTable>();
+		runner.Add(Stage{ "superposition",
+			[=]() -> size_t {
+				*pTree = CreateBranchTree(pFrames->front());
+				for (size_t i = 0; i < 30; i++)
+				{
+					const auto& frame = (*pFrames)[i % pFrames->size()];
+					(*pTree)->Evolution(StepTime, frame, XMLoadFloat4x4(&frame.ToWorld));
+				}
+				(*pTree)->CaculateSuperposition(*pTable);
+				return LeafCount(**pTree) * pTable->ObjectCount();
+			},
+			[=](size_t) {
+				(*pTree)->CaculateSuperposition(*pTable);
+			} });
+	}
+
+	// Hand trace bounding box as WorldScene does, a new frame per iteration
+	{
+		auto pTrace = std::make_shared<TraceWindow>();
+		auto pEstimator = std::make_shared<StreamingOrientedBox>();
+		runner.Add(Stage{ "hand_trace_obb",
+			[=]() -> size_t {
+				for (size_t i = 0; i < TraceLength; i++)
+					PushTrace(*pTrace, *pEstimator, (*pFrames)[i % pFrames->size()]);
+				return TracePlotSize * 25;
+			},
+			[=](size_t i) {
+				PushTrace(*pTrace, *pEstimator, (*pFrames)[(TraceLength + i) % pFrames->size()]);
+				BoundingOrientedBox box;
+				pEstimator->GetBox(box);
+			} });
+	}
+
+	// Same box rebuilt from every point of the window, as it was before the streaming estimator
+	{
+		auto pTrace = std::make_shared<std::deque<TraceJoints>>();
+		auto pPoints = std::make_shared<std::vector<Vector3>>();
+		runner.Add(Stage{ "hand_trace_obb_rebuild",
+			[=]() -> size_t {
+				for (size_t i = 0; i < TraceLength; i++)
+					PushTrace(*pTrace, (*pFrames)[i % pFrames->size()]);
+				return TracePlotSize * 25;
+			},
+			[=](size_t i) {
+				PushTrace(*pTrace, (*pFrames)[(TraceLength + i) % pFrames->size()]);
+				pPoints->clear();
+				for (int k = (int) pTrace->size() - 1; k >= std::max(0, (int) pTrace->size() - (int) TracePlotSize); k--)
+					pPoints->insert(pPoints->end(), (*pTrace)[k].begin(), (*pTrace)[k].end());
+				BoundingOrientedBox box;
+				CreateBoundingOrientedBoxFromPoints(box, pPoints->size(), pPoints->data(), sizeof(Vector3));
+			} });
+	}
+
+	// Rank a scene set of candidate shapes against the hand, once per hand update
+	{
+		auto pIndex = std::make_shared<ShapeDescriptorIndex>();
+		auto pHand = std::make_shared<ShapeDescriptor>();
+		auto pSimilarities = std::make_shared<std::vector<float>>();
+		auto pTopK = std::make_shared<std::vector<ShapeDescriptorIndex::Match>>();
+		runner.Add(Stage{ "shape_rank",
+			[=]() -> size_t {
+				std::mt19937 gen(7);
+				std::uniform_real_distribution<float> extent(0.01f, 0.5f);
+				std::vector<float> parts;
+				pIndex->Clear();
+				for (unsigned id = 0; id < CandidateShapeCount; id++)
+				{
+					XMFLOAT3 extents(extent(gen), extent(gen), extent(gen));
+					parts.resize(gen() % 8);
+					for (auto& part : parts)
+						part = extent(gen) * 0.5f;
+					pIndex->Add(id, ShapeDescriptor::Create(extents, parts.data(), parts.size()));
+				}
+				const auto& joints = pFrames->front().HandStates[0].Bones;
+				float boneSizes[HandState::BoneCount];
+				for (int i = 0; i < HandState::BoneCount; i++)
+					boneSizes[i] = 0.5f * XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&joints[i].NextJoint), XMLoadFloat3(&joints[i].PrevJoint))));
+				*pHand = ShapeDescriptor::Create(XMFLOAT3(120.0f, 60.0f, 30.0f), boneSizes, HandState::BoneCount);
+				return CandidateShapeCount;
+			},
+			[=](size_t) {
+				pIndex->Query(*pHand, 5, *pSimilarities, *pTopK);
+			} });
+	}
+
+	// Culled and sorted draw list of every state for both eyes
+	{
+		auto pTable = std::make_shared<SuperpositionTable>();
+		auto pBounds = std::make_shared<std::vector<BoundingOrientedBox>>();
+		auto pBatchKeys = std::make_shared<std::vector<uint32_t>>();
+		auto pBuilder = std::make_shared<DrawListBuilder>();
+		runner.Add(Stage{ "draw_list",
+			[=]() -> size_t {
+				SyntheticSuperposition(*pTable, *pBounds, *pBatchKeys);
+				BoundingFrustum frustums[2];
+				StereoFrustums(frustums);
+				pBuilder->SetViews(frustums, 2);
+				return pTable->StateCount();
+			},
+			[=](size_t) {
+				pBuilder->Build(*pTable, pBounds->data(), pBatchKeys->data(), DrawObjectCount);
+			} });
+	}
+
+	// Same draw list culled on one thread
+	{
+		auto pTable = std::make_shared<SuperpositionTable>();
+		auto pBounds = std::make_shared<std::vector<BoundingOrientedBox>>();
+		auto pBatchKeys = std::make_shared<std::vector<uint32_t>>();
+		auto pBuilder = std::make_shared<DrawListBuilder>();
+		runner.Add(Stage{ "draw_list_serial",
+			[=]() -> size_t {
+				SyntheticSuperposition(*pTable, *pBounds, *pBatchKeys);
+				BoundingFrustum frustums[2];
+				StereoFrustums(frustums);
+				pBuilder->SetViews(frustums, 2);
+				return pTable->StateCount();
+			},
+			[=](size_t) {
+				pBuilder->BuildSerial(*pTable, pBounds->data(), pBatchKeys->data(), DrawObjectCount);
+			} });
+	}
+
+	// A frame's worth of log calls, then a flush so queues never fill up between iterations
+	// Includes the sink's formatting, so it bounds the caller side cost from above
+	{
+		runner.Add(Stage{ "log_write",
+			[=]() -> size_t {
+				Logger::Start(false);
+				return LogCallsPerFrame;
+			},
+			[=](size_t i) {
+				for (size_t call = 0; call < LogCallsPerFrame; call++)
+					LOG_INFO(Log_Render, "Model %s state %u opacity %.3f", "Cube", static_cast<unsigned>(call), 0.5f);
+				Logger::Flush();
+			} });
+	}
+
+	// Hand force field, one point and one bone at a time
+	{
+		auto pSegments = std::make_shared<std::vector<std::pair<Vector3, Vector3>>>();
+		auto pPoints = std::make_shared<std::vector<Vector3>>();
+		auto pFields = std::make_shared<std::vector<Vector3>>();
+		runner.Add(Stage{ "hand_field_scalar",
+			[=]() -> size_t {
+				*pSegments = HandSegments(pFrames->front());
+				*pPoints = FieldSamplePoints(pFrames->front());
+				pFields->resize(pPoints->size());
+				return pPoints->size();
+			},
+			[=](size_t) {
+				for (size_t i = 0; i < pPoints->size(); i++)
+				{
+					XMVECTOR field = XMVectorZero();
+					for (const auto& segment : *pSegments)
+						field += FieldSegmentToPoint((*pPoints)[i], segment.first, segment.second);
+					(*pFields)[i] = field;
+				}
+			} });
+	}
+
+	// Hand force field batched over points
+	{
+		auto pBatch = std::make_shared<SegmentFieldBatch>();
+		auto pPoints = std::make_shared<std::vector<Vector3>>();
+		auto pFields = std::make_shared<std::vector<Vector3>>();
+		runner.Add(Stage{ "hand_field_batch",
+			[=]() -> size_t {
+				auto segments = HandSegments(pFrames->front());
+				pBatch->Reset(segments.data(), segments.size());
+				*pPoints = FieldSamplePoints(pFrames->front());
+				pFields->resize(pPoints->size());
+				return pPoints->size();
+			},
+			[=](size_t) {
+				pBatch->Evaluate(pPoints->data(), pFields->data(), pPoints->size());
+			} });
+	}
+
+	// Metaball surface of the hand joints
+	{
+		auto pModel = std::make_shared<Geometrics::MetaBallModel>();
+		auto pVertices = std::make_shared<std::vector<VertexPositionNormal>>();
+		auto pIndices = std::make_shared<std::vector<uint16_t>>();
+		runner.Add(Stage{ "metaball_tessellation",
+			[=]() -> size_t {
+				std::deque<TraceJoints> trace;
+				PushTrace(trace, pFrames->front());
+				for (const auto& joint : trace.back())
+					pModel->push_back(Geometrics::Metaball(joint, 0.015f));
+				pModel->SetISO(0.33333f);
+				pModel->Update();
+				pModel->Tessellate(*pVertices, *pIndices, 0.005f);
+				return pVertices->size();
+			},
+			[=](size_t) {
+				pModel->Tessellate(*pVertices, *pIndices, 0.005f);
+			} });
+	}
+
+	// Palm trajectory resampling
+	{
+		auto pTrajectory = std::make_shared<std::vector<Vector3>>();
+		runner.Add(Stage{ "spacecurve_resample",
+			[=]() -> size_t {
+				for (const auto& frame : *pFrames)
+				{
+					XMMATRIX leap2world = XMLoadFloat4x4(&frame.ToWorld);
+					for (const auto& hand : frame.hands())
+						pTrajectory->push_back(XMVector3Transform(XMLoadFloat3(&hand.PalmPosition), leap2world));
+				}
+				return pTrajectory->size();
+			},
+			[=](size_t) {
+				Geometrics::SpaceCurve curve(*pTrajectory);
+				curve.FixCountSampling(64);
+				curve.FixIntervalSampling(0.005f);
+			} });
+	}
+
+	// OBJ parsing and CPU-side mesh processing, without device resources
+	// The mesh cache is removed before each run, so this is a first load : parse, process and write the cache
+	{
+		auto pFile = std::make_shared<boost::filesystem::path>();
+		runner.Add(Stage{ "obj_load",
+			[=]() -> size_t {
+				*pFile = ObjFileOrSphere(options);
+				DirectX::Scene::GeometryModel model;
+				LoadObjUncached(model, *pFile);
+				return model.Vertices.size();
+			},
+			[=](size_t) {
+				DirectX::Scene::GeometryModel model;
+				LoadObjUncached(model, *pFile);
+			} });
+	}
+
+	// OBJ text to shapes only, and the bundled tiny_obj_loader on the same file
+	{
+		auto pFile = std::make_shared<boost::filesystem::path>();
+		auto setup = [=]() -> size_t {
+			*pFile = ObjFileOrSphere(options);
+			std::vector<tinyobj::shape_t> shapes;
+			std::vector<tinyobj::material_t> materials;
+			DirectX::Scene::ObjParser::Load(shapes, materials, pFile->wstring());
+			size_t vertices = 0;
+			for (const auto& shape : shapes)
+				vertices += shape.mesh.positions.size() / 3;
+			return vertices;
+		};
+		runner.Add(Stage{ "obj_parse", setup,
+			[=](size_t) {
+				std::vector<tinyobj::shape_t> shapes;
+				std::vector<tinyobj::material_t> materials;
+				DirectX::Scene::ObjParser::Load(shapes, materials, pFile->wstring());
+			} });
+		runner.Add(Stage{ "obj_parse_tinyobj", setup,
+			[=](size_t) {
+				std::vector<tinyobj::shape_t> shapes;
+				std::vector<tinyobj::material_t> materials;
+				tinyobj::LoadObj(shapes, materials, pFile->string().c_str(), (pFile->parent_path().string() + "/").c_str());
+			} });
+	}
+
+	// Same file again, loaded from the mesh cache the first load left behind
+	{
+		auto pFile = std::make_shared<boost::filesystem::path>();
+		runner.Add(Stage{ "obj_load_cached",
+			[=]() -> size_t {
+				*pFile = ObjFileOrSphere(options);
+				DirectX::Scene::GeometryModel model;
+				LoadObjUncached(model, *pFile);
+				return model.Vertices.size();
+			},
+			[=](size_t) {
+				DirectX::Scene::GeometryModel model;
+				LoadObj(model, *pFile);
+			} });
+	}
+
+	// Many part OBJ, parts are processed in parallel
+	{
+		auto pFile = std::make_shared<boost::filesystem::path>(boost::filesystem::temp_directory_path() / "causality_benchmark_spheres.obj");
+		runner.Add(Stage{ "obj_load_parts",
+			[=]() -> size_t {
+				WriteSphereObj(pFile->string(), 64, 32, 16);
+				DirectX::Scene::GeometryModel model;
+				LoadObjUncached(model, *pFile);
+				return model.Vertices.size();
+			},
+			[=](size_t) {
+				DirectX::Scene::GeometryModel model;
+				LoadObjUncached(model, *pFile);
+			} });
+	}
+
+	// One part over the 16 bit index range, cut into meshlets
+	{
+		auto pFile = std::make_shared<boost::filesystem::path>(boost::filesystem::temp_directory_path() / "causality_benchmark_large_sphere.obj");
+		runner.Add(Stage{ "obj_load_split",
+			[=]() -> size_t {
+				using namespace DirectX::Scene;
+				WriteSphereObj(pFile->string(), 512, 256);
+				GeometryModel model;
+				LoadObjUncached(model, *pFile, ModelLoad_SplitLargeParts);
+				return model.Vertices.size();
+			},
+			[=](size_t) {
+				using namespace DirectX::Scene;
+				GeometryModel model;
+				LoadObjUncached(model, *pFile, ModelLoad_SplitLargeParts);
+			} });
+	}
+
+	// Vertex cache and overdraw ordering on load
+	{
+		auto pFile = std::make_shared<boost::filesystem::path>(boost::filesystem::temp_directory_path() / "causality_benchmark_spheres.obj");
+		runner.Add(Stage{ "obj_load_optimized",
+			[=]() -> size_t {
+				using namespace DirectX::Scene;
+				WriteSphereObj(pFile->string(), 64, 32, 16);
+				GeometryModel model;
+				LoadObjUncached(model, *pFile, ModelLoad_OptimizeVertexCache | ModelLoad_OptimizeOverdraw);
+				return model.Vertices.size();
+			},
+			[=](size_t) {
+				using namespace DirectX::Scene;
+				GeometryModel model;
+				LoadObjUncached(model, *pFile, ModelLoad_OptimizeVertexCache | ModelLoad_OptimizeOverdraw);
+			} });
+	}
+
+	// Level of detail chains, simplified on load and written to the mesh cache with the part
+	{
+		auto pFile = std::make_shared<boost::filesystem::path>(boost::filesystem::temp_directory_path() / "causality_benchmark_lod_sphere.obj");
+		runner.Add(Stage{ "obj_load_lods",
+			[=]() -> size_t {
+				using namespace DirectX::Scene;
+				WriteSphereObj(pFile->string(), 128, 64);
+				GeometryModel model;
+				LoadObjUncached(model, *pFile, ModelLoad_OptimizeVertexCache | ModelLoad_GenerateLods);
+				return model.Facets.size();
+			},
+			[=](size_t) {
+				using namespace DirectX::Scene;
+				GeometryModel model;
+				LoadObjUncached(model, *pFile, ModelLoad_OptimizeVertexCache | ModelLoad_GenerateLods);
+			} });
+	}
+
+	// Normals and tangent frames of a textured sphere, generated again from the loaded model
+	{
+		auto pFile = std::make_shared<boost::filesystem::path>(boost::filesystem::temp_directory_path() / "causality_benchmark_textured_sphere.obj");
+		auto pModel = std::make_shared<DirectX::Scene::GeometryModel>();
+		runner.Add(Stage{ "obj_load_tangents",
+			[=]() -> size_t {
+				using namespace DirectX::Scene;
+				WriteTexturedSphereObj(pFile->string(), 128, 64);
+				LoadObjUncached(*pModel, *pFile, ModelLoad_GenerateTangents);
+				return pModel->Vertices.size();
+			},
+			[=](size_t) {
+				using namespace DirectX::Scene;
+				typedef VertexPositionNormalTexture VertexType;
+				const auto& model = *pModel;
+				const auto& mesh = *model.Parts[0]->pMesh;
+				auto pIndex = reinterpret_cast<const uint32_t*>(model.Facets.data());
+				std::vector<XMFLOAT3> normals(model.Vertices.size());
+				std::vector<XMFLOAT4> tangents(model.Vertices.size());
+				TangentFrame::ComputeNormals(&model.Vertices[0].position, sizeof(VertexType), model.Vertices.size(), pIndex, mesh.IndexCount, normals.data(), sizeof(XMFLOAT3));
+				TangentFrame::ComputeTangents(&model.Vertices[0].position, sizeof(VertexType), normals.data(), sizeof(XMFLOAT3), &model.Vertices[0].textureCoordinate, sizeof(VertexType),
+					model.Vertices.size(), pIndex, mesh.IndexCount, tangents.data());
+			} });
+	}
+
+	// Box, oriented box and sphere of a rotated, elongated cloud far from the origin, in two passes
+	{
+		auto pPoints = std::make_shared<std::vector<Vector3>>();
+		runner.Add(Stage{ "bounds_fit",
+			[=]() -> size_t {
+				*pPoints = ElongatedCloud(BoundsPointCount);
+				return pPoints->size();
+			},
+			[=](size_t) {
+				using namespace DirectX::Scene;
+				PointSetBounds bounds;
+				BoundsFitter::Fit(bounds, pPoints->data(), pPoints->size(), sizeof(Vector3));
+			} });
+	}
+}
@@ -0,0 +1,95 @@
+// Headless benchmark of the simulation core, no window, device or headset required
+//
+// Usage : Benchmark [--iterations N] [--warmup N] [--filter name] [--label text]
+//                   [--replay session.hfr] [--obj model.obj] [--json out.json|-]
+// Timing only, the stages' results are checked by the UnitTest project
+#include "Benchmark.h"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace Causality::Benchmark;
+
+// Count every allocation through global operator new, so stages report allocations per iteration
+void* operator new(size_t size)
+{
+	AllocationCounter::Count.fetch_add(1, std::memory_order_relaxed);
+	AllocationCounter::Bytes.fetch_add(size, std::memory_order_relaxed);
+	void* p = std::malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+	std::free(p);
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			std::cerr << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+		if (!strcmp(arg, "--iterations"))
+			options.Iterations = std::strtoul(value, nullptr, 10);
+		else if (!strcmp(arg, "--warmup"))
+			options.Warmup = std::strtoul(value, nullptr, 10);
+		else if (!strcmp(arg, "--filter"))
+			options.Filter = value;
+		else if (!strcmp(arg, "--label"))
+			options.Label = value;
+		else if (!strcmp(arg, "--replay"))
+			options.ReplayFile = value;
+		else if (!strcmp(arg, "--obj"))
+			options.ObjFile = value;
+		else if (!strcmp(arg, "--json"))
+			options.JsonFile = value;
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return 1;
+		}
+		i++;
+	}
+
+	Runner runner(options.Iterations, options.Warmup);
+	RegisterStages(runner, options);
+	auto results = runner.Run(options.Filter);
+
+	// The table goes to stderr when stdout carries the JSON, so the JSON can be piped as is
+	if (options.JsonFile == "-")
+	{
+		Runner::WriteTable(std::cerr, results);
+		Runner::WriteJson(std::cout, options.Label, results);
+	}
+	else
+	{
+		Runner::WriteTable(std::cout, results);
+		if (!options.JsonFile.empty())
+		{
+			std::ofstream file(options.JsonFile);
+			Runner::WriteJson(file, options.Label, results);
+		}
+	}
+	return 0;
+}
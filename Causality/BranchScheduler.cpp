@@ -0,0 +1,216 @@
+#include "BranchScheduler.h"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace Causality;
+
+// Zero is kept for no owner
+static size_t CurrentThreadKey()
+{
+	return std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+}
+
+static void PinCurrentThread(unsigned core)
+{
+	unsigned cores = std::max(1U, std::thread::hardware_concurrency());
+	core %= cores;
+#if defined(_WIN32)
+	SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+	(void) core;
+#endif
+}
+
+Causality::BranchScheduler::BranchScheduler(unsigned workerCount, bool pinWorkers)
+	: m_Generation(0), m_Quit(false), m_Owner(0), m_pJob(nullptr), m_Stolen(0), m_Busy(0)
+{
+	if (workerCount == 0)
+		workerCount = std::max(1U, std::thread::hardware_concurrency());
+
+	for (unsigned i = 0; i < workerCount; i++)
+		m_Workers.emplace_back(new Worker());
+
+	// Worker 0 is the dispatching thread itself
+	for (unsigned i = 1; i < workerCount; i++)
+	{
+		m_Threads.emplace_back([this, i, pinWorkers]()
+		{
+			if (pinWorkers)
+				PinCurrentThread(i);
+			WorkerLoop(i);
+		});
+	}
+}
+
+Causality::BranchScheduler::~BranchScheduler()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_WakeLock);
+		m_Quit = true;
+	}
+	m_WakeCondition.notify_all();
+	for (auto& thread : m_Threads)
+		thread.join();
+}
+
+void Causality::BranchScheduler::Dispatch(size_t count, const std::function<void(size_t)>& job, const unsigned * affinity)
+{
+	if (count == 0)
+		return;
+
+	unsigned N = WorkerCount();
+	// Nested in a job, the workers are all held by the outer Dispatch
+	if (N == 1 || count == 1 || IsSchedulerThread())
+	{
+		for (size_t i = 0; i < count; i++)
+			job(i);
+		return;
+	}
+
+	// Waiting for the workers would stall this thread for a whole other dispatch, running inline never does
+	std::unique_lock<std::mutex> dispatchGuard(m_DispatchLock, std::try_to_lock);
+	if (!dispatchGuard.owns_lock())
+	{
+		for (size_t i = 0; i < count; i++)
+			job(i);
+		return;
+	}
+	m_Owner.store(CurrentThreadKey());
+	m_pJob = &job;
+	m_Stolen.store(0, std::memory_order_relaxed);
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned w = affinity ? affinity[i] % N : static_cast<unsigned>(i % N);
+		auto& worker = *m_Workers[w];
+		std::lock_guard<std::mutex> guard(worker.Lock);
+		worker.Queue.push_back(i);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(m_WakeLock);
+		m_Busy = N - 1;
+		++m_Generation;
+	}
+	m_WakeCondition.notify_all();
+
+	Drain(0);
+
+	// Every job runs inside some worker's Drain, so no busy worker means no job in flight
+	std::unique_lock<std::mutex> lock(m_WakeLock);
+	m_DoneCondition.wait(lock, [this]() { return m_Busy == 0; });
+	m_pJob = nullptr;
+	m_Owner.store(0);
+	std::exception_ptr exception;
+	std::swap(exception, m_Exception);
+	lock.unlock();
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+static std::once_flag g_SharedOnce;
+static std::unique_ptr<BranchScheduler> g_pShared;
+
+BranchScheduler & Causality::BranchScheduler::Shared()
+{
+	// Not a function static, MSVC 2013 doesn't initialize those thread safely
+	// Workers aren't pinned, the pool shares the cores with the render and load threads
+	std::call_once(g_SharedOnce, []() { g_pShared.reset(new BranchScheduler(0, false)); });
+	return *g_pShared;
+}
+
+bool Causality::BranchScheduler::IsSchedulerThread() const
+{
+	if (m_Owner.load() == CurrentThreadKey())
+		return true;
+	auto id = std::this_thread::get_id();
+	return std::any_of(m_Threads.begin(), m_Threads.end(), [id](const std::thread& thread) { return thread.get_id() == id; });
+}
+
+void Causality::BranchScheduler::WorkerLoop(unsigned index)
+{
+	unsigned long long seen = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_WakeLock);
+			m_WakeCondition.wait(lock, [this, seen]() { return m_Quit || m_Generation != seen; });
+			if (m_Quit)
+				return;
+			seen = m_Generation;
+		}
+
+		Drain(index);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> guard(m_WakeLock);
+			last = --m_Busy == 0;
+		}
+		if (last)
+			m_DoneCondition.notify_all();
+	}
+}
+
+void Causality::BranchScheduler::Drain(unsigned index)
+{
+	size_t job;
+	while (PopLocal(index, job) || Steal(index, job))
+	{
+		// Remaining jobs still run, so every queue is empty when the Dispatch returns
+		try
+		{
+			(*m_pJob)(job);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> guard(m_WakeLock);
+			if (!m_Exception)
+				m_Exception = std::current_exception();
+		}
+	}
+}
+
+bool Causality::BranchScheduler::PopLocal(unsigned index, size_t & job)
+{
+	auto& worker = *m_Workers[index];
+	std::lock_guard<std::mutex> guard(worker.Lock);
+	if (worker.Queue.empty())
+		return false;
+	job = worker.Queue.back();
+	worker.Queue.pop_back();
+	return true;
+}
+
+bool Causality::BranchScheduler::Steal(unsigned thief, size_t & job)
+{
+	unsigned N = WorkerCount();
+	for (unsigned k = 1; k < N; k++)
+	{
+		auto& victim = *m_Workers[(thief + k) % N];
+		std::lock_guard<std::mutex> guard(victim.Lock);
+		if (!victim.Queue.empty())
+		{
+			job = victim.Queue.front();
+			victim.Queue.pop_front();
+			m_Stolen.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <exception>
+
+namespace Causality
+{
+	// Persistent worker pool with per-worker deques and work stealing
+	// Jobs carry a worker hint, so the same branch lands on the same worker (and core) frame after frame
+	// The calling thread takes part as worker 0, so Dispatch never idles the caller
+	// Deques are std::deque behind a per-worker mutex rather than lock-free (Chase-Lev) deques,
+	// a job is a whole branch evolution, next to which an uncontended lock per pop or steal is noise
+	class BranchScheduler
+	{
+	public:
+		// workerCount == 0 means one worker per hardware thread
+		explicit BranchScheduler(unsigned workerCount = 0, bool pinWorkers = true);
+		~BranchScheduler();
+
+		BranchScheduler(const BranchScheduler&) = delete;
+		BranchScheduler& operator=(const BranchScheduler&) = delete;
+
+		unsigned WorkerCount() const { return static_cast<unsigned>(m_Workers.size()); }
+
+		// Run job(i) for i in [0,count), job i is queued on worker affinity[i] % WorkerCount()
+		// Blocks until every job has finished, the first exception a job throws is rethrown here
+		// A Dispatch from inside a job, or while another thread's Dispatch holds the workers, runs its jobs inline on the calling thread
+		void Dispatch(size_t count, const std::function<void(size_t)>& job, const unsigned* affinity = nullptr);
+
+		// Pool for data parallel loops outside branch evolution : draw list culling and model loading
+		// Branches evolve on WorldBranch::Scheduler, so the simulation thread never waits behind a load
+		static BranchScheduler& Shared();
+
+		// Number of jobs executed by a worker other than the hinted one in last Dispatch
+		size_t StolenCount() const { return m_Stolen.load(std::memory_order_relaxed); }
+
+	private:
+		struct Worker
+		{
+			std::mutex			Lock;
+			// Owner pops from back, thieves steal from front
+			std::deque<size_t>	Queue;
+		};
+
+		bool IsSchedulerThread() const;
+		void WorkerLoop(unsigned index);
+		void Drain(unsigned index);
+		bool PopLocal(unsigned index, size_t& job);
+		bool Steal(unsigned thief, size_t& job);
+
+		std::vector<std::unique_ptr<Worker>>	m_Workers;
+		std::vector<std::thread>				m_Threads;
+
+		std::mutex								m_WakeLock;
+		std::condition_variable					m_WakeCondition;
+		std::condition_variable					m_DoneCondition;
+		unsigned long long						m_Generation;
+		bool									m_Quit;
+
+		// One Dispatch at a time owns the workers and m_pJob, m_Owner identifies its thread
+		std::mutex								m_DispatchLock;
+		std::atomic<size_t>						m_Owner;
+		const std::function<void(size_t)>*		m_pJob;
+		// First exception thrown by a job of the current Dispatch, guarded by m_WakeLock
+		std::exception_ptr						m_Exception;
+		std::atomic<size_t>						m_Stolen;
+		std::atomic<unsigned>					m_Busy;
+	};
+}
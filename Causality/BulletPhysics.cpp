@@ -65,6 +65,51 @@ void Causality::PhysicalRigid::InitializePhysics(const std::shared_ptr<btDynamic
 	Enable();
 }
 
+void Causality::PhysicalRigid::InitializePhysics(const std::shared_ptr<btDynamicsWorld>& pWorld, const PhysicalRigid & prototype)
+{
+	auto pProto = prototype.GetBulletRigid();
+	float invMass = pProto->getInvMass();
+	float mass = invMass > 0 ? 1.0f / invMass : 0.0f;
+
+	m_pShape = prototype.m_pShape;
+	m_pWorld = pWorld;
+	auto pProtoState = static_cast<const btDefaultMotionState*>(pProto->getMotionState());
+	btDefaultMotionState* initalState =
+		new btDefaultMotionState(pProto->getWorldTransform(), pProtoState ? pProtoState->m_centerOfMassOffset : btTransform::getIdentity());
+	btRigidBody::btRigidBodyConstructionInfo rigidBodyCI(mass, initalState, m_pShape.get(), pProto->getLocalInertia());
+	rigidBodyCI.m_friction = pProto->getFriction();
+	rigidBodyCI.m_restitution = pProto->getRestitution();
+	rigidBodyCI.m_linearDamping = pProto->getLinearDamping();
+	rigidBodyCI.m_angularDamping = pProto->getAngularDamping();
+	m_pRigidBody = std::make_unique<btRigidBody>(rigidBodyCI);
+	m_pRigidBody->setCollisionFlags(pProto->getCollisionFlags());
+	CopyStateFrom(prototype);
+	Enable();
+}
+
+void Causality::PhysicalRigid::CopyStateFrom(const PhysicalRigid & src)
+{
+	auto pDst = m_pRigidBody.get();
+	auto pSrc = src.m_pRigidBody.get();
+	assert(pDst->getCollisionShape() == pSrc->getCollisionShape());
+
+	pDst->setWorldTransform(pSrc->getWorldTransform());
+	pDst->setInterpolationWorldTransform(pSrc->getInterpolationWorldTransform());
+	pDst->setLinearVelocity(pSrc->getLinearVelocity());
+	pDst->setAngularVelocity(pSrc->getAngularVelocity());
+	pDst->setInterpolationLinearVelocity(pSrc->getInterpolationLinearVelocity());
+	pDst->setInterpolationAngularVelocity(pSrc->getInterpolationAngularVelocity());
+	pDst->clearForces();
+	pDst->forceActivationState(pSrc->getActivationState());
+	pDst->setDeactivationTime(pSrc->getDeactivationTime());
+	if (pDst->getMotionState())
+		pDst->getMotionState()->setWorldTransform(pSrc->getWorldTransform());
+
+	// Keep the broadphase proxy in sync with the teleported body
+	if (m_IsEnabled && m_pWorld != nullptr)
+		m_pWorld->updateSingleAabb(pDst);
+}
+
 const DirectX::Vector3 & Causality::PhysicalRigid::GetPosition() const
 {
 	Position = vector_cast<Vector3>(m_pRigidBody->getCenterOfMassPosition());
@@ -102,6 +147,140 @@ void Causality::PhysicalRigid::SetScale(const DirectX::Vector3 & s)
 	m_pShape->setLocalScaling(vector_cast<btVector3>(s));
 }
 
+namespace
+{
+	// Adds pairs of one dynamic proxy against the layer proxies its AABB touches
+	struct StaticPairCollector : public btBroadphaseAabbCallback
+	{
+		btOverlappingPairCache*	pPairCache;
+		btBroadphaseProxy*		pDynamicProxy;
+
+		virtual bool process(const btBroadphaseProxy* pProxy) override
+		{
+			pPairCache->addOverlappingPair(pDynamicProxy, const_cast<btBroadphaseProxy*>(pProxy));
+			return true;
+		}
+	};
+
+	// Removes pairs against layer proxies, all of them or only those whose AABBs no longer overlap
+	struct StalePairRemover : public btOverlapCallback
+	{
+		bool	RemoveAll;
+
+		virtual bool processOverlap(btBroadphasePair& pair) override
+		{
+			auto pProxy0 = pair.m_pProxy0;
+			auto pProxy1 = pair.m_pProxy1;
+			if (!Causality::StaticCollisionLayer::IsLayerProxy(pProxy0) && !Causality::StaticCollisionLayer::IsLayerProxy(pProxy1))
+				return false;
+			return RemoveAll || !TestAabbAgainstAabb2(pProxy0->m_aabbMin, pProxy0->m_aabbMax, pProxy1->m_aabbMin, pProxy1->m_aabbMax);
+		}
+	};
+}
+
+Causality::StaticCollisionLayer::StaticCollisionLayer()
+	: m_pBroadphase(new btDbvtBroadphase())
+{
+	m_pBroadphase->m_gid = ProxyIdBase;
+}
+
+Causality::StaticCollisionLayer::~StaticCollisionLayer()
+{
+	for (auto& pObject : m_Objects)
+	{
+		if (pObject)
+			m_pBroadphase->destroyProxy(pObject->getBroadphaseHandle(), nullptr);
+	}
+}
+
+bool Causality::StaticCollisionLayer::AddObject(unsigned id, const std::shared_ptr<btCollisionShape>& pShape, const DirectX::Vector3 & Pos, const DirectX::Quaternion & Rot)
+{
+	if (m_Objects.size() <= id)
+	{
+		m_Objects.resize(id + 1);
+		m_Shapes.resize(id + 1);
+	}
+	if (m_Objects[id])
+		return false;
+
+	// Same placement as PhysicalRigid::InitializePhysics, which centers the body on the shape's AABB
+	btVector3 minbox, maxbox;
+	pShape->getAabb(btTransform::getIdentity(), minbox, maxbox);
+	btTransform transform(vector_cast<btQuaternion>(Rot), vector_cast<btVector3>(Pos));
+	transform = transform * btTransform(btQuaternion::getIdentity(), 0.5*(minbox + maxbox)).inverse();
+
+	auto pObject = std::make_unique<btCollisionObject>();
+	pObject->setCollisionShape(pShape.get());
+	pObject->setWorldTransform(transform);
+	pObject->setInterpolationWorldTransform(transform);
+	pObject->setCollisionFlags(pObject->getCollisionFlags() | btCollisionObject::CF_STATIC_OBJECT);
+	pObject->setActivationState(ISLAND_SLEEPING);
+	pObject->setFriction(1.0f);
+	pObject->setRestitution(0.0f);
+
+	pShape->getAabb(transform, minbox, maxbox);
+	auto pProxy = m_pBroadphase->createProxy(minbox, maxbox, pShape->getShapeType(), pObject.get(),
+		btBroadphaseProxy::StaticFilter, btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter, nullptr, nullptr);
+	pObject->setBroadphaseHandle(pProxy);
+
+	m_Objects[id] = std::move(pObject);
+	m_Shapes[id] = pShape;
+	return true;
+}
+
+void Causality::StaticCollisionLayer::FindPairs(btCollisionWorld & world) const
+{
+	auto pPairCache = world.getPairCache();
+	// The world's broadphase does not own our proxies, so it won't reliably drop the pairs that separated
+	StalePairRemover remover;
+	remover.RemoveAll = false;
+	pPairCache->processAllOverlappingPairs(&remover, world.getDispatcher());
+
+	StaticPairCollector collector;
+	collector.pPairCache = pPairCache;
+	const auto& objects = world.getCollisionObjectArray();
+	for (int i = 0; i < objects.size(); i++)
+	{
+		auto pObject = objects[i];
+		auto pProxy = pObject->getBroadphaseHandle();
+		// Sleeping objects keep their pairs, kinematic and static ones never collide with the layer
+		if (!pProxy || pObject->isStaticOrKinematicObject() || !pObject->isActive())
+			continue;
+		collector.pDynamicProxy = pProxy;
+		m_pBroadphase->aabbTest(pProxy->m_aabbMin, pProxy->m_aabbMax, collector);
+	}
+}
+
+void Causality::StaticCollisionLayer::RemovePairs(btCollisionWorld & world)
+{
+	StalePairRemover remover;
+	remover.RemoveAll = true;
+	world.getPairCache()->processAllOverlappingPairs(&remover, world.getDispatcher());
+}
+
+Causality::BranchDynamicsWorld::BranchDynamicsWorld(btDispatcher * pDispatcher, btBroadphaseInterface * pBroadphase, btConstraintSolver * pSolver, btCollisionConfiguration * pCollisionConfiguration)
+	: btDiscreteDynamicsWorld(pDispatcher, pBroadphase, pSolver, pCollisionConfiguration), m_pStaticLayer(nullptr)
+{
+}
+
+void Causality::BranchDynamicsWorld::SetStaticLayer(const StaticCollisionLayer * pLayer)
+{
+	if (m_pStaticLayer && m_pStaticLayer != pLayer)
+		StaticCollisionLayer::RemovePairs(*this);
+	m_pStaticLayer = pLayer;
+}
+
+void Causality::BranchDynamicsWorld::performDiscreteCollisionDetection()
+{
+	updateAabbs();
+	getBroadphase()->calculateOverlappingPairs(getDispatcher());
+	if (m_pStaticLayer)
+		m_pStaticLayer->FindPairs(*this);
+	auto pDispatcher = getDispatcher();
+	if (pDispatcher)
+		pDispatcher->dispatchAllCollisionPairs(getPairCache(), getDispatchInfo(), pDispatcher);
+}
+
 //void Causality::PhysicalGeometryModel::InitializePhysicalRigid(float mass)
 //{
 //	btTransform trans;
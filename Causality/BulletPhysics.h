@@ -97,6 +97,11 @@ namespace Causality
 		const btCollisionShape* GetBulletShape() const { return m_pShape.get(); }
 
 		void InitializePhysics(const std::shared_ptr<btDynamicsWorld> &pWorld, const std::shared_ptr<btCollisionShape>& pShape, float mass, const DirectX::Vector3 & Pos = DirectX::Vector3::Zero, const DirectX::Quaternion & Rot = DirectX::Quaternion::Identity);
+		// Initialize as a replica of the prototype, sharing its collision shape, mass and material
+		void InitializePhysics(const std::shared_ptr<btDynamicsWorld> &pWorld, const PhysicalRigid& prototype);
+		// Copy the simulated state (transform, velocities, activation) from a rigid with the same shape
+		void CopyStateFrom(const PhysicalRigid& src);
+		std::shared_ptr<btCollisionShape> GetSharedShape() const { return m_pShape; }
 
 		// Inherited via IRigid
 		virtual const DirectX::Vector3 & GetPosition() const override;
@@ -116,6 +121,64 @@ namespace Causality
 		mutable DirectX::Quaternion			Orientation;
 	};
 
+	// Static collision objects built once and shared read-only by many dynamics worlds
+	// Worlds referencing the layer query its broadphase for their dynamic objects each step (see BranchDynamicsWorld),
+	// so static scenery costs no proxies, AABB updates or broadphase nodes per world
+	class StaticCollisionLayer
+	{
+	public:
+		// Proxy ids of the layer start here, pair caches of the worlds key pairs on proxy ids
+		enum : int { ProxyIdBase = 1 << 30 };
+
+		StaticCollisionLayer();
+		~StaticCollisionLayer();
+
+		StaticCollisionLayer(const StaticCollisionLayer&) = delete;
+		StaticCollisionLayer& operator=(const StaticCollisionLayer&) = delete;
+
+		// Not thread safe, no world referencing this layer may be stepping
+		// Returns false and keeps the existing object if id is already in the layer, the pair caches of the worlds may still reference its proxy
+		bool AddObject(unsigned id, const std::shared_ptr<btCollisionShape>& pShape, const DirectX::Vector3 & Pos = DirectX::Vector3::Zero, const DirectX::Quaternion & Rot = DirectX::Quaternion::Identity);
+
+		// nullptr if id is not a static object
+		const btCollisionObject* GetCollisionObject(unsigned id) const
+		{
+			return id < m_Objects.size() ? m_Objects[id].get() : nullptr;
+		}
+		// One past the largest id added
+		size_t IdBound() const { return m_Objects.size(); }
+
+		static bool IsLayerProxy(const btBroadphaseProxy* pProxy) { return pProxy->m_uniqueId > ProxyIdBase; }
+
+		// Refresh the pairs between world's dynamic objects and this layer in world's pair cache
+		// Only reads the layer, any number of worlds may do this concurrently
+		void FindPairs(btCollisionWorld& world) const;
+		// Remove all pairs against this layer from world's pair cache
+		static void RemovePairs(btCollisionWorld& world);
+
+	private:
+		std::unique_ptr<btDbvtBroadphase>					m_pBroadphase;
+		// Indexed by object id, null for non-static ids
+		std::vector<std::unique_ptr<btCollisionObject>>		m_Objects;
+		std::vector<std::shared_ptr<btCollisionShape>>		m_Shapes;
+	};
+
+	// Discrete dynamics world which also collides its dynamic objects against a shared static layer
+	class BranchDynamicsWorld : public btDiscreteDynamicsWorld
+	{
+	public:
+		BranchDynamicsWorld(btDispatcher* pDispatcher, btBroadphaseInterface* pBroadphase, btConstraintSolver* pSolver, btCollisionConfiguration* pCollisionConfiguration);
+
+		// The layer must outlive the world or be detached before it is destroyed
+		void SetStaticLayer(const StaticCollisionLayer* pLayer);
+		const StaticCollisionLayer* GetStaticLayer() const { return m_pStaticLayer; }
+
+		virtual void performDiscreteCollisionDetection() override;
+
+	private:
+		const StaticCollisionLayer*	m_pStaticLayer;
+	};
+
 	namespace Bullet
 	{
 		class RigidObject : public btRigidBody
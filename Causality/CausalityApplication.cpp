@@ -5,6 +5,7 @@
 #include "Foregrounds.h"
 #include <CommonStates.h>
 #include "Common\PrimitiveVisualizer.h"
+#include "Common\Logger.h"
 
 using namespace Causality;
 using namespace std;
@@ -17,6 +18,19 @@ using namespace boost;
 
 wstring ResourcesDirectory(L"C:\\Users\\Yupeng\\Documents\\GitHub\\VR\\Causality\\Resources\\");
 
+// Value following option in args, empty if the option isn't given
+static filesystem::path CommandLineValue(Platform::Array<Platform::String^>^ args, const wchar_t* option)
+{
+	if (args == nullptr)
+		return filesystem::path();
+	for (unsigned i = 0; i + 1 < args->Length; i++)
+	{
+		if (wcscmp(args[i]->Data(), option) == 0)
+			return filesystem::path(args[i + 1]->Data());
+	}
+	return filesystem::path();
+}
+
 App::App()
 {
 }
@@ -47,6 +61,8 @@ void Causality::App::OnStartup(Platform::Array<Platform::String^>^ args)
 	// Initialize Windows
 	pConsole = make_shared<DebugConsole>();
 	pConsole->Initialize(ref new String(L"CausalityDebug"), 800, 600, false);
+	// Log lines go to the debug console, written by the logger's own thread
+	Logger::Start(true);
 
 	pWindow = make_shared<Platform::NativeWindow>();
 	pWindow->Initialize(ref new String(L"Causality"), 1280U, 720, false);
@@ -85,6 +101,17 @@ void Causality::App::OnStartup(Platform::Array<Platform::String^>^ args)
 	pLeap = std::make_shared<Platform::Devices::LeapMotion>(false,false);
 	pLeap->SetMotionProvider(pPlayer.get(), pPlayer.get());
 
+	// --record <file> writes every Leap frame of the session, HandFrameReplay plays it back
+	auto recordPath = CommandLineValue(args, L"--record");
+	if (!recordPath.empty())
+	{
+		auto pRecorder = std::make_shared<Platform::Devices::HandFrameRecorder>();
+		if (pRecorder->Open(recordPath.string()))
+			pLeap->SetRecorder(pRecorder);
+		else
+			LOG_ERROR(Log_Device, "Failed to open %s for recording", recordPath.string().c_str());
+	}
+
 	m_pPrimaryCamera = std::move(pPlayer);
 
 	// Scenes & Logic
@@ -136,6 +163,7 @@ void Causality::App::UnregisterComponent(Platform::IAppComponent * pComponent)
 
 void Causality::App::OnExit()
 {
+	Logger::Stop();
 }
 
 void Causality::App::OnIdle()
@@ -0,0 +1,274 @@
+#include "BoundsFitter.h"
+#include "..\BranchScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include <Eigen\Dense>
+
+using namespace DirectX;
+using namespace DirectX::Scene;
+using namespace std;
+
+namespace
+{
+	const XMFLOAT3& Point(const XMFLOAT3* points, size_t stride, size_t index)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const char*>(points) + index * stride);
+	}
+
+	// Blocks run in parallel, a single block runs on the calling thread
+	void ParallelBlocks(size_t count, const std::function<void(size_t, size_t, size_t)>& body)
+	{
+		const size_t blockSize = BoundsFitter::BlockSize;
+		size_t blockCount = (count + blockSize - 1) / blockSize;
+		if (blockCount == 1)
+		{
+			body(0, 0, count);
+			return;
+		}
+		Causality::BranchScheduler::Shared().Dispatch(blockCount, [&](size_t block)
+		{
+			body(block, block * blockSize, std::min(count, (block + 1) * blockSize));
+		});
+	}
+
+	// First pass of one block
+	struct BlockMoments
+	{
+		XMFLOAT3	Min;
+		XMFLOAT3	Max;
+		// Points where Min and Max were found, per axis
+		XMFLOAT3	MinPoints[3];
+		XMFLOAT3	MaxPoints[3];
+		// Relative to the set's first point : sums of x, y, z, of xx, yy, zz and of xy, yz, zx
+		double		Sum[3];
+		double		Squares[3];
+		double		Products[3];
+	};
+
+	// Second pass of one block, in the oriented box's frame
+	struct BlockExtents
+	{
+		XMFLOAT3		Min;
+		XMFLOAT3		Max;
+		BoundingSphere	Sphere;
+	};
+
+	void Accumulate(BlockMoments& moments, const XMFLOAT3* points, size_t stride, size_t begin, size_t end, const XMFLOAT3& origin)
+	{
+		XMVECTOR o = XMLoadFloat3(&origin);
+		XMVECTOR p = XMLoadFloat3(&Point(points, stride, begin));
+		XMVECTOR vMin = p, vMax = p;
+		XMVECTOR minPoints[3] = { p, p, p }, maxPoints[3] = { p, p, p };
+		// Float sums over a block, the set's totals are kept in double
+		XMVECTOR sum = XMVectorZero(), squares = XMVectorZero(), products = XMVectorZero();
+		for (size_t i = begin; i < end; i++)
+		{
+			p = XMLoadFloat3(&Point(points, stride, i));
+			XMVECTOR d = p - o;
+			sum += d;
+			squares += d * d;
+			products += d * XMVectorSwizzle(d, 1, 2, 0, 3);
+
+			// New extremes get rare quickly, they take the slow path
+			if (XMVector3GreaterOrEqual(p, vMin) && XMVector3LessOrEqual(p, vMax))
+				continue;
+			for (size_t k = 0; k < 3; k++)
+			{
+				float value = XMVectorGetByIndex(p, k);
+				if (value < XMVectorGetByIndex(vMin, k))
+				{
+					vMin = XMVectorSetByIndex(vMin, value, k);
+					minPoints[k] = p;
+				}
+				if (value > XMVectorGetByIndex(vMax, k))
+				{
+					vMax = XMVectorSetByIndex(vMax, value, k);
+					maxPoints[k] = p;
+				}
+			}
+		}
+
+		XMStoreFloat3(&moments.Min, vMin);
+		XMStoreFloat3(&moments.Max, vMax);
+		for (size_t k = 0; k < 3; k++)
+		{
+			XMStoreFloat3(&moments.MinPoints[k], minPoints[k]);
+			XMStoreFloat3(&moments.MaxPoints[k], maxPoints[k]);
+			moments.Sum[k] = XMVectorGetByIndex(sum, k);
+			moments.Squares[k] = XMVectorGetByIndex(squares, k);
+			moments.Products[k] = XMVectorGetByIndex(products, k);
+		}
+	}
+
+	// Blocks are merged in order, ties keep the earlier extreme point
+	void Merge(BlockMoments& total, const BlockMoments& block)
+	{
+		const float* pMin = &block.Min.x;
+		const float* pMax = &block.Max.x;
+		float* pTotalMin = &total.Min.x;
+		float* pTotalMax = &total.Max.x;
+		for (size_t k = 0; k < 3; k++)
+		{
+			if (pMin[k] < pTotalMin[k])
+			{
+				pTotalMin[k] = pMin[k];
+				total.MinPoints[k] = block.MinPoints[k];
+			}
+			if (pMax[k] > pTotalMax[k])
+			{
+				pTotalMax[k] = pMax[k];
+				total.MaxPoints[k] = block.MaxPoints[k];
+			}
+			total.Sum[k] += block.Sum[k];
+			total.Squares[k] += block.Squares[k];
+			total.Products[k] += block.Products[k];
+		}
+	}
+
+	// axes holds the box's axes as columns, so a transform takes a point to its coordinates along them
+	void Project(BlockExtents& extents, const XMFLOAT3* points, size_t stride, size_t begin, size_t end, const XMFLOAT4X4& axes, const XMFLOAT3& center, bool fitSphere)
+	{
+		XMMATRIX frame = XMLoadFloat4x4(&axes);
+		XMVECTOR c = XMLoadFloat3(&center);
+		XMVECTOR local = XMVector3TransformNormal(XMLoadFloat3(&Point(points, stride, begin)) - c, frame);
+		XMVECTOR vMin = local, vMax = local;
+		XMVECTOR sphereCenter = XMLoadFloat3(&extents.Sphere.Center);
+		float radius = extents.Sphere.Radius;
+		XMVECTOR radiusSq = XMVectorReplicate(radius * radius);
+		for (size_t i = begin; i < end; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(&Point(points, stride, i));
+			local = XMVector3TransformNormal(p - c, frame);
+			vMin = XMVectorMin(vMin, local);
+			vMax = XMVectorMax(vMax, local);
+			if (!fitSphere)
+				continue;
+
+			// Ritter : a point outside moves the sphere towards it just enough to take it in
+			XMVECTOR d = p - sphereCenter;
+			XMVECTOR distanceSq = XMVector3LengthSq(d);
+			if (XMVector3LessOrEqual(distanceSq, radiusSq))
+				continue;
+			float distance = sqrtf(XMVectorGetX(distanceSq));
+			float grown = (radius + distance) * 0.5f;
+			sphereCenter += d * ((grown - radius) / distance);
+			radius = grown;
+			radiusSq = XMVectorReplicate(radius * radius);
+		}
+		XMStoreFloat3(&extents.Min, vMin);
+		XMStoreFloat3(&extents.Max, vMax);
+		XMStoreFloat3(&extents.Sphere.Center, sphereCenter);
+		extents.Sphere.Radius = radius;
+	}
+}
+
+void DirectX::Scene::BoundsFitter::Fit(PointSetBounds & bounds, const XMFLOAT3 * points, size_t count, size_t stride, bool fitSphere)
+{
+	bounds.Box = BoundingBox(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0));
+	bounds.OrientedBox = BoundingOrientedBox(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0), XMFLOAT4(0, 0, 0, 1));
+	bounds.Sphere = BoundingSphere(XMFLOAT3(0, 0, 0), 0);
+	if (count == 0)
+		return;
+
+	// First pass : box, extreme points and moments
+	auto blockCount = (count + BlockSize - 1) / BlockSize;
+	const auto& origin = Point(points, stride, 0);
+	vector<BlockMoments> blockMoments(blockCount);
+	ParallelBlocks(count, [&](size_t block, size_t begin, size_t end)
+	{
+		Accumulate(blockMoments[block], points, stride, begin, end, origin);
+	});
+	auto moments = blockMoments[0];
+	for (size_t b = 1; b < blockCount; b++)
+		Merge(moments, blockMoments[b]);
+
+	XMVECTOR vMin = XMLoadFloat3(&moments.Min), vMax = XMLoadFloat3(&moments.Max);
+	XMStoreFloat3(&bounds.Box.Center, (vMin + vMax) * 0.5f);
+	XMStoreFloat3(&bounds.Box.Extents, (vMax - vMin) * 0.5f);
+
+	// Principal axes of the covariance, in double since it is a difference of large sums
+	Eigen::Vector3d mean(moments.Sum[0], moments.Sum[1], moments.Sum[2]);
+	mean /= double(count);
+	Eigen::Matrix3d covariance;
+	covariance <<
+		moments.Squares[0], moments.Products[0], moments.Products[2],
+		moments.Products[0], moments.Squares[1], moments.Products[1],
+		moments.Products[2], moments.Products[1], moments.Squares[2];
+	covariance = covariance / double(count) - mean * mean.transpose();
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+	solver.computeDirect(covariance);
+	const auto& vectors = solver.eigenvectors();
+	mean += Eigen::Vector3d(origin.x, origin.y, origin.z);
+
+	XMFLOAT4X4 axes;
+	XMStoreFloat4x4(&axes, XMMatrixIdentity());
+	for (int k = 0; k < 3; k++)
+	{
+		// Eigen values are increasing
+		for (int r = 0; r < 3; r++)
+			axes.m[r][k] = float(vectors(r, 2 - k));
+	}
+	XMFLOAT3 center(float(mean.x()), float(mean.y()), float(mean.z()));
+
+	// Ritter's starting sphere spans the farthest apart pair of extreme points
+	BoundingSphere start(XMFLOAT3(0, 0, 0), 0);
+	if (fitSphere)
+	{
+		size_t widest = 0;
+		float widestSq = -1;
+		for (size_t k = 0; k < 3; k++)
+		{
+			float lengthSq = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&moments.MaxPoints[k]) - XMLoadFloat3(&moments.MinPoints[k])));
+			if (lengthSq > widestSq)
+			{
+				widestSq = lengthSq;
+				widest = k;
+			}
+		}
+		XMVECTOR a = XMLoadFloat3(&moments.MinPoints[widest]), b = XMLoadFloat3(&moments.MaxPoints[widest]);
+		XMStoreFloat3(&start.Center, (a + b) * 0.5f);
+		start.Radius = sqrtf(widestSq) * 0.5f;
+	}
+
+	// Second pass : extents along the axes and the sphere, every block grows its own from the starting one
+	vector<BlockExtents> blockExtents(blockCount);
+	ParallelBlocks(count, [&](size_t block, size_t begin, size_t end)
+	{
+		blockExtents[block].Sphere = start;
+		Project(blockExtents[block], points, stride, begin, end, axes, center, fitSphere);
+	});
+	XMVECTOR localMin = XMLoadFloat3(&blockExtents[0].Min), localMax = XMLoadFloat3(&blockExtents[0].Max);
+	bounds.Sphere = blockExtents[0].Sphere;
+	for (size_t b = 1; b < blockCount; b++)
+	{
+		localMin = XMVectorMin(localMin, XMLoadFloat3(&blockExtents[b].Min));
+		localMax = XMVectorMax(localMax, XMLoadFloat3(&blockExtents[b].Max));
+		if (fitSphere)
+			BoundingSphere::CreateMerged(bounds.Sphere, bounds.Sphere, blockExtents[b].Sphere);
+	}
+
+	// Axes sorted by extent, the last one rebuilt from the first two to stay right handed
+	XMMATRIX frame = XMLoadFloat4x4(&axes);
+	XMVECTOR localCenter = (localMin + localMax) * 0.5f;
+	XMStoreFloat3(&bounds.OrientedBox.Center, XMLoadFloat3(&center) + XMVector3TransformNormal(localCenter, XMMatrixTranspose(frame)));
+	XMFLOAT3 halfExtents;
+	XMStoreFloat3(&halfExtents, (localMax - localMin) * 0.5f);
+	float extents[3] = { halfExtents.x, halfExtents.y, halfExtents.z };
+	size_t order[3] = { 0, 1, 2 };
+	std::stable_sort(order, order + 3, [&extents](size_t a, size_t b) { return extents[a] > extents[b]; });
+	XMMATRIX rotation = XMMatrixIdentity();
+	for (size_t k = 0; k < 2; k++)
+		rotation.r[k] = XMVectorSet(axes.m[0][order[k]], axes.m[1][order[k]], axes.m[2][order[k]], 0);
+	rotation.r[2] = XMVector3Cross(rotation.r[0], rotation.r[1]);
+	bounds.OrientedBox.Extents = XMFLOAT3(extents[order[0]], extents[order[1]], extents[order[2]]);
+	XMStoreFloat4(&bounds.OrientedBox.Orientation, XMQuaternionNormalize(XMQuaternionRotationMatrix(rotation)));
+}
+
+void DirectX::Scene::BoundsFitter::FitOrientedBox(BoundingOrientedBox & box, const XMFLOAT3 * points, size_t count, size_t stride)
+{
+	PointSetBounds bounds;
+	Fit(bounds, points, count, stride, false);
+	box = bounds.OrientedBox;
+}
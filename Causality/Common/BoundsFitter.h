@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+namespace DirectX
+{
+	namespace Scene
+	{
+		// Bounding volumes of one point set, fitted together
+		struct PointSetBounds
+		{
+			BoundingBox			Box;
+			BoundingOrientedBox	OrientedBox;
+			BoundingSphere		Sphere;
+		};
+
+		// Box, oriented box and sphere of a point set in two streaming passes
+		// The first pass takes the box, the extreme points along x, y and z, and the covariance of the points,
+		// the second projects the points on the principal axes and grows a Ritter sphere started from the farthest extreme pair
+		// Points are cut in blocks that are fitted in parallel and merged in order, so results don't depend on scheduling
+		class BoundsFitter
+		{
+		public:
+			// Points per task
+			static const size_t BlockSize = 4096;
+
+			// Oriented box extents are sorted from bigger to smaller, its axes right handed
+			// The sphere is left empty when fitSphere is false
+			static void Fit(PointSetBounds& bounds, const XMFLOAT3* points, size_t count, size_t stride, bool fitSphere = true);
+
+			static void FitOrientedBox(BoundingOrientedBox& box, const XMFLOAT3* points, size_t count, size_t stride);
+		};
+	}
+}
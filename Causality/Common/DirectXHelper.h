@@ -3,6 +3,7 @@
 #include <ppltasks.h>	// For create_task
 #include <fstream>
 #include <filesystem>
+#include <system_error>
 #include <VertexTypes.h>
 
 #if defined(_XBOX_ONE) && defined(_TITLE)
@@ -67,6 +68,7 @@ namespace DirectX
 		HAS_MEMBER(weights, has_weights);
 
 	}
+#if defined(__cplusplus_winrt)
 	inline Platform::String^ ErrorDescription(HRESULT hr)
 	{
 		if (FACILITY_WINDOWS == HRESULT_FACILITY(hr))
@@ -88,6 +90,7 @@ namespace DirectX
 			return "Undifined Error Code";
 		}
 	}
+#endif
 
 
 
@@ -95,8 +98,12 @@ namespace DirectX
 	{
 		if (FAILED(hr))
 		{
+#if defined(__cplusplus_winrt)
 			auto ErrMsg = ErrorDescription(hr);
 			throw Platform::Exception::CreateException(hr);
+#else
+			throw std::system_error(hr, std::system_category());
+#endif
 		}
 	}
 
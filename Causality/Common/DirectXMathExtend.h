@@ -21,6 +21,7 @@
 #include <Eigen\Dense>
 #include <Eigen\Sparse>
 #include <boost\operators.hpp>
+#include "BoundsFitter.h"
 
 
 namespace DirectX
@@ -387,40 +388,10 @@ namespace DirectX
 	}
 
 	// This function garuntee the extends of the bounding box is sorted from bigger to smaller
+	// Principal axes of the covariance and exact extents along them, see Scene::BoundsFitter
 	inline void CreateBoundingOrientedBoxFromPoints(_Out_ BoundingOrientedBox& Out, _In_ size_t Count,
 		_In_reads_bytes_(sizeof(XMFLOAT3) + Stride*(Count - 1)) const XMFLOAT3* pPoints, _In_ size_t Stride) {
-		using namespace std;
-		BoundingOrientedBox::CreateFromPoints(Out, Count, pPoints, Stride);
-		XMMATRIX rot = XMMatrixIdentity();
-		auto& ext = Out.Extents;
-
-		// Sort the demension
-		if (ext.x < ext.y)
-		{
-			swap(ext.x, ext.y);
-			swap(rot.r[0], rot.r[1]);
-			rot.r[2] = -rot.r[2]; // Flip the other axias to maintain the chirality
-		}
-		if (ext.y < ext.z)
-		{
-			swap(ext.y, ext.z);
-			swap(rot.r[1], rot.r[2]);
-			rot.r[0] = -rot.r[0];
-		}
-		if (ext.x < ext.y)
-		{
-			swap(ext.x, ext.y);
-			swap(rot.r[0], rot.r[1]);
-			rot.r[2] = -rot.r[2];
-		}
-
-		//qw = sqrt(1 + m00 + m11 + m22) / 2
-		//qx = (m21 - m12) / (4 * qw)
-		//qy = (m02 - m20) / (4 * qw)
-		//qz = (m10 - m01) / (4 * qw)
-		XMVECTOR q = XMQuaternionRotationMatrix(rot);
-		XMStoreFloat4(&Out.Orientation, XMQuaternionMultiply(q, XMLoadFloat4(&Out.Orientation)));
-		//auto q = XMQuaternionRotationMatrix(rot);
+		Scene::BoundsFitter::FitOrientedBox(Out, pPoints, Count, Stride);
 	}
 
 	XMVECTOR XM_CALLCONV XMVector3Displacement(FXMVECTOR V, FXMVECTOR RotationQuaternion, FXMVECTOR TranslationQuaternion);
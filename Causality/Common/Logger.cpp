@@ -0,0 +1,319 @@
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace Causality;
+using namespace Causality::Logging;
+using namespace std;
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define LOG_THREAD_LOCAL __declspec(thread)
+#else
+#define LOG_THREAD_LOCAL thread_local
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define LOG_SNPRINTF(buffer, size, ...) _snprintf_s(buffer, size, _TRUNCATE, __VA_ARGS__)
+#else
+#define LOG_SNPRINTF snprintf
+#endif
+
+// How long the sink sleeps between drains when nobody flushes
+static const auto SinkPeriod = chrono::milliseconds(10);
+
+std::atomic<uint8_t> Causality::Logger::s_Level(static_cast<uint8_t>(LogLevel::Info));
+std::atomic<uint32_t> Causality::Logger::s_Categories(Log_AllCategories);
+std::atomic<uint64_t> Causality::Logger::s_Sequence(0);
+
+namespace
+{
+	struct LogSink
+	{
+		LogSink() : Stopping(false), FlushRequested(0), FlushDone(0), Console(false), pFile(nullptr) {}
+		// Whatever is still queued at exit is written
+		~LogSink() { Logger::Stop(); }
+
+		// Guards the queue list and the flush counters
+		mutex								Lock;
+		vector<unique_ptr<ThreadQueue>>		Queues;
+		thread								Thread;
+		condition_variable					Wake;
+		condition_variable					Flushed;
+		bool								Stopping;
+		uint64_t							FlushRequested;
+		uint64_t							FlushDone;
+
+		// Sink thread only
+		bool								Console;
+		FILE*								pFile;
+		vector<LogRecord>					Records;
+		vector<ThreadQueue*>				Draining;
+	};
+
+	// Not a function local static, those are not thread safe before VC 2015
+	LogSink g_Sink;
+	const auto g_StartTime = chrono::high_resolution_clock::now();
+	LOG_THREAD_LOCAL ThreadQueue* t_pQueue = nullptr;
+
+	const char* LevelName(LogLevel level)
+	{
+		static const char* names[] = { "TRACE", "DEBUG", "INFO", "WARNING", "ERROR" };
+		return names[static_cast<size_t>(level)];
+	}
+
+	const char* CategoryName(uint32_t category)
+	{
+		static const char* names[] = { "General", "Device", "Simulation", "Render", "Loading" };
+		for (size_t i = 0; i < extent<decltype(names)>::value; i++)
+		{
+			if (category & (1U << i))
+				return names[i];
+		}
+		return "";
+	}
+}
+
+// Consumes the next argument if its code is expected
+static bool TakeArgument(const unsigned* codes, size_t count, size_t& next, size_t expected)
+{
+	return next < count && codes[next++] == expected;
+}
+
+bool Causality::Logging::MatchArguments(const LogRecord & record, const unsigned * codes, char * text, size_t size)
+{
+	size_t count = record.ArgumentCount;
+	size_t next = 0;
+	bool matched = true;
+	for (const char* p = record.Format; matched && *p; )
+	{
+		if (*p++ != '%')
+			continue;
+		if (*p == '%')
+		{
+			p++;
+			continue;
+		}
+
+		while (*p && strchr("-+ #0", *p))
+			p++;
+		// * width and precision are read as int arguments
+		if (*p == '*')
+		{
+			matched = TakeArgument(codes, count, next, Kind_Integer | sizeof(int));
+			p++;
+		}
+		while (*p >= '0' && *p <= '9')
+			p++;
+		if (*p == '.')
+		{
+			p++;
+			if (*p == '*')
+			{
+				matched = matched && TakeArgument(codes, count, next, Kind_Integer | sizeof(int));
+				p++;
+			}
+			while (*p >= '0' && *p <= '9')
+				p++;
+		}
+
+		size_t integerSize = sizeof(int);
+		size_t floatSize = sizeof(double);
+		bool wide = false;
+		if (p[0] == 'h')
+		{
+			p += p[1] == 'h' ? 2 : 1;
+		}
+		else if (p[0] == 'l' && p[1] == 'l')
+		{
+			integerSize = sizeof(long long);
+			p += 2;
+		}
+		else if (p[0] == 'l')
+		{
+			integerSize = sizeof(long);
+			wide = true;
+			p++;
+		}
+		else if (p[0] == 'j' || p[0] == 'z' || p[0] == 't')
+		{
+			integerSize = p[0] == 'j' ? sizeof(intmax_t) : sizeof(size_t);
+			p++;
+		}
+		else if (p[0] == 'L')
+		{
+			floatSize = sizeof(long double);
+			p++;
+		}
+		// MSVC's sizes
+		else if (p[0] == 'I')
+		{
+			bool sized = (p[1] == '6' && p[2] == '4') || (p[1] == '3' && p[2] == '2');
+			integerSize = !sized ? sizeof(size_t) : p[1] == '6' ? 8 : 4;
+			p += sized ? 3 : 1;
+		}
+
+		if (!matched || !*p)
+			break;
+		switch (*p++)
+		{
+		case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+			matched = TakeArgument(codes, count, next, Kind_Integer | integerSize);
+			break;
+		case 'c':
+			matched = TakeArgument(codes, count, next, Kind_Integer | sizeof(int));
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			matched = TakeArgument(codes, count, next, Kind_Float | floatSize);
+			break;
+		// Only narrow strings are copied into records
+		case 's':
+			matched = !wide && TakeArgument(codes, count, next, Kind_String);
+			break;
+		case 'p':
+			matched = TakeArgument(codes, count, next, Kind_Pointer);
+			break;
+		default:
+			matched = false;
+			break;
+		}
+	}
+
+	if (matched && next == count)
+		return true;
+	LOG_SNPRINTF(text, size, "Log arguments don't match format \"%s\"", record.Format);
+	return false;
+}
+
+ThreadQueue & Causality::Logger::ThisThreadQueue()
+{
+	if (!t_pQueue)
+	{
+		// Queues outlive their threads, so the sink can still drain what a finished thread logged
+		lock_guard<mutex> guard(g_Sink.Lock);
+		g_Sink.Queues.emplace_back(new ThreadQueue(static_cast<uint32_t>(g_Sink.Queues.size())));
+		t_pQueue = g_Sink.Queues.back().get();
+	}
+	return *t_pQueue;
+}
+
+int64_t Causality::Logger::Now()
+{
+	return chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - g_StartTime).count();
+}
+
+void Causality::Logger::Start(bool console, const char * filePath)
+{
+	Stop();
+	g_Sink.Console = console;
+	if (filePath)
+	{
+#pragma warning(suppress: 4996)
+		g_Sink.pFile = fopen(filePath, "w");
+	}
+	g_Sink.Stopping = false;
+	g_Sink.Thread = thread(&Logger::Run);
+}
+
+void Causality::Logger::Stop()
+{
+	if (!g_Sink.Thread.joinable())
+		return;
+	{
+		lock_guard<mutex> guard(g_Sink.Lock);
+		g_Sink.Stopping = true;
+	}
+	g_Sink.Wake.notify_one();
+	g_Sink.Thread.join();
+	if (g_Sink.pFile)
+	{
+		fclose(g_Sink.pFile);
+		g_Sink.pFile = nullptr;
+	}
+}
+
+void Causality::Logger::Flush()
+{
+	if (!g_Sink.Thread.joinable())
+	{
+		Drain();
+		return;
+	}
+	unique_lock<mutex> lock(g_Sink.Lock);
+	auto ticket = ++g_Sink.FlushRequested;
+	g_Sink.Wake.notify_one();
+	g_Sink.Flushed.wait(lock, [ticket]() { return g_Sink.FlushDone >= ticket || g_Sink.Stopping; });
+}
+
+void Causality::Logger::Run()
+{
+	unique_lock<mutex> lock(g_Sink.Lock);
+	while (!g_Sink.Stopping)
+	{
+		g_Sink.Wake.wait_for(lock, SinkPeriod, []() { return g_Sink.Stopping || g_Sink.FlushRequested != g_Sink.FlushDone; });
+		// Records committed before a flush request was made are visible once the request is
+		auto requested = g_Sink.FlushRequested;
+		lock.unlock();
+		Drain();
+		lock.lock();
+		g_Sink.FlushDone = requested;
+		g_Sink.Flushed.notify_all();
+	}
+	lock.unlock();
+	Drain();
+}
+
+size_t Causality::Logger::Drain()
+{
+	auto& queues = g_Sink.Draining;
+	{
+		lock_guard<mutex> guard(g_Sink.Lock);
+		queues.clear();
+		for (const auto& pQueue : g_Sink.Queues)
+			queues.push_back(pQueue.get());
+	}
+
+	auto& records = g_Sink.Records;
+	records.clear();
+	uint64_t dropped = 0;
+	for (auto pQueue : queues)
+	{
+		pQueue->Drain(records);
+		dropped += pQueue->TakeDropped();
+	}
+	if (records.empty() && dropped == 0)
+		return 0;
+
+	sort(records.begin(), records.end(), [](const LogRecord& lhs, const LogRecord& rhs)
+	{
+		return lhs.Sequence < rhs.Sequence;
+	});
+
+	char message[512];
+	char line[640];
+	for (const auto& record : records)
+	{
+		record.Formatter(record, message, sizeof(message));
+		LOG_SNPRINTF(line, sizeof(line), "[%10.6f] [%s] [%s] %s\n", record.Time * 1e-6, LevelName(record.Level), CategoryName(record.Category), message);
+		if (g_Sink.Console)
+			fputs(line, stdout);
+		if (g_Sink.pFile)
+			fputs(line, g_Sink.pFile);
+	}
+	if (dropped)
+	{
+		LOG_SNPRINTF(line, sizeof(line), "[Logger] %llu records dropped, queues were full\n", static_cast<unsigned long long>(dropped));
+		if (g_Sink.Console)
+			fputs(line, stdout);
+		if (g_Sink.pFile)
+			fputs(line, g_Sink.pFile);
+	}
+	if (g_Sink.Console)
+		fflush(stdout);
+	if (g_Sink.pFile)
+		fflush(g_Sink.pFile);
+	return records.size();
+}
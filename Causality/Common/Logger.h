@@ -0,0 +1,301 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <type_traits>
+#include <cstdio>
+#ifdef _MSC_VER
+#include <sal.h>
+#else
+#define _Printf_format_string_
+#endif
+
+namespace Causality
+{
+	enum class LogLevel : uint8_t
+	{
+		Trace,
+		Debug,
+		Info,
+		Warning,
+		Error,
+	};
+
+	// Categories are bits, so any set of them can be enabled at once
+	enum LogCategory : uint32_t
+	{
+		Log_General = 1 << 0,
+		Log_Device = 1 << 1,
+		Log_Simulation = 1 << 2,
+		Log_Render = 1 << 3,
+		Log_Loading = 1 << 4,
+		Log_AllCategories = 0xffffffff,
+	};
+
+	struct LogRecord;
+
+	// Fixed fields of a LogRecord, their size depends on the pointer size
+	struct LogRecordHeader
+	{
+		enum { Size = 256, MaxArguments = 8 };
+
+		uint64_t		Sequence;
+		int64_t			Time;
+		const char*		Format;
+		void			(*Formatter)(const LogRecord& record, char* text, size_t size);
+		uint32_t		Category;
+		uint32_t		Thread;
+		LogLevel		Level;
+		uint8_t			ArgumentCount;
+		uint16_t		StringBytes;
+		uint64_t		Slots[MaxArguments];
+	};
+
+	// One logged call, formatted later on the sink thread
+	// Arguments are kept raw in fixed 8 byte slots, C strings are copied behind the slots into what the header leaves
+	struct LogRecord : LogRecordHeader
+	{
+		char			Strings[Size - sizeof(LogRecordHeader)];
+	};
+	static_assert(sizeof(LogRecord) == LogRecord::Size, "LogRecord is not packed as expected");
+
+	namespace Logging
+	{
+		template <size_t... _Indices> struct IndexSequence {};
+		template <size_t _Count, size_t... _Indices> struct MakeIndexSequence : MakeIndexSequence<_Count - 1, _Count - 1, _Indices...> {};
+		template <size_t... _Indices> struct MakeIndexSequence<0, _Indices...> { typedef IndexSequence<_Indices...> type; };
+
+		// What a conversion reads, an argument's code is its kind or'ed with its size after default promotion
+		enum ArgumentKind
+		{
+			Kind_Integer = 1 << 8,
+			Kind_Float = 2 << 8,
+			Kind_Pointer = 3 << 8,
+			Kind_String = 4 << 8,
+		};
+
+		// Checks the argument codes against the conversions of record's format, as printf would read them
+		// Writes a diagnostic to text instead and returns false if they don't match
+		bool MatchArguments(const LogRecord& record, const unsigned* codes, char* text, size_t size);
+
+		// How an argument type is kept in a slot, only trivially copyable values and C strings can be logged
+		template <class T, class _Enable = void>
+		struct Argument
+		{
+			static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+				"Only numbers, enums, pointers and C strings can be logged");
+			static_assert(sizeof(T) <= sizeof(uint64_t), "Argument is bigger than a log slot");
+
+			enum
+			{
+				Code = std::is_floating_point<T>::value ? Kind_Float | (sizeof(T) > sizeof(double) ? sizeof(T) : sizeof(double))
+					: std::is_pointer<T>::value ? static_cast<size_t>(Kind_Pointer)
+					: Kind_Integer | (sizeof(T) > sizeof(int) ? sizeof(T) : sizeof(int))
+			};
+
+			static void Put(LogRecord& record, size_t slot, T value)
+			{
+				memcpy(&record.Slots[slot], &value, sizeof(T));
+			}
+			static T Get(const LogRecord& record, size_t slot)
+			{
+				T value;
+				memcpy(&value, &record.Slots[slot], sizeof(T));
+				return value;
+			}
+		};
+
+		// C strings are copied, truncated if the record is out of room
+		struct StringArgument
+		{
+			enum { Code = Kind_String };
+
+			static void Put(LogRecord& record, size_t slot, const char* value)
+			{
+				size_t room = sizeof(record.Strings) - record.StringBytes;
+				size_t length = value ? strlen(value) : 0;
+				if (room == 0)
+				{
+					record.Slots[slot] = sizeof(record.Strings) - 1;
+					return;
+				}
+				length = length < room - 1 ? length : room - 1;
+				memcpy(record.Strings + record.StringBytes, value, length);
+				record.Strings[record.StringBytes + length] = '\0';
+				record.Slots[slot] = record.StringBytes;
+				record.StringBytes += static_cast<uint16_t>(length + 1);
+			}
+			static const char* Get(const LogRecord& record, size_t slot)
+			{
+				return record.Strings + record.Slots[slot];
+			}
+		};
+
+		template <> struct Argument<const char*> : StringArgument {};
+		template <> struct Argument<char*> : StringArgument {};
+		template <size_t N> struct Argument<char[N]> : StringArgument {};
+		template <size_t N> struct Argument<const char[N]> : StringArgument {};
+
+		template <class T>
+		struct Decay { typedef typename std::remove_cv<typename std::remove_reference<T>::type>::type type; };
+
+		template <class... _Args, size_t... _Indices>
+		inline void Format(const LogRecord& record, char* text, size_t size, IndexSequence<_Indices...>)
+		{
+#ifdef _MSC_VER
+#pragma warning(suppress: 4996)
+			_snprintf_s(text, size, _TRUNCATE, record.Format, Argument<_Args>::Get(record, _Indices)...);
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+			snprintf(text, size, record.Format, Argument<_Args>::Get(record, _Indices)...);
+#pragma GCC diagnostic pop
+#endif
+		}
+
+		template <class... _Args>
+		inline void FormatRecord(const LogRecord& record, char* text, size_t size)
+		{
+			// Checked on the sink thread, so the logging call doesn't pay for it
+			static const unsigned codes[] = { Argument<_Args>::Code..., 0 };
+			if (!MatchArguments(record, codes, text, size))
+				return;
+			Format<_Args...>(record, text, size, typename MakeIndexSequence<sizeof...(_Args)>::type());
+		}
+
+		inline void PutArguments(LogRecord&, size_t) {}
+
+		template <class T, class... _Rest>
+		inline void PutArguments(LogRecord& record, size_t slot, const T& value, const _Rest&... rest)
+		{
+			Argument<typename Decay<T>::type>::Put(record, slot, value);
+			PutArguments(record, slot + 1, rest...);
+		}
+
+		// Never called, lets GCC check the arguments of a logging call against its format at compile time
+		// MSVC 2013 has no such check short of /analyze, which reads _Printf_format_string_, so FormatRecord checks them again on every compiler before formatting
+		inline void CheckFormat(_Printf_format_string_ const char* format, ...)
+#ifdef __GNUC__
+			__attribute__((format(printf, 1, 2)))
+#endif
+			;
+		inline void CheckFormat(const char*, ...) {}
+
+		// Single producer / single consumer queue of one thread's records
+		class ThreadQueue
+		{
+		public:
+			enum { Capacity = 1024 };
+
+			explicit ThreadQueue(uint32_t thread) : Thread(thread), m_Head(0), m_Tail(0), m_Dropped(0) {}
+
+			// Producer side, nullptr if full
+			LogRecord* Reserve()
+			{
+				auto tail = m_Tail.load(std::memory_order_relaxed);
+				if (tail - m_Head.load(std::memory_order_acquire) >= Capacity)
+				{
+					m_Dropped.fetch_add(1, std::memory_order_relaxed);
+					return nullptr;
+				}
+				return &m_Records[tail % Capacity];
+			}
+			void Commit() { m_Tail.store(m_Tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+			// Consumer side, copies out every committed record
+			size_t Drain(std::vector<LogRecord>& records)
+			{
+				auto head = m_Head.load(std::memory_order_relaxed);
+				auto tail = m_Tail.load(std::memory_order_acquire);
+				for (auto i = head; i < tail; i++)
+					records.push_back(m_Records[i % Capacity]);
+				m_Head.store(tail, std::memory_order_release);
+				return static_cast<size_t>(tail - head);
+			}
+			uint64_t TakeDropped() { return m_Dropped.exchange(0, std::memory_order_relaxed); }
+
+			const uint32_t			Thread;
+
+		private:
+			LogRecord				m_Records[Capacity];
+			// Head is written by the consumer only, tail by the producer only
+			std::atomic<uint64_t>	m_Head;
+			std::atomic<uint64_t>	m_Tail;
+			std::atomic<uint64_t>	m_Dropped;
+		};
+	}
+
+	// Asynchronous logger, calls only copy their raw arguments to the calling thread's queue
+	// A sink thread formats and writes them, ordered by call within each drain, to the console (stdout, which DebugConsole opens) and / or a file
+	// Queues never block : when a thread logs faster than the sink drains, its records are dropped and counted
+	class Logger
+	{
+	public:
+		// Start the sink thread, records logged before are kept until it drains them
+		static void Start(bool console, const char* filePath = nullptr);
+		// Drain everything and stop the sink thread
+		static void Stop();
+		// Block until every record logged before this call is written
+		static void Flush();
+
+		static void SetLevel(LogLevel level) { s_Level.store(static_cast<uint8_t>(level), std::memory_order_relaxed); }
+		static void SetCategories(uint32_t categories) { s_Categories.store(categories, std::memory_order_relaxed); }
+
+		static bool IsEnabled(LogLevel level, uint32_t category)
+		{
+			return static_cast<uint8_t>(level) >= s_Level.load(std::memory_order_relaxed)
+				&& (category & s_Categories.load(std::memory_order_relaxed)) != 0;
+		}
+
+		// format must be a literal, use CAUSALITY_LOG which checks the arguments against it
+		template <class... _Args>
+		static void Write(LogLevel level, uint32_t category, const char* format, const _Args&... args)
+		{
+			static_assert(sizeof...(_Args) <= LogRecord::MaxArguments, "Too many log arguments");
+			auto& queue = ThisThreadQueue();
+			auto pRecord = queue.Reserve();
+			if (!pRecord)
+				return;
+			pRecord->Sequence = s_Sequence.fetch_add(1, std::memory_order_relaxed);
+			pRecord->Time = Now();
+			pRecord->Format = format;
+			pRecord->Formatter = &Logging::FormatRecord<typename Logging::Decay<_Args>::type...>;
+			pRecord->Category = category;
+			pRecord->Thread = queue.Thread;
+			pRecord->Level = level;
+			pRecord->ArgumentCount = static_cast<uint8_t>(sizeof...(_Args));
+			pRecord->StringBytes = 0;
+			Logging::PutArguments(*pRecord, 0, args...);
+			queue.Commit();
+		}
+
+	private:
+		static Logging::ThreadQueue& ThisThreadQueue();
+		static int64_t Now();
+		static void Run();
+		// Drain every queue once and write what was drained, on the sink thread
+		static size_t Drain();
+
+		static std::atomic<uint8_t>		s_Level;
+		static std::atomic<uint32_t>	s_Categories;
+		static std::atomic<uint64_t>	s_Sequence;
+	};
+}
+
+// Log a printf style message if level and category are enabled, arguments are not evaluated otherwise
+#define CAUSALITY_LOG(level, category, format, ...) \
+	do { \
+		if (::Causality::Logger::IsEnabled(level, category)) \
+		{ \
+			if (false) ::Causality::Logging::CheckFormat("" format, ##__VA_ARGS__); \
+			::Causality::Logger::Write(level, category, "" format, ##__VA_ARGS__); \
+		} \
+	} while (false)
+
+#define LOG_TRACE(category, format, ...) CAUSALITY_LOG(::Causality::LogLevel::Trace, category, format, ##__VA_ARGS__)
+#define LOG_DEBUG(category, format, ...) CAUSALITY_LOG(::Causality::LogLevel::Debug, category, format, ##__VA_ARGS__)
+#define LOG_INFO(category, format, ...) CAUSALITY_LOG(::Causality::LogLevel::Info, category, format, ##__VA_ARGS__)
+#define LOG_WARNING(category, format, ...) CAUSALITY_LOG(::Causality::LogLevel::Warning, category, format, ##__VA_ARGS__)
+#define LOG_ERROR(category, format, ...) CAUSALITY_LOG(::Causality::LogLevel::Error, category, format, ##__VA_ARGS__)
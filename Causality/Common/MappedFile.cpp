@@ -0,0 +1,121 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace DirectX;
+
+DirectX::MappedFile::MappedFile()
+	: m_IsOpen(false), m_pData(nullptr), m_Size(0)
+#ifdef _WIN32
+	, m_hFile(INVALID_HANDLE_VALUE), m_hMapping(nullptr)
+#else
+	, m_File(-1)
+#endif
+{
+}
+
+DirectX::MappedFile::MappedFile(const std::wstring & path)
+	: MappedFile()
+{
+	Open(path);
+}
+
+DirectX::MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool DirectX::MappedFile::Open(const std::wstring & path)
+{
+	Close();
+	m_hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size))
+	{
+		Close();
+		return false;
+	}
+	m_Size = static_cast<size_t>(size.QuadPart);
+	m_IsOpen = true;
+	// Empty files can't be mapped
+	if (m_Size == 0)
+		return true;
+
+	m_hMapping = CreateFileMappingW(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping)
+		m_pData = static_cast<const char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void DirectX::MappedFile::Close()
+{
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping)
+		CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = nullptr;
+	m_pData = nullptr;
+	m_Size = 0;
+	m_IsOpen = false;
+}
+#else
+bool DirectX::MappedFile::Open(const std::wstring & path)
+{
+	Close();
+	m_File = open(std::string(path.begin(), path.end()).c_str(), O_RDONLY);
+	if (m_File < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(m_File, &status) != 0)
+	{
+		Close();
+		return false;
+	}
+	m_Size = static_cast<size_t>(status.st_size);
+	m_IsOpen = true;
+	if (m_Size == 0)
+		return true;
+
+	auto pData = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+	if (pData == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	m_pData = static_cast<const char*>(pData);
+	return true;
+}
+
+void DirectX::MappedFile::Close()
+{
+	if (m_pData)
+		munmap(const_cast<char*>(m_pData), m_Size);
+	if (m_File >= 0)
+		close(m_File);
+	m_File = -1;
+	m_pData = nullptr;
+	m_Size = 0;
+	m_IsOpen = false;
+}
+#endif
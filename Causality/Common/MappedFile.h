@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+namespace DirectX
+{
+	// Read only view of a whole file mapped into memory, pages are read in on first touch
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		explicit MappedFile(const std::wstring& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::wstring& path);
+		void Close();
+
+		// An empty file is open with no data
+		bool IsOpen() const { return m_IsOpen; }
+		const char* Data() const { return m_pData; }
+		size_t Size() const { return m_Size; }
+
+	private:
+		bool		m_IsOpen;
+		const char*	m_pData;
+		size_t		m_Size;
+#ifdef _WIN32
+		void*		m_hFile;
+		void*		m_hMapping;
+#else
+		int			m_File;
+#endif
+	};
+}
@@ -2,7 +2,7 @@
 #include <fstream>
 #include <WICTextureLoader.h>
 #include "Material.h"
-#include "Extern/tiny_obj_loader.h"
+#include "ObjParser.h"
 #include <boost\filesystem.hpp>
 using namespace DirectX;
 using namespace DirectX::Scene;
@@ -16,10 +16,8 @@ DirectX::Scene::PhongMaterial::PhongMaterial()
 std::vector<std::shared_ptr<PhongMaterial>> DirectX::Scene::PhongMaterial::CreateFromMtlFile(ID3D11Device * pDevice, const std::wstring & file, const std::wstring & lookupDirectory)
 {
 	std::vector<std::shared_ptr<PhongMaterial>> Materials;
-	std::map<std::string, int> map;
 	std::vector<material_t> materis;
-	std::ifstream fin(file);
-	tinyobj::LoadMtl(map, materis, fin);
+	ObjParser::LoadMtl(materis, file);
 	ComPtr<ID3D11DeviceContext> pContext;
 	ComPtr<ID3D11Resource> pResource;
 	boost::filesystem::path lookup(lookupDirectory);
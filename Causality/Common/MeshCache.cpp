@@ -0,0 +1,320 @@
+#include "MeshCache.h"
+#include "Model.h"
+#include <cstring>
+#include <boost\filesystem.hpp>
+#include <boost\filesystem\fstream.hpp>
+
+using namespace DirectX;
+using namespace DirectX::Scene;
+using namespace std;
+
+static const char CacheMagic[4] = { 'C', 'M', 'S', 'H' };
+static const uint64_t SectionAlignment = 16;
+
+static uint64_t Align(uint64_t offset)
+{
+	return (offset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+}
+
+namespace
+{
+	// Zero terminated strings of one cache, offset 0 is the empty string
+	class StringTable
+	{
+	public:
+		StringTable() : m_Bytes(1, '\0') {}
+
+		uint32_t Add(const std::string& str)
+		{
+			if (str.empty())
+				return 0;
+			auto offset = static_cast<uint32_t>(m_Bytes.size());
+			m_Bytes.insert(m_Bytes.end(), str.begin(), str.end());
+			m_Bytes.push_back('\0');
+			return offset;
+		}
+
+		const std::vector<char>& Bytes() const { return m_Bytes; }
+
+	private:
+		std::vector<char> m_Bytes;
+	};
+
+	void WritePadded(boost::filesystem::ofstream& stream, const void* data, size_t size)
+	{
+		static const char zeros[SectionAlignment] = {};
+		if (size)
+			stream.write(static_cast<const char*>(data), size);
+		auto padding = Align(size) - size;
+		if (padding)
+			stream.write(zeros, padding);
+	}
+}
+
+uint64_t DirectX::Scene::MeshCache::Hash(const char * data, size_t size)
+{
+	const uint64_t prime = 1099511628211ULL;
+	uint64_t hash = 14695981039346656037ULL ^ size;
+	size_t words = size / sizeof(uint64_t);
+	uint64_t word;
+	for (size_t i = 0; i < words; i++)
+	{
+		memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+		hash = (hash ^ word) * prime;
+	}
+	for (size_t i = words * sizeof(uint64_t); i < size; i++)
+		hash = (hash ^ static_cast<uint8_t>(data[i])) * prime;
+	return hash;
+}
+
+std::wstring DirectX::Scene::MeshCache::PathFor(const std::wstring & sourceFile)
+{
+	return boost::filesystem::path(sourceFile).replace_extension(L".meshcache").wstring();
+}
+
+bool DirectX::Scene::MeshCache::Write(const std::wstring & path, uint64_t sourceHash, uint64_t sourceSize, unsigned loadFlags, const GeometryModel & model, const std::vector<int>& partMaterials, const std::vector<MaterialDescription>& materials)
+{
+	StringTable strings;
+	vector<MeshCachePart> parts(model.Parts.size());
+	vector<MeshCacheLod> lods;
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		const auto& part = *model.Parts[i];
+		auto& record = parts[i];
+		record.Name = strings.Add(part.Name);
+		record.Material = i < partMaterials.size() ? partMaterials[i] : -1;
+		record.VertexOffset = part.pMesh->VertexOffset;
+		record.VertexCount = part.pMesh->VertexCount;
+		record.StartIndex = part.pMesh->StartIndex;
+		record.IndexCount = part.pMesh->IndexCount;
+		record.IndexSize = part.pMesh->IndexFormat == DXGI_FORMAT_R32_UINT ? sizeof(uint32_t) : sizeof(uint16_t);
+		record.FirstLod = static_cast<uint32_t>(lods.size());
+		record.LodCount = static_cast<uint32_t>(part.pMesh->Lods.size());
+		for (const auto& lod : part.pMesh->Lods)
+		{
+			MeshCacheLod lodRecord = { lod.StartIndex, lod.IndexCount, lod.Error };
+			lods.push_back(lodRecord);
+		}
+		record.BoundBox = part.BoundBox;
+		record.BoundOrientedBox = part.BoundOrientedBox;
+	}
+
+	vector<MeshCacheMaterial> mats(materials.size());
+	for (size_t i = 0; i < mats.size(); i++)
+	{
+		const auto& desc = materials[i];
+		auto& record = mats[i];
+		record.Name = strings.Add(desc.Name);
+		record.DiffuseMap = strings.Add(desc.DiffuseMap);
+		record.SpecularMap = strings.Add(desc.SpecularMap);
+		record.NormalMap = strings.Add(desc.NormalMap);
+		record.Alpha = desc.Alpha;
+		memcpy(record.DiffuseColor, desc.DiffuseColor, sizeof(record.DiffuseColor));
+		memcpy(record.AmbientColor, desc.AmbientColor, sizeof(record.AmbientColor));
+		memcpy(record.SpecularColor, desc.SpecularColor, sizeof(record.SpecularColor));
+	}
+
+	vector<uint16_t> shortIndices;
+	vector<uint32_t> longIndices;
+	model.GatherIndices(shortIndices, longIndices);
+
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, CacheMagic, sizeof(CacheMagic));
+	header.Version = Version;
+	header.SourceHash = sourceHash;
+	header.SourceSize = sourceSize;
+	header.LoadFlags = loadFlags;
+	header.VertexStride = sizeof(VertexPositionNormalTexture);
+	header.VertexCount = static_cast<uint32_t>(model.Vertices.size());
+	header.TangentCount = static_cast<uint32_t>(model.Tangents.size());
+	header.ShortIndexCount = static_cast<uint32_t>(shortIndices.size());
+	header.LongIndexCount = static_cast<uint32_t>(longIndices.size());
+	header.PartCount = static_cast<uint32_t>(parts.size());
+	header.LodCount = static_cast<uint32_t>(lods.size());
+	header.MaterialCount = static_cast<uint32_t>(mats.size());
+	header.StringBytes = static_cast<uint32_t>(strings.Bytes().size());
+	header.VertexSection = Align(sizeof(MeshCacheHeader));
+	header.TangentSection = header.VertexSection + Align(uint64_t(header.VertexCount) * header.VertexStride);
+	header.ShortIndexSection = header.TangentSection + Align(uint64_t(header.TangentCount) * sizeof(XMFLOAT4));
+	header.LongIndexSection = header.ShortIndexSection + Align(shortIndices.size() * sizeof(uint16_t));
+	header.PartSection = header.LongIndexSection + Align(longIndices.size() * sizeof(uint32_t));
+	header.LodSection = header.PartSection + Align(parts.size() * sizeof(MeshCachePart));
+	header.MaterialSection = header.LodSection + Align(lods.size() * sizeof(MeshCacheLod));
+	header.StringSection = header.MaterialSection + Align(mats.size() * sizeof(MeshCacheMaterial));
+	header.BoundBox = model.BoundBox;
+	header.BoundOrientedBox = model.BoundOrientedBox;
+	header.BoundSphere = model.BoundSphere;
+
+	// Loads of the same source may write it at once, each through its own temporary file
+	boost::filesystem::path target(path);
+	auto temporary = target;
+	temporary += boost::filesystem::unique_path(L".%%%%-%%%%-%%%%.tmp");
+	bool written;
+	{
+		boost::filesystem::ofstream stream(temporary, ios::binary | ios::trunc);
+		if (!stream)
+			return false;
+		WritePadded(stream, &header, sizeof(header));
+		WritePadded(stream, model.Vertices.data(), model.Vertices.size() * sizeof(VertexPositionNormalTexture));
+		WritePadded(stream, model.Tangents.data(), model.Tangents.size() * sizeof(XMFLOAT4));
+		WritePadded(stream, shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+		WritePadded(stream, longIndices.data(), longIndices.size() * sizeof(uint32_t));
+		WritePadded(stream, parts.data(), parts.size() * sizeof(MeshCachePart));
+		WritePadded(stream, lods.data(), lods.size() * sizeof(MeshCacheLod));
+		WritePadded(stream, mats.data(), mats.size() * sizeof(MeshCacheMaterial));
+		WritePadded(stream, strings.Bytes().data(), strings.Bytes().size());
+		written = !!stream;
+	}
+
+	boost::system::error_code error;
+	if (!written)
+	{
+		boost::filesystem::remove(temporary, error);
+		return false;
+	}
+	boost::filesystem::rename(temporary, target, error);
+	if (!error)
+		return true;
+	boost::filesystem::remove(temporary, error);
+	return false;
+}
+
+bool DirectX::Scene::MeshCache::Open(const std::wstring & path, uint64_t sourceHash, uint64_t sourceSize, unsigned loadFlags)
+{
+	Close();
+	if (!m_File.Open(path) || m_File.Size() < sizeof(MeshCacheHeader))
+	{
+		Close();
+		return false;
+	}
+
+	auto pHeader = reinterpret_cast<const MeshCacheHeader*>(m_File.Data());
+	auto size = static_cast<uint64_t>(m_File.Size());
+	auto fits = [size](uint64_t offset, uint64_t bytes)
+	{
+		return offset % SectionAlignment == 0 && offset <= size && bytes <= size - offset;
+	};
+	bool valid = memcmp(pHeader->Magic, CacheMagic, sizeof(CacheMagic)) == 0
+		&& pHeader->Version == Version
+		&& pHeader->SourceHash == sourceHash
+		&& pHeader->SourceSize == sourceSize
+		&& pHeader->LoadFlags == loadFlags
+		&& pHeader->VertexStride == sizeof(VertexPositionNormalTexture)
+		&& fits(pHeader->VertexSection, uint64_t(pHeader->VertexCount) * pHeader->VertexStride)
+		&& (pHeader->TangentCount == 0 || pHeader->TangentCount == pHeader->VertexCount)
+		&& fits(pHeader->TangentSection, uint64_t(pHeader->TangentCount) * sizeof(XMFLOAT4))
+		&& fits(pHeader->ShortIndexSection, uint64_t(pHeader->ShortIndexCount) * sizeof(uint16_t))
+		&& fits(pHeader->LongIndexSection, uint64_t(pHeader->LongIndexCount) * sizeof(uint32_t))
+		&& fits(pHeader->PartSection, uint64_t(pHeader->PartCount) * sizeof(MeshCachePart))
+		&& fits(pHeader->LodSection, uint64_t(pHeader->LodCount) * sizeof(MeshCacheLod))
+		&& fits(pHeader->MaterialSection, uint64_t(pHeader->MaterialCount) * sizeof(MeshCacheMaterial))
+		&& fits(pHeader->StringSection, pHeader->StringBytes)
+		&& pHeader->StringBytes > 0
+		&& m_File.Data()[pHeader->StringSection + pHeader->StringBytes - 1] == '\0';
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+	m_pHeader = pHeader;
+
+	// Part ranges and references are checked once here, so users of the cache can trust them
+	auto parts = Parts();
+	auto lods = Lods();
+	for (uint32_t i = 0; i < pHeader->PartCount; i++)
+	{
+		const auto& part = parts[i];
+		auto indexCount = part.IndexSize == sizeof(uint32_t) ? pHeader->LongIndexCount : pHeader->ShortIndexCount;
+		bool valid = uint64_t(part.VertexOffset) + part.VertexCount <= pHeader->VertexCount
+			&& (part.IndexSize == sizeof(uint16_t) || part.IndexSize == sizeof(uint32_t))
+			&& part.IndexCount % 3 == 0
+			&& uint64_t(part.StartIndex) + part.IndexCount <= indexCount
+			&& part.Material >= -1 && part.Material < int32_t(pHeader->MaterialCount)
+			&& part.Name < pHeader->StringBytes
+			&& uint64_t(part.FirstLod) + part.LodCount <= pHeader->LodCount;
+		for (uint32_t l = 0; valid && l < part.LodCount; l++)
+		{
+			const auto& lod = lods[part.FirstLod + l];
+			valid = lod.IndexCount % 3 == 0 && uint64_t(lod.StartIndex) + lod.IndexCount <= indexCount;
+		}
+		if (!valid)
+		{
+			Close();
+			return false;
+		}
+	}
+	auto materials = Materials();
+	for (uint32_t i = 0; i < pHeader->MaterialCount; i++)
+	{
+		const auto& mat = materials[i];
+		if (mat.Name >= pHeader->StringBytes || mat.DiffuseMap >= pHeader->StringBytes
+			|| mat.SpecularMap >= pHeader->StringBytes || mat.NormalMap >= pHeader->StringBytes)
+		{
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void DirectX::Scene::MeshCache::Close()
+{
+	m_pHeader = nullptr;
+	m_File.Close();
+}
+
+const VertexPositionNormalTexture * DirectX::Scene::MeshCache::Vertices() const
+{
+	return reinterpret_cast<const VertexPositionNormalTexture*>(m_File.Data() + m_pHeader->VertexSection);
+}
+
+const XMFLOAT4 * DirectX::Scene::MeshCache::Tangents() const
+{
+	return reinterpret_cast<const XMFLOAT4*>(m_File.Data() + m_pHeader->TangentSection);
+}
+
+const uint16_t * DirectX::Scene::MeshCache::ShortIndices() const
+{
+	return reinterpret_cast<const uint16_t*>(m_File.Data() + m_pHeader->ShortIndexSection);
+}
+
+const uint32_t * DirectX::Scene::MeshCache::LongIndices() const
+{
+	return reinterpret_cast<const uint32_t*>(m_File.Data() + m_pHeader->LongIndexSection);
+}
+
+const MeshCachePart * DirectX::Scene::MeshCache::Parts() const
+{
+	return reinterpret_cast<const MeshCachePart*>(m_File.Data() + m_pHeader->PartSection);
+}
+
+const MeshCacheLod * DirectX::Scene::MeshCache::Lods() const
+{
+	return reinterpret_cast<const MeshCacheLod*>(m_File.Data() + m_pHeader->LodSection);
+}
+
+const MeshCacheMaterial * DirectX::Scene::MeshCache::Materials() const
+{
+	return reinterpret_cast<const MeshCacheMaterial*>(m_File.Data() + m_pHeader->MaterialSection);
+}
+
+const char * DirectX::Scene::MeshCache::String(uint32_t offset) const
+{
+	return m_File.Data() + m_pHeader->StringSection + offset;
+}
+
+MaterialDescription DirectX::Scene::MeshCache::DescribeMaterial(uint32_t index) const
+{
+	const auto& mat = Materials()[index];
+	MaterialDescription desc;
+	desc.Name = String(mat.Name);
+	desc.DiffuseMap = String(mat.DiffuseMap);
+	desc.SpecularMap = String(mat.SpecularMap);
+	desc.NormalMap = String(mat.NormalMap);
+	desc.Alpha = mat.Alpha;
+	memcpy(desc.DiffuseColor, mat.DiffuseColor, sizeof(desc.DiffuseColor));
+	memcpy(desc.AmbientColor, mat.AmbientColor, sizeof(desc.AmbientColor));
+	memcpy(desc.SpecularColor, mat.SpecularColor, sizeof(desc.SpecularColor));
+	return desc;
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <VertexTypes.h>
+#include <DirectXCollision.h>
+
+namespace DirectX
+{
+	namespace Scene
+	{
+		class GeometryModel;
+
+		// Binary image of a loaded GeometryModel, mapped and used in place on later loads
+		// Layout : header, vertices, tangents, 16 bit indices, 32 bit indices, parts, levels of detail, materials, strings, every section 16 byte aligned
+		// Indices are kept in their draw format, as GeometryModel::GatherIndices lays them out, levels included
+		// Strings are offsets into the string section, offset 0 is the empty string
+		struct MeshCacheHeader
+		{
+			char				Magic[4];
+			uint32_t			Version;
+			// Of the OBJ, with the hashes of its material libraries folded in
+			uint64_t			SourceHash;
+			uint64_t			SourceSize;
+			// ModelLoadFlags the model was loaded with
+			uint32_t			LoadFlags;
+			uint32_t			VertexStride;
+			uint32_t			VertexCount;
+			// Zero, or VertexCount when the model was loaded with tangents
+			uint32_t			TangentCount;
+			uint32_t			ShortIndexCount;
+			uint32_t			LongIndexCount;
+			uint32_t			PartCount;
+			uint32_t			LodCount;
+			uint32_t			MaterialCount;
+			uint32_t			StringBytes;
+			uint64_t			VertexSection;
+			uint64_t			TangentSection;
+			uint64_t			ShortIndexSection;
+			uint64_t			LongIndexSection;
+			uint64_t			PartSection;
+			uint64_t			LodSection;
+			uint64_t			MaterialSection;
+			uint64_t			StringSection;
+			BoundingBox			BoundBox;
+			BoundingOrientedBox	BoundOrientedBox;
+			BoundingSphere		BoundSphere;
+		};
+
+		struct MeshCachePart
+		{
+			uint32_t			Name;
+			int32_t				Material;
+			uint32_t			VertexOffset;
+			uint32_t			VertexCount;
+			// In the 16 or 32 bit index section, as IndexSize says
+			uint32_t			StartIndex;
+			uint32_t			IndexCount;
+			uint32_t			IndexSize;
+			// The part's coarser levels are [FirstLod, FirstLod + LodCount) of the level section
+			uint32_t			FirstLod;
+			uint32_t			LodCount;
+			BoundingBox			BoundBox;
+			BoundingOrientedBox	BoundOrientedBox;
+		};
+
+		// Same as MeshLod, StartIndex is in the index section of the part's IndexSize
+		struct MeshCacheLod
+		{
+			uint32_t			StartIndex;
+			uint32_t			IndexCount;
+			float				Error;
+		};
+
+		struct MeshCacheMaterial
+		{
+			uint32_t			Name;
+			uint32_t			DiffuseMap;
+			uint32_t			SpecularMap;
+			uint32_t			NormalMap;
+			float				Alpha;
+			float				DiffuseColor[3];
+			float				AmbientColor[3];
+			float				SpecularColor[3];
+		};
+
+		// What a model's materials are made from, textures are names relative to the texture directory
+		struct MaterialDescription
+		{
+			std::string			Name;
+			std::string			DiffuseMap;
+			std::string			SpecularMap;
+			std::string			NormalMap;
+			float				Alpha;
+			float				DiffuseColor[3];
+			float				AmbientColor[3];
+			float				SpecularColor[3];
+		};
+
+		class MeshCache
+		{
+		public:
+			// Bump whenever a cache struct or the model loading it is built from changes
+			static const uint32_t Version = 5;
+
+			// Content hash of a source file, 64 bit FNV-1a over 8 byte words
+			static uint64_t Hash(const char* data, size_t size);
+
+			// Cache file that belongs to a source model file
+			static std::wstring PathFor(const std::wstring& sourceFile);
+
+			// Write through a uniquely named temporary file and rename, so a reader never maps a partial cache
+			// and concurrent writers of the same cache don't write over each other's file
+			// partMaterials indexes materials per part, -1 for none
+			static bool Write(const std::wstring& path, uint64_t sourceHash, uint64_t sourceSize, unsigned loadFlags, const GeometryModel& model, const std::vector<int>& partMaterials, const std::vector<MaterialDescription>& materials);
+
+			// Maps the cache, fails if it is missing, truncated, of another version, from other source content or other load flags
+			bool Open(const std::wstring& path, uint64_t sourceHash, uint64_t sourceSize, unsigned loadFlags);
+			void Close();
+
+			// Pointers into the mapped file, valid until Close
+			const MeshCacheHeader& Header() const { return *m_pHeader; }
+			const VertexPositionNormalTexture* Vertices() const;
+			const XMFLOAT4* Tangents() const;
+			const uint16_t* ShortIndices() const;
+			const uint32_t* LongIndices() const;
+			const MeshCachePart* Parts() const;
+			const MeshCacheLod* Lods() const;
+			const MeshCacheMaterial* Materials() const;
+			const char* String(uint32_t offset) const;
+
+			MaterialDescription DescribeMaterial(uint32_t index) const;
+
+		private:
+			MappedFile				m_File;
+			const MeshCacheHeader*	m_pHeader = nullptr;
+		};
+	}
+}
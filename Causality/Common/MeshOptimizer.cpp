@@ -0,0 +1,300 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+using namespace DirectX::Scene;
+using namespace std;
+
+// A cluster is cut once its ACMR, simulated from an empty cache, gets this low
+// Lower keeps more cache efficiency, higher gives the overdraw sort more and smaller clusters to work with
+static const float ClusterSplitAcmr = 0.75f;
+static const uint32_t NoVertex = 0xffffffff;
+
+namespace
+{
+	// FIFO cache simulation by timestamps : a vertex is cached while fewer than cacheSize misses happened since its own
+	class CacheSimulator
+	{
+	public:
+		CacheSimulator(size_t vertexCount, uint32_t cacheSize)
+			: m_Stamps(vertexCount, 0), m_CacheSize(cacheSize), m_Time(cacheSize + 1)
+		{}
+
+		// True on a miss
+		bool Touch(uint32_t v)
+		{
+			if (m_Time - m_Stamps[v] <= m_CacheSize)
+				return false;
+			m_Stamps[v] = m_Time++;
+			return true;
+		}
+
+		void Flush()
+		{
+			m_Time += m_CacheSize + 1;
+		}
+
+	private:
+		vector<uint32_t>	m_Stamps;
+		uint32_t			m_CacheSize;
+		uint32_t			m_Time;
+	};
+
+	// Triangles around every vertex, compressed rows
+	struct Adjacency
+	{
+		vector<uint32_t> Offsets;
+		vector<uint32_t> Triangles;
+
+		Adjacency(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+			: Offsets(vertexCount + 1, 0), Triangles(indexCount)
+		{
+			for (size_t i = 0; i < indexCount; i++)
+				Offsets[indices[i] + 1]++;
+			for (size_t v = 0; v < vertexCount; v++)
+				Offsets[v + 1] += Offsets[v];
+			vector<uint32_t> fill(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i < indexCount; i++)
+				Triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	};
+}
+
+VertexCacheStatistics DirectX::Scene::MeshOptimizer::AnalyzeVertexCache(const uint32_t * indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	CacheSimulator cache(vertexCount, cacheSize);
+	vector<bool> referenced(vertexCount, false);
+	VertexCacheStatistics stats = {};
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		auto v = indices[i];
+		if (cache.Touch(v))
+			stats.Misses++;
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			stats.VertexCount++;
+		}
+	}
+	stats.TriangleCount = static_cast<uint32_t>(indexCount / 3);
+	stats.Acmr = stats.TriangleCount ? float(stats.Misses) / stats.TriangleCount : 0;
+	stats.Atvr = stats.VertexCount ? float(stats.Misses) / stats.VertexCount : 0;
+	return stats;
+}
+
+void DirectX::Scene::MeshOptimizer::OptimizeVertexCache(uint32_t * indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>* pClusters)
+{
+	auto triangleCount = indexCount / 3;
+	if (pClusters)
+		pClusters->clear();
+	if (triangleCount == 0)
+		return;
+
+	Adjacency adjacency(indices, indexCount, vertexCount);
+	vector<uint32_t> live(vertexCount), stamps(vertexCount, 0), deadEnds, candidates;
+	for (size_t v = 0; v < vertexCount; v++)
+		live[v] = adjacency.Offsets[v + 1] - adjacency.Offsets[v];
+	vector<bool> emitted(triangleCount, false);
+	vector<uint32_t> output;
+	output.reserve(indexCount);
+	// Triangle counts where the traversal restarted from a dead end
+	vector<uint32_t> hardBoundaries;
+
+	uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+	uint32_t fan = 0;
+	while (fan != NoVertex)
+	{
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (auto a = adjacency.Offsets[fan]; a < adjacency.Offsets[fan + 1]; a++)
+		{
+			auto t = adjacency.Triangles[a];
+			if (emitted[t])
+				continue;
+			emitted[t] = true;
+			for (size_t k = 0; k < 3; k++)
+			{
+				auto v = indices[t * 3 + k];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - stamps[v] > cacheSize)
+					stamps[v] = time++;
+			}
+		}
+
+		// Next fan : the oldest candidate still in the cache after its own fan is emitted
+		uint32_t next = NoVertex;
+		int64_t best = -1;
+		for (auto v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+			int64_t priority = 0;
+			if (time - stamps[v] + 2 * live[v] <= cacheSize)
+				priority = time - stamps[v];
+			if (priority > best)
+			{
+				best = priority;
+				next = v;
+			}
+		}
+
+		if (next == NoVertex)
+		{
+			// Dead end : recently used vertices first, then the next vertex in input order
+			while (!deadEnds.empty() && next == NoVertex)
+			{
+				auto v = deadEnds.back();
+				deadEnds.pop_back();
+				if (live[v] > 0)
+					next = v;
+			}
+			for (; next == NoVertex && cursor < vertexCount; cursor++)
+			{
+				if (live[cursor] > 0)
+					next = static_cast<uint32_t>(cursor);
+			}
+			if (next != NoVertex)
+				hardBoundaries.push_back(static_cast<uint32_t>(output.size() / 3));
+		}
+		fan = next;
+	}
+	copy(output.begin(), output.end(), indices);
+
+	if (!pClusters)
+		return;
+
+	// Hard clusters are cut further where they reuse the cache well enough on their own
+	hardBoundaries.push_back(static_cast<uint32_t>(triangleCount));
+	CacheSimulator cache(vertexCount, cacheSize);
+	uint32_t start = 0;
+	for (auto end : hardBoundaries)
+	{
+		if (end == start)
+			continue;
+		pClusters->push_back(start);
+		cache.Flush();
+		uint32_t misses = 0, clusterStart = start;
+		for (uint32_t t = start; t < end; t++)
+		{
+			for (size_t k = 0; k < 3; k++)
+				misses += cache.Touch(indices[t * 3 + k]);
+			if (t + 1 < end && misses < ClusterSplitAcmr * (t + 1 - clusterStart))
+			{
+				clusterStart = t + 1;
+				pClusters->push_back(clusterStart);
+				cache.Flush();
+				misses = 0;
+			}
+		}
+		start = end;
+	}
+}
+
+void DirectX::Scene::MeshOptimizer::OptimizeOverdraw(uint32_t * indices, size_t indexCount, const XMFLOAT3 * positions, size_t positionStride, const std::vector<uint32_t>& clusters)
+{
+	auto triangleCount = static_cast<uint32_t>(indexCount / 3);
+	if (clusters.size() < 2)
+		return;
+
+	auto position = [&](uint32_t v) -> const XMFLOAT3&
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const char*>(positions) + v * positionStride);
+	};
+
+	// Area weighted centroid and summed face normal of every cluster, in double so the order doesn't depend on rounding
+	struct ClusterShape
+	{
+		double Area;
+		double Centroid[3];
+		double Normal[3];
+	};
+	vector<ClusterShape> shapes(clusters.size());
+	double meshArea = 0, meshCentroid[3] = {};
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		auto& shape = shapes[c];
+		memset(&shape, 0, sizeof(shape));
+		auto end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		for (auto t = clusters[c]; t < end; t++)
+		{
+			const auto& p0 = position(indices[t * 3 + 0]);
+			const auto& p1 = position(indices[t * 3 + 1]);
+			const auto& p2 = position(indices[t * 3 + 2]);
+			double e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			double e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			double area = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			double center[3] = { (p0.x + p1.x + p2.x) / 3.0, (p0.y + p1.y + p2.y) / 3.0, (p0.z + p1.z + p2.z) / 3.0 };
+			shape.Area += area;
+			for (int k = 0; k < 3; k++)
+			{
+				shape.Centroid[k] += center[k] * area;
+				shape.Normal[k] += n[k];
+			}
+		}
+		meshArea += shape.Area;
+		for (int k = 0; k < 3; k++)
+			meshCentroid[k] += shape.Centroid[k];
+	}
+	if (meshArea <= 0)
+		return;
+	for (int k = 0; k < 3; k++)
+		meshCentroid[k] /= meshArea;
+
+	// Clusters far out along their own normal are likely to occlude the rest, they go first
+	vector<double> keys(clusters.size(), 0);
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const auto& shape = shapes[c];
+		double length = sqrt(shape.Normal[0] * shape.Normal[0] + shape.Normal[1] * shape.Normal[1] + shape.Normal[2] * shape.Normal[2]);
+		if (shape.Area <= 0 || length <= 0)
+			continue;
+		for (int k = 0; k < 3; k++)
+			keys[c] += (shape.Centroid[k] / shape.Area - meshCentroid[k]) * shape.Normal[k] / length;
+	}
+	vector<uint32_t> order(clusters.size());
+	for (size_t c = 0; c < order.size(); c++)
+		order[c] = static_cast<uint32_t>(c);
+	stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+	vector<uint32_t> sorted;
+	sorted.reserve(triangleCount * 3);
+	for (auto c : order)
+	{
+		auto end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		sorted.insert(sorted.end(), indices + clusters[c] * 3, indices + end * 3);
+	}
+	copy(sorted.begin(), sorted.end(), indices);
+}
+
+void DirectX::Scene::MeshOptimizer::OptimizeVertexFetch(uint32_t * indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& remap)
+{
+	remap.assign(vertexCount, NoVertex);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		auto& target = remap[indices[i]];
+		if (target == NoVertex)
+			target = next++;
+		indices[i] = target;
+	}
+	for (auto& target : remap)
+	{
+		if (target == NoVertex)
+			target = next++;
+	}
+}
+
+void DirectX::Scene::MeshOptimizer::RemapVertices(void * vertices, size_t vertexCount, size_t stride, const std::vector<uint32_t>& remap)
+{
+	auto pData = static_cast<char*>(vertices);
+	vector<char> original(pData, pData + vertexCount * stride);
+	for (size_t v = 0; v < vertexCount; v++)
+		memcpy(pData + remap[v] * stride, original.data() + v * stride, stride);
+}
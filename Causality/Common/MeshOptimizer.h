@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <DirectXMath.h>
+
+namespace DirectX
+{
+	namespace Scene
+	{
+		// Post-transform vertex cache behaviour of a triangle list, as a FIFO cache of the simulated size sees it
+		struct VertexCacheStatistics
+		{
+			// Vertex shader invocations per triangle, 3 without any reuse, about 0.5 at best on regular meshes
+			float		Acmr;
+			// Vertex shader invocations per referenced vertex, 1 at best
+			float		Atvr;
+			uint32_t	Misses;
+			uint32_t	TriangleCount;
+			uint32_t	VertexCount;
+		};
+
+		// Triangle and vertex reordering of indexed triangle lists, run once per part when a model is loaded
+		// Triangles : Tipsify (Sander, Nehab, Barczak 2007), linear in the triangle count
+		// Overdraw : Tipsify's clusters drawn outside-in, so near surfaces tend to be drawn before what they hide
+		// Vertices : first use order, so vertex fetch walks the buffer forward
+		class MeshOptimizer
+		{
+		public:
+			// Post-transform cache of current desktop GPUs is taken as 16 entries FIFO
+			static const uint32_t DefaultCacheSize = 16;
+
+			static VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = DefaultCacheSize);
+
+			// Reorders the triangles in place, pClusters receives the first triangle of every cluster
+			// A cluster ends where the traversal hits a dead end, clusters can be drawn in any order for little cache loss
+			static void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = DefaultCacheSize, std::vector<uint32_t>* pClusters = nullptr);
+
+			// Reorders clusters (as OptimizeVertexCache gave them) by how much they face out of the mesh center
+			// Front faces are clockwise, as Direct3D culls by default
+			static void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const XMFLOAT3* positions, size_t positionStride, const std::vector<uint32_t>& clusters);
+
+			// Renumbers vertices in the order indices first use them, unreferenced vertices go last in their old order
+			// remap receives the new index of every old vertex, the caller moves the vertex data with it
+			static void OptimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& remap);
+
+			// Moves elements of stride bytes to the positions remap gives them
+			static void RemapVertices(void* vertices, size_t vertexCount, size_t stride, const std::vector<uint32_t>& remap);
+		};
+	}
+}
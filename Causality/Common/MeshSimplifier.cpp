@@ -0,0 +1,267 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using namespace DirectX;
+using namespace DirectX::Scene;
+using namespace std;
+
+// A collapse may not turn a triangle further than this from its old normal (cosine)
+static const double MaxNormalDeviation = 0.2;
+
+namespace
+{
+	// Sum of area weighted squared distances to planes : Q(p) = p'Ap + 2b'p + c
+	struct Quadric
+	{
+		double A00, A01, A02, A11, A12, A22;
+		double B0, B1, B2;
+		double C;
+		double Weight;
+
+		void AddPlane(const double n[3], double d, double weight)
+		{
+			A00 += weight * n[0] * n[0]; A01 += weight * n[0] * n[1]; A02 += weight * n[0] * n[2];
+			A11 += weight * n[1] * n[1]; A12 += weight * n[1] * n[2]; A22 += weight * n[2] * n[2];
+			B0 += weight * d * n[0]; B1 += weight * d * n[1]; B2 += weight * d * n[2];
+			C += weight * d * d;
+			Weight += weight;
+		}
+
+		void Add(const Quadric& rhs)
+		{
+			A00 += rhs.A00; A01 += rhs.A01; A02 += rhs.A02;
+			A11 += rhs.A11; A12 += rhs.A12; A22 += rhs.A22;
+			B0 += rhs.B0; B1 += rhs.B1; B2 += rhs.B2;
+			C += rhs.C;
+			Weight += rhs.Weight;
+		}
+
+		double Evaluate(const XMFLOAT3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			return x * (A00 * x + A01 * y + A02 * z) + y * (A01 * x + A11 * y + A12 * z) + z * (A02 * x + A12 * y + A22 * z)
+				+ 2 * (B0 * x + B1 * y + B2 * z) + C;
+		}
+	};
+
+	// Moving vertex From onto To
+	struct Collapse
+	{
+		float		Error;
+		uint32_t	From;
+		uint32_t	To;
+
+		bool operator<(const Collapse& rhs) const
+		{
+			if (Error != rhs.Error)
+				return Error < rhs.Error;
+			return From != rhs.From ? From < rhs.From : To < rhs.To;
+		}
+	};
+
+	void Normal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2, double n[3])
+	{
+		double e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+		double e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+}
+
+float DirectX::Scene::MeshSimplifier::Simplify(std::vector<uint32_t>& destination, const uint32_t * indices, size_t indexCount, const XMFLOAT3 * positions, size_t vertexCount, size_t positionStride, size_t targetIndexCount, float maxError)
+{
+	destination.assign(indices, indices + indexCount);
+	auto position = [&](uint32_t v) -> const XMFLOAT3&
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const char*>(positions) + v * positionStride);
+	};
+
+	// Locked vertices : attribute seams first, any position used by more than one vertex
+	vector<bool> locked(vertexCount, false);
+	{
+		vector<uint32_t> order(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			order[v] = static_cast<uint32_t>(v);
+		auto less = [&](uint32_t a, uint32_t b) { return memcmp(&position(a), &position(b), sizeof(XMFLOAT3)) < 0; };
+		sort(order.begin(), order.end(), less);
+		for (size_t i = 1; i < vertexCount; i++)
+		{
+			if (!less(order[i - 1], order[i]))
+				locked[order[i - 1]] = locked[order[i]] = true;
+		}
+	}
+	// Then both ends of every edge without exactly one opposite half edge
+	{
+		unordered_map<uint64_t, uint32_t> edges;
+		edges.reserve(indexCount);
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			uint64_t a = indices[i], b = indices[i - i % 3 + (i + 1) % 3];
+			edges[a << 32 | b]++;
+		}
+		for (const auto& edge : edges)
+		{
+			uint32_t a = static_cast<uint32_t>(edge.first >> 32), b = static_cast<uint32_t>(edge.first);
+			auto opposite = edges.find(uint64_t(b) << 32 | a);
+			if (edge.second != 1 || opposite == edges.end() || opposite->second != 1)
+				locked[a] = locked[b] = true;
+		}
+	}
+
+	vector<Quadric> quadrics(vertexCount);
+	memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+	for (size_t t = 0; t < indexCount / 3; t++)
+	{
+		const auto& p0 = position(indices[t * 3]);
+		double n[3];
+		Normal(p0, position(indices[t * 3 + 1]), position(indices[t * 3 + 2]), n);
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0)
+			continue;
+		for (int k = 0; k < 3; k++)
+			n[k] /= length;
+		double d = -(n[0] * p0.x + n[1] * p0.y + n[2] * p0.z);
+		for (int k = 0; k < 3; k++)
+			quadrics[indices[t * 3 + k]].AddPlane(n, d, length * 0.5);
+	}
+
+	float error = 0;
+	vector<uint32_t> offsets(vertexCount + 1), adjacency, remap(vertexCount), fill;
+	vector<bool> touched(vertexCount);
+	vector<Collapse> collapses;
+	vector<uint32_t> neighbours;
+	while (destination.size() > targetIndexCount)
+	{
+		// Triangles around every vertex of the current mesh
+		auto triangleCount = destination.size() / 3;
+		fill_n(offsets.begin(), offsets.size(), 0);
+		for (auto v : destination)
+			offsets[v + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] += offsets[v];
+		adjacency.resize(destination.size());
+		fill.assign(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < destination.size(); i++)
+			adjacency[fill[destination[i]]++] = static_cast<uint32_t>(i / 3);
+
+		collapses.clear();
+		for (size_t i = 0; i < destination.size(); i++)
+		{
+			auto from = destination[i], to = destination[i - i % 3 + (i + 1) % 3];
+			for (int direction = 0; direction < 2; direction++, swap(from, to))
+			{
+				if (locked[from])
+					continue;
+				auto q = quadrics[from];
+				q.Add(quadrics[to]);
+				auto cost = q.Weight > 0 ? static_cast<float>(sqrt(max(q.Evaluate(position(to)), 0.0) / q.Weight)) : 0.0f;
+				if (cost <= maxError)
+					collapses.push_back(Collapse{ cost, from, to });
+			}
+		}
+		if (collapses.empty())
+			break;
+		sort(collapses.begin(), collapses.end());
+
+		// Collapses of one pass touch disjoint neighbourhoods, so each is checked against an unchanged mesh
+		// A collapse removes about two triangles, the pass stops once that would reach the target
+		size_t budget = (triangleCount - targetIndexCount / 3 + 1) / 2;
+		size_t performed = 0;
+		for (size_t v = 0; v < vertexCount; v++)
+			remap[v] = static_cast<uint32_t>(v);
+		fill_n(touched.begin(), touched.size(), false);
+		for (const auto& collapse : collapses)
+		{
+			if (performed >= budget)
+				break;
+			auto u = collapse.From, v = collapse.To;
+			if (touched[u] || touched[v])
+				continue;
+
+			// Link condition : the two vertices share exactly the neighbours opposite their edge, else the collapse folds the surface
+			neighbours.clear();
+			size_t shared = 0;
+			for (auto a = offsets[u]; a < offsets[u + 1]; a++)
+			{
+				auto t = adjacency[a];
+				bool hasV = destination[t * 3] == v || destination[t * 3 + 1] == v || destination[t * 3 + 2] == v;
+				shared += hasV;
+				for (int k = 0; k < 3; k++)
+				{
+					auto w = destination[t * 3 + k];
+					if (w != u && w != v)
+						neighbours.push_back(w);
+				}
+			}
+			sort(neighbours.begin(), neighbours.end());
+			neighbours.erase(unique(neighbours.begin(), neighbours.end()), neighbours.end());
+			size_t common = 0;
+			for (auto a = offsets[v]; a < offsets[v + 1]; a++)
+			{
+				auto t = adjacency[a];
+				for (int k = 0; k < 3; k++)
+				{
+					auto w = destination[t * 3 + k];
+					if (w != u && w != v && binary_search(neighbours.begin(), neighbours.end(), w))
+					{
+						common++;
+						// Counted once per vertex
+						neighbours.erase(lower_bound(neighbours.begin(), neighbours.end(), w));
+					}
+				}
+			}
+			if (shared == 0 || common != shared)
+				continue;
+
+			// No remaining triangle around u may flip or fold over
+			bool flips = false;
+			for (auto a = offsets[u]; a < offsets[u + 1] && !flips; a++)
+			{
+				auto t = adjacency[a];
+				const uint32_t* tri = &destination[t * 3];
+				if (tri[0] == v || tri[1] == v || tri[2] == v)
+					continue;
+				double before[3], after[3];
+				Normal(position(tri[0]), position(tri[1]), position(tri[2]), before);
+				Normal(position(tri[0] == u ? v : tri[0]), position(tri[1] == u ? v : tri[1]), position(tri[2] == u ? v : tri[2]), after);
+				double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+				double lengths = sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2])
+					* sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+				flips = dot < MaxNormalDeviation * lengths;
+			}
+			if (flips)
+				continue;
+
+			remap[u] = v;
+			quadrics[v].Add(quadrics[u]);
+			for (auto a = offsets[u]; a < offsets[u + 1]; a++)
+			{
+				auto t = adjacency[a];
+				for (int k = 0; k < 3; k++)
+					touched[destination[t * 3 + k]] = true;
+			}
+			error = max(error, collapse.Error);
+			performed++;
+		}
+		if (performed == 0)
+			break;
+
+		// Apply the pass, dropping the triangles that collapsed
+		size_t write = 0;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			auto a = remap[destination[t * 3]], b = remap[destination[t * 3 + 1]], c = remap[destination[t * 3 + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			destination[write++] = a;
+			destination[write++] = b;
+			destination[write++] = c;
+		}
+		destination.resize(write);
+	}
+	return error;
+}
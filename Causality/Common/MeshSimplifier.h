@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <DirectXMath.h>
+
+namespace DirectX
+{
+	namespace Scene
+	{
+		// Quadric error edge collapse (Garland, Heckbert 1997) of indexed triangle lists
+		// Collapses move a vertex onto a neighbour, so the result indexes the same vertices and keeps their attributes
+		// Vertices on open borders, non manifold edges and attribute seams (vertices sharing a position) never move,
+		// so meshlets of one part and texture seams stay closed at every level
+		class MeshSimplifier
+		{
+		public:
+			// Collapses the cheapest edges first until the triangle count is at most targetIndexCount / 3,
+			// or the next collapse would move a surface further than maxError
+			// Returns the largest distance of a collapsed vertex to its original surface, an RMS over the planes around it
+			static float Simplify(std::vector<uint32_t>& destination, const uint32_t* indices, size_t indexCount,
+				const XMFLOAT3* positions, size_t vertexCount, size_t positionStride, size_t targetIndexCount, float maxError);
+		};
+	}
+}
@@ -1,22 +1,44 @@
 #include "pch_directX.h"
 #define NOMINMAX
 #include "Model.h"
+#include "MeshCache.h"
+#include "ObjParser.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "TangentFrame.h"
+#include "BoundsFitter.h"
+#include "Logger.h"
+#include "..\BranchScheduler.h"
 #include <string>
 #include "stride_iterator.h"
 #include <sstream>
 #include <WICTextureLoader.h>
 #include <DDSTextureLoader.h>
 #include <boost\filesystem.hpp>
-#include "Extern\tiny_obj_loader.h"
 #include <boost\filesystem.hpp>
 #include <CommonStates.h>
+#include <cfloat>
 
 using namespace DirectX::Scene;
 using namespace DirectX;
 using namespace std;
 using namespace boost::filesystem;
 
+// Level of detail chains : each level aims at half the triangles of the one before
+static const size_t	MaxLodCount = 5;
+static const float	LodReduction = 0.5f;
+// No level is made from fewer triangles than this, or that saves less than LodMinSaving of them
+static const size_t	MinLodTriangles = 64;
+static const float	LodMinSaving = 0.1f;
+// Error a level may add, relative to its part's bounding radius
+static const float	LodMaxRelativeError = 0.05f;
+
 void DirectX::Scene::Mesh::Draw(ID3D11DeviceContext *pContext) const
+{
+	DrawLod(pContext, 0);
+}
+
+void DirectX::Scene::Mesh::DrawLod(ID3D11DeviceContext *pContext, size_t lod) const
 {
 	if (pInputLayout)
 		pContext->IASetInputLayout(pInputLayout.Get());
@@ -37,7 +59,10 @@ void DirectX::Scene::Mesh::Draw(ID3D11DeviceContext *pContext) const
 	if (pIndexBuffer)
 	{
 		pContext->IASetIndexBuffer(pIndexBuffer.Get(), IndexFormat, 0);
-		pContext->DrawIndexed(IndexCount, StartIndex, VertexOffset);
+		if (lod == 0 || lod > Lods.size())
+			pContext->DrawIndexed(IndexCount, StartIndex, VertexOffset);
+		else
+			pContext->DrawIndexed(Lods[lod - 1].IndexCount, Lods[lod - 1].StartIndex, VertexOffset);
 	}
 	else
 	{
@@ -46,7 +71,459 @@ void DirectX::Scene::Mesh::Draw(ID3D11DeviceContext *pContext) const
 	return;
 }
 
-bool DirectX::Scene::GeometryModel::CreateFromObjFile(DirectX::Scene::GeometryModel *pResult, ID3D11Device * pDevice, const std::wstring & fileName, const std::wstring & textureDir)
+size_t DirectX::Scene::Mesh::SelectLod(float tolerance) const
+{
+	size_t lod = 0;
+	while (lod < Lods.size() && Lods[lod].Error <= tolerance)
+		lod++;
+	return lod;
+}
+
+float DirectX::Scene::LodPolicy::Tolerance(float screenSize, float radius, float opacity) const
+{
+	// One view height is 2 * radius / screenSize in model space
+	if (screenSize <= 0)
+		return FLT_MAX;
+	return ScreenError * 2 * radius / screenSize / std::max(std::min(opacity, 1.0f), MinOpacity);
+}
+
+static MaterialDescription DescribeMaterial(const tinyobj::material_t& mat)
+{
+	MaterialDescription desc;
+	desc.Name = mat.name;
+	desc.DiffuseMap = mat.diffuse_texname;
+	desc.SpecularMap = mat.specular_texname;
+	desc.NormalMap = mat.normal_texname;
+	desc.Alpha = mat.dissolve;
+	std::copy_n(mat.diffuse, 3, desc.DiffuseColor);
+	std::copy_n(mat.ambient, 3, desc.AmbientColor);
+	std::copy_n(mat.specular, 3, desc.SpecularColor);
+	return desc;
+}
+
+// Textures decode in parallel, the device is free threaded
+static vector<shared_ptr<PhongMaterial>> CreateMaterials(ID3D11Device * pDevice, const vector<MaterialDescription>& descriptions, const path& lookup)
+{
+	vector<shared_ptr<PhongMaterial>> materials(descriptions.size());
+	Causality::BranchScheduler::Shared().Dispatch(descriptions.size(), [&](size_t i)
+	{
+		const auto& mat = descriptions[i];
+		HRESULT hr = S_OK;
+		ComPtr<ID3D11Resource> pResource;
+		auto pMaterial = make_shared<PhongMaterial>();
+		pMaterial->Name = mat.Name;
+		pMaterial->Alpha = mat.Alpha;
+		pMaterial->DiffuseColor = Color(mat.DiffuseColor[0], mat.DiffuseColor[1], mat.DiffuseColor[2]);
+		pMaterial->AmbientColor = Color(mat.AmbientColor[0], mat.AmbientColor[1], mat.AmbientColor[2]);
+		pMaterial->SpecularColor = Color(mat.SpecularColor[0], mat.SpecularColor[1], mat.SpecularColor[2]);
+		if (!mat.DiffuseMap.empty())
+		{
+			auto fileName = lookup / mat.DiffuseMap;
+			hr = CreateWICTextureFromFile(pDevice, fileName.wstring().data(), &pResource, &pMaterial->DiffuseMap);
+		}
+		if (!mat.SpecularMap.empty())
+		{
+			auto fileName = lookup / mat.SpecularMap;
+			hr = CreateWICTextureFromFile(pDevice, fileName.wstring().data(), &pResource, &pMaterial->SpecularMap);
+
+		}
+		if (!mat.NormalMap.empty())
+		{
+			auto fileName = lookup / mat.NormalMap;
+			hr = CreateWICTextureFromFile(pDevice, fileName.wstring().data(), &pResource, &pMaterial->NormalMap);
+		}
+		ThrowIfFailed(hr);
+		materials[i] = pMaterial;
+	});
+	return materials;
+}
+
+// One vertex buffer shared by all parts and one index buffer per index format, created from whatever memory holds the geometry
+static void CreatePartResources(GeometryModel * pResult, ID3D11Device * pDevice, const VertexPositionNormalTexture* vertices, size_t vertexCount,
+	const uint16_t* shortIndices, size_t shortIndexCount, const uint32_t* longIndices, size_t longIndexCount,
+	const vector<int>& partMaterials, const vector<MaterialDescription>& descriptions, const path& lookup)
+{
+	auto pVertexBuffer = DirectX::CreateVertexBuffer(pDevice, vertexCount, vertices);
+	ComPtr<ID3D11Buffer> pShortIndexBuffer, pLongIndexBuffer;
+	if (shortIndexCount)
+		pShortIndexBuffer = DirectX::CreateIndexBuffer(pDevice, shortIndexCount, shortIndices);
+	if (longIndexCount)
+		pLongIndexBuffer = DirectX::CreateIndexBuffer(pDevice, longIndexCount, longIndices);
+	auto materials = CreateMaterials(pDevice, descriptions, lookup);
+
+	for (size_t i = 0; i < pResult->Parts.size(); i++)
+	{
+		auto &part = pResult->Parts[i];
+		if (partMaterials[i] >= 0)
+			part->pMaterial = materials[partMaterials[i]];
+		else
+			part->pMaterial = nullptr;
+		part->pMesh->pVertexBuffer = pVertexBuffer;
+		part->pMesh->pIndexBuffer = part->pMesh->IndexFormat == DXGI_FORMAT_R32_UINT ? pLongIndexBuffer : pShortIndexBuffer;
+	}
+}
+
+// Part bounds, parts have no sphere
+static void CreatePartBounds(ModelPart& part, const XMFLOAT3* points, size_t count, size_t stride)
+{
+	PointSetBounds bounds;
+	BoundsFitter::Fit(bounds, points, count, stride, false);
+	part.BoundBox = bounds.Box;
+	part.BoundOrientedBox = bounds.OrientedBox;
+}
+
+// Cut parts over maxVertices vertices into meshlets, in triangle order
+// Vertices shared by two meshlets are duplicated, each meshlet is a part with the material of the part it comes from
+static void SplitLargeParts(GeometryModel * pResult, vector<int>& partMaterials, uint32_t maxVertices)
+{
+	typedef VertexPositionNormalTexture VertexType;
+	auto& parts = pResult->Parts;
+	if (std::none_of(parts.begin(), parts.end(), [maxVertices](const shared_ptr<ModelPart>& part) { return part->pMesh->VertexCount > maxVertices; }))
+		return;
+
+	const uint32_t unused = 0xffffffff;
+	vector<VertexType> vertices;
+	vector<XMFLOAT4> tangents;
+	bool hasTangents = !pResult->Tangents.empty();
+	vector<FacetPrimitives::Triangle<uint32_t>> facets;
+	vector<shared_ptr<ModelPart>> splitParts;
+	vector<int> splitMaterials;
+	vector<uint32_t> remap, used;
+	// Parts in splitParts that are new meshlets, their bounds are fitted once all vertices are in place
+	vector<size_t> meshlets;
+	size_t facetOffset = 0;
+	for (size_t p = 0; p < parts.size(); p++)
+	{
+		const auto& part = parts[p];
+		const auto& mesh = *part->pMesh;
+		auto pVertex = pResult->Vertices.data() + mesh.VertexOffset;
+		auto pFacet = pResult->Facets.data() + facetOffset;
+		size_t facetCount = mesh.IndexCount / 3;
+		facetOffset += facetCount;
+
+		if (mesh.VertexCount <= maxVertices)
+		{
+			part->pMesh->VertexOffset = static_cast<uint32_t>(vertices.size());
+			vertices.insert(vertices.end(), pVertex, pVertex + mesh.VertexCount);
+			if (hasTangents)
+				tangents.insert(tangents.end(), pResult->Tangents.begin() + mesh.VertexOffset, pResult->Tangents.begin() + mesh.VertexOffset + mesh.VertexCount);
+			facets.insert(facets.end(), pFacet, pFacet + facetCount);
+			splitParts.push_back(part);
+			splitMaterials.push_back(partMaterials[p]);
+			continue;
+		}
+
+		remap.assign(mesh.VertexCount, unused);
+		int piece = 0;
+		for (size_t f = 0; f < facetCount;)
+		{
+			auto vertexBase = vertices.size();
+			auto facetBase = facets.size();
+			uint32_t count = 0;
+			used.clear();
+			for (; f < facetCount; f++)
+			{
+				const auto& tri = pFacet[f];
+				uint32_t fresh = (remap[tri.V0] == unused)
+					+ (remap[tri.V1] == unused && tri.V1 != tri.V0)
+					+ (remap[tri.V2] == unused && tri.V2 != tri.V0 && tri.V2 != tri.V1);
+				if (count + fresh > maxVertices)
+					break;
+				FacetPrimitives::Triangle<uint32_t> local;
+				for (size_t k = 0; k < 3; k++)
+				{
+					auto v = tri[k];
+					if (remap[v] == unused)
+					{
+						remap[v] = count++;
+						used.push_back(v);
+						vertices.push_back(pVertex[v]);
+						if (hasTangents)
+							tangents.push_back(pResult->Tangents[mesh.VertexOffset + v]);
+					}
+					local[k] = remap[v];
+				}
+				facets.push_back(local);
+			}
+			for (auto v : used)
+				remap[v] = unused;
+
+			auto meshlet = make_shared<ModelPart>();
+			meshlet->Name = part->Name + "#" + to_string(piece++);
+			meshlet->pMesh = make_shared<Mesh>(mesh);
+			meshlet->pMesh->VertexOffset = static_cast<uint32_t>(vertexBase);
+			meshlet->pMesh->VertexCount = count;
+			meshlet->pMesh->IndexCount = static_cast<uint32_t>((facets.size() - facetBase) * 3);
+			meshlets.push_back(splitParts.size());
+			splitParts.push_back(meshlet);
+			splitMaterials.push_back(partMaterials[p]);
+		}
+	}
+
+	Causality::BranchScheduler::Shared().Dispatch(meshlets.size(), [&](size_t m)
+	{
+		const auto& mesh = *splitParts[meshlets[m]]->pMesh;
+		CreatePartBounds(*splitParts[meshlets[m]], &vertices[mesh.VertexOffset].position, mesh.VertexCount, sizeof(VertexType));
+	});
+
+	pResult->Vertices.swap(vertices);
+	if (hasTangents)
+		pResult->Tangents.swap(tangents);
+	pResult->Facets.swap(facets);
+	parts.swap(splitParts);
+	partMaterials.swap(splitMaterials);
+}
+
+// Triangle, cluster and vertex order of every part, parts own disjoint vertex and facet ranges so they run in parallel
+// Part and model bounds don't depend on the order, only the cache statistics of the whole model change
+static void OptimizeParts(GeometryModel * pResult, unsigned loadFlags)
+{
+	typedef VertexPositionNormalTexture VertexType;
+	auto& parts = pResult->Parts;
+	vector<size_t> facetOffsets(parts.size() + 1);
+	for (size_t i = 0; i < parts.size(); i++)
+		facetOffsets[i + 1] = facetOffsets[i] + parts[i]->pMesh->IndexCount / 3;
+	vector<VertexCacheStatistics> before(parts.size()), after(parts.size());
+
+	Causality::BranchScheduler::Shared().Dispatch(parts.size(), [&](size_t p)
+	{
+		const auto& mesh = *parts[p]->pMesh;
+		auto pIndex = reinterpret_cast<uint32_t*>(pResult->Facets.data() + facetOffsets[p]);
+		auto pVertex = pResult->Vertices.data() + mesh.VertexOffset;
+		before[p] = MeshOptimizer::AnalyzeVertexCache(pIndex, mesh.IndexCount, mesh.VertexCount);
+
+		vector<uint32_t> clusters, remap;
+		bool overdraw = (loadFlags & ModelLoad_OptimizeOverdraw) != 0;
+		MeshOptimizer::OptimizeVertexCache(pIndex, mesh.IndexCount, mesh.VertexCount, MeshOptimizer::DefaultCacheSize, overdraw ? &clusters : nullptr);
+		if (overdraw)
+			MeshOptimizer::OptimizeOverdraw(pIndex, mesh.IndexCount, &pVertex->position, sizeof(VertexType), clusters);
+		MeshOptimizer::OptimizeVertexFetch(pIndex, mesh.IndexCount, mesh.VertexCount, remap);
+		MeshOptimizer::RemapVertices(pVertex, mesh.VertexCount, sizeof(VertexType), remap);
+		if (!pResult->Tangents.empty())
+			MeshOptimizer::RemapVertices(&pResult->Tangents[mesh.VertexOffset], mesh.VertexCount, sizeof(XMFLOAT4), remap);
+
+		after[p] = MeshOptimizer::AnalyzeVertexCache(pIndex, mesh.IndexCount, mesh.VertexCount);
+	});
+
+	uint32_t triangles = 0, vertices = 0, missesBefore = 0, missesAfter = 0;
+	for (size_t p = 0; p < parts.size(); p++)
+	{
+		triangles += before[p].TriangleCount;
+		vertices += before[p].VertexCount;
+		missesBefore += before[p].Misses;
+		missesAfter += after[p].Misses;
+	}
+	if (triangles && vertices)
+	{
+		LOG_DEBUG(Causality::Log_Loading, "%s : ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", pResult->Name.c_str(),
+			float(missesBefore) / triangles, float(missesAfter) / triangles, float(missesBefore) / vertices, float(missesAfter) / vertices);
+	}
+}
+
+// Tangent frames of every part from its vertices and facets, parts are independent so they run in parallel
+static void GenerateTangents(GeometryModel * pResult)
+{
+	typedef VertexPositionNormalTexture VertexType;
+	auto& parts = pResult->Parts;
+	vector<size_t> facetOffsets(parts.size() + 1);
+	for (size_t i = 0; i < parts.size(); i++)
+		facetOffsets[i + 1] = facetOffsets[i] + parts[i]->pMesh->IndexCount / 3;
+	pResult->Tangents.resize(pResult->Vertices.size());
+
+	Causality::BranchScheduler::Shared().Dispatch(parts.size(), [&](size_t p)
+	{
+		const auto& mesh = *parts[p]->pMesh;
+		const auto pVertex = &pResult->Vertices[mesh.VertexOffset];
+		TangentFrame::ComputeTangents(&pVertex->position, sizeof(VertexType), &pVertex->normal, sizeof(VertexType), &pVertex->textureCoordinate, sizeof(VertexType),
+			mesh.VertexCount, reinterpret_cast<const uint32_t*>(pResult->Facets.data() + facetOffsets[p]), mesh.IndexCount, &pResult->Tangents[mesh.VertexOffset]);
+	});
+}
+
+// Simplify every part into its chain of coarser levels, parts are independent so they run in parallel
+// Each level is simplified from the one before, its error is the sum of the errors along the chain
+static void GenerateLods(GeometryModel * pResult, unsigned loadFlags)
+{
+	typedef VertexPositionNormalTexture VertexType;
+	auto& parts = pResult->Parts;
+	vector<size_t> facetOffsets(parts.size() + 1);
+	for (size_t i = 0; i < parts.size(); i++)
+		facetOffsets[i + 1] = facetOffsets[i] + parts[i]->pMesh->IndexCount / 3;
+	vector<vector<uint32_t>> partIndices(parts.size());
+
+	Causality::BranchScheduler::Shared().Dispatch(parts.size(), [&](size_t p)
+	{
+		auto& mesh = *parts[p]->pMesh;
+		auto pPosition = &pResult->Vertices[mesh.VertexOffset].position;
+		auto radius = Vector3(parts[p]->BoundBox.Extents).Length();
+		auto& indices = partIndices[p];
+		mesh.Lods.clear();
+
+		vector<uint32_t> previous(reinterpret_cast<const uint32_t*>(pResult->Facets.data() + facetOffsets[p]), reinterpret_cast<const uint32_t*>(pResult->Facets.data() + facetOffsets[p + 1]));
+		vector<uint32_t> level;
+		float error = 0;
+		while (mesh.Lods.size() < MaxLodCount && previous.size() / 3 > MinLodTriangles)
+		{
+			auto target = static_cast<size_t>(previous.size() / 3 * LodReduction) * 3;
+			error += MeshSimplifier::Simplify(level, previous.data(), previous.size(), pPosition, mesh.VertexCount, sizeof(VertexType), target, radius * LodMaxRelativeError);
+			if (level.empty() || level.size() > previous.size() * (1 - LodMinSaving))
+				break;
+			if (loadFlags & ModelLoad_OptimizeVertexCache)
+				MeshOptimizer::OptimizeVertexCache(level.data(), level.size(), mesh.VertexCount);
+
+			MeshLod lod;
+			lod.StartIndex = 0;
+			lod.IndexCount = static_cast<uint32_t>(level.size());
+			lod.Error = error;
+			mesh.Lods.push_back(lod);
+			indices.insert(indices.end(), level.begin(), level.end());
+			previous.swap(level);
+		}
+	});
+
+	pResult->LodIndices.clear();
+	for (const auto& indices : partIndices)
+		pResult->LodIndices.insert(pResult->LodIndices.end(), indices.begin(), indices.end());
+}
+
+// Index format of each part, and its start in that format's buffer as GatherIndices lays them out
+static void AssignIndexRanges(GeometryModel * pResult)
+{
+	uint32_t shortIndexCount = 0, longIndexCount = 0;
+	for (const auto& part : pResult->Parts)
+	{
+		auto& mesh = *part->pMesh;
+		if (mesh.VertexCount <= GeometryModel::MaxShortIndexVertexCount)
+		{
+			mesh.IndexFormat = DXGI_FORMAT_R16_UINT;
+			mesh.StartIndex = shortIndexCount;
+			shortIndexCount += mesh.IndexCount;
+			for (auto& lod : mesh.Lods)
+			{
+				lod.StartIndex = shortIndexCount;
+				shortIndexCount += lod.IndexCount;
+			}
+		}
+		else
+		{
+			mesh.IndexFormat = DXGI_FORMAT_R32_UINT;
+			mesh.StartIndex = longIndexCount;
+			longIndexCount += mesh.IndexCount;
+			for (auto& lod : mesh.Lods)
+			{
+				lod.StartIndex = longIndexCount;
+				longIndexCount += lod.IndexCount;
+			}
+		}
+	}
+}
+
+void DirectX::Scene::GeometryModel::GatherIndices(std::vector<uint16_t>& shortIndices, std::vector<uint32_t>& longIndices) const
+{
+	shortIndices.clear();
+	longIndices.clear();
+	auto pIndex = reinterpret_cast<const uint32_t*>(Facets.data());
+	auto pLodIndex = LodIndices.data();
+	for (const auto& part : Parts)
+	{
+		const auto& mesh = *part->pMesh;
+		auto lodIndexCount = 0U;
+		for (const auto& lod : mesh.Lods)
+			lodIndexCount += lod.IndexCount;
+		if (mesh.IndexFormat == DXGI_FORMAT_R32_UINT)
+		{
+			longIndices.insert(longIndices.end(), pIndex, pIndex + mesh.IndexCount);
+			longIndices.insert(longIndices.end(), pLodIndex, pLodIndex + lodIndexCount);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < mesh.IndexCount; i++)
+				shortIndices.push_back(static_cast<uint16_t>(pIndex[i]));
+			for (uint32_t i = 0; i < lodIndexCount; i++)
+				shortIndices.push_back(static_cast<uint16_t>(pLodIndex[i]));
+		}
+		pIndex += mesh.IndexCount;
+		pLodIndex += lodIndexCount;
+	}
+}
+
+// Everything the parser and the bounds computation would produce is in the cache
+static void CreateFromMeshCache(GeometryModel * pResult, ID3D11Device * pDevice, const MeshCache& cache, const path& lookup)
+{
+	typedef VertexPositionNormalTexture VertexType;
+	const auto& header = cache.Header();
+	auto& Vertices = pResult->Vertices;
+	auto& Facets = pResult->Facets;
+
+	Vertices.assign(cache.Vertices(), cache.Vertices() + header.VertexCount);
+	pResult->Tangents.assign(cache.Tangents(), cache.Tangents() + header.TangentCount);
+	// CPU facets are the parts' indices widened, in part order
+	size_t indexCount = 0;
+	for (uint32_t i = 0; i < header.PartCount; i++)
+		indexCount += cache.Parts()[i].IndexCount;
+	Facets.resize(indexCount / 3);
+	auto pIndex = reinterpret_cast<uint32_t*>(Facets.data());
+
+	vector<int> partMaterials(header.PartCount);
+	for (uint32_t i = 0; i < header.PartCount; i++)
+	{
+		const auto& record = cache.Parts()[i];
+		auto part = make_shared<ModelPart>();
+		part->Name = cache.String(record.Name);
+		part->BoundBox = record.BoundBox;
+		part->BoundOrientedBox = record.BoundOrientedBox;
+		auto& mesh = part->pMesh = std::make_shared<Mesh>();
+		mesh->VertexCount = record.VertexCount;
+		mesh->IndexCount = record.IndexCount;
+		mesh->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mesh->VertexStride = sizeof(VertexType);
+		mesh->VertexOffset = record.VertexOffset;
+		mesh->StartIndex = record.StartIndex;
+		if (record.IndexSize == sizeof(uint32_t))
+		{
+			mesh->IndexFormat = DXGI_FORMAT_R32_UINT;
+			std::copy_n(cache.LongIndices() + record.StartIndex, record.IndexCount, pIndex);
+		}
+		else
+		{
+			mesh->IndexFormat = DXGI_FORMAT_R16_UINT;
+			std::copy_n(cache.ShortIndices() + record.StartIndex, record.IndexCount, pIndex);
+		}
+		pIndex += record.IndexCount;
+		for (uint32_t l = 0; l < record.LodCount; l++)
+		{
+			const auto& lodRecord = cache.Lods()[record.FirstLod + l];
+			MeshLod lod = { lodRecord.StartIndex, lodRecord.IndexCount, lodRecord.Error };
+			mesh->Lods.push_back(lod);
+			if (record.IndexSize == sizeof(uint32_t))
+				pResult->LodIndices.insert(pResult->LodIndices.end(), cache.LongIndices() + lod.StartIndex, cache.LongIndices() + lod.StartIndex + lod.IndexCount);
+			else
+				pResult->LodIndices.insert(pResult->LodIndices.end(), cache.ShortIndices() + lod.StartIndex, cache.ShortIndices() + lod.StartIndex + lod.IndexCount);
+		}
+		partMaterials[i] = record.Material;
+		pResult->Parts.push_back(part);
+	}
+
+	pResult->BoundBox = header.BoundBox;
+	pResult->BoundOrientedBox = header.BoundOrientedBox;
+	pResult->BoundSphere = header.BoundSphere;
+	if (!Vertices.empty())
+	{
+		pResult->Positions = stride_range<Vector3>((Vector3*) &Vertices[0].position, sizeof(VertexType), Vertices.size());
+		pResult->Normals = stride_range<Vector3>((Vector3*) &Vertices[0].normal, sizeof(VertexType), Vertices.size());
+		pResult->TexCoords = stride_range<Vector2>((Vector2*) &Vertices[0].textureCoordinate, sizeof(VertexType), Vertices.size());
+	}
+
+	if (!pDevice)
+		return;
+
+	vector<MaterialDescription> materials(header.MaterialCount);
+	for (uint32_t i = 0; i < header.MaterialCount; i++)
+		materials[i] = cache.DescribeMaterial(i);
+	// Straight from the mapped pages, the CPU copies above are not read again
+	CreatePartResources(pResult, pDevice, cache.Vertices(), header.VertexCount, cache.ShortIndices(), header.ShortIndexCount, cache.LongIndices(), header.LongIndexCount, partMaterials, materials, lookup);
+}
+
+bool DirectX::Scene::GeometryModel::CreateFromObjFile(DirectX::Scene::GeometryModel *pResult, ID3D11Device * pDevice, const std::wstring & fileName, const std::wstring & textureDir, unsigned loadFlags, const std::wstring & cacheFileName)
 {
 	typedef VertexPositionNormalTexture VertexType;
 	using namespace tinyobj;
@@ -55,12 +532,37 @@ bool DirectX::Scene::GeometryModel::CreateFromObjFile(DirectX::Scene::GeometryMo
 	path file(fileName);
 	pResult->Name = file.filename().replace_extension().string();
 	auto dir = file.parent_path();
-	auto result = tinyobj::LoadObj(shapes, materis, file.string().c_str(), (dir.string() + "\\").c_str());
+	boost::filesystem::path lookup(textureDir);
 
-	std::vector<std::shared_ptr<Mesh>> Meshs;
-	std::vector<std::shared_ptr<PhongMaterial>> Materials;
+	// The source is mapped once, for its hash and for the parser
+	MappedFile source(fileName);
+	if (!source.IsOpen())
+		return false;
 
-	boost::filesystem::path lookup(textureDir);
+	// A cache written by an earlier load of the same content skips parsing and bounds computation
+	// The material libraries are part of the content, their hashes are folded into the OBJ's, a missing one counts as empty
+	auto cacheFile = cacheFileName.empty() ? MeshCache::PathFor(fileName) : cacheFileName;
+	vector<uint64_t> hashes(1, MeshCache::Hash(source.Data(), source.Size()));
+	for (const auto& library : ObjParser::MaterialLibraries(source.Data(), source.Size()))
+	{
+		MappedFile mtl((dir / library).wstring());
+		hashes.push_back(mtl.IsOpen() ? MeshCache::Hash(mtl.Data(), mtl.Size()) : 0);
+	}
+	uint64_t sourceHash = hashes.size() == 1 ? hashes[0] : MeshCache::Hash(reinterpret_cast<const char*>(hashes.data()), hashes.size() * sizeof(uint64_t));
+	uint64_t sourceSize = source.Size();
+	{
+		MeshCache cache;
+		if (cache.Open(cacheFile, sourceHash, sourceSize, loadFlags))
+		{
+			CreateFromMeshCache(pResult, pDevice, cache, lookup);
+			return true;
+		}
+	}
+
+	auto error = ObjParser::Parse(shapes, materis, source.Data(), source.Size(), dir.wstring());
+	source.Close();
+	if (!error.empty() || shapes.empty())
+		return false;
 
 	auto& Vertices = pResult->Vertices;
 	auto& Facets = pResult->Facets;
@@ -69,172 +571,112 @@ bool DirectX::Scene::GeometryModel::CreateFromObjFile(DirectX::Scene::GeometryMo
 	auto& Normals = pResult->Normals;
 	auto& TexCoords = pResult->TexCoords;
 
-	int vOffset = 0, iOffset = 0;
+	// Shapes own disjoint ranges of the vertex and facet arrays, so they are processed in parallel
+	std::vector<size_t> vOffsets(shapes.size() + 1), iOffsets(shapes.size() + 1);
+	for (size_t i = 0; i < shapes.size(); i++)
+	{
+		vOffsets[i + 1] = vOffsets[i] + shapes[i].mesh.positions.size() / 3;
+		iOffsets[i + 1] = iOffsets[i] + shapes[i].mesh.indices.size();
+	}
+	Vertices.resize(vOffsets.back());
+	Facets.resize(iOffsets.back() / 3);
+	for (size_t i = 0; i < shapes.size(); i++)
+	{
+		Parts.emplace_back(new ModelPart);
+		Parts.back()->Name = shapes[i].name;
+		Parts.back()->pMesh = std::make_shared<Mesh>();
+	}
 
-	for (auto& shape : shapes)
+	Causality::BranchScheduler::Shared().Dispatch(shapes.size(), [&](size_t s)
 	{
+		auto& shape = shapes[s];
 		auto N = shape.mesh.positions.size() / 3;
 
 		for (size_t i = 0; i < shape.mesh.indices.size() / 3; i++)
 		{
 			const auto& idcs = shape.mesh.indices;
 			//FacetPrimitives::Triangle<uint16_t> tri{ idcs[i * 3 + 0],idcs[i * 3 + 1],idcs[i * 3 + 2] };
-			FacetPrimitives::Triangle<uint16_t> tri{ idcs[i * 3 + 2],idcs[i * 3 + 1],idcs[i * 3 + 0] };
-			Facets.push_back(tri);
+			FacetPrimitives::Triangle<uint32_t> tri{ idcs[i * 3 + 2],idcs[i * 3 + 1],idcs[i * 3 + 0] };
+			Facets[iOffsets[s] / 3 + i] = tri;
 		}
 
 		stride_range<Vector3> Pos(reinterpret_cast<Vector3*>(&shape.mesh.positions[0]), sizeof(float) * 3, N);
-		if (shape.mesh.normals.size() == 0)
-		{
-			// Generate smooth vertex normal, should be improved to corperate co-tanget weight
-			shape.mesh.normals.resize(N * 3);
-			XMVECTOR n, v0, v1, v2;
-			stride_range<Vector3> normals(reinterpret_cast<Vector3*>(&shape.mesh.normals[0]), sizeof(float) * 3, N);
-			stride_range<FacetPrimitives::Triangle<unsigned int>> facets(reinterpret_cast<FacetPrimitives::Triangle<unsigned int>*>(&shape.mesh.indices[0]), sizeof(unsigned int) * 3, shape.mesh.indices.size() / 3);
-			std::fill_n(shape.mesh.normals.begin(), N * 3, .0f);
-			for (const auto& face : facets)
-			{
-				v0 = Pos[face.V0];
-				v1 = Pos[face.V1];
-				v2 = Pos[face.V2];
-				v1 -= v0;
-				v2 -= v0;
-				n = XMVector3Cross(v1, v2);
-				n = XMVector3Normalize(n);
-				n = XMVectorNegate(n);
-				//if (XMVectorGetY(n) < 0.0f)
-				//	n = XMVectorNegate(n);
-				//facetNormals.emplace_back(n);
-				normals[face.V0] += n;
-				normals[face.V1] += n;
-				normals[face.V2] += n;
-			}
-
-			for (auto& nor : normals)
-			{
-				nor.Normalize();
-			}
-		}
+		// Without normals in the file, they are generated from the part's facets once its vertices are in place
+		bool generateNormals = shape.mesh.normals.empty();
+		if (generateNormals)
+			shape.mesh.normals.assign(N * 3, 0.0f);
 		stride_range<Vector3> Nor(reinterpret_cast<Vector3*>(&shape.mesh.normals[0]), sizeof(float) * 3, N);
+		auto pVertex = &Vertices[vOffsets[s]];
 		if (shape.mesh.texcoords.size() != 0)
 		{
 			stride_range<Vector2> Tex(reinterpret_cast<Vector2*>(&shape.mesh.texcoords[0]), sizeof(float) * 2, N);
 			for (size_t i = 0; i < N; i++)
 			{
-				Vertices.emplace_back(Pos[i], Nor[i], Tex[i]);
+				pVertex[i] = VertexType(Pos[i], Nor[i], Tex[i]);
 			}
 		}
 		else
 		{
 			for (size_t i = 0; i < N; i++)
 			{
-				Vertices.emplace_back(Pos[i], Nor[i], Vector2(0, 0));
+				pVertex[i] = VertexType(Pos[i], Nor[i], Vector2(0, 0));
 			}
 		}
-
-
-		auto mesh = std::make_shared<Mesh>();
-		Parts.emplace_back(new ModelPart);
-		Parts.back()->Name = shape.name;
-		Parts.back()->pMesh = mesh;
-
-		auto& part = Parts.back();
-		auto& box = Parts.back()->BoundBox;
-		BoundingBox::CreateFromPoints(box, N, (XMFLOAT3*) shape.mesh.positions.data(), sizeof(float) * 3);
-		float scale = std::max(box.Extents.x, std::max(box.Extents.y, box.Extents.z));
-		for (auto& p : shape.mesh.positions)
+		if (generateNormals)
 		{
-			p /= scale;
+			// Facets are wound the other way round than the file's, so their cross products face outward
+			TangentFrame::ComputeNormals(&pVertex->position, sizeof(VertexType), N, reinterpret_cast<const uint32_t*>(Facets.data() + iOffsets[s] / 3), shape.mesh.indices.size(), &pVertex->normal, sizeof(VertexType));
 		}
 
-		//BoundingOrientedBox::CreateFromPoints(part.BoundOrientedBox, N, (XMFLOAT3*) shape.mesh.positions.data(), sizeof(float) * 3);
-		CreateBoundingOrientedBoxFromPoints(part->BoundOrientedBox, N, (XMFLOAT3*) shape.mesh.positions.data(), sizeof(float) * 3);
-		XMStoreFloat3(&part->BoundOrientedBox.Center, XMLoadFloat3(&part->BoundOrientedBox.Center) * scale);
-		XMStoreFloat3(&part->BoundOrientedBox.Extents, XMLoadFloat3(&part->BoundOrientedBox.Extents) * scale);
-		for (auto& p : shape.mesh.positions)
-		{
-			p *= scale;
-		}
+		auto& part = Parts[s];
+		auto& mesh = part->pMesh;
+		CreatePartBounds(*part, (XMFLOAT3*) shape.mesh.positions.data(), N, sizeof(float) * 3);
 		mesh->VertexCount = N;
 		mesh->IndexCount = shape.mesh.indices.size();
 		mesh->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		mesh->IndexFormat = ExtractDXGIFormat<uint16_t>::value;
 		mesh->VertexStride = sizeof(VertexPositionNormalTexture);
-		mesh->VertexOffset = vOffset;
-		mesh->StartIndex = iOffset;
-		vOffset += mesh->VertexCount;
-		iOffset += mesh->IndexCount;
-	}
+		mesh->VertexOffset = vOffsets[s];
+	});
+
+	vector<MaterialDescription> materials(materis.size());
+	std::transform(materis.begin(), materis.end(), materials.begin(), DescribeMaterial);
+	vector<int> partMaterials(shapes.size());
+	for (size_t i = 0; i < shapes.size(); i++)
+		partMaterials[i] = shapes[i].mesh.material_ids.empty() ? -1 : shapes[i].mesh.material_ids[0];
+
+	// Before splitting, so meshlet borders get the same frames as the whole part
+	if (loadFlags & ModelLoad_GenerateTangents)
+		GenerateTangents(pResult);
+	if (loadFlags & ModelLoad_SplitLargeParts)
+		SplitLargeParts(pResult, partMaterials, MaxShortIndexVertexCount);
+	if (loadFlags & ModelLoad_OptimizeVertexCache)
+		OptimizeParts(pResult, loadFlags);
+	if (loadFlags & ModelLoad_GenerateLods)
+		GenerateLods(pResult, loadFlags);
+	AssignIndexRanges(pResult);
 
 	Positions = stride_range<Vector3>((Vector3*) &Vertices[0].position, sizeof(VertexType), Vertices.size());
 	Normals = stride_range<Vector3>((Vector3*) &Vertices[0].normal, sizeof(VertexType), Vertices.size());
 	TexCoords = stride_range<Vector2>((Vector2*) &Vertices[0].textureCoordinate, sizeof(VertexType), Vertices.size());
 
-	BoundingBox::CreateFromPoints(pResult->BoundBox, Positions.size(), &Positions[0], sizeof(VertexType));
+	PointSetBounds bounds;
+	BoundsFitter::Fit(bounds, &Vertices[0].position, Vertices.size(), sizeof(VertexType));
+	pResult->BoundBox = bounds.Box;
+	pResult->BoundOrientedBox = bounds.OrientedBox;
+	pResult->BoundSphere = bounds.Sphere;
 
-	float scale = std::max(pResult->BoundBox.Extents.x, std::max(pResult->BoundBox.Extents.y, pResult->BoundBox.Extents.z));
-	XMVECTOR s = XMVectorReplicate(scale);
-	for (auto& p : Positions)
-	{
-		p = (XMVECTOR) p / s;
-	}
-	CreateBoundingOrientedBoxFromPoints(pResult->BoundOrientedBox, Positions.size(), &Positions[0], sizeof(VertexType));
-	//BoundingOrientedBox::CreateFromPoints(BoundOrientedBox, Positions.size(), &Positions[0], sizeof(VertexType));
-	BoundingSphere::CreateFromPoints(pResult->BoundSphere, Positions.size(), &Positions[0], sizeof(VertexType));
-	for (auto& p : Positions)
-	{
-		p = (XMVECTOR) p * s;
-	}
-	XMStoreFloat3(&pResult->BoundOrientedBox.Center, XMLoadFloat3(&pResult->BoundOrientedBox.Center) * s);
-	XMStoreFloat3(&pResult->BoundOrientedBox.Extents, XMLoadFloat3(&pResult->BoundOrientedBox.Extents) * s);
-	XMStoreFloat3(&pResult->BoundSphere.Center, XMLoadFloat3(&pResult->BoundSphere.Center) * s);
-	pResult->BoundSphere.Radius *= scale;
+	// A failed write only costs the next load its shortcut
+	MeshCache::Write(cacheFile, sourceHash, sourceSize, loadFlags, *pResult, partMaterials, materials);
 
-	// Device Dependent Resources Creation
-	auto pVertexBuffer = DirectX::CreateVertexBuffer(pDevice, Vertices.size(), &Vertices[0]);
-	auto pIndexBuffer = DirectX::CreateIndexBuffer(pDevice, Facets.size() * 3, &Facets[0].V0);
+	// Headless load (tools, benchmarks) keeps the CPU side only
+	if (!pDevice)
+		return true;
 
-	for (auto& mat : materis)
-	{
-		HRESULT hr = S_OK;
-		ComPtr<ID3D11Resource> pResource;
-		auto pMaterial = make_shared<PhongMaterial>();
-		pMaterial->Name = mat.name;
-		pMaterial->Alpha = mat.dissolve;
-		pMaterial->DiffuseColor = Color(mat.diffuse);
-		pMaterial->AmbientColor = Color(mat.ambient);
-		pMaterial->SpecularColor = Color(mat.specular);
-		if (!mat.diffuse_texname.empty())
-		{
-			auto fileName = lookup / mat.diffuse_texname;
-			hr = CreateWICTextureFromFile(pDevice, fileName.wstring().data(), &pResource, &pMaterial->DiffuseMap);
-		}
-		if (!mat.specular_texname.empty())
-		{
-			auto fileName = lookup / mat.specular_texname;
-			hr = CreateWICTextureFromFile(pDevice, fileName.wstring().data(), &pResource, &pMaterial->SpecularMap);
-
-		}
-		if (!mat.normal_texname.empty())
-		{
-			auto fileName = lookup / mat.normal_texname;
-			hr = CreateWICTextureFromFile(pDevice, fileName.wstring().data(), &pResource, &pMaterial->NormalMap);
-		}
-		ThrowIfFailed(hr);
-		Materials.push_back(pMaterial);
-	}
-
-	for (size_t i = 0; i < shapes.size(); i++)
-	{
-		const auto& shape = shapes[i];
-		auto &part = Parts[i];
-		if (shape.mesh.material_ids[0] >= 0)
-			part->pMaterial = Materials[shape.mesh.material_ids[0]];
-		else
-			part->pMaterial = nullptr;
-		part->pMesh->pVertexBuffer = pVertexBuffer;
-		part->pMesh->pIndexBuffer = pIndexBuffer;
-	}
+	// Device Dependent Resources Creation
+	vector<uint16_t> shortIndices;
+	vector<uint32_t> longIndices;
+	pResult->GatherIndices(shortIndices, longIndices);
+	CreatePartResources(pResult, pDevice, &Vertices[0], Vertices.size(), shortIndices.data(), shortIndices.size(), longIndices.data(), longIndices.size(), partMaterials, materials, lookup);
 	return true;
 }
 
@@ -242,6 +684,8 @@ BasicModel * DirectX::Scene::GeometryModel::ReleaseCpuResource()
 {
 	Vertices.clear();
 	Facets.clear();
+	LodIndices.clear();
+	Tangents.clear();
 	return this;
 }
 
@@ -262,15 +706,17 @@ void DirectX::Scene::ModelCollection::Render(ID3D11DeviceContext * pContext, IEf
 	for (size_t i = 0; (int)i < count; i++)
 	{
 		auto& model = at(i);
+		model->LodTolerance = LodTolerance;
 		model->Render(pContext, pEffect);
 	}
 }
 
-void DirectX::Scene::ModelPart::Render(ID3D11DeviceContext * pContext, IEffect * pEffect)
+void DirectX::Scene::ModelPart::Render(ID3D11DeviceContext * pContext, IEffect * pEffect, float lodTolerance)
 {
+	auto lod = pMesh->SelectLod(lodTolerance);
 	if (pEffect == nullptr)
 	{
-		pMesh->Draw(pContext);
+		pMesh->DrawLod(pContext, lod);
 	}
 	else
 	{
@@ -292,7 +738,7 @@ void DirectX::Scene::ModelPart::Render(ID3D11DeviceContext * pContext, IEffect *
 			pMEffect->SetSpecularColor(pMaterial->GetSpecularColor());
 		}
 		pEffect->Apply(pContext);
-		pMesh->Draw(pContext);
+		pMesh->DrawLod(pContext, lod);
 	}
 }
 
@@ -311,7 +757,7 @@ void DirectX::Scene::BasicModel::Render(ID3D11DeviceContext * pContext, IEffect*
 		{
 			pEffectB->SetAlpha(Opticity);
 		}
-		part->Render(pContext,pEffect);
+		part->Render(pContext, pEffect, LodTolerance);
 	}
 }
 
@@ -56,6 +56,15 @@ namespace DirectX
 			virtual void Draw(ID3D11DeviceContext* pContext) const = 0;
 		};
 
+		// A coarser level of a Mesh, drawn from the same vertices with its own range of the index buffer
+		struct MeshLod
+		{
+			uint32_t	StartIndex;
+			uint32_t	IndexCount;
+			// Largest distance to the full detail surface, in model space
+			float		Error;
+		};
+
 		// A Container of Vertex and Indices holding geometry information with Identical effect to render
 		// Should be use with std::shared_ptr
 		struct Mesh : public IMesh
@@ -106,9 +115,15 @@ namespace DirectX
 			Microsoft::WRL::ComPtr<ID3D11Buffer>                    pIndexBuffer;
 			Microsoft::WRL::ComPtr<ID3D11Buffer>                    pVertexBuffer;
 			bool                                                    IsAlpha;
+			// Coarser levels, by increasing error, level 0 is the mesh itself
+			std::vector<MeshLod>									Lods;
 
 			// Setup the Vertex/Index Buffer and call the draw command
 			void Draw(ID3D11DeviceContext *pContext) const;
+			// Same as Draw, with the index range of level lod
+			void DrawLod(ID3D11DeviceContext *pContext, size_t lod) const;
+			// Coarsest level whose error is within tolerance
+			size_t SelectLod(float tolerance) const;
 		};
 
 		// MeshPart with static vertex typeing
@@ -144,7 +159,20 @@ namespace DirectX
 			std::shared_ptr<PhongMaterial>	pMaterial;
 			DirectX::BoundingBox			BoundBox;
 			DirectX::BoundingOrientedBox	BoundOrientedBox;
-			void Render(ID3D11DeviceContext *pContext, IEffect* pEffect);
+			// lodTolerance is the model space error accepted, 0 draws full detail
+			void Render(ID3D11DeviceContext *pContext, IEffect* pEffect, float lodTolerance = 0);
+		};
+
+		// How coarse a level of detail a model may be drawn with, from the size its bounding sphere projects to
+		struct LodPolicy
+		{
+			// Accepted error on screen, as a fraction of the view height
+			float	ScreenError = 0.001f;
+			// Ghost states accept more error, divided by their opacity down to this one
+			float	MinOpacity = 0.1f;
+
+			// Model space error accepted for a model of this bounding radius, whose bounding sphere covers screenSize view heights
+			float Tolerance(float screenSize, float radius, float opacity) const;
 		};
 
 		class LocalMatrixHolder : virtual public ILocalMatrix
@@ -196,6 +224,8 @@ namespace DirectX
 			BoundingBox			BoundBox;
 			Matrix4x4			LocalMatrix;
 			float				Opticity;
+			// Model space error the renderer accepts for this frame, see LodPolicy
+			float				LodTolerance = 0;
 		};
 
 		// A basic model is a collection of ModelPart shares same Local Matrix
@@ -221,15 +251,46 @@ namespace DirectX
 			virtual void Render(ID3D11DeviceContext *pContext, IEffect* pEffect) override;
 		};
 
+		// Options of GeometryModel::CreateFromObjFile
+		enum ModelLoadFlags
+		{
+			ModelLoad_Default = 0,
+			// Cut parts too big for 16 bit indices into meshlets that fit, each one a part with its own bounds
+			// Without it such parts are drawn with 32 bit indices
+			ModelLoad_SplitLargeParts = 1,
+			// Reorder every part's triangles for the post-transform vertex cache, and its vertices to first use order
+			ModelLoad_OptimizeVertexCache = 2,
+			// With ModelLoad_OptimizeVertexCache, draw the triangle clusters it finds outside-in to cut overdraw
+			ModelLoad_OptimizeOverdraw = 4,
+			// Simplify every part into a chain of coarser levels, see Mesh::Lods
+			ModelLoad_GenerateLods = 8,
+			// Fill GeometryModel::Tangents for normal mapping, texture coordinates are expected to be split at seams
+			ModelLoad_GenerateTangents = 16,
+		};
+
 		// This Model also keeps the geomreics data in CPU
 		class GeometryModel : public BasicModel
 		{
 		public:
-			static bool CreateFromObjFile(GeometryModel *pResult, ID3D11Device *pDevice, const std::wstring &file, const std::wstring& textureDir);
+			// Parts up to this many vertices are drawn with 16 bit indices
+			static const uint32_t MaxShortIndexVertexCount = 0x10000;
+
+			// The mesh cache is read and written at cacheFile, next to the OBJ (MeshCache::PathFor) if it is empty
+			static bool CreateFromObjFile(GeometryModel *pResult, ID3D11Device *pDevice, const std::wstring &file, const std::wstring& textureDir, unsigned loadFlags = ModelLoad_Default, const std::wstring& cacheFile = std::wstring());
 			BasicModel* ReleaseCpuResource();
+
+			// Indices of all parts in their draw format, in part order, each part followed by its coarser levels
+			// 32 bit parts go in longIndices, the others in shortIndices
+			// A part's Mesh::StartIndex and its levels' MeshLod::StartIndex are starts in the one of the two that matches its IndexFormat
+			void GatherIndices(std::vector<uint16_t>& shortIndices, std::vector<uint32_t>& longIndices) const;
 		public:
 			std::vector<VertexPositionNormalTexture>			Vertices;
-			std::vector<FacetPrimitives::Triangle<uint16_t>>	Facets;
+			// All parts' facets in part order, indices are relative to the part's Mesh::VertexOffset
+			std::vector<FacetPrimitives::Triangle<uint32_t>>	Facets;
+			// All parts' coarser levels, in part then level order, relative to the part's Mesh::VertexOffset
+			std::vector<uint32_t>								LodIndices;
+			// Tangent frame of every vertex, xyz along +u, w the bitangent's sign : B = w * cross(N, T), empty unless generated
+			std::vector<XMFLOAT4>								Tangents;
 			stride_range<Vector3>	Positions;
 			stride_range<Vector3>	Normals;
 			stride_range<Vector2>	TexCoords;
@@ -0,0 +1,646 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "Logger.h"
+#include "..\BranchScheduler.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <map>
+#include <boost\filesystem.hpp>
+
+using namespace DirectX;
+using namespace DirectX::Scene;
+using namespace tinyobj;
+using namespace std;
+
+// Smaller chunks are not worth a task
+static const size_t MinChunkSize = 1 << 20;
+
+namespace
+{
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+	inline bool IsDigit(char c) { return static_cast<unsigned>(c - '0') < 10; }
+
+	inline void SkipSpaces(const char*& p, const char* end)
+	{
+		while (p < end && IsSpace(*p))
+			p++;
+	}
+
+	// Skips whatever is left of the current token
+	inline void SkipToken(const char*& p, const char* end)
+	{
+		while (p < end && !IsSpace(*p))
+			p++;
+	}
+
+	// Keyword followed by a blank, p is moved past it
+	inline bool Keyword(const char*& p, const char* end, const char* keyword, size_t length)
+	{
+		if (static_cast<size_t>(end - p) <= length || memcmp(p, keyword, length) != 0 || !IsSpace(p[length]))
+			return false;
+		p += length;
+		return true;
+	}
+
+	inline int ParseInt(const char*& p, const char* end)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+		int value = 0;
+		for (; p < end && IsDigit(*p); p++)
+			value = value * 10 + (*p - '0');
+		return negative ? -value : value;
+	}
+
+	inline float ParseNumber(const char*& p, const char* end)
+	{
+		auto value = ObjParser::ParseFloat(p, end);
+		SkipToken(p, end);
+		return value;
+	}
+
+	string ParseName(const char*& p, const char* end)
+	{
+		SkipSpaces(p, end);
+		auto begin = p;
+		SkipToken(p, end);
+		return string(begin, p);
+	}
+
+	// Rest of the line, texture names may contain blanks
+	string ParseRest(const char* p, const char* end)
+	{
+		SkipSpaces(p, end);
+		while (end > p && IsSpace(end[-1]))
+			end--;
+		return string(p, end);
+	}
+
+	// Calls fn(line, lineEnd) for every line that is not blank or a comment, leading blanks and line terminators are stripped
+	template <class _TFunc>
+	void ForEachLine(const char* p, const char* end, _TFunc fn)
+	{
+		while (p < end)
+		{
+			auto eol = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (!eol)
+				eol = end;
+			auto lineEnd = eol;
+			if (lineEnd > p && lineEnd[-1] == '\r')
+				lineEnd--;
+			SkipSpaces(p, lineEnd);
+			if (p < lineEnd && *p != '#')
+				fn(p, lineEnd);
+			p = eol < end ? eol + 1 : end;
+		}
+	}
+
+	// Zero based after Resolve, -1 when the corner has no texcoord / normal
+	struct Corner
+	{
+		int			V, T, N;
+		// Bits of the components that are still relative to the chunk
+		uint32_t	Relative;
+	};
+
+	enum EventType
+	{
+		Event_UseMaterial,
+		Event_Group,
+		Event_Object,
+		Event_MaterialLibrary,
+	};
+
+	// A line that ends the current shape, Triangle is the chunk's triangle count when it appears
+	struct Event
+	{
+		EventType	Type;
+		size_t		Triangle;
+		string		Name;
+	};
+
+	struct Chunk
+	{
+		const char*		Begin;
+		const char*		End;
+		vector<float>	Positions;
+		vector<float>	Normals;
+		vector<float>	TexCoords;
+		// Three per triangle, faces are fanned
+		vector<Corner>	Corners;
+		vector<Event>	Events;
+
+		void Parse();
+		void Resolve(int positionBase, int normalBase, int texCoordBase);
+	};
+
+	// Negative indices count back from the last element the chunk has seen, the chunk's base is added later
+	inline int ChunkIndex(int index, size_t count, uint32_t bit, uint32_t& relative)
+	{
+		if (index > 0)
+			return index - 1;
+		if (index == 0)
+			return 0;
+		relative |= bit;
+		return static_cast<int>(count) + index;
+	}
+
+	void Chunk::Parse()
+	{
+		vector<Corner> face;
+		ForEachLine(Begin, End, [&](const char* p, const char* end)
+		{
+			if (Keyword(p, end, "v", 1))
+			{
+				for (int i = 0; i < 3; i++)
+					Positions.push_back(ParseNumber(p, end));
+			}
+			else if (Keyword(p, end, "vn", 2))
+			{
+				for (int i = 0; i < 3; i++)
+					Normals.push_back(ParseNumber(p, end));
+			}
+			else if (Keyword(p, end, "vt", 2))
+			{
+				for (int i = 0; i < 2; i++)
+					TexCoords.push_back(ParseNumber(p, end));
+			}
+			else if (Keyword(p, end, "f", 1))
+			{
+				// i, i/j, i//k, i/j/k
+				face.clear();
+				for (SkipSpaces(p, end); p < end; SkipSpaces(p, end))
+				{
+					Corner corner = { 0, -1, -1, 0 };
+					corner.V = ChunkIndex(ParseInt(p, end), Positions.size() / 3, 1, corner.Relative);
+					if (p < end && *p == '/')
+					{
+						p++;
+						if (p < end && *p != '/')
+							corner.T = ChunkIndex(ParseInt(p, end), TexCoords.size() / 2, 2, corner.Relative);
+						if (p < end && *p == '/')
+						{
+							p++;
+							corner.N = ChunkIndex(ParseInt(p, end), Normals.size() / 3, 4, corner.Relative);
+						}
+					}
+					SkipToken(p, end);
+					face.push_back(corner);
+				}
+				for (size_t k = 2; k < face.size(); k++)
+				{
+					Corners.push_back(face[0]);
+					Corners.push_back(face[k - 1]);
+					Corners.push_back(face[k]);
+				}
+			}
+			else if (Keyword(p, end, "usemtl", 6))
+			{
+				Event e = { Event_UseMaterial, Corners.size() / 3, ParseName(p, end) };
+				Events.push_back(e);
+			}
+			else if (Keyword(p, end, "g", 1))
+			{
+				// Only the first of several group names is kept
+				Event e = { Event_Group, Corners.size() / 3, ParseName(p, end) };
+				Events.push_back(e);
+			}
+			else if (Keyword(p, end, "o", 1))
+			{
+				Event e = { Event_Object, Corners.size() / 3, ParseName(p, end) };
+				Events.push_back(e);
+			}
+			else if (Keyword(p, end, "mtllib", 6))
+			{
+				Event e = { Event_MaterialLibrary, Corners.size() / 3, ParseName(p, end) };
+				Events.push_back(e);
+			}
+			// Anything else is ignored
+		});
+	}
+
+	void Chunk::Resolve(int positionBase, int normalBase, int texCoordBase)
+	{
+		for (auto& corner : Corners)
+		{
+			if (!corner.Relative)
+				continue;
+			if (corner.Relative & 1)
+				corner.V += positionBase;
+			if (corner.Relative & 2)
+				corner.T += texCoordBase;
+			if (corner.Relative & 4)
+				corner.N += normalBase;
+			corner.Relative = 0;
+		}
+	}
+
+	// Triangles [Begin, End) of the whole file, with the name and material in effect
+	struct Segment
+	{
+		size_t	Begin;
+		size_t	End;
+		string	Name;
+		int		Material;
+	};
+
+	const uint32_t EmptySlot = 0xffffffff;
+
+	// Flat open addressing table from a corner's (v, vt, vn) to its vertex in the shape
+	class VertexTable
+	{
+	public:
+		explicit VertexTable(size_t cornerCount)
+		{
+			size_t capacity = 16;
+			while (capacity < cornerCount * 2)
+				capacity *= 2;
+			m_Mask = capacity - 1;
+			m_Keys.resize(capacity);
+			m_Values.assign(capacity, EmptySlot);
+		}
+
+		// Index of the corner's vertex, nextIndex if it is new
+		uint32_t Insert(const Corner& corner, uint32_t nextIndex, bool& inserted)
+		{
+			uint32_t hash = static_cast<uint32_t>(corner.V) * 0x9E3779B1u
+				^ static_cast<uint32_t>(corner.T) * 0x85EBCA77u
+				^ static_cast<uint32_t>(corner.N) * 0xC2B2AE3Du;
+			hash ^= hash >> 15;
+			for (size_t slot = hash & m_Mask;; slot = (slot + 1) & m_Mask)
+			{
+				if (m_Values[slot] == EmptySlot)
+				{
+					m_Keys[slot] = corner;
+					m_Values[slot] = nextIndex;
+					inserted = true;
+					return nextIndex;
+				}
+				const auto& key = m_Keys[slot];
+				if (key.V == corner.V && key.T == corner.T && key.N == corner.N)
+				{
+					inserted = false;
+					return m_Values[slot];
+				}
+			}
+		}
+
+	private:
+		size_t				m_Mask;
+		vector<Corner>		m_Keys;
+		vector<uint32_t>	m_Values;
+	};
+
+	bool BuildShape(shape_t& shape, const Segment& segment, const vector<Chunk>& chunks, const vector<size_t>& triangleBases,
+		const vector<float>& positions, const vector<float>& normals, const vector<float>& texCoords)
+	{
+		shape.name = segment.Name;
+		auto& mesh = shape.mesh;
+		auto cornerCount = (segment.End - segment.Begin) * 3;
+		auto positionCount = static_cast<int>(positions.size() / 3);
+		auto normalCount = static_cast<int>(normals.size() / 3);
+		auto texCoordCount = static_cast<int>(texCoords.size() / 2);
+
+		// Ranges of the segment in each chunk it spans
+		vector<pair<const Corner*, const Corner*>> ranges;
+		auto chunk = static_cast<size_t>(upper_bound(triangleBases.begin(), triangleBases.end(), segment.Begin) - triangleBases.begin() - 1);
+		for (; chunk < chunks.size() && triangleBases[chunk] < segment.End; chunk++)
+		{
+			auto begin = max(segment.Begin, triangleBases[chunk]) - triangleBases[chunk];
+			auto end = min(segment.End, triangleBases[chunk + 1]) - triangleBases[chunk];
+			if (begin < end)
+				ranges.push_back(make_pair(&chunks[chunk].Corners[begin * 3], &chunks[chunk].Corners[0] + end * 3));
+		}
+
+		// Normals and texcoords are zero filled for corners without, so the arrays always match positions
+		bool hasNormals = false, hasTexCoords = false;
+		for (const auto& range : ranges)
+		{
+			for (auto pCorner = range.first; pCorner != range.second; ++pCorner)
+			{
+				if (pCorner->V < 0 || pCorner->V >= positionCount || pCorner->T < -1 || pCorner->T >= texCoordCount || pCorner->N < -1 || pCorner->N >= normalCount)
+					return false;
+				hasNormals |= pCorner->N >= 0;
+				hasTexCoords |= pCorner->T >= 0;
+			}
+		}
+
+		VertexTable table(cornerCount);
+		mesh.indices.reserve(cornerCount);
+		mesh.material_ids.assign(cornerCount / 3, segment.Material);
+		uint32_t vertexCount = 0;
+		for (const auto& range : ranges)
+		{
+			for (auto pCorner = range.first; pCorner != range.second; ++pCorner)
+			{
+				bool inserted;
+				auto index = table.Insert(*pCorner, vertexCount, inserted);
+				mesh.indices.push_back(index);
+				if (!inserted)
+					continue;
+				vertexCount++;
+				mesh.positions.insert(mesh.positions.end(), &positions[pCorner->V * 3], &positions[pCorner->V * 3] + 3);
+				if (hasNormals)
+				{
+					if (pCorner->N >= 0)
+						mesh.normals.insert(mesh.normals.end(), &normals[pCorner->N * 3], &normals[pCorner->N * 3] + 3);
+					else
+						mesh.normals.insert(mesh.normals.end(), 3, 0.0f);
+				}
+				if (hasTexCoords)
+				{
+					if (pCorner->T >= 0)
+						mesh.texcoords.insert(mesh.texcoords.end(), &texCoords[pCorner->T * 2], &texCoords[pCorner->T * 2] + 2);
+					else
+						mesh.texcoords.insert(mesh.texcoords.end(), 2, 0.0f);
+				}
+			}
+		}
+		return true;
+	}
+
+	void InitMaterial(material_t& material)
+	{
+		material.name.clear();
+		material.ambient_texname.clear();
+		material.diffuse_texname.clear();
+		material.specular_texname.clear();
+		material.normal_texname.clear();
+		for (int i = 0; i < 3; i++)
+		{
+			material.ambient[i] = 0.f;
+			material.diffuse[i] = 0.f;
+			material.specular[i] = 0.f;
+			material.transmittance[i] = 0.f;
+			material.emission[i] = 0.f;
+		}
+		material.illum = 0;
+		material.dissolve = 1.f;
+		material.shininess = 1.f;
+		material.ior = 1.f;
+		material.unknown_parameter.clear();
+	}
+
+	void ParseColor(float* color, const char* p, const char* end)
+	{
+		for (int i = 0; i < 3; i++)
+			color[i] = ParseNumber(p, end);
+	}
+}
+
+float DirectX::Scene::ObjParser::ParseFloat(const char *& p, const char * end)
+{
+	// Powers of ten a double holds exactly
+	static const double Powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	SkipSpaces(p, end);
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	// Up to 19 significant digits fit the mantissa, later ones only scale it
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	for (; p < end && IsDigit(*p); p++)
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa != 0;
+		}
+		else
+			exponent++;
+	}
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && IsDigit(*p); p++)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
+				exponent--;
+			}
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		auto q = p + 1;
+		bool negativeExponent = false;
+		if (q < end && (*q == '-' || *q == '+'))
+			negativeExponent = *q++ == '-';
+		if (q < end && IsDigit(*q))
+		{
+			int value = 0;
+			for (; q < end && IsDigit(*q); q++)
+			{
+				if (value < 100000)
+					value = value * 10 + (*q - '0');
+			}
+			exponent += negativeExponent ? -value : value;
+			p = q;
+		}
+	}
+
+	if (mantissa == 0)
+		return negative ? -0.0f : 0.0f;
+	// Past what a float holds, the result is zero or infinity anyway
+	exponent = max(-100, min(100, exponent));
+	double value = static_cast<double>(mantissa);
+	for (; exponent > 22; exponent -= 22)
+		value *= Powers[22];
+	for (; exponent < -22; exponent += 22)
+		value /= Powers[22];
+	value = exponent < 0 ? value / Powers[-exponent] : value * Powers[exponent];
+	return static_cast<float>(negative ? -value : value);
+}
+
+std::string DirectX::Scene::ObjParser::Load(std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials, const std::wstring & fileName)
+{
+	MappedFile file(fileName);
+	if (!file.IsOpen())
+		return "Cannot open file [" + boost::filesystem::path(fileName).string() + "]";
+	return Parse(shapes, materials, file.Data(), file.Size(), boost::filesystem::path(fileName).parent_path().wstring());
+}
+
+std::string DirectX::Scene::ObjParser::Parse(std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials, const char * data, size_t size, const std::wstring & mtlDirectory)
+{
+	shapes.clear();
+
+	// Line aligned chunks
+	size_t chunkCount = max<size_t>(1, size / MinChunkSize);
+	vector<Chunk> chunks(chunkCount);
+	const char* begin = data;
+	const char* end = data + size;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = end;
+		if (i + 1 < chunkCount)
+		{
+			chunkEnd = max(begin, data + size * (i + 1) / chunkCount);
+			auto eol = static_cast<const char*>(memchr(chunkEnd, '\n', end - chunkEnd));
+			chunkEnd = eol ? eol + 1 : end;
+		}
+		chunks[i].Begin = begin;
+		chunks[i].End = chunkEnd;
+		begin = chunkEnd;
+	}
+
+	Causality::BranchScheduler::Shared().Dispatch(chunkCount, [&](size_t i)
+	{
+		chunks[i].Parse();
+	});
+
+	// Where each chunk's elements start in the file
+	vector<size_t> positionBases(chunkCount + 1), normalBases(chunkCount + 1), texCoordBases(chunkCount + 1), triangleBases(chunkCount + 1);
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		positionBases[i + 1] = positionBases[i] + chunks[i].Positions.size();
+		normalBases[i + 1] = normalBases[i] + chunks[i].Normals.size();
+		texCoordBases[i + 1] = texCoordBases[i] + chunks[i].TexCoords.size();
+		triangleBases[i + 1] = triangleBases[i] + chunks[i].Corners.size() / 3;
+	}
+
+	vector<float> positions(positionBases.back()), normals(normalBases.back()), texCoords(texCoordBases.back());
+	Causality::BranchScheduler::Shared().Dispatch(chunkCount, [&](size_t i)
+	{
+		auto& chunk = chunks[i];
+		chunk.Resolve(static_cast<int>(positionBases[i] / 3), static_cast<int>(normalBases[i] / 3), static_cast<int>(texCoordBases[i] / 2));
+		copy(chunk.Positions.begin(), chunk.Positions.end(), positions.begin() + positionBases[i]);
+		copy(chunk.Normals.begin(), chunk.Normals.end(), normals.begin() + normalBases[i]);
+		copy(chunk.TexCoords.begin(), chunk.TexCoords.end(), texCoords.begin() + texCoordBases[i]);
+		vector<float>().swap(chunk.Positions);
+		vector<float>().swap(chunk.Normals);
+		vector<float>().swap(chunk.TexCoords);
+	});
+
+	// Shape boundaries, in file order
+	vector<Segment> segments;
+	map<string, int> materialMap;
+	for (size_t i = 0; i < materials.size(); i++)
+		materialMap[materials[i].name] = static_cast<int>(i);
+	Segment current = { 0, 0, string(), -1 };
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		for (const auto& e : chunks[i].Events)
+		{
+			if (e.Type == Event_MaterialLibrary)
+			{
+				auto first = materials.size();
+				auto error = LoadMtl(materials, (boost::filesystem::path(mtlDirectory) / e.Name).wstring());
+				if (!error.empty())
+					LOG_WARNING(Causality::Log_Loading, "%s", error.c_str());
+				for (auto m = first; m < materials.size(); m++)
+					materialMap[materials[m].name] = static_cast<int>(m);
+				continue;
+			}
+
+			current.End = triangleBases[i] + e.Triangle;
+			if (current.End > current.Begin)
+				segments.push_back(current);
+			current.Begin = current.End;
+			if (e.Type == Event_UseMaterial)
+			{
+				auto itr = materialMap.find(e.Name);
+				current.Material = itr != materialMap.end() ? itr->second : -1;
+			}
+			else
+				current.Name = e.Name;
+		}
+	}
+	current.End = triangleBases.back();
+	if (current.End > current.Begin)
+		segments.push_back(current);
+
+	shapes.resize(segments.size());
+	vector<char> valid(segments.size());
+	Causality::BranchScheduler::Shared().Dispatch(segments.size(), [&](size_t i)
+	{
+		valid[i] = BuildShape(shapes[i], segments[i], chunks, triangleBases, positions, normals, texCoords);
+	});
+	if (find(valid.begin(), valid.end(), 0) != valid.end())
+	{
+		shapes.clear();
+		return "Face index out of range";
+	}
+	return string();
+}
+
+std::vector<std::string> DirectX::Scene::ObjParser::MaterialLibraries(const char * data, size_t size)
+{
+	vector<string> libraries;
+	ForEachLine(data, data + size, [&](const char* p, const char* end)
+	{
+		if (Keyword(p, end, "mtllib", 6))
+			libraries.push_back(ParseName(p, end));
+	});
+	return libraries;
+}
+
+std::string DirectX::Scene::ObjParser::LoadMtl(std::vector<tinyobj::material_t>& materials, const std::wstring & fileName)
+{
+	MappedFile file(fileName);
+	if (!file.IsOpen())
+		return "Cannot open file [" + boost::filesystem::path(fileName).string() + "]";
+	ParseMtl(materials, file.Data(), file.Size());
+	return string();
+}
+
+void DirectX::Scene::ObjParser::ParseMtl(std::vector<tinyobj::material_t>& materials, const char * data, size_t size)
+{
+	material_t material;
+	InitMaterial(material);
+	bool pending = false;
+	ForEachLine(data, data + size, [&](const char* p, const char* end)
+	{
+		if (Keyword(p, end, "newmtl", 6))
+		{
+			if (pending)
+				materials.push_back(material);
+			InitMaterial(material);
+			material.name = ParseName(p, end);
+			pending = true;
+		}
+		else if (Keyword(p, end, "Ka", 2))
+			ParseColor(material.ambient, p, end);
+		else if (Keyword(p, end, "Kd", 2))
+			ParseColor(material.diffuse, p, end);
+		else if (Keyword(p, end, "Ks", 2))
+			ParseColor(material.specular, p, end);
+		else if (Keyword(p, end, "Kt", 2))
+			ParseColor(material.transmittance, p, end);
+		else if (Keyword(p, end, "Ke", 2))
+			ParseColor(material.emission, p, end);
+		else if (Keyword(p, end, "Ni", 2))
+			material.ior = ParseNumber(p, end);
+		else if (Keyword(p, end, "Ns", 2))
+			material.shininess = ParseNumber(p, end);
+		else if (Keyword(p, end, "illum", 5))
+		{
+			SkipSpaces(p, end);
+			material.illum = ParseInt(p, end);
+		}
+		else if (Keyword(p, end, "d", 1) || Keyword(p, end, "Tr", 2))
+			material.dissolve = ParseNumber(p, end);
+		else if (Keyword(p, end, "map_Ka", 6))
+			material.ambient_texname = ParseRest(p, end);
+		else if (Keyword(p, end, "map_Kd", 6))
+			material.diffuse_texname = ParseRest(p, end);
+		else if (Keyword(p, end, "map_Ks", 6))
+			material.specular_texname = ParseRest(p, end);
+		else if (Keyword(p, end, "map_Ns", 6))
+			material.normal_texname = ParseRest(p, end);
+		else
+		{
+			auto key = ParseName(p, end);
+			if (p < end)
+				material.unknown_parameter[key] = ParseRest(p + 1, end);
+		}
+	});
+	if (pending)
+		materials.push_back(material);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Extern\tiny_obj_loader.h"
+#include <string>
+#include <vector>
+
+namespace DirectX
+{
+	namespace Scene
+	{
+		// OBJ / MTL parser filling tiny_obj_loader's shapes and materials, shapes are split on g, o and usemtl the same way
+		// The file is mapped and cut into line aligned chunks parsed in parallel, then shapes are built in parallel
+		// Vertices are de-duplicated per shape through a flat open addressing table
+		class ObjParser
+		{
+		public:
+			// Empty string on success, the error otherwise
+			static std::string Load(std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials, const std::wstring& fileName);
+			// Parse an OBJ already in memory, material libraries are looked up in mtlDirectory
+			static std::string Parse(std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials, const char* data, size_t size, const std::wstring& mtlDirectory);
+
+			// Names of the material libraries an OBJ refers to, in file order, without parsing the rest
+			static std::vector<std::string> MaterialLibraries(const char* data, size_t size);
+
+			// Appends the file's materials
+			static std::string LoadMtl(std::vector<tinyobj::material_t>& materials, const std::wstring& fileName);
+			static void ParseMtl(std::vector<tinyobj::material_t>& materials, const char* data, size_t size);
+
+			// Locale independent, leading blanks are skipped and text is left on the first character after the number
+			static float ParseFloat(const char*& text, const char* end);
+		};
+	}
+}
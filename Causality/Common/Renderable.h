@@ -1,6 +1,12 @@
 #pragma once
+// DeviceResources and StepTimer are C++/CX, builds without /ZW (the benchmark) only see the interfaces
+#if defined(__cplusplus_winrt)
 #include "DeviceResources.h"
 #include "StepTimer.h"
+#else
+#include <d3d11_2.h>
+namespace DirectX { class StepTimer; }
+#endif
 #include "DirectXMathExtend.h"
 #include "Locatable.h"
 #include <DirectXCollision.h>
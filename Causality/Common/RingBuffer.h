@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <cassert>
+
+namespace Causality
+{
+	// Fixed capacity FIFO kept in place, push_back on a full buffer overwrites the oldest element
+	// Elements are indexed from the oldest (0) to the newest (size() - 1)
+	template <class T, size_t _Capacity>
+	class RingBuffer
+	{
+	public:
+		RingBuffer() : m_Head(0), m_Size(0) {}
+
+		static size_t capacity() { return _Capacity; }
+		size_t size() const { return m_Size; }
+		bool empty() const { return m_Size == 0; }
+		bool full() const { return m_Size == _Capacity; }
+
+		void clear() { m_Head = 0; m_Size = 0; }
+
+		// Slot for the new element, its old content is whatever was evicted
+		T& push_back()
+		{
+			if (full())
+				pop_front();
+			++m_Size;
+			return back();
+		}
+		void push_back(const T& value) { push_back() = value; }
+
+		void pop_front()
+		{
+			assert(!empty());
+			m_Head = (m_Head + 1) % _Capacity;
+			--m_Size;
+		}
+
+		T& front() { return m_Data[m_Head]; }
+		const T& front() const { return m_Data[m_Head]; }
+		T& back() { return (*this)[m_Size - 1]; }
+		const T& back() const { return (*this)[m_Size - 1]; }
+
+		T& operator[](size_t i) { return m_Data[(m_Head + i) % _Capacity]; }
+		const T& operator[](size_t i) const { return m_Data[(m_Head + i) % _Capacity]; }
+
+	private:
+		std::array<T, _Capacity>	m_Data;
+		size_t						m_Head;
+		size_t						m_Size;
+	};
+}
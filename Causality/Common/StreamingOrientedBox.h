@@ -0,0 +1,104 @@
+#pragma once
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <Eigen\Dense>
+#include <algorithm>
+#include <cmath>
+
+namespace Causality
+{
+	// Oriented box of a point set which points enter and leave one at a time
+	// Keeps the first and second moments of the points, so Add and Remove are O(1) per point and GetBox is O(1)
+	// Axes are the principal axes of the covariance, as BoundingOrientedBox::CreateFromPoints picks them,
+	// Extents are those of a uniform box with the same variance (sqrt(3) sigma), sorted from bigger to smaller
+	// like CreateBoundingOrientedBoxFromPoints, since exact extents would need another pass over the points
+	class StreamingOrientedBox
+	{
+	public:
+		StreamingOrientedBox() { Clear(); }
+
+		void Clear()
+		{
+			m_Count = 0;
+			m_Origin.setZero();
+			m_Sum.setZero();
+			m_SumSq.setZero();
+		}
+
+		size_t Count() const { return m_Count; }
+
+		void Add(const DirectX::XMFLOAT3* pPoints, size_t count, size_t stride = sizeof(DirectX::XMFLOAT3))
+		{
+			// Moments are taken around the first point, so they don't lose precision far from the origin
+			if (m_Count == 0 && count > 0)
+				m_Origin = Eigen::Vector3d(pPoints->x, pPoints->y, pPoints->z);
+			Accumulate(pPoints, count, stride, 1.0);
+			m_Count += count;
+		}
+
+		// Points must be the same as some added before
+		void Remove(const DirectX::XMFLOAT3* pPoints, size_t count, size_t stride = sizeof(DirectX::XMFLOAT3))
+		{
+			if (count >= m_Count)
+			{
+				Clear();
+				return;
+			}
+			Accumulate(pPoints, count, stride, -1.0);
+			m_Count -= count;
+		}
+
+		void GetBox(DirectX::BoundingOrientedBox& box) const
+		{
+			using namespace DirectX;
+			if (m_Count == 0)
+			{
+				box = BoundingOrientedBox();
+				box.Extents = XMFLOAT3(0, 0, 0);
+				return;
+			}
+
+			double invCount = 1.0 / m_Count;
+			Eigen::Vector3d mean = m_Sum * invCount;
+			Eigen::Matrix3d covariance = m_SumSq * invCount - mean * mean.transpose();
+			Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+			solver.computeDirect(covariance);
+			// Eigen values are increasing, the box's x axis takes the biggest
+			const auto& values = solver.eigenvalues();
+			const auto& vectors = solver.eigenvectors();
+			Eigen::Vector3d axisX = vectors.col(2);
+			Eigen::Vector3d axisY = vectors.col(1);
+			Eigen::Vector3d axisZ = axisX.cross(axisY);
+
+			mean += m_Origin;
+			box.Center = XMFLOAT3((float) mean.x(), (float) mean.y(), (float) mean.z());
+			box.Extents = XMFLOAT3(
+				(float) sqrt(3.0 * std::max(values[2], 0.0)),
+				(float) sqrt(3.0 * std::max(values[1], 0.0)),
+				(float) sqrt(3.0 * std::max(values[0], 0.0)));
+			XMMATRIX rotation = XMMatrixIdentity();
+			rotation.r[0] = XMVectorSet((float) axisX.x(), (float) axisX.y(), (float) axisX.z(), 0);
+			rotation.r[1] = XMVectorSet((float) axisY.x(), (float) axisY.y(), (float) axisY.z(), 0);
+			rotation.r[2] = XMVectorSet((float) axisZ.x(), (float) axisZ.y(), (float) axisZ.z(), 0);
+			XMStoreFloat4(&box.Orientation, XMQuaternionNormalize(XMQuaternionRotationMatrix(rotation)));
+		}
+
+	private:
+		void Accumulate(const DirectX::XMFLOAT3* pPoints, size_t count, size_t stride, double sign)
+		{
+			auto pBytes = reinterpret_cast<const char*>(pPoints);
+			for (size_t i = 0; i < count; i++, pBytes += stride)
+			{
+				auto pPoint = reinterpret_cast<const DirectX::XMFLOAT3*>(pBytes);
+				Eigen::Vector3d p = Eigen::Vector3d(pPoint->x, pPoint->y, pPoint->z) - m_Origin;
+				m_Sum += sign * p;
+				m_SumSq += sign * (p * p.transpose());
+			}
+		}
+
+		size_t			m_Count;
+		Eigen::Vector3d	m_Origin;
+		Eigen::Vector3d	m_Sum;
+		Eigen::Matrix3d	m_SumSq;
+	};
+}
@@ -0,0 +1,180 @@
+#include "TangentFrame.h"
+#include "..\BranchScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::Scene;
+using namespace std;
+
+// Faces or vertices per task
+static const size_t BlockSize = 4096;
+
+namespace
+{
+	template <class T>
+	const T& Element(const T* base, size_t stride, size_t index)
+	{
+		return *reinterpret_cast<const T*>(reinterpret_cast<const char*>(base) + index * stride);
+	}
+
+	template <class T>
+	T& Element(T* base, size_t stride, size_t index)
+	{
+		return *reinterpret_cast<T*>(reinterpret_cast<char*>(base) + index * stride);
+	}
+
+	// Corners around every vertex, in corner order
+	struct VertexCorners
+	{
+		vector<uint32_t> Offsets;
+		vector<uint32_t> Corners;
+
+		VertexCorners(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+			: Offsets(vertexCount + 1, 0), Corners(indexCount)
+		{
+			for (size_t i = 0; i < indexCount; i++)
+				Offsets[indices[i] + 1]++;
+			for (size_t v = 0; v < vertexCount; v++)
+				Offsets[v + 1] += Offsets[v];
+			vector<uint32_t> fill(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i < indexCount; i++)
+				Corners[fill[indices[i]]++] = static_cast<uint32_t>(i);
+		}
+	};
+
+	void ParallelBlocks(size_t count, const std::function<void(size_t, size_t)>& body)
+	{
+		size_t blockCount = (count + BlockSize - 1) / BlockSize;
+		Causality::BranchScheduler::Shared().Dispatch(blockCount, [&](size_t block)
+		{
+			body(block * BlockSize, std::min(count, (block + 1) * BlockSize));
+		});
+	}
+
+	// Interior angles of a triangle at its three corners, zero for degenerate ones
+	void XM_CALLCONV CornerAngles(FXMVECTOR p0, FXMVECTOR p1, FXMVECTOR p2, float angles[3])
+	{
+		XMVECTOR d01 = XMVector3Normalize(p1 - p0);
+		XMVECTOR d02 = XMVector3Normalize(p2 - p0);
+		XMVECTOR d12 = XMVector3Normalize(p2 - p1);
+		angles[0] = XMVectorGetX(XMVector3AngleBetweenNormals(d01, d02));
+		angles[1] = XMVectorGetX(XMVector3AngleBetweenNormals(-d01, d12));
+		angles[2] = std::max(XM_PI - angles[0] - angles[1], 0.0f);
+	}
+}
+
+void DirectX::Scene::TangentFrame::ComputeNormals(const XMFLOAT3 * positions, size_t positionStride, size_t vertexCount, const uint32_t * indices, size_t indexCount, XMFLOAT3 * normals, size_t normalStride)
+{
+	indexCount -= indexCount % 3;
+	vector<XMFLOAT3> corners(indexCount);
+	ParallelBlocks(indexCount / 3, [&](size_t begin, size_t end)
+	{
+		float angles[3];
+		for (size_t f = begin; f < end; f++)
+		{
+			const uint32_t* face = indices + f * 3;
+			XMVECTOR p0 = XMLoadFloat3(&Element(positions, positionStride, face[0]));
+			XMVECTOR p1 = XMLoadFloat3(&Element(positions, positionStride, face[1]));
+			XMVECTOR p2 = XMLoadFloat3(&Element(positions, positionStride, face[2]));
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			if (XMVector3Equal(n, XMVectorZero()))
+			{
+				for (size_t k = 0; k < 3; k++)
+					XMStoreFloat3(&corners[f * 3 + k], XMVectorZero());
+				continue;
+			}
+			n = XMVector3Normalize(n);
+			CornerAngles(p0, p1, p2, angles);
+			for (size_t k = 0; k < 3; k++)
+				XMStoreFloat3(&corners[f * 3 + k], n * angles[k]);
+		}
+	});
+
+	VertexCorners table(indices, indexCount, vertexCount);
+	ParallelBlocks(vertexCount, [&](size_t begin, size_t end)
+	{
+		for (size_t v = begin; v < end; v++)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for (auto c = table.Offsets[v]; c < table.Offsets[v + 1]; c++)
+				sum += XMLoadFloat3(&corners[table.Corners[c]]);
+			XMStoreFloat3(&Element(normals, normalStride, v), XMVector3Normalize(sum));
+		}
+	});
+}
+
+void DirectX::Scene::TangentFrame::ComputeTangents(const XMFLOAT3 * positions, size_t positionStride, const XMFLOAT3 * normals, size_t normalStride, const XMFLOAT2 * texcoords, size_t texcoordStride, size_t vertexCount, const uint32_t * indices, size_t indexCount, XMFLOAT4 * tangents)
+{
+	indexCount -= indexCount % 3;
+	vector<XMFLOAT3> cornerTangents(indexCount), cornerBitangents(indexCount);
+	ParallelBlocks(indexCount / 3, [&](size_t begin, size_t end)
+	{
+		float angles[3];
+		for (size_t f = begin; f < end; f++)
+		{
+			const uint32_t* face = indices + f * 3;
+			XMVECTOR p0 = XMLoadFloat3(&Element(positions, positionStride, face[0]));
+			XMVECTOR p1 = XMLoadFloat3(&Element(positions, positionStride, face[1]));
+			XMVECTOR p2 = XMLoadFloat3(&Element(positions, positionStride, face[2]));
+			const auto& t0 = Element(texcoords, texcoordStride, face[0]);
+			const auto& t1 = Element(texcoords, texcoordStride, face[1]);
+			const auto& t2 = Element(texcoords, texcoordStride, face[2]);
+
+			// Directions of +u and +v on the face's plane
+			float du1 = t1.x - t0.x, dv1 = t1.y - t0.y;
+			float du2 = t2.x - t0.x, dv2 = t2.y - t0.y;
+			float area = du1 * dv2 - du2 * dv1;
+			XMVECTOR e1 = p1 - p0, e2 = p2 - p0;
+			if (area == 0 || XMVector3Equal(XMVector3Cross(e1, e2), XMVectorZero()))
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					XMStoreFloat3(&cornerTangents[f * 3 + k], XMVectorZero());
+					XMStoreFloat3(&cornerBitangents[f * 3 + k], XMVectorZero());
+				}
+				continue;
+			}
+			XMVECTOR s = (e1 * dv2 - e2 * dv1) / area;
+			XMVECTOR t = (e2 * du1 - e1 * du2) / area;
+
+			CornerAngles(p0, p1, p2, angles);
+			for (size_t k = 0; k < 3; k++)
+			{
+				XMVECTOR n = XMLoadFloat3(&Element(normals, normalStride, face[k]));
+				XMVECTOR sk = XMVector3Normalize(s - n * XMVector3Dot(n, s));
+				XMVECTOR tk = XMVector3Normalize(t - n * XMVector3Dot(n, t));
+				XMStoreFloat3(&cornerTangents[f * 3 + k], sk * angles[k]);
+				XMStoreFloat3(&cornerBitangents[f * 3 + k], tk * angles[k]);
+			}
+		}
+	});
+
+	VertexCorners table(indices, indexCount, vertexCount);
+	ParallelBlocks(vertexCount, [&](size_t begin, size_t end)
+	{
+		for (size_t v = begin; v < end; v++)
+		{
+			XMVECTOR tangent = XMVectorZero(), bitangent = XMVectorZero();
+			for (auto c = table.Offsets[v]; c < table.Offsets[v + 1]; c++)
+			{
+				tangent += XMLoadFloat3(&cornerTangents[table.Corners[c]]);
+				bitangent += XMLoadFloat3(&cornerBitangents[table.Corners[c]]);
+			}
+			XMVECTOR n = XMLoadFloat3(&Element(normals, normalStride, v));
+			tangent = XMVector3Normalize(tangent - n * XMVector3Dot(n, tangent));
+			if (XMVector3Equal(tangent, XMVectorZero()))
+			{
+				// No uv gradient here, any direction on the normal plane will do
+				XMVECTOR axis = fabsf(XMVectorGetX(n)) < 0.9f ? g_XMIdentityR0 : g_XMIdentityR1;
+				tangent = XMVector3Normalize(XMVector3Cross(n, axis));
+				if (XMVector3Equal(tangent, XMVectorZero()))
+					tangent = g_XMIdentityR0;
+			}
+			float handedness = XMVectorGetX(XMVector3Dot(XMVector3Cross(n, tangent), bitangent)) < 0 ? -1.0f : 1.0f;
+			XMStoreFloat4(&tangents[v], XMVectorSetW(tangent, handedness));
+		}
+	});
+}
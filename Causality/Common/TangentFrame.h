@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <DirectXMath.h>
+
+namespace DirectX
+{
+	namespace Scene
+	{
+		// Vertex normals and tangent frames of indexed triangle lists
+		// Faces are processed in parallel into per corner contributions, then every vertex sums its corners
+		// through a vertex to corner table in face order, so results don't depend on scheduling and can be compared bit for bit
+		class TangentFrame
+		{
+		public:
+			// Angle weighted normals (Thurmer, Wuthrich 1998), faces face along cross(p1 - p0, p2 - p0)
+			// Vertices no face uses, or only degenerate ones, get a zero normal
+			static void ComputeNormals(const XMFLOAT3* positions, size_t positionStride, size_t vertexCount,
+				const uint32_t* indices, size_t indexCount, XMFLOAT3* normals, size_t normalStride);
+
+			// Tangents along +u, xyz unit and orthogonal to the normal, w the sign of the bitangent : B = w * cross(N, T)
+			// Same construction as MikkTSpace : per face directions projected on each corner's normal plane, normalized and angle weighted
+			// MikkTSpace also splits vertices whose faces disagree on handedness, vertices are expected to be split at uv seams already
+			static void ComputeTangents(const XMFLOAT3* positions, size_t positionStride, const XMFLOAT3* normals, size_t normalStride,
+				const XMFLOAT2* texcoords, size_t texcoordStride, size_t vertexCount, const uint32_t* indices, size_t indexCount, XMFLOAT4* tangents);
+		};
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+
+namespace Causality
+{
+	// Wait-free single producer / single consumer handoff of the latest value
+	// The producer fills Back() and publishes it, the consumer picks up the latest published value with Acquire()
+	// Neither side ever blocks, values the consumer didn't pick up in time are overwritten
+	template <class T>
+	class TripleBuffer
+	{
+	public:
+		TripleBuffer()
+			: m_Back(0), m_Middle(1), m_Front(2)
+		{}
+
+		TripleBuffer(const TripleBuffer&) = delete;
+		TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+		// Producer side
+		T& Back() { return m_Buffers[m_Back]; }
+
+		// Swap the filled back buffer with the middle one, Back() is the stale middle buffer afterwards
+		void Publish()
+		{
+			m_Back = m_Middle.exchange(m_Back | Fresh, std::memory_order_acq_rel) & IndexMask;
+		}
+
+		// Consumer side, returns true if a newer value was published since last Acquire
+		bool Acquire()
+		{
+			if (!(m_Middle.load(std::memory_order_relaxed) & Fresh))
+				return false;
+			m_Front = m_Middle.exchange(m_Front, std::memory_order_acq_rel) & IndexMask;
+			return true;
+		}
+
+		const T& Front() const { return m_Buffers[m_Front]; }
+
+	private:
+		enum : unsigned
+		{
+			IndexMask = 0x3,
+			// Set on the middle index when it holds a value the consumer has not seen
+			Fresh = 0x4,
+		};
+
+		T						m_Buffers[3];
+		unsigned				m_Back;
+		std::atomic<unsigned>	m_Middle;
+		unsigned				m_Front;
+	};
+}
@@ -120,14 +120,14 @@ namespace stree
 
 		// Logical Parent for this node
 		const_pointer parent() const {
-			pointer p = this;
+			const_pointer p = static_cast<const_pointer>(this);
 			while (p->_parent && p->_parent->_child != p)
 				p = p->_parent;
 			return p->_parent;
 		}
 		// Logical Parent for this node
 		pointer parent() {
-			pointer = this;
+			pointer p = static_cast<pointer>(this);
 			while (p->_parent && p->_parent->_child != p)
 				p = p->_parent;
 			return p->_parent;
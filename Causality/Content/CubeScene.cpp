@@ -110,8 +110,9 @@ void Causality::CubeScene::OnHandsTrackLost(const UserHandsEventArgs & e)
 
 void Causality::CubeScene::OnHandsMove(const UserHandsEventArgs & e)
 {
-	auto frame = e.sender.frame();
-	TrackingUpdate(frame.hands().frontmost().palmPosition().toVector3<Vector3>().x);
+	auto pHand = e.frame.Frontmost();
+	if (pHand)
+		TrackingUpdate(pHand->PalmPosition.x);
 }
 
 void Causality::CubeScene::OnMouseButtonDown(const CursorButtonEvent & e)
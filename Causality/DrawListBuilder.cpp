@@ -0,0 +1,133 @@
+#include "pch_bullet.h"
+#include "DrawListBuilder.h"
+#include "WorldBranch.h"
+#include "BranchScheduler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+using namespace Causality;
+using namespace DirectX;
+using namespace std;
+
+const float Causality::DrawListBuilder::OpaqueThreshold = 0.999f;
+
+void Causality::DrawListBuilder::SetViews(const BoundingFrustum * pFrustums, size_t count)
+{
+	count = std::min<size_t>(count, MaxViews);
+	m_Views.assign(pFrustums, pFrustums + count);
+}
+
+uint64_t Causality::DrawListBuilder::SortKey(uint32_t batchKey, float opacity, uint32_t state)
+{
+	if (opacity >= OpaqueThreshold)
+		return (uint64_t) (batchKey & 0x7fffffff) << 32 | state;
+	// Ghosts : 16 bits of inverted opacity, then 15 bits of batch key
+	auto quantized = static_cast<uint32_t>(std::min(std::max(opacity, 0.0f), 1.0f) * 0xffff + 0.5f);
+	return 1ULL << 63 | (uint64_t) (0xffff - quantized) << 47 | (uint64_t) (batchKey & 0x7fff) << 32 | state;
+}
+
+float Causality::DrawListBuilder::ProjectedSize(const BoundingFrustum & view, FXMVECTOR center, float radius)
+{
+	// The view is (TopSlope - BottomSlope) * distance tall at the sphere's distance
+	float distance = XMVectorGetX(XMVector3Length(center - XMLoadFloat3(&view.Origin)));
+	float height = (view.TopSlope - view.BottomSlope) * distance;
+	if (distance <= radius || height <= 0)
+		return FLT_MAX;
+	return 2 * radius / height;
+}
+
+void Causality::DrawListBuilder::CullObjects(const SuperpositionTable & states, const BoundingOrientedBox * bounds, const uint32_t * batchKeys, size_t begin, size_t end, std::vector<DrawItem>& items) const
+{
+	BoundingOrientedBox box;
+	DrawItem item;
+	// Items are compared byte for byte, padding included
+	memset(&item, 0, sizeof(item));
+	auto viewCount = m_Views.size();
+	for (size_t id = begin; id < end; id++)
+	{
+		const auto& range = states.Objects[id];
+		for (uint32_t state = range.Offset; state < range.Offset + range.Count; state++)
+		{
+			XMMATRIX world = states.TransformMatrix(state);
+			bounds[id].Transform(box, world);
+			uint32_t mask = 0;
+			float size = 0;
+			XMVECTOR center = XMLoadFloat3(&box.Center);
+			float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&box.Extents)));
+			for (size_t v = 0; v < viewCount; v++)
+			{
+				if (m_Views[v].Contains(box) != ContainmentType::DISJOINT)
+				{
+					mask |= 1U << v;
+					size = std::max(size, ProjectedSize(m_Views[v], center, radius));
+				}
+			}
+			if (!mask)
+				continue;
+
+			item.Opacity = states.Probabilities[state];
+			item.SortKey = SortKey(batchKeys[id], item.Opacity, state);
+			XMStoreFloat4x4(&item.World, world);
+			item.Id = static_cast<uint32_t>(id);
+			item.State = state;
+			item.ViewMask = mask;
+			item.ScreenSize = size;
+			items.push_back(item);
+		}
+	}
+}
+
+void Causality::DrawListBuilder::Build(const SuperpositionTable & states, const BoundingOrientedBox * bounds, const uint32_t * batchKeys, size_t objectCount)
+{
+	objectCount = std::min(objectCount, states.ObjectCount());
+	size_t blockCount = (objectCount + BlockSize - 1) / BlockSize;
+	if (m_Blocks.size() < blockCount)
+		m_Blocks.resize(blockCount);
+
+	BranchScheduler::Shared().Dispatch(blockCount, [&](size_t block)
+	{
+		auto& items = m_Blocks[block];
+		items.clear();
+		CullObjects(states, bounds, batchKeys, block * BlockSize, std::min(objectCount, (block + 1) * BlockSize), items);
+	});
+
+	Finish(blockCount);
+}
+
+void Causality::DrawListBuilder::Finish(size_t blockCount)
+{
+	m_Unsorted.clear();
+	for (size_t block = 0; block < blockCount; block++)
+		m_Unsorted.insert(m_Unsorted.end(), m_Blocks[block].begin(), m_Blocks[block].end());
+
+	// Sort the keys only, items are moved once
+	m_Order.resize(m_Unsorted.size());
+	for (size_t i = 0; i < m_Unsorted.size(); i++)
+		m_Order[i] = make_pair(m_Unsorted[i].SortKey, static_cast<uint32_t>(i));
+	std::sort(m_Order.begin(), m_Order.end());
+
+	m_Items.resize(m_Order.size());
+	m_OpaqueCount = 0;
+	for (size_t i = 0; i < m_Order.size(); i++)
+	{
+		m_Items[i] = m_Unsorted[m_Order[i].second];
+		if (!(m_Order[i].first >> 63))
+			m_OpaqueCount = i + 1;
+	}
+}
+
+void Causality::DrawListBuilder::BuildSerial(const SuperpositionTable & states, const BoundingOrientedBox * bounds, const uint32_t * batchKeys, size_t objectCount)
+{
+	objectCount = std::min(objectCount, states.ObjectCount());
+	m_Items.clear();
+	CullObjects(states, bounds, batchKeys, 0, objectCount, m_Items);
+	std::sort(m_Items.begin(), m_Items.end(), [](const DrawItem& lhs, const DrawItem& rhs)
+	{
+		return lhs.SortKey < rhs.SortKey;
+	});
+	m_OpaqueCount = std::count_if(m_Items.begin(), m_Items.end(), [](const DrawItem& item)
+	{
+		return !(item.SortKey >> 63);
+	});
+}
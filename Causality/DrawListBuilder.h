@@ -0,0 +1,70 @@
+#pragma once
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+#include <cstdint>
+
+namespace Causality
+{
+	struct SuperpositionTable;
+
+	// One visible (object, state) pair, ready to submit
+	struct DrawItem
+	{
+		// Opaque states first grouped by batch key, then ghost states by decreasing opacity, ties broken by state
+		uint64_t			SortKey;
+		DirectX::XMFLOAT4X4	World;
+		float				Opacity;
+		uint32_t			Id;
+		uint32_t			State;
+		// Bit v is set if the item is visible in view v
+		uint32_t			ViewMask;
+		// Largest fraction of a view's height the state's bounding sphere covers, over the views it is visible in
+		float				ScreenSize;
+	};
+
+	// Culls every state of a superposition against all views of a frame in parallel,
+	// into one compact sorted draw list which every view submits with its own mask
+	class DrawListBuilder
+	{
+	public:
+		enum { MaxViews = 32 };
+		// States less probable than this are drawn as ghosts, after the opaque ones
+		static const float OpaqueThreshold;
+		// Objects culled by one task
+		static const size_t BlockSize = 64;
+
+		// Frustums in world space, at most MaxViews
+		void SetViews(const DirectX::BoundingFrustum* pFrustums, size_t count);
+		size_t ViewCount() const { return m_Views.size(); }
+
+		// bounds and batchKeys are the model space boxes and mesh / material keys of objects [0, objectCount)
+		// Items are the same as BuildSerial's, in the same order
+		void Build(const SuperpositionTable& states, const DirectX::BoundingOrientedBox* bounds, const uint32_t* batchKeys, size_t objectCount);
+		// Single threaded reference of Build
+		void BuildSerial(const SuperpositionTable& states, const DirectX::BoundingOrientedBox* bounds, const uint32_t* batchKeys, size_t objectCount);
+
+		const std::vector<DrawItem>& Items() const { return m_Items; }
+		// Items [0, OpaqueCount()) are opaque, the rest are ghosts
+		size_t OpaqueCount() const { return m_OpaqueCount; }
+
+		static uint64_t SortKey(uint32_t batchKey, float opacity, uint32_t state);
+		// Fraction of the view's height a world space sphere covers, FLT_MAX when the eye is inside it
+		static float ProjectedSize(const DirectX::BoundingFrustum& view, DirectX::FXMVECTOR center, float radius);
+
+	private:
+		// Cull objects [begin, end) into items, unsorted
+		void CullObjects(const SuperpositionTable& states, const DirectX::BoundingOrientedBox* bounds, const uint32_t* batchKeys,
+			size_t begin, size_t end, std::vector<DrawItem>& items) const;
+		// Merge the block lists into m_Items and sort it
+		void Finish(size_t blockCount);
+
+		std::vector<DirectX::BoundingFrustum>	m_Views;
+		// Per block results, kept across frames so building doesn't allocate once warmed up
+		std::vector<std::vector<DrawItem>>		m_Blocks;
+		std::vector<std::pair<uint64_t, uint32_t>>	m_Order;
+		std::vector<DrawItem>					m_Unsorted;
+		std::vector<DrawItem>					m_Items;
+		size_t									m_OpaqueCount = 0;
+	};
+}
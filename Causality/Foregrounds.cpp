@@ -4,6 +4,7 @@
 #include "Foregrounds.h"
 #include "CausalityApplication.h"
 #include "Common\PrimitiveVisualizer.h"
+#include "Common\Logger.h"
 #include "Common\Extern\cpplinq.hpp"
 #include <boost\format.hpp>
 
@@ -37,18 +38,6 @@ const static wstring SkyBoxTextures[6] = {
 //// The actual physics solver
 //std::unique_ptr<btSequentialImpulseConstraintSolver> pSolver = nullptr;
 
-std::queue<std::unique_ptr<WorldBranch>> WorldBranch::BranchPool;
-
-
-float ShapeSimiliarity(const Eigen::VectorXf& v1, const Eigen::VectorXf& v2)
-{
-	auto v = v1 - v2;
-	//dis = sqrt(v.dot(v);
-	//1.414 - dis;
-	auto theta = XMScalarACosEst(v1.dot(v2) * XMScalarReciprocalSqrtEst(v1.dot(v1) * v2.dot(v2))); // Difference in angular [0,pi/4]
-	auto rhlo = abs(sqrt(v1.dot(v1)) - sqrtf(v2.dot(v2)));	// Difference in length [0,sqrt(2)]
-	return 1.0f - 0.5f * (0.3f * rhlo / sqrtf(2.0f) + 0.7f * theta / (XM_PIDIV4));
-}
 
 Causality::WorldScene::WorldScene(const std::shared_ptr<DirectX::DeviceResources>& pResouce, const DirectX::ILocatable* pCamera)
 	: States(pResouce->GetD3DDevice())
@@ -56,6 +45,9 @@ Causality::WorldScene::WorldScene(const std::shared_ptr<DirectX::DeviceResources
 {
 	m_HaveHands = false;
 	m_showTrace = true;
+	m_HandTraceVersion = 0;
+	m_RankedTraceVersion = 0;
+	m_ViewMask = ~0U;
 	LoadAsync(pResouce->GetD3DDevice());
 }
 
@@ -63,29 +55,87 @@ WorldScene::~WorldScene()
 {
 }
 
-const float fingerRadius = 0.006f;
-const float fingerLength = 0.02f;
-
-class XmlModelLoader
+// One object of Foregrounds.xml, as described, before anything is loaded
+struct SceneObjectDescription
 {
+	enum ObjectType
+	{
+		Obj,
+		Cube,
+	};
+
+	SceneObjectDescription()
+		: Type(Cube), Name("cube"), Extent(1.0f), CubeColor(1.0f, 1.0f, 1.0f, 1.0f), Scale(1.0f), Mass(1.0f)
+	{}
+
+	ObjectType	Type;
+	string		Source;
+	string		Name;
+	Vector3		Position;
+	Vector3		Extent;
+	Color		CubeColor;
+	float		Scale;
+	float		Mass;
 };
 
-WorldBranch::WorldBranch()
+// Parses the scene description only, so loading the objects can fan out right after
+class XmlModelLoader
 {
-	pBroadphase.reset(new btDbvtBroadphase());
-
-	// Set up the collision configuration and dispatcher
-	pCollisionConfiguration.reset(new btDefaultCollisionConfiguration());
-	pDispatcher.reset(new btCollisionDispatcher(pCollisionConfiguration.get()));
+public:
+	static std::vector<SceneObjectDescription> Parse(const tinyxml2::XMLElement* scene)
+	{
+		std::vector<SceneObjectDescription> objects;
+		for (auto node = scene ? scene->FirstChildElement() : nullptr; node; node = node->NextSiblingElement())
+		{
+			SceneObjectDescription object;
+			if (!strcmp(node->Name(), "obj"))
+			{
+				auto path = node->Attribute("src");
+				if (path == nullptr || strlen(path) == 0)
+					continue;
+				object.Type = SceneObjectDescription::Obj;
+				object.Source = path;
+				ParseFloats(node->Attribute("scale"), &object.Scale, 1);
+			}
+			else if (!strcmp(node->Name(), "cube"))
+			{
+				object.Type = SceneObjectDescription::Cube;
+				ParseFloats(node->Attribute("extent"), &object.Extent.x, 3);
+				float color[4] = { 255, 255, 255, 255 };
+				ParseFloats(node->Attribute("color"), color, 4);
+				object.CubeColor = Color(color[0], color[1], color[2], color[3]).ToVector4() / 255;
+				object.CubeColor.Saturate();
+				auto name = node->Attribute("name");
+				if (name)
+					object.Name = name;
+			}
+			else
+				continue;
 
-	// The actual physics solver
-	pSolver.reset(new btSequentialImpulseConstraintSolver());
-	// The world.
-	pDynamicsWorld.reset(new btDiscreteDynamicsWorld(pDispatcher.get(), pBroadphase.get(), pSolver.get(), pCollisionConfiguration.get()));
-	pDynamicsWorld->setGravity(btVector3(0, -1.0f, 0));
+			ParseFloats(node->Attribute("position"), &object.Position.x, 3);
+			ParseFloats(node->Attribute("mass"), &object.Mass, 1);
+			objects.push_back(object);
+		}
+		return objects;
+	}
 
-	IsEnabled = false;
-}
+private:
+	// Numbers separated by one character each like "1,2,3", values not in attr are left as they are
+	static size_t ParseFloats(const char* attr, float* values, size_t count)
+	{
+		size_t parsed = 0;
+		while (attr && parsed < count)
+		{
+			char* end;
+			float value = strtof(attr, &end);
+			if (end == attr)
+				break;
+			values[parsed++] = value;
+			attr = *end ? end + 1 : nullptr;
+		}
+		return parsed;
+	}
+};
 
 void Causality::WorldScene::LoadAsync(ID3D11Device* pDevice)
 {
@@ -100,9 +150,8 @@ void Causality::WorldScene::LoadAsync(ID3D11Device* pDevice)
 
 	concurrency::task<void> load_models([this, pDevice]() {
 		{
-			lock_guard<mutex> guard(m_RenderLock);
 			WorldBranch::InitializeBranchPool(30);
-			WorldTree = WorldBranch::DemandCreate("Root");
+			auto pTree = WorldBranch::DemandCreate("Root");
 
 			std::vector<AffineTransform> subjectTrans(30);
 			subjectTrans.resize(20);
@@ -111,8 +160,9 @@ void Causality::WorldScene::LoadAsync(ID3D11Device* pDevice)
 				subjectTrans[i].Scale = XMVectorReplicate(1.1f + 0.15f * i);// XMMatrixTranslation(0, 0, i*(-150.f));
 			}
 
-			WorldTree->Fork(subjectTrans);
-			WorldTree->Enable(DirectX::AffineTransform::Identity());
+			pTree->Fork(subjectTrans);
+			pTree->Enable(DirectX::AffineTransform::Identity());
+			WorldSimulation.Start(std::move(pTree));
 		}
 
 		//m_pFramesPool.reset(new WorldBranchPool);
@@ -147,129 +197,51 @@ void Causality::WorldScene::LoadAsync(ID3D11Device* pDevice)
 
 		//pBackground = std::make_unique<SkyDome>(pDevice, SkyBoxTextures);
 
+		// Read the whole description first, then load every object on its own task and publish it as soon as it's ready
 		auto sceneFile = Directory / "Foregrounds.xml";
 		tinyxml2::XMLDocument sceneDoc;
 		sceneDoc.LoadFile(sceneFile.string().c_str());
-		auto scene = sceneDoc.FirstChildElement("scene");
-		auto node = scene->FirstChildElement();
-		while (node)
+		auto objects = XmlModelLoader::Parse(sceneDoc.FirstChildElement("scene"));
+
+		std::vector<concurrency::task<void>> loads;
+		for (const auto& object : objects)
 		{
-			if (!strcmp(node->Name(), "obj"))
+			if (object.Type == SceneObjectDescription::Cube)
 			{
-				auto path = node->Attribute("src");
-				if (path != nullptr && strlen(path) != 0)
+				// Nothing to load
+				auto pModel = make_shared<CubeModel>(object.Name, object.Extent, (XMVECTOR) object.CubeColor);
+				AddObject(pModel, object.Mass, object.Position, DirectX::Quaternion::Identity, DirectX::Vector3::One);
+				continue;
+			}
+
+			auto modelFile = (ModelDirectory / object.Source).wstring();
+			loads.push_back(concurrency::create_task([this, pDevice, object, modelFile, texDir]() {
+				try
 				{
 					auto pModel = std::make_shared<ShapedGeomrtricModel>();
-					GeometryModel::CreateFromObjFile(pModel.get(), pDevice, (ModelDirectory / path).wstring(), texDir);
-
-					XMFLOAT3 v = pModel->BoundOrientedBox.Extents;
-					v.y /= v.x;
-					v.z /= v.x;
-					m_ModelFeatures[pModel->Name] = Eigen::Vector2f(v.y, v.z);
-					std::cout << "[Model] f(" << pModel->Name << ") = " << m_ModelFeatures[pModel->Name] << std::endl;
-
-					float scale = 1.0f;
-					float mass = 1.0f;
-					Vector3 pos;
-
-					auto attr = node->Attribute("scale");
-					if (attr != nullptr)
+					if (!GeometryModel::CreateFromObjFile(pModel.get(), pDevice, modelFile, texDir, ModelLoad_OptimizeVertexCache | ModelLoad_OptimizeOverdraw | ModelLoad_GenerateLods | ModelLoad_GenerateTangents))
 					{
-						stringstream ss(attr);
-
-						ss >> scale;
-						//model->SetScale(XMVectorReplicate(scale));
+						LOG_ERROR(Log_Loading, "Failed to parse model %s", object.Source.c_str());
+						return;
 					}
-					attr = node->Attribute("position");
-					if (attr != nullptr)
-					{
-						stringstream ss(attr);
-
-						char ch;
-						ss >> pos.x >> ch >> pos.y >> ch >> pos.z;
-						//model->SetPosition(pos);
-					}
-
-					attr = node->Attribute("mass");
-					if (attr)
-						mass = (float) atof(attr);
-
-					AddObject(pModel, mass, pos, DirectX::Quaternion::Identity, DirectX::Vector3(scale));
-
-					//auto pShape = model->CreateCollisionShape();
-					//pShape->setLocalScaling(btVector3(scale, scale, scale));
-					//btVector3 minb, maxb;
-					//model->InitializePhysics(pDynamicsWorld, pShape, mass, pos, XMQuaternionIdentity());
-					//model->GetBulletRigid()->setFriction(1.0f);
-					//{
-					//	std::lock_guard<mutex> guard(m_RenderLock);
-					//	Models.push_back(model);
-					//}
-				}
-			}
-			else if (!strcmp(node->Name(), "cube"))
-			{
-				Vector3 extent(1.0f);
-				Vector3 pos;
-				Color color(255, 255, 255, 255);
-				string name("cube");
-				float mass = 1.0f;
-				auto attr = node->Attribute("extent");
-				if (attr != nullptr)
-				{
-					stringstream ss(attr);
-					char ch;
-					ss >> extent.x >> ch >> extent.y >> ch >> extent.z;
-				}
-				attr = node->Attribute("position");
-				if (attr != nullptr)
-				{
-					stringstream ss(attr);
-
-					char ch;
-					ss >> pos.x >> ch >> pos.y >> ch >> pos.z;
+					AddObject(pModel, object.Mass, object.Position, DirectX::Quaternion::Identity, DirectX::Vector3(object.Scale));
+					LOG_INFO(Log_Loading, "Model %s loaded, %u vertices", object.Source.c_str(), static_cast<unsigned>(pModel->Vertices.size()));
 				}
-				attr = node->Attribute("color");
-				if (attr != nullptr)
+				catch (...)
 				{
-					stringstream ss(attr);
-
-					char ch;
-					ss >> color.x >> ch >> color.y >> ch >> color.z;
-					if (!ss.eof())
-						ss >> ch >> color.w;
-					color = color.ToVector4() / 255;
-					color.Saturate();
+					LOG_ERROR(Log_Loading, "Failed to load model %s", object.Source.c_str());
 				}
-				attr = node->Attribute("name");
-				if (attr)
-					name = attr;
-
-				attr = node->Attribute("mass");
-				if (attr)
-					mass = (float) atof(attr);
-
-				auto pModel = make_shared<CubeModel>(name, extent, (XMVECTOR) color);
-
-				XMFLOAT3 v = pModel->BoundOrientedBox.Extents;
-				v.y /= v.x;
-				v.z /= v.x;
-				m_ModelFeatures[pModel->Name] = Eigen::Vector2f(v.y, v.z);
-
-				AddObject(pModel, mass, pos, DirectX::Quaternion::Identity, DirectX::Vector3::One);
-				//auto pShape = pModel->CreateCollisionShape();
-				//pModel->InitializePhysics(nullptr, pShape, mass, pos);
-				//pModel->Enable(pDynamicsWorld);
-				//pModel->GetBulletRigid()->setFriction(1.0f);
-				//{
-				//	std::lock_guard<mutex> guard(m_RenderLock);
-				//	Models.push_back(pModel);
-				//}
-			}
-			node = node->NextSiblingElement();
+			}));
 		}
 
-		m_loadingComplete = true;
+		if (loads.empty())
+		{
+			m_loadingComplete = true;
+			return;
+		}
+		concurrency::when_all(loads.begin(), loads.end()).then([this]() {
+			m_loadingComplete = true;
+		});
 	});
 }
 
@@ -289,39 +261,24 @@ void Causality::WorldScene::Render(ID3D11DeviceContext * pContext)
 		pContext->PSSetSamplers(0, 1, &pAWrap);
 		pContext->RSSetState(pRSState.Get());
 		std::lock_guard<mutex> guard(m_RenderLock);
-		
-		BoundingOrientedBox modelBox;
-		using namespace cpplinq;
 
-		// Render models
-		for (const auto& model : Models)
+		// Render models, culled and sorted for every view in UpdateAnimation
+		for (const auto& item : m_DrawList.Items())
 		{
-			auto superposition = ModelStates[model->Name];
-			for (const auto& state : superposition)
-			{
-				auto mat = state.TransformMatrix();
-				model->LocalMatrix = state.TransformMatrix(); //.first->GetRigidTransformMatrix();
-				model->Opticity = state.Probability; //state.second;
-
-				model->BoundOrientedBox.Transform(modelBox, mat);
-				// Render if in the view frustum
-
-				if (ViewFrutum.Contains(modelBox) != ContainmentType::DISJOINT)
-					model->Render(pContext, pEffect.get());
-			}
+			if (!(item.ViewMask & m_ViewMask))
+				continue;
+			const auto& model = Models[item.Id];
+			model->LocalMatrix = item.World;
+			model->Opticity = item.Opacity;
+			model->LodTolerance = m_LodPolicy.Tolerance(item.ScreenSize, Vector3(m_ModelBounds[item.Id].Extents).Length(), item.Opacity);
+			model->Render(pContext, pEffect.get());
 		}
 
-		for (const auto& branch : WorldTree->leaves())
+		// Subjects, as the simulation thread left them
+		for (const auto& capsule : WorldSimulation.Snapshot().Subjects)
 		{
-				//Subjects
-				for (const auto& item : branch.Subjects)
-				{
-					if (item.second)
-					{
-						item.second->Opticity = branch.Liklyhood();
-						item.second->Render(pContext, nullptr);
-					}
-				}
+			XMVECTOR color = XMVectorSetW(Colors::LimeGreen, capsule.Opticity);
+			g_PrimitiveDrawer.DrawCylinder(capsule.Center, capsule.Axis, capsule.Height, capsule.Radius, color);
 		}
 	}
 
@@ -341,13 +298,9 @@ void Causality::WorldScene::Render(ID3D11DeviceContext * pContext)
 		//g_PrimitiveDrawer.DrawQuad({ 1.0f,0,1.0f }, { -1.0f,0,1.0f }, { -1.0f,0,-1.0f }, { 1.0f,0,-1.0f }, Colors::Pink);
 
 
-		auto& fh = m_HandDescriptionFeature;
-
 		{
 			std::lock_guard<mutex> guard(m_RenderLock);
 			auto s = Models.size();
-			if (m_HaveHands)
-				std::cout << "Detail Similarity = {";
 			for (size_t i = 0; i < s; i++)
 			{
 				const auto& model = Models[i];
@@ -355,15 +308,13 @@ void Causality::WorldScene::Render(ID3D11DeviceContext * pContext)
 				if (ViewFrutum.Contains(obox) != ContainmentType::DISJOINT)
 				{
 					obox.GetCorners(conners);
-					DrawBox(conners, DirectX::Colors::DarkGreen);
+					bool bestMatch = m_HaveHands && !m_TopMatches.empty() && m_TopMatches.front().Id == i;
+					DrawBox(conners, bestMatch ? DirectX::Colors::Yellow : DirectX::Colors::DarkGreen);
 				}
-				if (m_HaveHands)
+				if (m_HaveHands && i < m_ModelSimilarity.size())
 				{
-					auto fm = m_ModelFeatures[model->Name];
-
-					auto similarity = ShapeSimiliarity(fm, fh);
-					m_ModelDetailSimilarity[model->Name] = similarity;
-					std::cout << model->Name << ':' << similarity << " , ";
+					// Ranked in UpdateAnimation once per hand update
+					auto similarity = m_ModelSimilarity[i];
 					Color c = Color::Lerp({ 1,0,0 }, { 0,1,0 }, similarity);
 					for (size_t i = 0; i < 8; i++)
 					{
@@ -386,8 +337,6 @@ void Causality::WorldScene::Render(ID3D11DeviceContext * pContext)
 				}
 			}
 		}
-		if (m_HaveHands)
-			std::cout << '}' << std::endl;
 	}
 
 	if (m_HaveHands)
@@ -404,7 +353,7 @@ void Causality::WorldScene::Render(ID3D11DeviceContext * pContext)
 		std::lock_guard<mutex> guard(m_HandFrameMutex);
 		for (const auto& hand : m_Frame.hands())
 		{
-			auto palmPosition = XMVector3Transform(hand.palmPosition().toVector3<Vector3>(), leap2world);
+			auto palmPosition = XMVector3Transform(XMLoadFloat3(&hand.PalmPosition), leap2world);
 			g_PrimitiveDrawer.DrawSphere(palmPosition, 0.02f, Colors::YellowGreen);
 			//for (const auto& finger : hand.fingers())
 			//{
@@ -508,6 +457,14 @@ void Causality::WorldScene::DrawBox(DirectX::SimpleMath::Vector3  conners [], Di
 
 }
 
+// World space frustum of a right-handed view and projection
+static void XM_CALLCONV CreateViewFrustum(BoundingFrustum& frustum, FXMMATRIX view, CXMMATRIX projection)
+{
+	BoundingFrustumExtension::CreateFromMatrixRH(frustum, projection);
+	XMVECTOR det;
+	frustum.Transform(frustum, XMMatrixInverse(&det, view));
+}
+
 void XM_CALLCONV Causality::WorldScene::UpdateViewMatrix(DirectX::FXMMATRIX view, DirectX::CXMMATRIX projection)
 {
 	if (pEffect)
@@ -521,6 +478,25 @@ void XM_CALLCONV Causality::WorldScene::UpdateViewMatrix(DirectX::FXMMATRIX view
 	}
 	g_PrimitiveDrawer.SetView(view);
 	g_PrimitiveDrawer.SetProjection( projection);
+
+	// Find which of the camera views is rendered, the draw list is culled per camera view in UpdateAnimation
+	// A view matrix that is none of them draws what any view sees
+	m_ViewMask = ~0U;
+	auto pCamera = dynamic_cast<const ICameraBase*>(m_pCameraLocation);
+	if (pCamera)
+	{
+		auto viewCount = std::min<size_t>(pCamera->ViewCount(), DrawListBuilder::MaxViews);
+		for (size_t i = 0; i < viewCount; i++)
+		{
+			XMMATRIX cameraView = pCamera->GetViewMatrix(i);
+			if (XMVector4Equal(cameraView.r[0], view.r[0]) && XMVector4Equal(cameraView.r[1], view.r[1])
+				&& XMVector4Equal(cameraView.r[2], view.r[2]) && XMVector4Equal(cameraView.r[3], view.r[3]))
+			{
+				m_ViewMask = 1U << i;
+				break;
+			}
+		}
+	}
 	
 	// BoundingFrustum is assumpt Left-Handed
 	BoundingFrustumExtension::CreateFromMatrixRH(ViewFrutum, projection);
@@ -567,33 +543,47 @@ void XM_CALLCONV Causality::WorldScene::UpdateViewMatrix(DirectX::FXMMATRIX view
 
 void Causality::WorldScene::UpdateAnimation(StepTimer const & timer)
 {
+	// Physics steps on its own thread, pick up its latest result for this frame's views
+	WorldSimulation.AcquireSnapshot();
+	SimulationThread::Interpolate(WorldSimulation.Snapshot(), WorldSimulation.StepTime(), ModelStates);
+
+	// Cull for every view of the camera at once, so stereo views share one draw list
 	{
-		lock_guard<mutex> guard(m_RenderLock);
-		using namespace cpplinq;
-		using namespace std::placeholders;
-		float stepTime = (float) timer.GetElapsedSeconds();
-		WorldTree->Evolution(stepTime, m_Frame, m_FrameTransform);
-		ModelStates = WorldTree->CaculateSuperposition();
+		BoundingFrustum frustums[DrawListBuilder::MaxViews];
+		size_t viewCount = 1;
+		auto pCamera = dynamic_cast<const ICameraBase*>(m_pCameraLocation);
+		if (pCamera)
+		{
+			viewCount = std::min<size_t>(pCamera->ViewCount(), DrawListBuilder::MaxViews);
+			for (size_t view = 0; view < viewCount; view++)
+				CreateViewFrustum(frustums[view], pCamera->GetViewMatrix(view), pCamera->GetProjectionMatrix(view));
+		}
+		else
+			frustums[0] = ViewFrutum;
+
+		std::lock_guard<mutex> guard(m_RenderLock);
+		m_DrawList.SetViews(frustums, viewCount);
+		m_DrawList.Build(ModelStates, m_ModelBounds.data(), m_ModelBatchKeys.data(), m_ModelBounds.size());
 	}
 
-	if (m_HandTrace.size() > 0)
-	{
-		{ // Critia section
-			std::lock_guard<mutex> guard(m_HandFrameMutex);
-			const int plotSize = 45;
-			BoundingOrientedBox::CreateFromPoints(m_CurrentHandBoundingBox, m_HandTrace.back().size(), m_HandTrace.back().data(), sizeof(Vector3));
-			m_TracePoints.clear();
-			Color color = Colors::LimeGreen;
-			for (int i = m_HandTrace.size() - 1; i >= std::max(0, (int) m_HandTrace.size() - plotSize); i--)
-			{
-				const auto& h = m_HandTrace[i];
-				//float radius = (i + 1 - std::max(0U, m_HandTrace.size() - plotSize)) / (std::min<float>(m_HandTrace.size(), plotSize));
-				for (size_t j = 0; j < h.size(); j++)
-				{
-					//g_PrimitiveDrawer.DrawSphere(h[j], 0.005 * radius, color);
-					m_TracePoints.push_back(h[j]);
-				}
-			}
+	uint64_t traceVersion = m_RankedTraceVersion;
+	{ // Critia section
+		std::lock_guard<mutex> guard(m_HandFrameMutex);
+		// Checked under the lock, OnHandsTrackLost clears the trace from the device thread
+		if (m_HandTrace.size() > 0)
+		{
+			traceVersion = m_HandTraceVersion;
+			const auto& joints = m_HandTrace.back();
+			BoundingOrientedBox::CreateFromPoints(m_CurrentHandBoundingBox, joints.size(), joints.data(), sizeof(Vector3));
+			// The estimator follows the trace window in OnHandsMove, so this doesn't depend on the window length
+			m_HandTraceBoxEstimator.GetBox(m_HandTraceBoundingBox);
+
+			// The bones of the newest hand are the parts of the hand's shape
+			float boneSizes[HandState::FingerCount * HandState::BonePerFinger];
+			for (int f = 0; f < HandState::FingerCount; f++)
+				for (int b = 0; b < HandState::BonePerFinger; b++)
+					boneSizes[f * HandState::BonePerFinger + b] = 0.5f * Vector3::Distance(joints[f * 5 + b], joints[f * 5 + b + 1]);
+			m_HandDescriptor = ShapeDescriptor::Create(m_HandTraceBoundingBox.Extents, boneSizes, std::extent<decltype(boneSizes)>::value);
 			//for (const auto& pModel : Children)
 			//{
 			//	//btCollisionWorld::RayResultCallback
@@ -603,45 +593,47 @@ void Causality::WorldScene::UpdateAnimation(StepTimer const & timer)
 			//auto pBat = dynamic_cast<PhysicalGeometryModel*>(Children[0].get());
 			//pBat->SetPosition(vector_cast<Vector3>(m_Frame.hands().frontmost().palmPosition()));
 		}
-		CreateBoundingOrientedBoxFromPoints(m_HandTraceBoundingBox, m_TracePoints.size(), m_TracePoints.data(), sizeof(Vector3));
-		XMFLOAT3 v = m_HandTraceBoundingBox.Extents;
-		m_HandDescriptionFeature = Eigen::Vector2f(v.y / v.x, v.z / v.x);
+	}
 
-		// ASSUMPTION: Extends is sorted from!
+	if (traceVersion != m_RankedTraceVersion)
+	{
+		std::lock_guard<mutex> guard(m_RenderLock);
+		m_ShapeIndex.Query(m_HandDescriptor, TopMatchCount, m_ModelSimilarity, m_TopMatches);
+		m_RankedTraceVersion = traceVersion;
+	}
 
 
-		//XMMATRIX invTrans = XMMatrixAffineTransformation(g_XMOne / XMVectorReplicate(m_HandTraceBoundingBox.Extents.x), XMVectorZero(), XMQuaternionInverse(XMLoadFloat4(&m_HandTraceBoundingBox.Orientation)), -XMLoadFloat3(&m_HandTraceBoundingBox.Center));
-		//int sampleCount = std::min<int>(m_TraceSamples.size(), TraceLength)*m_TraceSamples[0].size();
-		//for (const auto& model : Children)
-		//{
-		//	auto pModel = dynamic_cast<Model*>(model.get());
-		//	auto inCount = 0;
-		//	if (pModel)
-		//	{
-		//		auto obox = model->GetOrientedBoundingBox();
-		//		XMMATRIX fowTrans = XMMatrixAffineTransformation(XMVectorReplicate(obox.Extents.x), XMVectorZero(), XMQuaternionIdentity(), XMVectorZero());
-		//		fowTrans = invTrans * fowTrans;
-		//		auto pSample = m_TraceSamples.back().data() + m_TraceSamples.back().size()-1;
-		//		for (size_t i = 0; i < sampleCount; i++)
-		//		{
-		//			const auto& point = pSample[-i];
-		//			XMVECTOR p = XMVector3Transform(point, fowTrans);
-		//			int j;
-		//			for ( j = 0; j < pModel->Parts.size(); j++)
-		//			{
-		//				if (pModel->Parts[j].BoundOrientedBox.Contains(p))
-		//					break;
-		//			}
-		//			if (j >= pModel->Parts.size())
-		//				inCount++;
-		//		}
-		//	}
-		//	m_ModelDetailSimilarity[model->Name] = (float) inCount / (float)sampleCount;
-		//}
+	//XMMATRIX invTrans = XMMatrixAffineTransformation(g_XMOne / XMVectorReplicate(m_HandTraceBoundingBox.Extents.x), XMVectorZero(), XMQuaternionInverse(XMLoadFloat4(&m_HandTraceBoundingBox.Orientation)), -XMLoadFloat3(&m_HandTraceBoundingBox.Center));
+	//int sampleCount = std::min<int>(m_TraceSamples.size(), TraceLength)*m_TraceSamples[0].size();
+	//for (const auto& model : Children)
+	//{
+	//	auto pModel = dynamic_cast<Model*>(model.get());
+	//	auto inCount = 0;
+	//	if (pModel)
+	//	{
+	//		auto obox = model->GetOrientedBoundingBox();
+	//		XMMATRIX fowTrans = XMMatrixAffineTransformation(XMVectorReplicate(obox.Extents.x), XMVectorZero(), XMQuaternionIdentity(), XMVectorZero());
+	//		fowTrans = invTrans * fowTrans;
+	//		auto pSample = m_TraceSamples.back().data() + m_TraceSamples.back().size()-1;
+	//		for (size_t i = 0; i < sampleCount; i++)
+	//		{
+	//			const auto& point = pSample[-i];
+	//			XMVECTOR p = XMVector3Transform(point, fowTrans);
+	//			int j;
+	//			for ( j = 0; j < pModel->Parts.size(); j++)
+	//			{
+	//				if (pModel->Parts[j].BoundOrientedBox.Contains(p))
+	//					break;
+	//			}
+	//			if (j >= pModel->Parts.size())
+	//				inCount++;
+	//		}
+	//	}
+	//	m_ModelDetailSimilarity[model->Name] = (float) inCount / (float)sampleCount;
+	//}
 
 
 
-	}
 
 	//if (pGroundRigid)
 	//	pGroundRigid->setLinearVelocity({ 0,-1.0f,0 });
@@ -700,33 +692,17 @@ void Causality::WorldScene::OnHandsTracked(const UserHandsEventArgs & e)
 	//	}
 	//}
 
-	m_Frame = e.sender.frame();
-	for (auto& branch : WorldTree->leaves())
-	{
-		for (const auto& hand : m_Frame.hands())
+	m_Frame = e.frame;
+	WorldSimulation.SetHands(e.frame, e.toWorldTransform);
+	HandFrame frame = e.frame;
+	Matrix4x4 toWorld = e.toWorldTransform;
+	WorldSimulation.Post([frame, toWorld](WorldBranch& tree) {
+		for (auto& branch : tree.leaves())
 		{
-			auto & subjects = branch.Subjects;
-			branch.AddSubjectiveObject(hand,e.toWorldTransform);
-			//if (!subjects[hand.id()])
-			//{
-			//	subjects[hand.id()].reset(
-			//		new HandPhysicalModel(
-			//		pFrame->pDynamicsWorld,
-			//		hand, e.toWorldTransform,
-			//		pFrame->SubjectTransform)
-			//		);
-			//	//for (const auto& itm : pFrame->Objects)
-			//	//{
-			//	//	const auto& pObj = itm.second;
-			//	//	if (!pObj->GetBulletRigid()->isStaticOrKinematicObject())
-			//	//	{
-			//	//		for (const auto& bone : subjects[hand.id()]->Rigids())
-			//	//			pObj->GetBulletRigid()->setIgnoreCollisionCheck(bone.get(), false);
-			//	//	}
-			//	//}
-			//}
+			for (const auto& hand : frame.hands())
+				branch.AddSubjectiveObject(hand, toWorld);
 		}
-	}
+	});
 
 	//for (size_t j = 0; j < i; j++)
 	//{
@@ -737,15 +713,15 @@ void Causality::WorldScene::OnHandsTracked(const UserHandsEventArgs & e)
 
 void Causality::WorldScene::OnHandsTrackLost(const UserHandsEventArgs & e)
 {
-	m_Frame = e.sender.frame();
+	m_Frame = e.frame;
 	m_FrameTransform = e.toWorldTransform;
-	if (m_Frame.hands().count() == 0)
+	WorldSimulation.SetHands(e.frame, e.toWorldTransform);
+	if (m_Frame.HandCount == 0)
 	{
 		m_HaveHands = false;
 		std::lock_guard<mutex> guard(m_HandFrameMutex);
 		m_HandTrace.clear();
-		m_TraceSamples.clear();
-		WorldTree->Collapse();
+		m_HandTraceBoxEstimator.Clear();
 		//for (const auto &pRigid : m_HandRigids)
 		//{
 		//	pDynamicsWorld->removeRigidBody(pRigid->GetBulletRigid());
@@ -756,8 +732,9 @@ void Causality::WorldScene::OnHandsTrackLost(const UserHandsEventArgs & e)
 void Causality::WorldScene::OnHandsMove(const UserHandsEventArgs & e)
 {
 	std::lock_guard<mutex> guard(m_HandFrameMutex);
-	m_Frame = e.sender.frame();
+	m_Frame = e.frame;
 	m_FrameTransform = e.toWorldTransform;
+	WorldSimulation.SetHands(e.frame, e.toWorldTransform);
 	XMMATRIX leap2world = m_FrameTransform;
 	//std::array<DirectX::Vector3, 25> joints;
 	std::vector<DirectX::BoundingOrientedBox> handBoxes;
@@ -771,19 +748,18 @@ void Causality::WorldScene::OnHandsMove(const UserHandsEventArgs & e)
 	int handIdx = 0;
 	for (const auto& hand : m_Frame.hands())
 	{
-		int fingerIdx = 0; // hand idx
-		m_HandTrace.emplace_back();
-		m_TraceSamples.emplace_back();
-		auto& samples = m_TraceSamples.back();
-		auto& joints = m_HandTrace.back();
-		for (const auto& finger : hand.fingers())
+		// The oldest joints leave the window as the new ones enter
+		if (m_HandTrace.full())
+			m_HandTraceBoxEstimator.Remove(m_HandTrace.front().data(), m_HandTrace.front().size());
+		auto& joints = m_HandTrace.push_back();
+		for (int fingerIdx = 0; fingerIdx < HandState::FingerCount; fingerIdx++)
 		{
-			XMVECTOR bJ = XMVector3Transform(finger.bone((Leap::Bone::Type)0).prevJoint().toVector3<Vector3>(), leap2world);
+			XMVECTOR bJ = XMVector3Transform(XMLoadFloat3(&hand.Bone(fingerIdx, 0).PrevJoint), leap2world);
 			joints[fingerIdx * 5] = bJ;
 			for (size_t boneIdx = 0; boneIdx < 4; boneIdx++) // bone idx
 			{
-				const auto & bone = finger.bone((Leap::Bone::Type)boneIdx);
-				XMVECTOR eJ = XMVector3Transform(bone.nextJoint().toVector3<Vector3>(), leap2world);
+				const auto & bone = hand.Bone(fingerIdx, boneIdx);
+				XMVECTOR eJ = XMVector3Transform(XMLoadFloat3(&bone.NextJoint), leap2world);
 				joints[fingerIdx * 5 + boneIdx + 1] = eJ;
 
 
@@ -804,14 +780,10 @@ void Causality::WorldScene::OnHandsMove(const UserHandsEventArgs & e)
 				//	samples[(fingerIdx * 4 + boneIdx) * 100 + k] = disp;
 				//}
 			}
-			fingerIdx++;
 		}
 		handIdx++;
-		while (m_HandTrace.size() > 60)
-		{
-			m_HandTrace.pop_front();
-			//m_TraceSamples.pop_front();
-		}
+		m_HandTraceBoxEstimator.Add(joints.data(), joints.size());
+		++m_HandTraceVersion;
 
 		// Cone intersection test section
 		//Vector3 rayEnd = XMVector3Transform(hand.palmPosition().toVector3<Vector3>(), leap2world);
@@ -881,7 +853,7 @@ void Causality::WorldScene::OnHandsMove(const UserHandsEventArgs & e)
 	//}
 
 
-	std::cout << "[Leap] Hands Move." << std::endl;
+	LOG_TRACE(Log_Device, "[Leap] Hands Move.");
 }
 
 void Causality::WorldScene::OnKeyDown(const KeyboardEventArgs & e)
@@ -894,15 +866,48 @@ void Causality::WorldScene::OnKeyUp(const KeyboardEventArgs & e)
 		m_showTrace = !m_showTrace;
 }
 
-void Causality::WorldScene::AddObject(const std::shared_ptr<IModelNode>& pModel, float mass, const DirectX::Vector3 & Position, const DirectX::Quaternion & Orientation, const Vector3 & Scale)
+// Extent ratios of the model's box and the sizes of its parts' boxes
+static ShapeDescriptor DescribeShape(const IModelNode& model)
+{
+	std::vector<float> partSizes;
+	auto pModel = dynamic_cast<const BasicModel*>(&model);
+	if (pModel)
+	{
+		for (const auto& part : pModel->Parts)
+		{
+			const auto& extents = part->BoundOrientedBox.Extents;
+			partSizes.push_back(std::max(extents.x, std::max(extents.y, extents.z)));
+		}
+	}
+	return ShapeDescriptor::Create(model.BoundOrientedBox.Extents, partSizes.data(), partSizes.size());
+}
+
+// Models sharing the mesh and material of their first part share a key, others get one of their own
+uint32_t Causality::WorldScene::BatchKey(const IModelNode & model)
+{
+	std::pair<const void*, const void*> batch(&model, nullptr);
+	auto pModel = dynamic_cast<const BasicModel*>(&model);
+	if (pModel && !pModel->Parts.empty())
+		batch = std::make_pair(pModel->Parts.front()->pMesh.get(), pModel->Parts.front()->pMaterial.get());
+	auto result = m_BatchKeys.insert(std::make_pair(batch, static_cast<uint32_t>(m_BatchKeys.size())));
+	return result.first->second;
+}
+
+unsigned Causality::WorldScene::AddObject(const std::shared_ptr<IModelNode>& pModel, float mass, const DirectX::Vector3 & Position, const DirectX::Quaternion & Orientation, const Vector3 & Scale)
 {
 	lock_guard<mutex> guard(m_RenderLock);
+	unsigned id = Models.size();
 	Models.push_back(pModel);
+	m_ShapeIndex.Add(id, DescribeShape(*pModel));
+	m_ModelBounds.push_back(pModel->BoundOrientedBox);
+	m_ModelBatchKeys.push_back(BatchKey(*pModel));
 	auto pShaped = dynamic_cast<IShaped*>(pModel.get());
 	auto pShape = pShaped->CreateCollisionShape();
 	pShape->setLocalScaling(vector_cast<btVector3>(Scale));
 
-	WorldTree->AddDynamicObject(pModel->Name, pShape, mass, Position, Orientation);
+	WorldSimulation.Post([id, pShape, mass, Position, Orientation](WorldBranch& tree) {
+		tree.AddDynamicObject(id, pShape, mass, Position, Orientation);
+	});
 	//for (const auto& pFrame : m_StateFrames)
 	//{
 	//	auto pObject = std::shared_ptr<PhysicalRigid>(new PhysicalRigid());
@@ -912,304 +917,9 @@ void Causality::WorldScene::AddObject(const std::shared_ptr<IModelNode>& pModel,
 	//	pObject->GetBulletRigid()->setRestitution(0.0);
 	//	pFrame->Objects[pModel->Name] = pObject;
 	//}
+	return id;
 }
 
-std::pair<DirectX::Vector3, DirectX::Quaternion> XM_CALLCONV CaculateCylinderTransform(FXMVECTOR P1, FXMVECTOR P2)
-{
-	std::pair<DirectX::Vector3, DirectX::Quaternion> trans;
-	auto center = XMVectorAdd(P1, P2);
-	center = XMVectorMultiply(center, g_XMOneHalf);
-	auto dir = XMVectorSubtract(P1, P2);
-	auto scale = XMVector3Length(dir);
-	XMVECTOR rot;
-	if (XMVector4Equal(dir, g_XMZero))
-		rot = XMQuaternionIdentity();
-	else
-		rot = XMQuaternionRotationVectorToVector(g_XMIdentityR1.v, dir);
-	trans.first = center;
-	trans.second = rot;
-	return trans;
-}
-
-XMMATRIX Causality::HandPhysicalModel::CaculateLocalMatrix(const Leap::Hand & hand, const DirectX::Matrix4x4 & leapTransform)
-{
-	XMVECTOR palmCenter = hand.palmPosition().toVector3<Vector3>();
-	return XMMatrixScalingFromCenter(m_InheritTransform.Scale, palmCenter) * ((RigidTransform&) m_InheritTransform).TransformMatrix() * (XMMATRIX) leapTransform;
-
-}
-
-
-Causality::HandPhysicalModel::HandPhysicalModel
-(const std::shared_ptr<btDynamicsWorld> &pWorld,
-const Leap::Hand & hand, const DirectX::Matrix4x4 & leapTransform,
-const DirectX::AffineTransform &inheritTransform)
-: m_Hand(hand)
-{
-	Id = hand.id();
-	m_InheritTransform = inheritTransform;
-
-	LocalMatrix = CaculateLocalMatrix(hand, leapTransform);
-	XMMATRIX leap2world = LocalMatrix;
-	int j = 0;
-	for (const auto& finger : m_Hand.fingers())
-	{
-		for (size_t i = 0; i < 4; i++)
-		{
-			const auto & bone = finger.bone((Leap::Bone::Type)i);
-			XMVECTOR bJ = XMVector3Transform(bone.prevJoint().toVector3<Vector3>(), leap2world);
-			XMVECTOR eJ = XMVector3Transform(bone.nextJoint().toVector3<Vector3>(), leap2world);
-			m_Bones[i + j * 4].first = bJ;
-			m_Bones[i + j * 4].second = eJ;
-
-			// Initalize rigid hand model
-			auto center = 0.5f * XMVectorAdd(bJ, eJ);
-			auto dir = XMVectorSubtract(eJ, bJ);
-			auto height = std::max(XMVectorGetX(XMVector3Length(dir)), fingerLength);
-			XMVECTOR rot;
-			if (XMVector4Equal(dir, g_XMZero))
-				rot = XMQuaternionIdentity();
-			else
-				rot = XMQuaternionRotationVectorToVector(g_XMIdentityR1, dir);
-			shared_ptr<btCapsuleShape> pShape(new btCapsuleShape(fingerRadius, height));
-
-			// Scaling in Y axis is encapsled in bJ and eJ
-			btVector3 scl = vector_cast<btVector3>(m_InheritTransform.Scale);
-			scl.setY(1.0f);
-			pShape->setLocalScaling(scl);
-
-			m_HandRigids.emplace_back(new PhysicalRigid());
-			const auto & pRigid = m_HandRigids.back();
-			//pRigid->GetBulletRigid()->setGravity({ 0,0,0 });
-			pRigid->InitializePhysics(nullptr, pShape, 0, center, rot);
-			const auto& body = pRigid->GetBulletRigid();
-			body->setFriction(1.0f);
-			body->setRestitution(0.0f);
-			body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
-			body->setActivationState(DISABLE_DEACTIVATION);
-			//body->setAngularFactor(0.0f); // Rotation Along Y not affact
-
-			pRigid->Enable(pWorld);
-		}
-	}
-
-	//for (size_t i = 0; i < m_HandRigids.size(); i++)
-	//{
-	//	for (size_t j = 0; j < m_HandRigids.size(); j++)
-	//	{
-	//		if (i != j)
-	//			m_HandRigids[i]->GetBulletRigid()->setIgnoreCollisionCheck(m_HandRigids[j]->GetBulletRigid(), true);
-	//	}
-	//}
-
-}
-
-bool Causality::HandPhysicalModel::Update(const Leap::Frame & frame, const DirectX::Matrix4x4 & leapTransform)
-{
-	m_Hand = frame.hand(Id);
-
-	if (m_Hand.isValid())
-	{
-		XMMATRIX transform = CaculateLocalMatrix(m_Hand, leapTransform);
-		LocalMatrix = transform;
-
-		LostFrames = 0;
-		int j = 0;
-		for (const auto& finger : m_Hand.fingers())
-		{
-			for (size_t i = 0; i < 4; i++)
-			{
-				const auto & bone = finger.bone((Leap::Bone::Type)i);
-				XMVECTOR bJ = XMVector3Transform(bone.prevJoint().toVector3<Vector3>(), transform);
-				XMVECTOR eJ = XMVector3Transform(bone.nextJoint().toVector3<Vector3>(), transform);
-				m_Bones[i + j * 4].first = bJ;
-				m_Bones[i + j * 4].second = eJ;
-
-				// Rigid hand model
-
-				auto & pRigid = m_HandRigids[i + j * 4];
-				if (!pRigid->IsEnabled())
-					pRigid->Enable();
-				auto center = 0.5f * XMVectorAdd(bJ, eJ);
-				auto dir = XMVectorSubtract(eJ, bJ);
-				XMVECTOR rot;
-				if (XMVector4Equal(dir, g_XMZero))
-					rot = XMQuaternionIdentity();
-				else
-					rot = XMQuaternionRotationVectorToVector(g_XMIdentityR1, dir);
-				auto trans = btTransform(vector_cast<btQuaternion>(rot), vector_cast<btVector3>(center));
-				pRigid->GetBulletRigid()->getMotionState()->setWorldTransform(trans);
-			}
-			j++;
-		}
-		return true;
-	}
-	else
-	{
-		for (auto& pRigid : m_HandRigids)
-		{
-			pRigid->Disable();
-		}
-		LostFrames++;
-		return false;
-	}
-}
-
-// Inherited via IModelNode
-
-void Causality::HandPhysicalModel::Render(ID3D11DeviceContext * pContext, DirectX::IEffect * pEffect)
-{
-	XMMATRIX leap2world = LocalMatrix;
-	//auto palmPosition = XMVector3Transform(m_Hand.palmPosition().toVector3<Vector3>(), leap2world);
-	//g_PrimitiveDrawer.DrawSphere(palmPosition, 0.02f, Colors::YellowGreen);
-	XMVECTOR color = Colors::LimeGreen;
-	color = XMVectorSetW(color, Opticity);
-
-	//g_PrimitiveDrawer.Begin();
-	//for (const auto& bone : m_Bones)
-	//{
-	//	//g_PrimitiveDrawer.DrawSphere(bone.second, fingerRadius, jC);
-	//	g_PrimitiveDrawer.DrawCylinder(bone.first, bone.second, fingerRadius * m_InheritTransform.Scale.x, color);
-	//}
-	//g_PrimitiveDrawer.End();
-
-	for (const auto& pRigid : m_HandRigids)
-	{
-		g_PrimitiveDrawer.DrawCylinder(
-			pRigid->GetPosition(),
-			XMVector3Rotate(g_XMIdentityR1, pRigid->GetOrientation()),
-			dynamic_cast<btCapsuleShape*>(pRigid->GetBulletShape())->getHalfHeight() * 2,
-			fingerRadius * m_InheritTransform.Scale.x,
-			color);
-	}
-
-	//for (const auto& finger : m_Hand.fingers())
-	//{
-	//	for (size_t i = 0; i < 4; i++)
-	//	{
-	//		const auto & bone = finger.bone((Leap::Bone::Type)i);
-	//		XMVECTOR bJ = XMVector3Transform(bone.prevJoint().toVector3<Vector3>(), leap2world);
-	//		XMVECTOR eJ = XMVector3Transform(bone.nextJoint().toVector3<Vector3>(), leap2world);
-	//		//g_PrimitiveDrawer.DrawLine(bJ, eJ, Colors::LimeGreen);
-	//		//g_PrimitiveDrawer.DrawCube(bJ, g_XMOne * 0.03, g_XMIdentityR3, Colors::Red);
-	//		g_PrimitiveDrawer.DrawCylinder(bJ, eJ,0.015f,Colors::LimeGreen);
-
-	//		//auto center = 0.5f * XMVectorAdd(bJ, eJ);
-	//		//auto dir = XMVectorSubtract(eJ, bJ);
-	//		//auto scale = XMVector3Length(dir);
-	//		//XMVECTOR rot;
-	//		//if (XMVector4LessOrEqual(XMVector3LengthSq(dir), XMVectorReplicate(0.01f)))
-	//		//	rot = XMQuaternionIdentity();
-	//		//else
-	//		//	rot = XMQuaternionRotationVectorToVector(g_XMIdentityR1, dir);
-	//		//XMMATRIX world = XMMatrixAffineTransformation(scale, g_XMZero, rot, center);
-	//		//s_pCylinder->Draw(world, ViewMatrix, ProjectionMatrix,Colors::LimeGreen);
-	//	}
-	//}
-}
-
-inline void debug_assert(bool condition)
-{
-#ifdef DEBUG
-	if (!condition)
-	{
-		_CrtDbgBreak();
-		//std::cout << "assert failed." << std::endl;
-	}
-#endif
-}
-
-// normalized feild intensity equalent charge
-XMVECTOR XM_CALLCONV FieldSegmentToPoint(FXMVECTOR P, FXMVECTOR L0, FXMVECTOR L1)
-{
-	if (XMVector4NearEqual(L0, L1, XMVectorReplicate(0.001f)))
-	{
-		XMVECTOR v = XMVectorAdd(L0, L1);
-		v = XMVectorMultiply(v, g_XMOneHalf);
-		v = XMVectorSubtract(v, P);
-		XMVECTOR d = XMVector3LengthSq(v);
-		v = XMVector3Normalize(v);
-		v /= d;
-		return v;
-	}
-
-	XMVECTOR s = XMVectorSubtract(L1, L0);
-	XMVECTOR v0 = XMVectorSubtract(L0, P);
-	XMVECTOR v1 = XMVectorSubtract(L1, P);
-
-	XMMATRIX Rot;
-	Rot.r[1] = XMVector3Normalize(s);
-	Rot.r[2] = XMVector3Cross(v0, v1);
-	Rot.r[2] = XMVector3Normalize(Rot.r[2]);
-	Rot.r[0] = XMVector3Cross(Rot.r[1], Rot.r[2]);
-	Rot.r[3] = g_XMIdentityR3;
-
-	// Rotated to standard question:
-	//  Y
-	//  ^     *y1
-	//  |     |
-	//--o-----|x0----->X
-	//  |     |
-	//	|     |
-	//	      *y0
-	// Close form solution of the intergral : f(y0,y1) = <-y/(x0*sqrt(x0^2+y^2)),1/sqrt(x0^2+y^2),0> | (y0,y1)
-	XMVECTOR Ds = XMVector3ReciprocalLength(s);
-	XMVECTOR Ps = XMVector3Dot(v0, s);
-	XMVECTOR Y0 = XMVectorMultiply(Ps, Ds);
-
-	Ps = XMVector3Dot(v1, s);
-	XMVECTOR Y1 = XMVectorMultiply(Ps, Ds);
-
-	XMVECTOR X0 = XMVector3LengthSq(v1);
-	Ps = XMVectorMultiply(Y1, Y1);
-	X0 = XMVectorSubtract(X0, Ps);
-	//debug_assert(XMVector4GreaterOrEqual(X0, XMVectorZero()));
-	XMVECTOR R0 = XMVectorMultiplyAdd(Y0, Y0, X0);
-	XMVECTOR R1 = XMVectorMultiplyAdd(Y1, Y1, X0);
-	R0 = XMVectorReciprocalSqrt(R0);
-	R1 = XMVectorReciprocalSqrt(R1);
-
-	XMVECTOR Ry = XMVectorSubtract(R1, R0);
-
-	R0 = XMVectorMultiply(R0, Y0);
-	R1 = XMVectorMultiply(R1, Y1);
-	XMVECTOR Rx = XMVectorSubtract(R0, R1);
-	X0 = XMVectorReciprocalSqrt(X0);
-	//debug_assert(!XMVectorGetIntX(XMVectorIsNaN(X0)));
-	Rx = XMVectorMultiply(Rx, X0);
-	Rx = XMVectorSelect(Rx, Ry, g_XMSelect0101);
-	// Field intensity in P centered coordinate
-	Rx = XMVectorAndInt(Rx, g_XMSelect1100);
-
-	Rx = XMVectorMultiply(Rx, Ds);
-	Rx = XMVector3Transform(Rx, Rot);
-
-	//debug_assert(!XMVectorGetIntX(XMVectorIsNaN(Rx)));
-	return Rx;
-}
-
-DirectX::XMVECTOR XM_CALLCONV Causality::HandPhysicalModel::FieldAtPoint(DirectX::FXMVECTOR P)
-{
-	// Palm push force 
-	//XMVECTOR palmP = m_Hand.palmPosition().toVector3<Vector3>();
-	//XMVECTOR palmN = m_Hand.palmNormal().toVector3<Vector3>();
-	//auto dis = XMVectorSubtract(P,palmP);
-	//auto mag = XMVectorReciprocal(XMVector3LengthSq(dis));
-	//dis = XMVector3Normalize(dis);
-	//auto fac = XMVector3Dot(dis, palmN);
-	//mag = XMVectorMultiply(fac, mag);
-	//return XMVectorMultiply(dis, mag);
-
-	XMVECTOR field = XMVectorZero();
-	for (const auto& bone : m_Bones)
-	{
-		XMVECTOR v0 = bone.first;
-		XMVECTOR v1 = bone.second;
-		XMVECTOR f = FieldSegmentToPoint(P, v0, v1);
-		field += f;
-		//XMVECTOR l = XMVector3LengthSq(XMVectorSubtract(v1,v0));
-	}
-	return field;
-}
 
 inline Causality::CubeModel::CubeModel(const std::string & name, DirectX::FXMVECTOR extend, DirectX::FXMVECTOR color)
 {
@@ -1261,280 +971,3 @@ inline std::shared_ptr<btCollisionShape> Causality::ShapedGeomrtricModel::Create
 		return m_pShape;
 	}
 }
-
-void Causality::WorldBranch::InitializeBranchPool(int size, bool autoExpandation)
-{
-	for (size_t i = 0; i < 30; i++)
-	{
-		BranchPool.emplace(new WorldBranch());
-	}
-}
-
-void Causality::WorldBranch::Reset()
-{
-	for (const auto& pair : Items)
-	{
-		pair.second->Disable();
-	}
-	Items.clear();
-}
-
-void Causality::WorldBranch::Collapse()
-{
-	//using namespace cpplinq;
-	//using cref = decltype(m_StateFrames)::const_reference;
-	//auto mlh = from(m_StateFrames)
-	//	>> where([](cref pFrame) {return pFrame->IsEnabled; })
-	//	>> max([](cref pFrame)->float {return pFrame->Liklyhood(); });
-	//WordBranch master_frame;
-	////for (auto & pFrame : m_StateFrames)
-	////{
-	////	if (pFrame->Liklyhood() < mlh)
-	////	{
-	////		pFrame->Disable();
-	////		m_pFramesPool->Recycle(std::move(pFrame));
-	////	}
-	////	else
-	////	{
-	////		master_frame = std::move(pFrame);
-	////	}
-	////}
-	//m_StateFrames.clear();
-	//m_StateFrames.push_back(std::move(master_frame));
-}
-
-SuperpositionMap Causality::WorldBranch::CaculateSuperposition()
-{
-	using namespace cpplinq;
-	SuperpositionMap SuperStates;
-
-	auto itr = this->begin();
-	auto eitr = this->end();
-
-	NormalizeLiklyhood(CaculateLiklyhood());
-
-	auto pItem = Items.begin();
-	for (size_t i = 0; i < Items.size(); i++,++pItem)
-	{
-		const auto& pModel = pItem->second;
-		auto& distribution = SuperStates[pItem->first];
-		//auto&  = state.StatesDistribution;
-		int j = 0;
-
-		for (const auto& branch : leaves())
-		{
-			if (!branch.IsEnabled)
-				continue;
-
-			auto itrObj = branch.Items.find(pItem->first);
-
-			if (itrObj == branch.Items.end())
-				continue;
-			auto pNew = itrObj->second;
-
-			ProblistiscAffineTransform tNew;
-			tNew.Translation = pNew->GetPosition();
-			tNew.Rotation = pNew->GetOrientation();
-			tNew.Scale = pNew->GetScale();
-			tNew.Probability = branch.Liklyhood();
-
-			auto itr = std::find_if(distribution.begin(), distribution.end(),
-				[&tNew](std::remove_reference_t<decltype(distribution)>::const_reference trans) -> bool
-			{
-				return trans.NearEqual(tNew);
-			});
-
-			if (itr == distribution.end())
-			{
-				distribution.push_back(tNew);
-			}
-			else
-			{
-				itr->Probability += tNew.Probability;
-			}
-			j++;
-		}
-	}
-
-	return SuperStates;
-}
-
-void Causality::WorldBranch::InternalEvolution(float timeStep, const Leap::Frame & frame, const DirectX::Matrix4x4 & leapTransform)
-{
-	auto& subjects = Subjects;
-
-	BoundingSphere sphere;
-
-	//if (!is_leaf()) return;
-	for (auto itr = subjects.begin(); itr != subjects.end(); )
-	{
-		bool result = itr->second->Update(frame, leapTransform);
-		// Remove hands lost track for 60+ frames
-		if (!result)
-		{
-			if (itr->second->LostFramesCount() > 60)
-				itr = subjects.erase(itr);
-		}
-		else
-		{
-			//std::vector<PhysicalRigid*> collideObjects;
-
-			//for (auto& item : Items)
-			//{
-			//	btVector3 c;
-			//	item.second->GetBulletShape()->getBoundingSphere(c, sphere.Radius);
-			//	sphere.Center = vector_cast<Vector3>(sphere.Center);
-			//	if (itr->second->OperatingFrustum().Contains(sphere) != ContainmentType::DISJOINT)
-			//	{
-			//		collideObjects.push_back(item.second.get());
-			//	}
-			//}
-			//if (collideObjects.size() > 0)
-			//{
-			//	Fork(collideObjects);
-			//}
-
-
-			//const auto &pHand = itr->second;
-			//for (auto& item : pFrame->Objects)
-			//{
-			//	const auto& pObj = item.second;
-			//	if (pObj->GetBulletRigid()->isStaticObject())
-			//		continue;
-			//	//pObj->GetBulletShape()->
-			//	auto force = pHand->FieldAtPoint(pObj->GetPosition()) * 0.00001f;
-			//	pObj->GetBulletRigid()->clearForces();
-			//	//vector_cast<btVector3>(force) * 0.01f
-			//	std::cout << item.first << " : " << Vector3(force) << std::endl;
-			//	pObj->GetBulletRigid()->applyCentralForce(vector_cast<btVector3>(force));
-			//	pObj->GetBulletRigid()->activate();
-			//}
-			++itr;
-		}
-	}
-	pDynamicsWorld->stepSimulation(timeStep, 10);
-}
-
-float Causality::WorldBranch::CaculateLiklyhood()
-{
-	if (is_leaf())
-	{
-		if (IsEnabled)
-			_Liklyhood = 1;
-		else
-			_Liklyhood = 0;
-		return _Liklyhood;
-	}
-	else
-	{
-		_Liklyhood = 0;
-		for (auto& branch : children())
-		{
-			_Liklyhood += branch.CaculateLiklyhood();
-		}
-		return _Liklyhood;
-	}
-}
-
-void Causality::WorldBranch::NormalizeLiklyhood(float total)
-{
-	for (auto& branch : nodes_in_tree())
-	{
-		branch._Liklyhood /= total;
-	}
-}
-
-void Causality::WorldBranch::AddSubjectiveObject(const Leap::Hand & hand, const DirectX::Matrix4x4& leapTransform)
-{
-	if (!Subjects[hand.id()])
-	{
-		Subjects[hand.id()].reset(
-			new HandPhysicalModel(
-			pDynamicsWorld,
-			hand, leapTransform,
-			SubjectTransform)
-			);
-		//for (const auto& itm : pFrame->Objects)
-		//{
-		//	const auto& pObj = itm.second;
-		//	if (!pObj->GetBulletRigid()->isStaticOrKinematicObject())
-		//	{
-		//		for (const auto& bone : subjects[hand.id()]->Rigids())
-		//			pObj->GetBulletRigid()->setIgnoreCollisionCheck(bone.get(), false);
-		//	}
-		//}
-	}
-}
-
-void Causality::WorldBranch::AddDynamicObject(const std::string &name, const std::shared_ptr<btCollisionShape> &pShape, float mass, const DirectX::Vector3 & Position, const DirectX::Quaternion & Orientation)
-{
-	for (auto& branch : nodes_in_tree())
-	{
-		auto pObject = std::shared_ptr<PhysicalRigid>(new PhysicalRigid());
-		pObject->InitializePhysics(branch.pDynamicsWorld, pShape, mass, Position, Orientation);
-		pObject->GetBulletRigid()->setFriction(1.0f);
-		pObject->GetBulletRigid()->setDamping(0.8f, 0.9f);
-		pObject->GetBulletRigid()->setRestitution(0.0);
-		branch.Items[name] = pObject;
-	}
-}
-
-void Causality::WorldBranch::Evolution(float timeStep, const Leap::Frame & frame, const DirectX::Matrix4x4 & leapTransform)
-{
-	using namespace cpplinq;
-	vector<reference_wrapper<WorldBranch>> leaves;
-
-
-
-	//auto levr = this->leaves();
-	copy(this->leaves_begin(), leaves_end(), back_inserter(leaves));
-
-	auto branchEvolution = [timeStep, &frame, &leapTransform](WorldBranch& branch) {
-		branch.InternalEvolution(timeStep,frame, leapTransform);
-	};
-	//auto branchEvolution = std::bind(&WorldBranch::InternalEvolution, placeholders::_1, frame, leapTransform);
-
-	if (leaves.size() >= 10)
-		concurrency::parallel_for_each(leaves.begin(), leaves.end(), branchEvolution);
-	else
-		for_each(leaves.begin(), leaves.end(), branchEvolution);
-}
-
-void Causality::WorldBranch::Fork(const std::vector<PhysicalRigid*>& focusObjects)
-{
-	//int i = 0;
-	//for (const auto& obj : focusObjects)
-	//{
-	//	auto branch = DemandCreate((boost::format("%s/%d") % this->Name % i++).str());
-	//}
-}
-
-void Causality::WorldBranch::Fork(const std::vector<DirectX::AffineTransform>& subjectTransforms)
-{
-	for (int i = subjectTransforms.size() - 1; i >= 0; --i)
-	{
-		const auto& trans = subjectTransforms[i];
-		auto branch = DemandCreate((boost::format("%s/%d") % this->Name % i).str());
-		branch->Enable(trans);
-		append_children_front(branch.release());
-		//branch->SubjectTransform = trans;
-	}
-}
-std::unique_ptr<WorldBranch> Causality::WorldBranch::DemandCreate(const string& branchName)
-{
-	if (!BranchPool.empty())
-	{
-		auto frame = std::move(BranchPool.front());
-		BranchPool.pop();
-		frame->Name = branchName;
-		return frame;
-	}
-	else
-		return nullptr;
-}
-
-void Causality::WorldBranch::Recycle(std::unique_ptr<WorldBranch>&& pFrame)
-{
-	pFrame->Reset();
-	BranchPool.push(std::move(pFrame));
-}
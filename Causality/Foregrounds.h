@@ -19,7 +19,11 @@
 #include "BulletPhysics.h"
 #include <GeometricPrimitive.h>
 #include "Common\Filter.h"
-#include "Common\tree.h"
+#include "SimulationThread.h"
+#include "Common\RingBuffer.h"
+#include "Common\StreamingOrientedBox.h"
+#include "ShapeDescriptorIndex.h"
+#include "DrawListBuilder.h"
 
 namespace Causality
 {
@@ -44,67 +48,6 @@ namespace Causality
 		std::shared_ptr<btCollisionShape> m_pShape;
 	};
 
-	struct ProblistiscAffineTransform : public DirectX::AffineTransform
-	{
-		using DirectX::AffineTransform::AffineTransform;
-		float Probability;
-	};
-
-	// A super state which encode different states with probility
-	//struct ProblistiscState
-	//{
-	//public:
-	//	std::string	Name;
-	//	std::vector<ProblistiscAffineTransform> StatesDistribution;
-	//};
-
-	struct HandPhysicalModel : public DirectX::Scene::IModelNode
-	{
-		HandPhysicalModel(const std::shared_ptr<btDynamicsWorld> &pWorld,
-			const Leap::Hand & hand, const DirectX::Matrix4x4 & leapTransform,
-			const DirectX::AffineTransform &inheritTransform);
-
-		DirectX::XMMATRIX CaculateLocalMatrix(const Leap::Hand & hand, const DirectX::Matrix4x4 & leapTransform);
-
-		inline const std::vector<std::unique_ptr<PhysicalRigid>>& Rigids()
-		{
-			return m_HandRigids;
-		}
-
-		bool Update(const Leap::Frame& frame, const DirectX::Matrix4x4& leapTransform);
-
-		bool IsTracked() const
-		{
-			return m_Hand.isValid();
-		}
-		int LostFramesCount() const { return LostFrames; }
-		// Inherited via IModelNode
-		virtual void Render(ID3D11DeviceContext * pContext, DirectX::IEffect * pEffect) override;
-
-		DirectX::XMVECTOR XM_CALLCONV FieldAtPoint(DirectX::FXMVECTOR P);
-
-		const DirectX::BoundingFrustum& OperatingFrustum() const
-		{
-			return m_HandFrustum;
-		}
-
-	public:
-		float		Opticity;
-
-	private:
-		int			Id;
-		int			LostFrames;
-		Leap::Hand  m_Hand;
-		DirectX::AffineTransform m_InheritTransform;
-		std::array<std::pair<DirectX::Vector3, DirectX::Vector3>, 20> m_Bones;
-		std::vector<std::unique_ptr<PhysicalRigid>>			m_HandRigids;
-
-		//std::unique_ptr<Bullet::GhostObject>				m_HandFrustrum;
-		DirectX::BoundingFrustum							m_HandFrustum;
-		//static std::unique_ptr<DirectX::GeometricPrimitive> s_pCylinder;
-		//static std::unique_ptr<DirectX::GeometricPrimitive> s_pSphere;
-	};
-
 	class CubeModel : public DirectX::Scene::IModelNode, virtual public IShaped
 	{
 	public:
@@ -119,8 +62,6 @@ namespace Causality
 		DirectX::Color m_Color;
 	};
 
-	typedef std::map<std::string, std::vector<ProblistiscAffineTransform>> SuperpositionMap;
-
 	class CollisionShape : public DirectX::IBoundable
 	{
 	};
@@ -137,104 +78,6 @@ namespace Causality
 		virtual bool Update(/*param*/);
 	};
 
-	// One problistic frame for current state
-	class WorldBranch : public stree::tree_node<WorldBranch, false>
-	{
-	public:
-
-		enum CollisionGroupEnum : short
-		{
-			Group_Focused_Object = 0x1,
-			Group_Unfocused_Object = 0x2,
-			Group_Subject = 0x4,
-			Mask_Focused_Object = 0x7,
-			Mask_Unfocused_Object = 0x3,
-			Mask_Subject = 0x1,
-		};
-
-	public:
-		static void InitializeBranchPool(int size, bool autoExpandation = true);
-		static std::unique_ptr<WorldBranch> DemandCreate(const std::string& branchName);
-		static void Recycle(std::unique_ptr<WorldBranch>&&);
-
-	private:
-		static std::queue<std::unique_ptr<WorldBranch>> BranchPool;
-
-	public:
-		void Reset();
-
-		float Liklyhood() const
-		{
-			return _Liklyhood;
-		}
-
-		WorldBranch();
-
-		void Enable(const DirectX::AffineTransform& subjectTransform)
-		{
-			IsEnabled = true;
-			SubjectTransform = subjectTransform;
-		}
-
-		void Disable()
-		{
-			IsEnabled = false;
-		}
-
-		//copy / move sementic is deleted for use with pointer
-		WorldBranch(const WorldBranch& other) = delete;
-		WorldBranch& operator=(const WorldBranch& other) = delete;
-		WorldBranch(WorldBranch&& other) = delete;
-		WorldBranch& operator=(const WorldBranch&& other) = delete;
-
-		void AddSubjectiveObject(const Leap::Hand& hand, const DirectX::Matrix4x4& leapTransform);
-		void AddDynamicObject(const std::string &name, const std::shared_ptr<btCollisionShape> &pShape, float mass, const DirectX::Vector3 & Position, const DirectX::Quaternion & Orientation);
-		void Evolution(float timeStep, const Leap::Frame & frame, const DirectX::Matrix4x4 & leapTransform);
-		void Fork(const std::vector<PhysicalRigid*>& focusObjects);
-		void Fork(const std::vector<DirectX::AffineTransform>& subjectTransform);
-		void Collapse();
-		SuperpositionMap CaculateSuperposition();
-
-	protected:
-		float CaculateLiklyhood();
-		void NormalizeLiklyhood(float total);
-	public:
-		// Internal evolution algorithm as-if this branch is a "Leaf"
-		void InternalEvolution(float timeStep, const Leap::Frame & frame, const DirectX::Matrix4x4 & leapTransform);
-
-	public:
-		std::string												Name;
-
-	protected:
-		float													_Liklyhood;
-
-		std::unique_ptr<std::thread>							pWorkerThread;
-		std::condition_variable									queuePending;
-		std::mutex												queueMutex;
-	protected:
-		// Evolution caculation object
-		std::shared_ptr<btBroadphaseInterface>					pBroadphase = nullptr;
-		// Set up the collision configuration and dispatcher
-		std::shared_ptr<btDefaultCollisionConfiguration>		pCollisionConfiguration = nullptr;
-		std::shared_ptr<btCollisionDispatcher>					pDispatcher = nullptr;
-		// The actual physics solver
-		std::shared_ptr<btSequentialImpulseConstraintSolver>	pSolver = nullptr;
-		std::shared_ptr<btDynamicsWorld>						pDynamicsWorld = nullptr;
-
-	public:
-		// Object states evolution with time and interaction subjects
-		std::map<std::string, std::shared_ptr<PhysicalRigid>>	Items;
-
-		// Interactive subjects
-		std::map<int, std::shared_ptr<HandPhysicalModel>>		Subjects;
-
-		DirectX::AffineTransform								SubjectTransform;
-
-
-		bool													IsDirty;
-		bool													IsEnabled;
-	};
-
 	class WorldScene : public Platform::IAppComponent, public Platform::IUserHandsInteractive, public Platform::IKeybordInteractive, public DirectX::Scene::IRenderable, public DirectX::Scene::IViewable, public DirectX::Scene::ITimeAnimatable
 	{
 	public:
@@ -271,9 +114,13 @@ namespace Causality
 
 		virtual void OnKeyUp(const Platform::KeyboardEventArgs & e) override;
 
-		void AddObject(const std::shared_ptr<DirectX::Scene::IModelNode>& pModel, float mass, const DirectX::Vector3 &Position, const DirectX::Quaternion &Orientation, const DirectX::Vector3 &Scale);
+		// Returns the object id, which is also the model's index in Models
+		unsigned AddObject(const std::shared_ptr<DirectX::Scene::IModelNode>& pModel, float mass, const DirectX::Vector3 &Position, const DirectX::Quaternion &Orientation, const DirectX::Vector3 &Scale);
 
 	private:
+		// Draw list batch key of a model, called under m_RenderLock
+		uint32_t BatchKey(const DirectX::Scene::IModelNode& model);
+
 		std::unique_ptr<DirectX::Scene::SkyDome>		pBackground;
 		Microsoft::WRL::ComPtr<ID3D11RasterizerState>	pRSState;
 		Microsoft::WRL::ComPtr<ID3D11InputLayout>		pInputLayout;
@@ -281,17 +128,25 @@ namespace Causality
 		std::unique_ptr<DirectX::PrimitiveBatch<DirectX::VertexPositionNormal>>
 			pBatch;
 		bool											m_HaveHands;
-		Leap::Frame										m_Frame;
+		Platform::HandFrame								m_Frame;
 		DirectX::Matrix4x4								m_FrameTransform;
 		const int TraceLength = 1;
-		std::deque<std::array<DirectX::Vector3, 25>>	m_HandTrace;
-		std::deque<std::array<DirectX::Vector3, 2000>>	m_TraceSamples;
-		std::vector<DirectX::Vector3>					m_TracePoints;
+		// Joints of the hands in the last frames, the descriptor box covers the whole window
+		static const size_t TraceWindowSize = 45;
+		RingBuffer<std::array<DirectX::Vector3, 25>, TraceWindowSize>	m_HandTrace;
+		StreamingOrientedBox							m_HandTraceBoxEstimator;
+		// Bumped by every hand update, models are re-ranked only when it changed
+		uint64_t										m_HandTraceVersion;
+		uint64_t										m_RankedTraceVersion;
 		DirectX::BoundingOrientedBox					m_CurrentHandBoundingBox;
 		DirectX::BoundingOrientedBox					m_HandTraceBoundingBox;
-		std::map<std::string, Eigen::VectorXf>			m_ModelFeatures;
-		std::map<std::string, float>					m_ModelDetailSimilarity;
-		Eigen::VectorXf									m_HandDescriptionFeature;
+		// Shape descriptors of Models, indexed by object id
+		ShapeDescriptorIndex							m_ShapeIndex;
+		ShapeDescriptor									m_HandDescriptor;
+		// Similarity of each model to the hand descriptor and the best matches, guarded by m_RenderLock
+		std::vector<float>								m_ModelSimilarity;
+		std::vector<ShapeDescriptorIndex::Match>		m_TopMatches;
+		static const size_t								TopMatchCount = 5;
 		std::mutex										m_HandFrameMutex;
 		Geometrics::MetaBallModel						m_HandTraceModel;
 		std::vector<DirectX::VertexPositionNormal>		m_HandTraceVertices;
@@ -301,9 +156,22 @@ namespace Causality
 
 		DirectX::Scene::ModelCollection					Models;
 
-		std::unique_ptr<WorldBranch>					WorldTree;
-
-		SuperpositionMap								ModelStates;
+		// Owns the branch tree, every access to it is posted to the simulation thread
+		SimulationThread								WorldSimulation;
+
+		// Superposition interpolated for this render frame
+		SuperpositionTable								ModelStates;
+
+		// Visible states of ModelStates for every view of the frame, built once in UpdateAnimation, guarded by m_RenderLock
+		DrawListBuilder									m_DrawList;
+		// Draw list views the view matrix of the current UpdateViewMatrix call belongs to
+		uint32_t										m_ViewMask;
+		// Model space boxes and mesh / material batch keys of Models, indexed by object id
+		std::vector<DirectX::BoundingOrientedBox>		m_ModelBounds;
+		std::vector<uint32_t>							m_ModelBatchKeys;
+		std::map<std::pair<const void*, const void*>, uint32_t>	m_BatchKeys;
+		// Level of detail each draw item may use, from its screen size and opacity
+		DirectX::Scene::LodPolicy						m_LodPolicy;
 
 		//std::list<WorldBranch*>							m_StateFrames;
 
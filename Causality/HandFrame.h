@@ -0,0 +1,88 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+
+namespace Platform
+{
+	// Device independent snapshot of user's hands
+	// Everything is plain-old-data in the device's own space (millimeters for Leap),
+	// so frames can be copied around, written to disk and memory-mapped back as is
+	struct HandBone
+	{
+		DirectX::XMFLOAT3	PrevJoint;
+		DirectX::XMFLOAT3	NextJoint;
+	};
+
+	struct HandState
+	{
+		enum
+		{
+			FingerCount = 5,
+			BonePerFinger = 4,
+			BoneCount = FingerCount * BonePerFinger,
+		};
+
+		int32_t				Id;
+		uint32_t			IsLeft;
+		float				Confidence;
+		float				GrabStrength;
+		DirectX::XMFLOAT3	PalmPosition;
+		DirectX::XMFLOAT3	PalmNormal;
+		DirectX::XMFLOAT3	PalmVelocity;
+		DirectX::XMFLOAT3	Direction;
+		// Finger-major : thumb to pinky, metacarpal to distal
+		HandBone			Bones[BoneCount];
+
+		const HandBone& Bone(int finger, int bone) const { return Bones[finger * BonePerFinger + bone]; }
+	};
+
+	struct HandFrame
+	{
+		enum { MaxHands = 4 };
+
+		struct HandRange
+		{
+			const HandState* First;
+			const HandState* Last;
+			const HandState* begin() const { return First; }
+			const HandState* end() const { return Last; }
+			int count() const { return static_cast<int>(Last - First); }
+		};
+
+		HandFrame()
+			: Id(0), Timestamp(0), HandCount(0), Reserved(0)
+		{
+			DirectX::XMStoreFloat4x4(&ToWorld, DirectX::XMMatrixIdentity());
+		}
+
+		int64_t				Id;
+		// Device timestamp in microseconds
+		int64_t				Timestamp;
+		// Device space to world space transform at the time of capture
+		DirectX::XMFLOAT4X4	ToWorld;
+		uint32_t			HandCount;
+		uint32_t			Reserved;
+		HandState			HandStates[MaxHands];
+
+		HandRange hands() const { return HandRange{ HandStates, HandStates + HandCount }; }
+
+		// nullptr if the hand is not in this frame
+		const HandState* Hand(int id) const
+		{
+			for (uint32_t i = 0; i < HandCount; i++)
+				if (HandStates[i].Id == id)
+					return &HandStates[i];
+			return nullptr;
+		}
+
+		// The hand closest to the user's screen (smallest z in device space)
+		const HandState* Frontmost() const
+		{
+			const HandState* pFront = nullptr;
+			for (uint32_t i = 0; i < HandCount; i++)
+				if (!pFront || HandStates[i].PalmPosition.z < pFront->PalmPosition.z)
+					pFront = &HandStates[i];
+			return pFront;
+		}
+	};
+}
@@ -0,0 +1,253 @@
+#include "HandFrameStream.h"
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace Platform;
+using namespace Platform::Devices;
+
+static const char		HandFrameMagic[4] = { 'H', 'F', 'R', 'M' };
+static const uint32_t	HandFrameVersion = 1;
+// Everything in HandFrame before the hand array is written verbatim as frame header
+static const size_t		FrameHeaderSize = offsetof(HandFrame, HandStates);
+
+Platform::Devices::HandsEventSource::HandsEventSource()
+	: PrevHandsCount(0)
+{
+}
+
+void Platform::Devices::HandsEventSource::DispatchFrame(const HandFrame & frame, const DirectX::Matrix4x4 & toWorld)
+{
+	UserHandsEventArgs e{ frame , toWorld };
+	int count = static_cast<int>(frame.HandCount);
+
+	if (count > PrevHandsCount)
+	{
+		PrevHandsCount = count;
+		HandsTracked(e);
+	}
+	else if (count < PrevHandsCount)
+	{
+		PrevHandsCount = count;
+		HandsLost(e);
+	}
+	if (count > 0)
+	{
+		HandsMove(e);
+	}
+}
+
+Platform::Devices::HandFrameRecorder::HandFrameRecorder()
+	: m_FrameCount(0)
+{
+}
+
+Platform::Devices::HandFrameRecorder::HandFrameRecorder(const std::string & path)
+	: m_FrameCount(0)
+{
+	Open(path);
+}
+
+Platform::Devices::HandFrameRecorder::~HandFrameRecorder()
+{
+	Close();
+}
+
+bool Platform::Devices::HandFrameRecorder::Open(const std::string & path)
+{
+	std::lock_guard<std::mutex> guard(m_Lock);
+	if (m_Stream.is_open())
+		m_Stream.close();
+	m_FrameCount = 0;
+	m_Stream.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_Stream.is_open())
+		return false;
+
+	HandFrameFileHeader header;
+	memcpy(header.Magic, HandFrameMagic, sizeof(header.Magic));
+	header.Version = HandFrameVersion;
+	header.FrameHeaderSize = static_cast<uint32_t>(FrameHeaderSize);
+	header.HandStateSize = static_cast<uint32_t>(sizeof(HandState));
+	m_Stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	return m_Stream.good();
+}
+
+void Platform::Devices::HandFrameRecorder::Close()
+{
+	std::lock_guard<std::mutex> guard(m_Lock);
+	if (m_Stream.is_open())
+		m_Stream.close();
+}
+
+void Platform::Devices::HandFrameRecorder::Write(const HandFrame & frame)
+{
+	std::lock_guard<std::mutex> guard(m_Lock);
+	if (!m_Stream.is_open())
+		return;
+	uint32_t count = std::min<uint32_t>(frame.HandCount, HandFrame::MaxHands);
+	HandFrame header = frame;
+	header.HandCount = count;
+	m_Stream.write(reinterpret_cast<const char*>(&header), FrameHeaderSize);
+	m_Stream.write(reinterpret_cast<const char*>(frame.HandStates), count * sizeof(HandState));
+	m_FrameCount++;
+}
+
+Platform::Devices::HandFrameReplay::HandFrameReplay()
+	: m_pData(nullptr), m_Size(0),
+#if defined(_WIN32)
+	m_hFile(INVALID_HANDLE_VALUE), m_hMapping(nullptr),
+#else
+	m_FileDescriptor(-1),
+#endif
+	m_Position(0), m_Loop(false)
+{
+}
+
+Platform::Devices::HandFrameReplay::HandFrameReplay(const std::string & path)
+	: HandFrameReplay()
+{
+	Open(path);
+}
+
+Platform::Devices::HandFrameReplay::~HandFrameReplay()
+{
+	Close();
+}
+
+bool Platform::Devices::HandFrameReplay::Open(const std::string & path)
+{
+	Close();
+#if defined(_WIN32)
+	m_hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	m_Size = static_cast<size_t>(size.QuadPart);
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_hMapping)
+	{
+		Close();
+		return false;
+	}
+	m_pData = static_cast<const char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_FileDescriptor = open(path.c_str(), O_RDONLY);
+	if (m_FileDescriptor < 0)
+		return false;
+	struct stat st;
+	if (fstat(m_FileDescriptor, &st) != 0 || st.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	m_Size = static_cast<size_t>(st.st_size);
+	void* pView = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_FileDescriptor, 0);
+	m_pData = pView == MAP_FAILED ? nullptr : static_cast<const char*>(pView);
+#endif
+	if (!m_pData || !BuildIndex())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void Platform::Devices::HandFrameReplay::Close()
+{
+#if defined(_WIN32)
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping)
+		CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+	m_hMapping = nullptr;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (m_pData)
+		munmap(const_cast<char*>(m_pData), m_Size);
+	if (m_FileDescriptor >= 0)
+		close(m_FileDescriptor);
+	m_FileDescriptor = -1;
+#endif
+	m_pData = nullptr;
+	m_Size = 0;
+	m_Offsets.clear();
+	m_Position = 0;
+	PrevHandsCount = 0;
+}
+
+bool Platform::Devices::HandFrameReplay::BuildIndex()
+{
+	if (m_Size < sizeof(HandFrameFileHeader))
+		return false;
+	HandFrameFileHeader header;
+	memcpy(&header, m_pData, sizeof(header));
+	if (memcmp(header.Magic, HandFrameMagic, sizeof(header.Magic)) != 0
+		|| header.Version != HandFrameVersion
+		|| header.FrameHeaderSize != FrameHeaderSize
+		|| header.HandStateSize != sizeof(HandState))
+		return false;
+
+	// A truncated trailing frame (e.g. recorder killed) is dropped
+	size_t offset = sizeof(HandFrameFileHeader);
+	while (offset + FrameHeaderSize <= m_Size)
+	{
+		uint32_t count;
+		memcpy(&count, m_pData + offset + offsetof(HandFrame, HandCount), sizeof(count));
+		if (count > HandFrame::MaxHands)
+			break;
+		size_t next = offset + FrameHeaderSize + count * sizeof(HandState);
+		if (next > m_Size)
+			break;
+		m_Offsets.push_back(offset);
+		offset = next;
+	}
+	return true;
+}
+
+void Platform::Devices::HandFrameReplay::Seek(size_t frameIndex)
+{
+	m_Position = std::min(frameIndex, m_Offsets.size());
+}
+
+bool Platform::Devices::HandFrameReplay::ReadFrame(size_t index, HandFrame & frame) const
+{
+	if (index >= m_Offsets.size())
+		return false;
+	const char* pRecord = m_pData + m_Offsets[index];
+	memcpy(static_cast<void*>(&frame), pRecord, FrameHeaderSize);
+	memcpy(frame.HandStates, pRecord + FrameHeaderSize, frame.HandCount * sizeof(HandState));
+	return true;
+}
+
+bool Platform::Devices::HandFrameReplay::PullFrame()
+{
+	if (m_Position >= m_Offsets.size())
+	{
+		if (!m_Loop || m_Offsets.empty())
+			return false;
+		m_Position = 0;
+	}
+
+	ReadFrame(m_Position++, m_Frame);
+	DispatchFrame(m_Frame, DirectX::XMLoadFloat4x4(&m_Frame.ToWorld));
+	return true;
+}
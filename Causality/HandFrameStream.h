@@ -0,0 +1,113 @@
+#pragma once
+#include "HandFrame.h"
+#include "Interactive.h"
+#include <boost\signals2.hpp>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+
+namespace Platform
+{
+	namespace Devices
+	{
+		// Same type as Fundation::Event<const UserHandsEventArgs&>, without pulling in WRL
+		typedef boost::signals2::signal<void(const UserHandsEventArgs&)> HandsEvent;
+
+		// Anything that produce HandFrames, live device or recorded stream
+		class HandsEventSource
+		{
+		public:
+			HandsEventSource();
+			virtual ~HandsEventSource() {}
+
+			HandsEvent HandsTracked;
+			HandsEvent HandsLost;
+			HandsEvent HandsMove;
+
+		protected:
+			// Fire HandsTracked / HandsLost by comparing hands count with previous frame, then HandsMove if any hand present
+			void DispatchFrame(const HandFrame& frame, const DirectX::Matrix4x4& toWorld);
+
+			int PrevHandsCount;
+		};
+
+		// Binary layout : HandFrameFileHeader, then per frame the HandFrame fields before HandStates,
+		// followed by HandCount HandState records. All little-endian POD, no padding in between records
+		struct HandFrameFileHeader
+		{
+			char		Magic[4];
+			uint32_t	Version;
+			uint32_t	FrameHeaderSize;
+			uint32_t	HandStateSize;
+		};
+
+		class HandFrameRecorder
+		{
+		public:
+			HandFrameRecorder();
+			explicit HandFrameRecorder(const std::string& path);
+			~HandFrameRecorder();
+
+			bool Open(const std::string& path);
+			void Close();
+			bool IsOpen() const { return m_Stream.is_open(); }
+			size_t FrameCount() const { return m_FrameCount; }
+
+			// Thread safe, Leap listener call this from it's own thread
+			void Write(const HandFrame& frame);
+
+		private:
+			std::mutex		m_Lock;
+			std::ofstream	m_Stream;
+			size_t			m_FrameCount;
+		};
+
+		// Replay a recorded session from a memory-mapped file, firing the same events as LeapMotion
+		// Uses the recorded world transform so the replay is deterministic regardless of camera
+		class HandFrameReplay : public HandsEventSource
+		{
+		public:
+			HandFrameReplay();
+			explicit HandFrameReplay(const std::string& path);
+			~HandFrameReplay();
+
+			HandFrameReplay(const HandFrameReplay&) = delete;
+			HandFrameReplay& operator=(const HandFrameReplay&) = delete;
+
+			bool Open(const std::string& path);
+			void Close();
+			bool IsOpen() const { return m_pData != nullptr; }
+
+			size_t FrameCount() const { return m_Offsets.size(); }
+			size_t Position() const { return m_Position; }
+			void Seek(size_t frameIndex);
+			void SetLoop(bool loop) { m_Loop = loop; }
+
+			// Decode frame at index without firing events
+			bool ReadFrame(size_t index, HandFrame& frame) const;
+
+			// To use with seqential logic : decode next frame and distribute events
+			// Returns false when the stream is exhausted (and not looping)
+			bool PullFrame();
+
+			const HandFrame& CurrentFrame() const { return m_Frame; }
+
+		private:
+			bool BuildIndex();
+
+			const char*				m_pData;
+			size_t					m_Size;
+#if defined(_WIN32)
+			void*					m_hFile;
+			void*					m_hMapping;
+#else
+			int						m_FileDescriptor;
+#endif
+			std::vector<size_t>		m_Offsets;
+			size_t					m_Position;
+			bool					m_Loop;
+			HandFrame				m_Frame;
+		};
+	}
+}
@@ -1,6 +1,6 @@
 #pragma once
 #include "Common\DirectXMathExtend.h"
-#include <Leap.h>
+#include "HandFrame.h"
 
 namespace Platform
 {
@@ -101,7 +101,7 @@ namespace Platform
 
 	struct UserHandsEventArgs
 	{
-		const Leap::Controller& sender;
+		const HandFrame& frame;
 		DirectX::Matrix4x4 toWorldTransform;
 	};
 
@@ -1,6 +1,7 @@
 #include "LeapMotion.h"
-#include <iostream>
+#include "Common\Logger.h"
 
+using namespace Platform;
 using namespace Platform::Devices;
 
 class LeapMotion::Listener : public Leap::Listener
@@ -9,14 +10,13 @@ public:
 	Listener(LeapMotion* pLeap)
 	{
 		pOwner = pLeap;
-		PrevHandsCount = 0;
 	}
 	virtual void onConnect(const Leap::Controller & controller) override;
 	virtual void onDisconnect(const Leap::Controller &controller) override;
 	virtual void onFrame(const Leap::Controller &controller) override;
 
-	int							PrevHandsCount;
 	Leap::Frame					CurrentFrame;
+	HandFrame					Frame;
 	LeapMotion*	pOwner;
 };
 
@@ -64,6 +64,11 @@ void Platform::Devices::LeapMotion::PullFrame()
 		pListener->onFrame(LeapController);
 }
 
+void Platform::Devices::LeapMotion::SetRecorder(const std::shared_ptr<HandFrameRecorder>& pRecorder)
+{
+	std::atomic_store(&this->pRecorder, pRecorder);
+}
+
 void Platform::Devices::LeapMotion::SetMotionProvider(DirectX::ILocatable * pHeadLoc, DirectX::IOriented * pHeadOrient)
 {
 	pHeadLocation = pHeadLoc;
@@ -88,15 +93,52 @@ DirectX::XMMATRIX Platform::Devices::LeapMotion::ToWorldTransform() const
 void Platform::Devices::LeapMotion::Listener::onConnect(const Leap::Controller & controller)
 {
 	pOwner->DeviceConnected(controller);
-	PrevHandsCount = 0;
-	std::cout << "[Leap] Device Connected." << std::endl;
+	pOwner->PrevHandsCount = 0;
+	LOG_INFO(Causality::Log_Device, "[Leap] Device Connected.");
 }
 
 void Platform::Devices::LeapMotion::Listener::onDisconnect(const Leap::Controller & controller)
 {
 	pOwner->DeviceConnected(controller);
-	PrevHandsCount = 0;
-	std::cout << "[Leap] Device Disconnected." << std::endl;
+	pOwner->PrevHandsCount = 0;
+	LOG_INFO(Causality::Log_Device, "[Leap] Device Disconnected.");
+}
+
+static void ConvertFrame(const Leap::Frame& frame, const DirectX::Matrix4x4& toWorld, HandFrame& out)
+{
+	using namespace DirectX;
+	out.Id = frame.id();
+	out.Timestamp = frame.timestamp();
+	XMStoreFloat4x4(&out.ToWorld, toWorld);
+	out.HandCount = 0;
+	for (const auto& hand : frame.hands())
+	{
+		if (out.HandCount >= HandFrame::MaxHands)
+			break;
+		auto& state = out.HandStates[out.HandCount++];
+		state.Id = hand.id();
+		state.IsLeft = hand.isLeft();
+		state.Confidence = hand.confidence();
+		state.GrabStrength = hand.grabStrength();
+		state.PalmPosition = hand.palmPosition().toVector3<XMFLOAT3>();
+		state.PalmNormal = hand.palmNormal().toVector3<XMFLOAT3>();
+		state.PalmVelocity = hand.palmVelocity().toVector3<XMFLOAT3>();
+		state.Direction = hand.direction().toVector3<XMFLOAT3>();
+		int j = 0;
+		for (const auto& finger : hand.fingers())
+		{
+			if (j >= HandState::FingerCount)
+				break;
+			for (int i = 0; i < HandState::BonePerFinger; i++)
+			{
+				const auto & bone = finger.bone((Leap::Bone::Type)i);
+				auto& dst = state.Bones[j * HandState::BonePerFinger + i];
+				dst.PrevJoint = bone.prevJoint().toVector3<XMFLOAT3>();
+				dst.NextJoint = bone.nextJoint().toVector3<XMFLOAT3>();
+			}
+			j++;
+		}
+	}
 }
 
 void Platform::Devices::LeapMotion::Listener::onFrame(const Leap::Controller & controller)
@@ -104,23 +146,14 @@ void Platform::Devices::LeapMotion::Listener::onFrame(const Leap::Controller & c
 	CurrentFrame = controller.frame();
 	pOwner->FrameArrived(controller);
 
-	UserHandsEventArgs e{ controller , pOwner->ToWorldTransform()};
+	DirectX::Matrix4x4 toWorld = pOwner->ToWorldTransform();
+	ConvertFrame(CurrentFrame, toWorld, Frame);
 
-	if (CurrentFrame.hands().count() > PrevHandsCount)
-	{
-		PrevHandsCount = CurrentFrame.hands().count();
-		pOwner->HandsTracked(e);
-	}
-	else if (CurrentFrame.hands().count() < PrevHandsCount)
-	{
-		PrevHandsCount = CurrentFrame.hands().count();
-		pOwner->HandsLost(e);
-		//pOwner->HandsMove(e);
-	}
-	if (CurrentFrame.hands().count() > 0)
-	{
-		pOwner->HandsMove(e);
-	}
+	auto pRecorder = std::atomic_load(&pOwner->pRecorder);
+	if (pRecorder)
+		pRecorder->Write(Frame);
+
+	pOwner->DispatchFrame(Frame, toWorld);
 
 	//std::cout << "[Leap] Frame arrived." << std::endl;
-}
+}
\ No newline at end of file
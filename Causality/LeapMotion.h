@@ -4,13 +4,14 @@
 #include <Leap.h>
 #include <memory>
 #include "Interactive.h"
+#include "HandFrameStream.h"
 #include "Common\Locatable.h"
 
 namespace Platform
 {
 	namespace Devices
 	{
-		class LeapMotion : public std::enable_shared_from_this<LeapMotion>
+		class LeapMotion : public HandsEventSource, public std::enable_shared_from_this<LeapMotion>
 		{
 		public:
 
@@ -32,9 +33,9 @@ namespace Platform
 			Platform::Fundation::Event<const Leap::Controller &> FrameArrived;
 			Platform::Fundation::Event<const Leap::Controller &> DeviceConnected;
 			Platform::Fundation::Event<const Leap::Controller &> DeviceDisconnected;
-			Platform::Fundation::Event<const Platform::UserHandsEventArgs &> HandsTracked;
-			Platform::Fundation::Event<const Platform::UserHandsEventArgs &> HandsLost;
-			Platform::Fundation::Event<const Platform::UserHandsEventArgs &> HandsMove;
+
+			// Every frame converted from Leap is also written to the recorder, nullptr to stop recording
+			void SetRecorder(const std::shared_ptr<HandFrameRecorder>& pRecorder);
 
 		private:
 			class Listener;
@@ -43,6 +44,7 @@ namespace Platform
 			DirectX::ILocatable			*pHeadLocation;
 			DirectX::IOriented			*pHeadOrientation;
 			bool						PrevConnectionStates;
+			std::shared_ptr<HandFrameRecorder> pRecorder;
 			Leap::Controller			LeapController;
 		};
 	}
@@ -0,0 +1,101 @@
+#include "ShapeDescriptorIndex.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Causality;
+using namespace DirectX;
+
+const float ShapeDescriptorIndex::HistogramWeight = 0.3f;
+
+ShapeDescriptor Causality::ShapeDescriptor::Create(const XMFLOAT3 & extents, const float * partSizes, size_t partCount)
+{
+	float sorted[3] = { extents.x, extents.y, extents.z };
+	std::sort(sorted, sorted + 3, [](float lhs, float rhs) { return lhs > rhs; });
+
+	ShapeDescriptor descriptor;
+	float invSize = sorted[0] > 0 ? 1.0f / sorted[0] : 0.0f;
+	descriptor.ExtentRatios[0] = sorted[1] * invSize;
+	descriptor.ExtentRatios[1] = sorted[2] * invSize;
+
+	std::fill(descriptor.PartHistogram, descriptor.PartHistogram + HistogramBins, 0.0f);
+	if (partCount == 0)
+	{
+		descriptor.PartHistogram[HistogramBins - 1] = 1.0f;
+		return descriptor;
+	}
+	float weight = 1.0f / partCount;
+	for (size_t i = 0; i < partCount; i++)
+	{
+		int bin = static_cast<int>(partSizes[i] * invSize * HistogramBins);
+		bin = std::min(std::max(bin, 0), HistogramBins - 1);
+		descriptor.PartHistogram[bin] += weight;
+	}
+	return descriptor;
+}
+
+void Causality::ShapeDescriptorIndex::Clear()
+{
+	m_Rows.clear();
+	m_Ids.clear();
+	m_IdBound = 0;
+}
+
+void Causality::ShapeDescriptorIndex::Add(unsigned id, const ShapeDescriptor & descriptor)
+{
+	const auto& h = descriptor.PartHistogram;
+	m_Rows.emplace_back(descriptor.ExtentRatios[0], descriptor.ExtentRatios[1], h[0], h[1]);
+	m_Rows.emplace_back(h[2], h[3], h[4], h[5]);
+	m_Ids.push_back(id);
+	m_IdBound = std::max(m_IdBound, id + 1);
+}
+
+void Causality::ShapeDescriptorIndex::Query(const ShapeDescriptor & query, size_t k, std::vector<float>& similarities, std::vector<Match>& topK) const
+{
+	const auto& h = query.PartHistogram;
+	XMVECTOR query0 = XMVectorSet(query.ExtentRatios[0], query.ExtentRatios[1], h[0], h[1]);
+	XMVECTOR query1 = XMVectorSet(h[2], h[3], h[4], h[5]);
+
+	similarities.assign(m_IdBound, 0.0f);
+	topK.resize(m_Ids.size());
+	for (size_t i = 0; i < m_Ids.size(); i++)
+	{
+		float similarity = Similarity(XMLoadFloat4A(&m_Rows[2 * i]), XMLoadFloat4A(&m_Rows[2 * i + 1]), query0, query1);
+		similarities[m_Ids[i]] = similarity;
+		topK[i].Id = m_Ids[i];
+		topK[i].Similarity = similarity;
+	}
+
+	k = std::min(k, topK.size());
+	std::partial_sort(topK.begin(), topK.begin() + k, topK.end(), [](const Match& lhs, const Match& rhs) {
+		return lhs.Similarity > rhs.Similarity;
+	});
+	topK.resize(k);
+}
+
+float Causality::ShapeDescriptorIndex::Similarity(const ShapeDescriptor & lhs, const ShapeDescriptor & rhs)
+{
+	const auto& l = lhs.PartHistogram;
+	const auto& r = rhs.PartHistogram;
+	return Similarity(
+		XMVectorSet(lhs.ExtentRatios[0], lhs.ExtentRatios[1], l[0], l[1]), XMVectorSet(l[2], l[3], l[4], l[5]),
+		XMVectorSet(rhs.ExtentRatios[0], rhs.ExtentRatios[1], r[0], r[1]), XMVectorSet(r[2], r[3], r[4], r[5]));
+}
+
+float XM_CALLCONV Causality::ShapeDescriptorIndex::Similarity(FXMVECTOR lhs0, FXMVECTOR lhs1, FXMVECTOR rhs0, FXMVECTOR rhs1)
+{
+	// Extent ratios as a 2d vector : difference in angle [0,pi/4] and in length [0,sqrt(2)]
+	XMVECTOR lhsLength = XMVector2Length(lhs0);
+	XMVECTOR rhsLength = XMVector2Length(rhs0);
+	XMVECTOR cosine = XMVectorDivide(XMVector2Dot(lhs0, rhs0), XMVectorMax(XMVectorMultiply(lhsLength, rhsLength), g_XMEpsilon));
+	float theta = XMScalarACos(std::min(XMVectorGetX(cosine), 1.0f));
+	float rhlo = fabsf(XMVectorGetX(XMVectorSubtract(lhsLength, rhsLength)));
+	float extentSimilarity = 1.0f - 0.5f * (0.3f * rhlo / sqrtf(2.0f) + 0.7f * theta / XM_PIDIV4);
+
+	// Histogram intersection
+	XMVECTOR overlap = XMVectorAdd(
+		XMVectorSelect(g_XMZero, XMVectorMin(lhs0, rhs0), g_XMSelect0011),
+		XMVectorMin(lhs1, rhs1));
+	float histogramSimilarity = XMVectorGetX(XMVector4Dot(overlap, g_XMOne));
+
+	return (1.0f - HistogramWeight) * extentSimilarity + HistogramWeight * histogramSimilarity;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+
+namespace Causality
+{
+	// Fixed size shape descriptor, scale invariant
+	struct ShapeDescriptor
+	{
+		enum { HistogramBins = 6 };
+
+		// Bounding box extents sorted from bigger to smaller, as ratios to the biggest one
+		float	ExtentRatios[2];
+		// Parts counted by their biggest extent relative to the shape's biggest extent, sums to 1
+		float	PartHistogram[HistogramBins];
+
+		// partSizes are the biggest (half) extent of each part, a shape without parts is its own single part
+		static ShapeDescriptor Create(const DirectX::XMFLOAT3& extents, const float* partSizes, size_t partCount);
+	};
+
+	// Descriptors of all candidate models, ranked against the hand's descriptor
+	// Descriptors are kept as two aligned rows each : (ratios, histogram[0..1]), (histogram[2..5])
+	class ShapeDescriptorIndex
+	{
+	public:
+		struct Match
+		{
+			unsigned	Id;
+			float		Similarity;
+		};
+
+		// Weight of the part histogram against the extent ratios in Similarity
+		static const float HistogramWeight;
+
+		void Clear();
+		void Add(unsigned id, const ShapeDescriptor& descriptor);
+		size_t Count() const { return m_Ids.size(); }
+
+		// Similarity in [0,1] of every indexed shape to the query, indexed by id, 0 for ids not in the index
+		// and the k most similar ones, most similar first
+		void Query(const ShapeDescriptor& query, size_t k, std::vector<float>& similarities, std::vector<Match>& topK) const;
+
+		static float Similarity(const ShapeDescriptor& lhs, const ShapeDescriptor& rhs);
+
+	private:
+		static float XM_CALLCONV Similarity(DirectX::FXMVECTOR lhs0, DirectX::FXMVECTOR lhs1, DirectX::FXMVECTOR rhs0, DirectX::FXMVECTOR rhs1);
+
+		std::vector<DirectX::XMFLOAT4A>	m_Rows;
+		std::vector<unsigned>			m_Ids;
+		unsigned						m_IdBound = 0;
+	};
+}
@@ -0,0 +1,158 @@
+#include "pch_bullet.h"
+#include "SimulationThread.h"
+#include <cfloat>
+
+using namespace Causality;
+using namespace DirectX;
+using namespace Platform;
+using namespace std;
+
+typedef std::chrono::high_resolution_clock simulation_clock;
+
+Causality::SimulationThread::SimulationThread(float stepTime)
+	: m_StepTime(stepTime), m_Stopping(false), m_Step(0)
+{
+}
+
+Causality::SimulationThread::~SimulationThread()
+{
+	Stop();
+}
+
+void Causality::SimulationThread::Start(std::unique_ptr<WorldBranch>&& pTree)
+{
+	Stop();
+	m_pTree = std::move(pTree);
+	m_Stopping = false;
+	m_pThread.reset(new std::thread(&SimulationThread::Run, this));
+}
+
+void Causality::SimulationThread::Stop()
+{
+	if (!m_pThread)
+		return;
+	m_Stopping = true;
+	m_pThread->join();
+	m_pThread.reset();
+}
+
+void Causality::SimulationThread::SetHands(const HandFrame & frame, const DirectX::Matrix4x4 & toWorld)
+{
+	auto& input = m_Inputs.Back();
+	input.Frame = frame;
+	input.ToWorld = toWorld;
+	m_Inputs.Publish();
+}
+
+void Causality::SimulationThread::Post(Command && command)
+{
+	std::lock_guard<std::mutex> guard(m_CommandMutex);
+	m_Commands.push_back(std::move(command));
+}
+
+bool Causality::SimulationThread::AcquireSnapshot()
+{
+	return m_Snapshots.Acquire();
+}
+
+void Causality::SimulationThread::Run()
+{
+	auto step = std::chrono::duration_cast<simulation_clock::duration>(std::chrono::duration<float>(m_StepTime));
+	auto next = simulation_clock::now();
+	while (!m_Stopping)
+	{
+		RunCommands();
+
+		m_Inputs.Acquire();
+		const auto& input = m_Inputs.Front();
+		m_pTree->Evolution(m_StepTime, input.Frame, input.ToWorld);
+		// Every step, hands lost included, so the beam stays bounded
+		m_pTree->Collapse();
+		Publish();
+
+		next += step;
+		// More than a few steps behind, drop them instead of spiralling
+		auto now = simulation_clock::now();
+		if (now > next + 4 * step)
+			next = now;
+		std::this_thread::sleep_until(next);
+	}
+	RunCommands();
+}
+
+void Causality::SimulationThread::RunCommands()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_CommandMutex);
+		m_RunningCommands.swap(m_Commands);
+	}
+	for (auto& command : m_RunningCommands)
+		command(*m_pTree);
+	m_RunningCommands.clear();
+}
+
+void Causality::SimulationThread::Publish()
+{
+	auto& snapshot = m_Snapshots.Back();
+	snapshot.PreviousStates = m_LastStates;
+	m_pTree->CaculateSuperposition(snapshot.States);
+	m_LastStates = snapshot.States;
+
+	snapshot.Subjects.clear();
+	for (const auto& branch : m_pTree->leaves())
+	{
+		for (const auto& item : branch.Subjects)
+		{
+			if (item.second)
+				item.second->AppendCapsules(snapshot.Subjects, branch.Liklyhood());
+		}
+	}
+
+	snapshot.Step = ++m_Step;
+	snapshot.PublishTime = simulation_clock::now();
+	m_Snapshots.Publish();
+}
+
+void Causality::SimulationThread::Interpolate(const SimulationSnapshot & snapshot, float stepTime, SuperpositionTable & states)
+{
+	const auto& current = snapshot.States;
+	const auto& previous = snapshot.PreviousStates;
+	states = current;
+	if (snapshot.Step == 0)
+		return;
+
+	// Render one step behind : previous states at publish time, current states one step later
+	float alpha = std::chrono::duration<float>(simulation_clock::now() - snapshot.PublishTime).count() / stepTime;
+	alpha = std::min(std::max(alpha, 0.0f), 1.0f);
+	if (alpha >= 1.0f)
+		return;
+
+	auto objectCount = std::min(current.ObjectCount(), previous.ObjectCount());
+	for (size_t id = 0; id < objectCount; id++)
+	{
+		const auto& range = current.Objects[id];
+		const auto& prevRange = previous.Objects[id];
+		if (prevRange.Count == 0)
+			continue;
+		for (size_t state = range.Offset; state < range.Offset + range.Count; state++)
+		{
+			// Clusters may split or merge between steps, start from the nearest state of last step
+			XMVECTOR position = current.Positions[state];
+			size_t from = prevRange.Offset;
+			float nearest = FLT_MAX;
+			for (size_t prev = prevRange.Offset; prev < prevRange.Offset + prevRange.Count; prev++)
+			{
+				float distance = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(position, previous.Positions[prev])));
+				if (distance < nearest)
+				{
+					nearest = distance;
+					from = prev;
+				}
+			}
+
+			states.Positions[state] = XMVectorLerp(previous.Positions[from], position, alpha);
+			states.Orientations[state] = XMQuaternionSlerp(previous.Orientations[from], current.Orientations[state], alpha);
+			states.Scales[state] = XMVectorLerp(previous.Scales[from], current.Scales[state], alpha);
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "WorldBranch.h"
+#include "Common\TripleBuffer.h"
+#include <chrono>
+
+namespace Causality
+{
+	// Immutable result of one simulation step
+	struct SimulationSnapshot
+	{
+		SimulationSnapshot() : Step(0) {}
+
+		// Superposition of the step before, for interpolation
+		SuperpositionTable			PreviousStates;
+		SuperpositionTable			States;
+		std::vector<SubjectCapsule>	Subjects;
+		// Number of steps simulated, 0 if nothing is published yet
+		uint64_t					Step;
+		std::chrono::high_resolution_clock::time_point	PublishTime;
+	};
+
+	// Runs the branch tree on its own thread at a fixed time step
+	// Input frames and results go through wait-free triple buffers, so neither the device nor the render thread waits for physics
+	// Everything else touching the tree is posted as a command and runs on the simulation thread between steps
+	class SimulationThread
+	{
+	public:
+		typedef std::function<void(WorldBranch&)> Command;
+
+		explicit SimulationThread(float stepTime = 1.0f / 60.0f);
+		~SimulationThread();
+
+		SimulationThread(const SimulationThread&) = delete;
+		SimulationThread& operator=(const SimulationThread&) = delete;
+
+		void Start(std::unique_ptr<WorldBranch>&& pTree);
+		void Stop();
+		bool IsRunning() const { return m_pThread != nullptr; }
+
+		float StepTime() const { return m_StepTime; }
+
+		// Device thread, latest hands for the next step
+		void SetHands(const Platform::HandFrame& frame, const DirectX::Matrix4x4& toWorld);
+
+		// Any thread, runs before the next step
+		void Post(Command&& command);
+
+		// Render thread, pick up the latest snapshot, returns true if it changed
+		// The returned reference stays valid until next AcquireSnapshot
+		bool AcquireSnapshot();
+		const SimulationSnapshot& Snapshot() const { return m_Snapshots.Front(); }
+
+		// Interpolate snapshot's states to now, clamped to its own step
+		static void Interpolate(const SimulationSnapshot& snapshot, float stepTime, SuperpositionTable& states);
+
+	private:
+		struct HandInput
+		{
+			Platform::HandFrame	Frame;
+			DirectX::Matrix4x4	ToWorld;
+		};
+
+		void Run();
+		void RunCommands();
+		void Publish();
+
+		float								m_StepTime;
+		std::unique_ptr<WorldBranch>		m_pTree;
+		std::unique_ptr<std::thread>		m_pThread;
+		std::atomic<bool>					m_Stopping;
+
+		std::mutex							m_CommandMutex;
+		std::vector<Command>				m_Commands;
+		// Swapped with m_Commands, so commands run outside the lock
+		std::vector<Command>				m_RunningCommands;
+
+		TripleBuffer<HandInput>				m_Inputs;
+		TripleBuffer<SimulationSnapshot>	m_Snapshots;
+		// Simulation thread's own copy of the last published states
+		SuperpositionTable					m_LastStates;
+		uint64_t							m_Step;
+	};
+}
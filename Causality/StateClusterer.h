@@ -0,0 +1,124 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "Common\DirectXMathExtend.h"
+
+namespace Causality
+{
+	// Merge near-equal probabilistic states into clusters in (amortized) constant time per state
+	// Translation is quantized into a hash grid with cell size 2*tEpsilon, so any match within tEpsilon
+	// lies in the state's own cell or in the neighbour cell on the near side of each axis (8 probes)
+	// Rotation is compared with |dot(q0,q1)| >= cos(rEpsilon/2), which equals NearEqual without acosf
+	// _TState requires Translation (Vector3), Rotation (Quaternion) and Probability (float) members
+	// Buffers keep their capacity between Reset calls, so a per-frame clusterer does not allocate
+	template <class _TState>
+	class StateClusterer
+	{
+	public:
+		typedef _TState state_type;
+
+		explicit StateClusterer(float tEpsilon = 0.002f, float rEpsilon = 0.5f)
+		{
+			SetTolerance(tEpsilon, rEpsilon);
+			Reset(0);
+		}
+
+		void SetTolerance(float tEpsilon, float rEpsilon)
+		{
+			m_TEpsilonSq = tEpsilon * tEpsilon;
+			m_InvCellSize = 0.5f / tEpsilon;
+			m_CosHalfREpsilon = cosf(0.5f * rEpsilon);
+		}
+
+		// Clear all clusters, expectedCount sizes the hash table
+		void Reset(size_t expectedCount)
+		{
+			m_Clusters.clear();
+			m_Entries.clear();
+			size_t size = 16;
+			while (size < expectedCount * 2)
+				size <<= 1;
+			m_Buckets.assign(size, -1);
+			m_Mask = size - 1;
+		}
+
+		// Add a state, it's probability accumulates into the matching cluster if there is one
+		void Add(const state_type& state)
+		{
+			float fx = state.Translation.x * m_InvCellSize;
+			float fy = state.Translation.y * m_InvCellSize;
+			float fz = state.Translation.z * m_InvCellSize;
+			int cx = (int) floorf(fx), cy = (int) floorf(fy), cz = (int) floorf(fz);
+			// Neighbour on the near side of each axis
+			int nx = fx - cx < 0.5f ? cx - 1 : cx + 1;
+			int ny = fy - cy < 0.5f ? cy - 1 : cy + 1;
+			int nz = fz - cz < 0.5f ? cz - 1 : cz + 1;
+
+			for (int i = 0; i < 8; i++)
+			{
+				int c = Find(i & 1 ? nx : cx, i & 2 ? ny : cy, i & 4 ? nz : cz, state);
+				if (c >= 0)
+				{
+					m_Clusters[c].Probability += state.Probability;
+					return;
+				}
+			}
+
+			m_Clusters.push_back(state);
+			Insert(cx, cy, cz, (int) m_Clusters.size() - 1);
+		}
+
+		const std::vector<state_type>& Clusters() const { return m_Clusters; }
+
+	private:
+		struct Entry
+		{
+			int X, Y, Z;
+			int Cluster;
+			int Next;
+		};
+
+		static size_t Hash(int x, int y, int z)
+		{
+			return ((size_t) x * 73856093u) ^ ((size_t) y * 19349663u) ^ ((size_t) z * 83492791u);
+		}
+
+		bool Match(const state_type& cluster, const state_type& state) const
+		{
+			DirectX::XMVECTOR d = DirectX::XMVectorSubtract(cluster.Translation, state.Translation);
+			if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(d)) > m_TEpsilonSq)
+				return false;
+			float dot = DirectX::XMVectorGetX(DirectX::XMVector4Dot(cluster.Rotation, state.Rotation));
+			return fabsf(dot) >= m_CosHalfREpsilon;
+		}
+
+		int Find(int x, int y, int z, const state_type& state) const
+		{
+			for (int e = m_Buckets[Hash(x, y, z) & m_Mask]; e >= 0; e = m_Entries[e].Next)
+			{
+				const auto& entry = m_Entries[e];
+				if (entry.X == x && entry.Y == y && entry.Z == z && Match(m_Clusters[entry.Cluster], state))
+					return entry.Cluster;
+			}
+			return -1;
+		}
+
+		void Insert(int x, int y, int z, int cluster)
+		{
+			auto& bucket = m_Buckets[Hash(x, y, z) & m_Mask];
+			Entry entry = { x, y, z, cluster, bucket };
+			bucket = (int) m_Entries.size();
+			m_Entries.push_back(entry);
+		}
+
+		float					m_TEpsilonSq;
+		float					m_InvCellSize;
+		float					m_CosHalfREpsilon;
+		size_t					m_Mask;
+		std::vector<int>		m_Buckets;
+		std::vector<Entry>		m_Entries;
+		std::vector<state_type>	m_Clusters;
+	};
+}
@@ -0,0 +1,52 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\Benchmark\Fixtures.h"
+#include "..\Common\BoundsFitter.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Causality::Benchmark;
+using namespace DirectX;
+using namespace DirectX::Scene;
+
+namespace UnitTest
+{
+	TEST_CLASS(BoundsFitterTest)
+	{
+	public:
+
+		// Every point must be inside the box, oriented box and sphere, and they must be no looser than DirectXMath's own fits
+		TEST_METHOD(FitContainsPointsAndIsTight)
+		{
+			auto points = ElongatedCloud(1 << 18);
+			PointSetBounds bounds, repeat;
+			BoundsFitter::Fit(bounds, points.data(), points.size(), sizeof(Vector3));
+			BoundsFitter::Fit(repeat, points.data(), points.size(), sizeof(Vector3));
+			BoundingOrientedBox referenceBox;
+			BoundingSphere referenceSphere;
+			BoundingOrientedBox::CreateFromPoints(referenceBox, points.size(), points.data(), sizeof(Vector3));
+			BoundingSphere::CreateFromPoints(referenceSphere, points.size(), points.data(), sizeof(Vector3));
+
+			// Rounding of the centers and extents, relative to the distance from the origin
+			const float tolerance = 1e-3f;
+			XMVECTOR inverse = XMQuaternionInverse(XMLoadFloat4(&bounds.OrientedBox.Orientation));
+			float outside = 0;
+			for (const auto& p : points)
+			{
+				XMVECTOR local = XMVector3Rotate((XMVECTOR) p - XMLoadFloat3(&bounds.OrientedBox.Center), inverse);
+				outside = std::max(outside, XMVectorGetX(XMVector3Length(XMVectorMax(XMVectorAbs(local) - XMLoadFloat3(&bounds.OrientedBox.Extents), XMVectorZero()))));
+				outside = std::max(outside, XMVectorGetX(XMVector3Length(XMVectorMax(XMVectorAbs((XMVECTOR) p - XMLoadFloat3(&bounds.Box.Center)) - XMLoadFloat3(&bounds.Box.Extents), XMVectorZero()))));
+				outside = std::max(outside, XMVectorGetX(XMVector3Length((XMVECTOR) p - XMLoadFloat3(&bounds.Sphere.Center))) - bounds.Sphere.Radius);
+			}
+			Assert::IsTrue(outside < tolerance, L"A point is outside the bounds");
+
+			const auto& extents = bounds.OrientedBox.Extents;
+			const auto& referenceExtents = referenceBox.Extents;
+			Assert::IsTrue(extents.x >= extents.y && extents.y >= extents.z, L"Extents aren't sorted from bigger to smaller");
+			Assert::IsTrue(extents.x * extents.y * extents.z <= referenceExtents.x * referenceExtents.y * referenceExtents.z * 1.01f, L"Oriented box is looser than DirectXMath's");
+			Assert::IsTrue(bounds.Sphere.Radius <= referenceSphere.Radius * 1.01f, L"Sphere is looser than DirectXMath's");
+			Assert::IsTrue(memcmp(&bounds, &repeat, sizeof(bounds)) == 0, L"Fit isn't repeatable");
+		}
+	};
+}
@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\Benchmark\Fixtures.h"
+#include "..\DrawListBuilder.h"
+#include <cstring>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Causality;
+using namespace Causality::Benchmark;
+using namespace DirectX;
+
+namespace UnitTest
+{
+	TEST_CLASS(DrawListBuilderTest)
+	{
+	public:
+
+		// Culled in parallel, the list must be the serial one item for item
+		TEST_METHOD(BuildMatchesSerialReference)
+		{
+			SuperpositionTable table;
+			std::vector<BoundingOrientedBox> bounds;
+			std::vector<uint32_t> batchKeys;
+			SyntheticSuperposition(table, bounds, batchKeys);
+			BoundingFrustum frustums[2];
+			StereoFrustums(frustums);
+
+			DrawListBuilder builder, reference;
+			builder.SetViews(frustums, 2);
+			reference.SetViews(frustums, 2);
+			builder.Build(table, bounds.data(), batchKeys.data(), DrawObjectCount);
+			reference.BuildSerial(table, bounds.data(), batchKeys.data(), DrawObjectCount);
+
+			const auto& items = builder.Items();
+			const auto& expected = reference.Items();
+			Assert::IsFalse(expected.empty(), L"No state is visible, the test scene is wrong");
+			Assert::AreEqual(expected.size(), items.size(), L"Draw list size differs from the serial reference");
+			Assert::AreEqual(reference.OpaqueCount(), builder.OpaqueCount(), L"Opaque count differs from the serial reference");
+			for (size_t i = 0; i < items.size(); i++)
+				Assert::IsTrue(memcmp(&items[i], &expected[i], sizeof(DrawItem)) == 0, L"Draw item differs from the serial reference");
+
+			// Built again into the same builder, nothing is left over from the first build
+			builder.Build(table, bounds.data(), batchKeys.data(), DrawObjectCount);
+			Assert::AreEqual(expected.size(), builder.Items().size(), L"Rebuild changed the draw list");
+		}
+	};
+}
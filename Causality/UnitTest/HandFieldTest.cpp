@@ -0,0 +1,48 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\Benchmark\Fixtures.h"
+#include <algorithm>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Causality;
+using namespace Causality::Benchmark;
+using namespace DirectX;
+
+namespace UnitTest
+{
+	TEST_CLASS(SegmentFieldBatchTest)
+	{
+	public:
+
+		// Batched over points, the field must be the sum of FieldSegmentToPoint over the bones
+		TEST_METHOD(EvaluateMatchesScalarReference)
+		{
+			auto frame = SyntheticHandFrame(0);
+			auto segments = HandSegments(frame);
+			auto points = FieldSamplePoints(frame);
+			SegmentFieldBatch batch;
+			batch.Reset(segments.data(), segments.size());
+			Assert::AreEqual(segments.size(), batch.SegmentCount(), L"Segments were lost in Reset");
+
+			std::vector<Vector3> fields(points.size());
+			batch.Evaluate(points.data(), fields.data(), points.size());
+
+			float maxError = 0;
+			for (size_t i = 0; i < points.size(); i++)
+			{
+				XMVECTOR reference = XMVectorZero();
+				for (const auto& segment : segments)
+					reference += FieldSegmentToPoint(points[i], segment.first, segment.second);
+				float error = XMVectorGetX(XMVector3Length(XMVectorSubtract(reference, fields[i]))) / XMVectorGetX(XMVector3Length(reference));
+				maxError = std::max(maxError, error);
+			}
+			Assert::IsTrue(maxError < 1e-3f, L"Batched field differs from the scalar reference");
+
+			// Points and fields may alias, and a count that isn't a multiple of 4 takes the tail path
+			std::vector<Vector3> inPlace(points.begin(), points.begin() + 7);
+			batch.Evaluate(inPlace.data(), inPlace.data(), inPlace.size());
+			for (size_t i = 0; i < inPlace.size(); i++)
+				Assert::IsTrue(XMVector3NearEqual(inPlace[i], fields[i], XMVectorReplicate(1e-5f * XMVectorGetX(XMVector3Length(fields[i])))), L"Aliased evaluation differs");
+		}
+	};
+}
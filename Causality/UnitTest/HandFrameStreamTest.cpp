@@ -0,0 +1,87 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\Benchmark\Fixtures.h"
+#include "..\HandFrameStream.h"
+#include <cstring>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Causality::Benchmark;
+using namespace DirectX;
+using namespace Platform;
+using namespace Platform::Devices;
+
+namespace UnitTest
+{
+	// Synthetic frame i with the given number of hands, the second one is the first mirrored
+	static HandFrame FrameWithHands(size_t index, uint32_t handCount)
+	{
+		auto frame = SyntheticHandFrame(index);
+		frame.HandStates[1] = frame.HandStates[0];
+		frame.HandStates[1].Id = 2;
+		frame.HandStates[1].IsLeft = 1;
+		frame.HandStates[1].PalmPosition.x = -frame.HandStates[1].PalmPosition.x;
+		frame.HandCount = handCount;
+		return frame;
+	}
+
+	static bool SameFrame(const HandFrame& lhs, const HandFrame& rhs)
+	{
+		return lhs.Id == rhs.Id && lhs.Timestamp == rhs.Timestamp && lhs.HandCount == rhs.HandCount
+			&& memcmp(&lhs.ToWorld, &rhs.ToWorld, sizeof(XMFLOAT4X4)) == 0
+			&& memcmp(lhs.HandStates, rhs.HandStates, lhs.HandCount * sizeof(HandState)) == 0;
+	}
+
+	TEST_CLASS(HandFrameStreamTest)
+	{
+	public:
+
+		// Recorded frames read back unchanged, and replaying them fires the events LeapMotion would
+		TEST_METHOD(RecordReplayRoundTrip)
+		{
+			const uint32_t handCounts[] = { 1, 2, 2, 1, 0, 1 };
+			const size_t frameCount = sizeof(handCounts) / sizeof(handCounts[0]);
+			auto path = (boost::filesystem::temp_directory_path() / "causality_test_hands.bin").string();
+
+			HandFrameRecorder recorder;
+			Assert::IsTrue(recorder.Open(path), L"Can't open the recording");
+			for (size_t i = 0; i < frameCount; i++)
+				recorder.Write(FrameWithHands(i, handCounts[i]));
+			Assert::AreEqual(frameCount, recorder.FrameCount(), L"Recorder lost frames");
+			recorder.Close();
+
+			HandFrameReplay replay;
+			Assert::IsTrue(replay.Open(path), L"Can't open the recording for replay");
+			Assert::AreEqual(frameCount, replay.FrameCount(), L"Replay indexed a different number of frames");
+			HandFrame frame;
+			for (size_t i = 0; i < frameCount; i++)
+			{
+				Assert::IsTrue(replay.ReadFrame(i, frame), L"Recorded frame can't be read");
+				Assert::IsTrue(SameFrame(FrameWithHands(i, handCounts[i]), frame), L"Frame read back differs from the recorded one");
+			}
+			Assert::IsFalse(replay.ReadFrame(frameCount, frame), L"Read past the last frame");
+
+			// T for tracked, L for lost, M for move, frames separated by spaces
+			std::string events;
+			bool transformsMatch = true;
+			auto onEvent = [&events, &transformsMatch](char kind, const UserHandsEventArgs& e)
+			{
+				events += kind;
+				transformsMatch = transformsMatch && memcmp(&e.toWorldTransform, &e.frame.ToWorld, sizeof(XMFLOAT4X4)) == 0;
+			};
+			replay.HandsTracked.connect([&onEvent](const UserHandsEventArgs& e) { onEvent('T', e); });
+			replay.HandsLost.connect([&onEvent](const UserHandsEventArgs& e) { onEvent('L', e); });
+			replay.HandsMove.connect([&onEvent](const UserHandsEventArgs& e) { onEvent('M', e); });
+			while (replay.PullFrame())
+			{
+				Assert::IsTrue(SameFrame(FrameWithHands(replay.Position() - 1, handCounts[replay.Position() - 1]), replay.CurrentFrame()), L"Pulled frame differs from the recorded one");
+				events += ' ';
+			}
+			replay.Close();
+			boost::filesystem::remove(path);
+
+			Assert::IsTrue(events == "TM TM M LM L TM ", L"Replay fired the wrong events");
+			Assert::IsTrue(transformsMatch, L"Events don't carry the recorded world transform");
+		}
+	};
+}
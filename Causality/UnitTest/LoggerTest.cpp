@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\Common\Logger.h"
+#include <boost\filesystem.hpp>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	// Messages of the lines in the log file, without the time, level and category
+	static std::vector<std::string> ReadMessages(const std::string& path, const char* level, const char* category)
+	{
+		std::vector<std::string> messages;
+		std::ifstream file(path);
+		std::string prefix = std::string("] [") + level + "] [" + category + "] ";
+		std::string line;
+		while (std::getline(file, line))
+		{
+			auto at = line.find(prefix);
+			if (at != std::string::npos)
+				messages.push_back(line.substr(at + prefix.size()));
+		}
+		return messages;
+	}
+
+	TEST_CLASS(LoggerTest)
+	{
+	public:
+
+		// After Flush every record logged before is in the file, each thread's records in the order they were logged
+		TEST_METHOD(FlushWritesOrderedRecords)
+		{
+			const int threadCount = 4, recordsPerThread = 200;
+			auto path = (boost::filesystem::temp_directory_path() / "causality_test_log.txt").string();
+			// Whatever other tests logged before is drained first, so the file only has this test's records
+			Causality::Logger::Flush();
+			Causality::Logger::Start(false, path.c_str());
+
+			std::vector<std::thread> threads;
+			for (int t = 0; t < threadCount; t++)
+			{
+				threads.emplace_back([t, recordsPerThread]()
+				{
+					for (int i = 0; i < recordsPerThread; i++)
+						LOG_INFO(Causality::Log_Render, "thread %d record %d", t, i);
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+			LOG_DEBUG(Causality::Log_Simulation, "below the level");
+			LOG_WARNING(Causality::Log_Simulation, "%s then %s", "first", "second");
+			// Checked on the sink thread, written as a diagnostic instead of passed to printf
+			Causality::Logger::Write(Causality::LogLevel::Warning, Causality::Log_Simulation, "count %d", "not a number");
+			LOG_WARNING(Causality::Log_Simulation, "last %.2f", 0.5);
+			Causality::Logger::Flush();
+
+			auto render = ReadMessages(path, "INFO", "Render");
+			auto simulation = ReadMessages(path, "WARNING", "Simulation");
+			Causality::Logger::Stop();
+			boost::filesystem::remove(path);
+
+			Assert::AreEqual((size_t) (threadCount * recordsPerThread), render.size(), L"Records are missing after Flush");
+			std::vector<int> next(threadCount, 0);
+			bool ordered = true;
+			for (const auto& message : render)
+			{
+				int t = -1, i = -1;
+				if (sscanf_s(message.c_str(), "thread %d record %d", &t, &i) != 2 || t < 0 || t >= threadCount || i != next[t]++)
+					ordered = false;
+			}
+			Assert::IsTrue(ordered, L"A thread's records are out of order");
+
+			Assert::AreEqual((size_t) 3, simulation.size(), L"Wrong number of warnings, or a record below the level was written");
+			Assert::IsTrue(simulation[0] == "first then second", L"Strings weren't formatted");
+			Assert::IsTrue(simulation[1] == "Log arguments don't match format \"count %d\"", L"Mismatched arguments weren't caught");
+			Assert::IsTrue(simulation[2] == "last 0.50", L"Last record before Flush is missing");
+		}
+	};
+}
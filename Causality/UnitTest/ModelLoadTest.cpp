@@ -0,0 +1,291 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\Benchmark\Fixtures.h"
+#include "..\Common\ObjParser.h"
+#include "..\Common\MeshOptimizer.h"
+#include "..\Common\TangentFrame.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cstring>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Causality::Benchmark;
+using namespace DirectX;
+using namespace DirectX::Scene;
+
+namespace UnitTest
+{
+	// OBJ files of the tests live next to the benchmark's, under their own names
+	static boost::filesystem::path TestObj(const char* name)
+	{
+		return boost::filesystem::temp_directory_path() / name;
+	}
+
+	TEST_CLASS(ObjLoadTest)
+	{
+	public:
+
+		// The chunked parser must give tiny_obj_loader's shapes
+		TEST_METHOD(ParseMatchesTinyObj)
+		{
+			auto file = TestObj("causality_test_parse_spheres.obj");
+			WriteSphereObj(file.string(), 64, 32, 4);
+			std::vector<tinyobj::shape_t> shapes, expected;
+			std::vector<tinyobj::material_t> materials, expectedMaterials;
+			ObjParser::Load(shapes, materials, file.wstring());
+			tinyobj::LoadObj(expected, expectedMaterials, file.string().c_str(), (file.parent_path().string() + "/").c_str());
+
+			Assert::AreEqual(expected.size(), shapes.size(), L"Shape count differs from tiny_obj_loader's");
+			for (size_t i = 0; i < shapes.size(); i++)
+			{
+				Assert::IsTrue(shapes[i].name == expected[i].name, L"Shape name differs from tiny_obj_loader's");
+				Assert::IsTrue(shapes[i].mesh.indices == expected[i].mesh.indices, L"Indices differ from tiny_obj_loader's");
+				Assert::IsTrue(shapes[i].mesh.material_ids == expected[i].mesh.material_ids, L"Material ids differ from tiny_obj_loader's");
+				Assert::AreEqual(expected[i].mesh.positions.size(), shapes[i].mesh.positions.size(), L"Position count differs from tiny_obj_loader's");
+			}
+		}
+
+		// The cached model must be the parsed one, byte for byte
+		TEST_METHOD(CachedModelMatchesParsed)
+		{
+			auto file = TestObj("causality_test_sphere.obj");
+			WriteSphereObj(file.string(), 128, 64);
+			GeometryModel parsed, cached;
+			LoadObjUncached(parsed, file);
+			Assert::IsTrue(boost::filesystem::exists(CacheFileFor(file)), L"First load didn't write the mesh cache");
+			LoadObj(cached, file);
+
+			Assert::IsFalse(parsed.Vertices.empty(), L"Nothing was loaded");
+			Assert::AreEqual(parsed.Vertices.size(), cached.Vertices.size());
+			Assert::AreEqual(parsed.Facets.size(), cached.Facets.size());
+			Assert::AreEqual(parsed.Parts.size(), cached.Parts.size());
+			Assert::IsTrue(memcmp(parsed.Vertices.data(), cached.Vertices.data(), parsed.Vertices.size() * sizeof(parsed.Vertices[0])) == 0, L"Cached vertices differ");
+			Assert::IsTrue(memcmp(parsed.Facets.data(), cached.Facets.data(), parsed.Facets.size() * sizeof(parsed.Facets[0])) == 0, L"Cached facets differ");
+			Assert::IsTrue(memcmp(&parsed.BoundOrientedBox, &cached.BoundOrientedBox, sizeof(parsed.BoundOrientedBox)) == 0, L"Cached bounds differ");
+		}
+
+		// The whole part keeps 32 bit indices, every meshlet fits 16 bit ones and together they draw the same triangles
+		TEST_METHOD(SplitPartsDrawSameTriangles)
+		{
+			auto file = TestObj("causality_test_large_sphere.obj");
+			WriteSphereObj(file.string(), 512, 256);
+			GeometryModel whole, split;
+			LoadObjUncached(whole, file);
+			LoadObjUncached(split, file, ModelLoad_SplitLargeParts);
+
+			Assert::AreEqual(size_t(1), whole.Parts.size());
+			Assert::IsTrue(whole.Parts[0]->pMesh->IndexFormat == DXGI_FORMAT_R32_UINT, L"Part over 16 bit range must use 32 bit indices");
+			Assert::IsTrue(split.Parts.size() > 1, L"Large part wasn't split");
+			Assert::AreEqual(whole.Facets.size(), split.Facets.size());
+			size_t facet = 0;
+			for (const auto& part : split.Parts)
+			{
+				const auto& mesh = *part->pMesh;
+				Assert::IsTrue(mesh.VertexCount <= GeometryModel::MaxShortIndexVertexCount && mesh.IndexFormat == DXGI_FORMAT_R16_UINT, L"Meshlet doesn't fit 16 bit indices");
+				for (uint32_t f = 0; f < mesh.IndexCount / 3; f++, facet++)
+				{
+					for (int k = 0; k < 3; k++)
+					{
+						const auto& expected = whole.Vertices[whole.Facets[facet][k]].position;
+						const auto& actual = split.Vertices[mesh.VertexOffset + split.Facets[facet][k]].position;
+						Assert::IsTrue(memcmp(&expected, &actual, sizeof(expected)) == 0, L"Meshlet triangle differs from the whole part's");
+					}
+				}
+			}
+		}
+
+		// The optimized model must draw the same triangles with fewer simulated vertex shader runs, part by part
+		TEST_METHOD(OptimizedPartsMissLess)
+		{
+			auto file = TestObj("causality_test_spheres.obj");
+			WriteSphereObj(file.string(), 64, 32, 16);
+			GeometryModel plain, optimized;
+			LoadObjUncached(plain, file);
+			LoadObjUncached(optimized, file, ModelLoad_OptimizeVertexCache | ModelLoad_OptimizeOverdraw);
+
+			Assert::AreEqual(plain.Parts.size(), optimized.Parts.size());
+			Assert::AreEqual(plain.Facets.size(), optimized.Facets.size());
+			uint32_t missesBefore = 0, missesAfter = 0;
+			size_t facet = 0;
+			for (size_t p = 0; p < plain.Parts.size(); p++)
+			{
+				const auto& mesh = *plain.Parts[p]->pMesh;
+				const auto& optimizedMesh = *optimized.Parts[p]->pMesh;
+				auto pBefore = reinterpret_cast<const uint32_t*>(plain.Facets.data() + facet);
+				auto pAfter = reinterpret_cast<const uint32_t*>(optimized.Facets.data() + facet);
+				auto before = MeshOptimizer::AnalyzeVertexCache(pBefore, mesh.IndexCount, mesh.VertexCount);
+				auto after = MeshOptimizer::AnalyzeVertexCache(pAfter, optimizedMesh.IndexCount, optimizedMesh.VertexCount);
+				missesBefore += before.Misses;
+				missesAfter += after.Misses;
+				Assert::IsTrue(after.Misses <= before.Misses, L"Part has more vertex cache misses after optimizing");
+
+				// Same triangles, compared by their corner positions
+				std::vector<std::array<float, 9>> expected(mesh.IndexCount / 3), actual(mesh.IndexCount / 3);
+				for (uint32_t i = 0; i < mesh.IndexCount; i++)
+				{
+					memcpy(&expected[i / 3][i % 3 * 3], &plain.Vertices[mesh.VertexOffset + pBefore[i]].position, sizeof(XMFLOAT3));
+					memcpy(&actual[i / 3][i % 3 * 3], &optimized.Vertices[optimizedMesh.VertexOffset + pAfter[i]].position, sizeof(XMFLOAT3));
+				}
+				std::sort(expected.begin(), expected.end());
+				std::sort(actual.begin(), actual.end());
+				Assert::IsTrue(expected == actual, L"Optimized part draws different triangles");
+				facet += mesh.IndexCount / 3;
+			}
+			Assert::IsTrue(missesAfter < missesBefore, L"Optimized model isn't cheaper to draw");
+		}
+
+		// Every level must be coarser than the one before, survive the mesh cache,
+		// and stray from the unit sphere by at most its error more than full detail does
+		TEST_METHOD(LodChainIsConsistent)
+		{
+			auto file = TestObj("causality_test_lod_sphere.obj");
+			WriteSphereObj(file.string(), 128, 64);
+			GeometryModel model, cached;
+			LoadObjUncached(model, file, ModelLoad_OptimizeVertexCache | ModelLoad_GenerateLods);
+			LoadObj(cached, file, ModelLoad_OptimizeVertexCache | ModelLoad_GenerateLods);
+
+			Assert::AreEqual(size_t(1), model.Parts.size());
+			const auto& mesh = *model.Parts[0]->pMesh;
+			const auto& cachedMesh = *cached.Parts[0]->pMesh;
+			Assert::IsFalse(mesh.Lods.empty(), L"No level of detail was generated");
+			Assert::IsTrue(model.LodIndices == cached.LodIndices, L"Cached level indices differ");
+			Assert::AreEqual(mesh.Lods.size(), cachedMesh.Lods.size());
+			Assert::AreEqual(size_t(0), mesh.SelectLod(0));
+			Assert::AreEqual(mesh.Lods.size(), mesh.SelectLod(FLT_MAX));
+
+			// Deepest triangle centroid under the sphere
+			auto deviation = [&](const uint32_t* pIndex, uint32_t indexCount) -> float
+			{
+				float deepest = 0;
+				for (uint32_t t = 0; t < indexCount; t += 3)
+				{
+					XMVECTOR centroid = XMVectorZero();
+					for (int k = 0; k < 3; k++)
+					{
+						Assert::IsTrue(pIndex[t + k] < mesh.VertexCount, L"Level index out of the part's vertices");
+						centroid += XMLoadFloat3(&model.Vertices[mesh.VertexOffset + pIndex[t + k]].position);
+					}
+					deepest = std::max(deepest, 1.0f - XMVectorGetX(XMVector3Length(centroid / 3)));
+				}
+				return deepest;
+			};
+			auto baseDeviation = deviation(reinterpret_cast<const uint32_t*>(model.Facets.data()), mesh.IndexCount);
+			auto pIndex = model.LodIndices.data();
+			uint32_t previousCount = mesh.IndexCount;
+			float previousError = 0;
+			for (size_t l = 0; l < mesh.Lods.size(); l++)
+			{
+				const auto& lod = mesh.Lods[l];
+				const auto& cachedLod = cachedMesh.Lods[l];
+				Assert::IsTrue(lod.IndexCount < previousCount, L"Level isn't coarser than the one before");
+				Assert::IsTrue(lod.Error >= previousError, L"Level error is smaller than the one before");
+				Assert::IsTrue(lod.StartIndex == cachedLod.StartIndex && lod.IndexCount == cachedLod.IndexCount && lod.Error == cachedLod.Error, L"Cached level differs");
+				Assert::IsTrue(deviation(pIndex, lod.IndexCount) <= baseDeviation + lod.Error + 1e-4f, L"Level strays further than its error");
+				previousCount = lod.IndexCount;
+				previousError = lod.Error;
+				pIndex += lod.IndexCount;
+			}
+		}
+
+		// Normals point out of the sphere, tangents along the parallels away from the poles, all with one handedness
+		// Generating them again must give the same bits, however the work was scheduled
+		TEST_METHOD(TangentFramesFollowSphere)
+		{
+			typedef VertexPositionNormalTexture VertexType;
+			auto file = TestObj("causality_test_textured_sphere.obj");
+			WriteTexturedSphereObj(file.string(), 128, 64);
+			GeometryModel model, cached;
+			LoadObjUncached(model, file, ModelLoad_GenerateTangents);
+			LoadObj(cached, file, ModelLoad_GenerateTangents);
+
+			Assert::AreEqual(size_t(1), model.Parts.size());
+			Assert::IsFalse(model.Vertices.empty(), L"Nothing was loaded");
+			Assert::AreEqual(model.Vertices.size(), model.Tangents.size());
+			Assert::AreEqual(model.Tangents.size(), cached.Tangents.size());
+			Assert::IsTrue(memcmp(model.Tangents.data(), cached.Tangents.data(), model.Tangents.size() * sizeof(XMFLOAT4)) == 0, L"Cached tangents differ");
+
+			float worstNormal = 1, worstTangent = 1;
+			float handedness = 0;
+			for (size_t v = 0; v < model.Vertices.size(); v++)
+			{
+				XMVECTOR p = XMVector3Normalize(XMLoadFloat3(&model.Vertices[v].position));
+				XMVECTOR n = XMLoadFloat3(&model.Vertices[v].normal);
+				XMVECTOR t = XMLoadFloat4(&model.Tangents[v]);
+				Assert::IsTrue(fabsf(XMVectorGetX(XMVector3Dot(n, t))) < 1e-3f, L"Tangent isn't orthogonal to the normal");
+				// Around the poles triangles are flat against them or degenerate
+				float ring = XMVectorGetX(XMVector3Length(p * XMVectorSet(1, 0, 1, 0)));
+				if (ring < 0.2f)
+					continue;
+				if (handedness == 0)
+					handedness = model.Tangents[v].w;
+				Assert::IsTrue(model.Tangents[v].w == handedness, L"Tangent frames don't share one handedness");
+				worstNormal = std::min(worstNormal, XMVectorGetX(XMVector3Dot(n, p)));
+				XMVECTOR parallel = XMVector3Normalize(XMVectorSet(-XMVectorGetZ(p), 0, XMVectorGetX(p), 0));
+				worstTangent = std::min(worstTangent, XMVectorGetX(XMVector3Dot(t, parallel)));
+			}
+			Assert::IsTrue(worstNormal > 0.999f, L"Normals don't point out of the sphere");
+			Assert::IsTrue(worstTangent > 0.99f, L"Tangents don't follow the parallels");
+
+			const auto& mesh = *model.Parts[0]->pMesh;
+			auto pIndex = reinterpret_cast<const uint32_t*>(model.Facets.data());
+			std::vector<XMFLOAT3> normals(model.Vertices.size()), repeatNormals(model.Vertices.size());
+			std::vector<XMFLOAT4> tangents(model.Vertices.size());
+			TangentFrame::ComputeNormals(&model.Vertices[0].position, sizeof(VertexType), model.Vertices.size(), pIndex, mesh.IndexCount, normals.data(), sizeof(XMFLOAT3));
+			TangentFrame::ComputeNormals(&model.Vertices[0].position, sizeof(VertexType), model.Vertices.size(), pIndex, mesh.IndexCount, repeatNormals.data(), sizeof(XMFLOAT3));
+			TangentFrame::ComputeTangents(&model.Vertices[0].position, sizeof(VertexType), &model.Vertices[0].normal, sizeof(VertexType), &model.Vertices[0].textureCoordinate, sizeof(VertexType),
+				model.Vertices.size(), pIndex, mesh.IndexCount, tangents.data());
+			Assert::IsTrue(memcmp(normals.data(), repeatNormals.data(), normals.size() * sizeof(XMFLOAT3)) == 0, L"Normals aren't repeatable");
+			Assert::IsTrue(memcmp(tangents.data(), model.Tangents.data(), tangents.size() * sizeof(XMFLOAT4)) == 0, L"Tangents aren't repeatable");
+		}
+
+		// Shapes are processed in parallel, each must still land in its own ranges with its own normals and bounds,
+		// and loading again must give the same bits
+		TEST_METHOD(ParallelPartsKeepTheirRanges)
+		{
+			const int partCount = 16;
+			auto file = TestObj("causality_test_parts.obj");
+			WriteSphereObj(file.string(), 64, 32, partCount);
+			GeometryModel model, repeat;
+			LoadObjUncached(model, file);
+			LoadObjUncached(repeat, file);
+
+			Assert::AreEqual(size_t(partCount), model.Parts.size());
+			Assert::AreEqual(model.Vertices.size(), repeat.Vertices.size());
+			Assert::AreEqual(model.Facets.size(), repeat.Facets.size());
+			Assert::IsTrue(memcmp(model.Vertices.data(), repeat.Vertices.data(), model.Vertices.size() * sizeof(model.Vertices[0])) == 0, L"Vertices depend on scheduling");
+			Assert::IsTrue(memcmp(model.Facets.data(), repeat.Facets.data(), model.Facets.size() * sizeof(model.Facets[0])) == 0, L"Facets depend on scheduling");
+
+			uint32_t vertexOffset = 0;
+			size_t facet = 0;
+			for (int i = 0; i < partCount; i++)
+			{
+				const auto& part = *model.Parts[i];
+				const auto& mesh = *part.pMesh;
+				Assert::AreEqual(vertexOffset, mesh.VertexOffset, L"Parts' vertex ranges aren't contiguous in part order");
+				Assert::IsTrue(memcmp(&part.BoundBox, &repeat.Parts[i]->BoundBox, sizeof(BoundingBox)) == 0, L"Part bounds depend on scheduling");
+
+				// Part i is a unit sphere around (2.5 i, 0, 0)
+				XMVECTOR center = XMVectorSet(2.5f * i, 0, 0, 0);
+				Assert::IsTrue(XMVector3NearEqual(XMLoadFloat3(&part.BoundBox.Center), center, XMVectorReplicate(1e-3f))
+					&& XMVector3NearEqual(XMLoadFloat3(&part.BoundBox.Extents), XMVectorReplicate(1.0f), XMVectorReplicate(1e-3f)), L"Part's bounds aren't its sphere's");
+				float worstNormal = 1;
+				for (uint32_t v = mesh.VertexOffset; v < mesh.VertexOffset + mesh.VertexCount; v++)
+				{
+					XMVECTOR p = XMLoadFloat3(&model.Vertices[v].position) - center;
+					Assert::IsTrue(fabsf(XMVectorGetX(XMVector3Length(p)) - 1.0f) < 1e-3f, L"Vertex belongs to another part");
+					worstNormal = std::min(worstNormal, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&model.Vertices[v].normal), p)));
+				}
+				Assert::IsTrue(worstNormal > 0, L"Normals were generated from another part's triangles");
+				for (uint32_t f = 0; f < mesh.IndexCount / 3; f++, facet++)
+				{
+					for (int k = 0; k < 3; k++)
+						Assert::IsTrue(model.Facets[facet][k] < mesh.VertexCount, L"Facet indexes outside its part");
+				}
+				vertexOffset += mesh.VertexCount;
+			}
+			Assert::AreEqual(model.Vertices.size(), size_t(vertexOffset), L"Vertices are left outside the parts");
+			Assert::AreEqual(model.Facets.size(), facet, L"Facets are left outside the parts");
+		}
+	};
+}
@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\ShapeDescriptorIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Causality;
+using namespace DirectX;
+
+namespace UnitTest
+{
+	static ShapeDescriptor RandomDescriptor(std::mt19937& gen)
+	{
+		std::uniform_real_distribution<float> extent(0.01f, 0.5f);
+		XMFLOAT3 extents(extent(gen), extent(gen), extent(gen));
+		std::vector<float> parts(gen() % 8);
+		for (auto& part : parts)
+			part = extent(gen) * 0.5f;
+		return ShapeDescriptor::Create(extents, parts.data(), parts.size());
+	}
+
+	TEST_CLASS(ShapeDescriptorIndexTest)
+	{
+	public:
+
+		// Descriptors don't depend on the shape's scale, and a shape is most similar to itself
+		TEST_METHOD(DescriptorIsScaleInvariant)
+		{
+			// Away from the histogram's bin boundaries, so rounding doesn't move a part to the next bin
+			const float parts[] = { 0.11f, 0.06f, 0.02f };
+			const float scaledParts[] = { 1.1f, 0.6f, 0.2f };
+			auto descriptor = ShapeDescriptor::Create(XMFLOAT3(0.1f, 0.3f, 0.2f), parts, 3);
+			auto scaled = ShapeDescriptor::Create(XMFLOAT3(1.0f, 3.0f, 2.0f), scaledParts, 3);
+
+			Assert::IsTrue(fabsf(ShapeDescriptorIndex::Similarity(descriptor, scaled) - 1.0f) < 1e-3f, L"Scaled shape isn't identical");
+			Assert::IsTrue(descriptor.ExtentRatios[0] >= descriptor.ExtentRatios[1], L"Extent ratios aren't sorted");
+			float histogram = 0;
+			for (auto bin : descriptor.PartHistogram)
+				histogram += bin;
+			Assert::IsTrue(fabsf(histogram - 1.0f) < 1e-5f, L"Part histogram doesn't sum to 1");
+		}
+
+		// Query gives every indexed shape's Similarity by id, and the k best of them in order
+		TEST_METHOD(QueryMatchesSimilarity)
+		{
+			std::mt19937 gen(5);
+			std::vector<ShapeDescriptor> descriptors;
+			std::vector<unsigned> ids;
+			ShapeDescriptorIndex index;
+			// Sparse ids, and a count which isn't a multiple of the SIMD width
+			for (unsigned i = 0; i < 1001; i++)
+			{
+				descriptors.push_back(RandomDescriptor(gen));
+				ids.push_back(3 * i + 1);
+				index.Add(ids.back(), descriptors.back());
+			}
+			Assert::AreEqual(descriptors.size(), index.Count(), L"Shapes were lost");
+
+			auto query = RandomDescriptor(gen);
+			const size_t k = 7;
+			std::vector<float> similarities;
+			std::vector<ShapeDescriptorIndex::Match> topK;
+			index.Query(query, k, similarities, topK);
+
+			Assert::IsTrue(similarities.size() > ids.back(), L"Similarities aren't indexed by id");
+			std::vector<ShapeDescriptorIndex::Match> reference;
+			for (size_t i = 0; i < ids.size(); i++)
+			{
+				float similarity = ShapeDescriptorIndex::Similarity(query, descriptors[i]);
+				Assert::IsTrue(fabsf(similarities[ids[i]] - similarity) < 1e-5f, L"Batched similarity differs from Similarity");
+				Assert::IsTrue(similarity >= 0 && similarity <= 1.0f + 1e-6f, L"Similarity is out of [0,1]");
+				ShapeDescriptorIndex::Match match = { ids[i], similarity };
+				reference.push_back(match);
+			}
+			for (unsigned id = 0; id < similarities.size(); id++)
+			{
+				if (id % 3 != 1)
+					Assert::IsTrue(similarities[id] == 0, L"An id which isn't indexed has a similarity");
+			}
+
+			std::sort(reference.begin(), reference.end(), [](const ShapeDescriptorIndex::Match& lhs, const ShapeDescriptorIndex::Match& rhs)
+			{
+				return lhs.Similarity > rhs.Similarity;
+			});
+			Assert::AreEqual(k, topK.size(), L"Wrong number of best matches");
+			for (size_t i = 0; i < k; i++)
+			{
+				Assert::IsTrue(fabsf(topK[i].Similarity - reference[i].Similarity) < 1e-5f, L"Best matches aren't the most similar shapes in order");
+				Assert::IsTrue(fabsf(similarities[topK[i].Id] - topK[i].Similarity) < 1e-5f, L"Best match's id doesn't carry its similarity");
+			}
+
+			index.Clear();
+			index.Query(query, k, similarities, topK);
+			Assert::AreEqual((size_t) 0, index.Count(), L"Clear kept shapes");
+			Assert::AreEqual((size_t) 0, topK.size(), L"Empty index has matches");
+		}
+	};
+}
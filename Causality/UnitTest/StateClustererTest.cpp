@@ -0,0 +1,98 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\WorldBranch.h"
+#include <random>
+#include <cmath>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Causality;
+using namespace DirectX;
+
+namespace UnitTest
+{
+	static const float TEpsilon = 0.002f;
+	static const float REpsilon = 0.5f;
+
+	static ProblistiscAffineTransform MakeState(const Vector3& translation, const Quaternion& rotation, float probability)
+	{
+		ProblistiscAffineTransform state;
+		state.Translation = translation;
+		state.Rotation = rotation;
+		state.Scale = Vector3(1.0f, 1.0f, 1.0f);
+		state.Probability = probability;
+		return state;
+	}
+
+	// Brute force version of the clusterer's rule, a state starts a new cluster only if no cluster matches it
+	static size_t ReferenceClusterCount(const std::vector<ProblistiscAffineTransform>& states)
+	{
+		std::vector<const ProblistiscAffineTransform*> clusters;
+		for (const auto& state : states)
+		{
+			bool matched = false;
+			for (auto pCluster : clusters)
+			{
+				XMVECTOR d = XMVectorSubtract(pCluster->Translation, state.Translation);
+				float dot = XMVectorGetX(XMVector4Dot(pCluster->Rotation, state.Rotation));
+				if (XMVectorGetX(XMVector3LengthSq(d)) <= TEpsilon * TEpsilon && fabsf(dot) >= cosf(0.5f * REpsilon))
+				{
+					matched = true;
+					break;
+				}
+			}
+			if (!matched)
+				clusters.push_back(&state);
+		}
+		return clusters.size();
+	}
+
+	TEST_CLASS(StateClustererTest)
+	{
+	public:
+
+		// Near states merge even across a grid cell boundary, their probabilities add up
+		TEST_METHOD(NearStatesMerge)
+		{
+			StateClusterer<ProblistiscAffineTransform> clusterer(TEpsilon, REpsilon);
+			clusterer.Reset(4);
+			// Cells are 2*TEpsilon wide, so these two straddle the boundary at x = 0.004
+			clusterer.Add(MakeState(Vector3(0.0039f, 0.1f, 0.1f), XMQuaternionIdentity(), 0.25f));
+			clusterer.Add(MakeState(Vector3(0.0041f, 0.1f, 0.1f), XMQuaternionIdentity(), 0.5f));
+			// q and -q are the same rotation
+			clusterer.Add(MakeState(Vector3(0.004f, 0.1f, 0.1f), XMQuaternionNegate(XMQuaternionIdentity()), 0.125f));
+			// Too far away, and too far rotated
+			clusterer.Add(MakeState(Vector3(0.01f, 0.1f, 0.1f), XMQuaternionIdentity(), 0.0625f));
+			clusterer.Add(MakeState(Vector3(0.004f, 0.1f, 0.1f), XMQuaternionRotationAxis(g_XMIdentityR1, 1.0f), 0.0625f));
+
+			const auto& clusters = clusterer.Clusters();
+			Assert::AreEqual((size_t) 3, clusters.size(), L"Wrong number of clusters");
+			Assert::IsTrue(clusters[0].Probability == 0.875f, L"Merged probability isn't the sum of the states'");
+			Assert::IsTrue(clusters[1].Probability == 0.0625f && clusters[2].Probability == 0.0625f, L"Separate states were merged");
+
+			clusterer.Reset(0);
+			Assert::AreEqual((size_t) 0, clusterer.Clusters().size(), L"Reset kept clusters");
+		}
+
+		// The hash grid finds the same number of clusters as comparing against every cluster
+		TEST_METHOD(MatchesBruteForce)
+		{
+			std::mt19937 random(7);
+			std::uniform_real_distribution<float> position(-0.01f, 0.01f);
+			std::uniform_real_distribution<float> angle(-0.6f, 0.6f);
+			std::vector<ProblistiscAffineTransform> states;
+			for (int i = 0; i < 2000; i++)
+				states.push_back(MakeState(Vector3(position(random), position(random), position(random)), XMQuaternionRotationAxis(g_XMIdentityR2, angle(random)), 1.0f / 2000));
+
+			StateClusterer<ProblistiscAffineTransform> clusterer(TEpsilon, REpsilon);
+			clusterer.Reset(states.size());
+			for (const auto& state : states)
+				clusterer.Add(state);
+
+			float total = 0;
+			for (const auto& cluster : clusterer.Clusters())
+				total += cluster.Probability;
+			Assert::AreEqual(ReferenceClusterCount(states), clusterer.Clusters().size(), L"Cluster count differs from brute force");
+			Assert::AreEqual(1.0f, total, 1e-4f, L"Probability was lost");
+		}
+	};
+}
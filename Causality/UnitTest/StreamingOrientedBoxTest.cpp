@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\Benchmark\Fixtures.h"
+#include "..\Common\DirectXMathExtend.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Causality;
+using namespace Causality::Benchmark;
+using namespace DirectX;
+
+namespace UnitTest
+{
+	// Points of a uniform grid filling a box, where sqrt(3) sigma is close to the exact extent
+	static std::vector<Vector3> BoxGrid(const XMFLOAT3& extents, FXMVECTOR rotation, FXMVECTOR center)
+	{
+		const int steps = 40;
+		std::vector<Vector3> points;
+		for (int i = 0; i <= steps; i++)
+			for (int j = 0; j <= steps; j++)
+				for (int k = 0; k <= steps; k++)
+				{
+					XMVECTOR local = XMVectorSet(extents.x * (2.0f * i / steps - 1), extents.y * (2.0f * j / steps - 1), extents.z * (2.0f * k / steps - 1), 0);
+					points.push_back(XMVector3Rotate(local, rotation) + center);
+				}
+		return points;
+	}
+
+	// Each axis of lhs must match some axis of rhs up to sign, with the same extent within relative tolerance
+	static bool SameAxes(const BoundingOrientedBox& lhs, const BoundingOrientedBox& rhs, float tolerance)
+	{
+		XMMATRIX lhsAxes = XMMatrixRotationQuaternion(XMLoadFloat4(&lhs.Orientation));
+		XMMATRIX rhsAxes = XMMatrixRotationQuaternion(XMLoadFloat4(&rhs.Orientation));
+		const float* lhsExtents = &lhs.Extents.x;
+		const float* rhsExtents = &rhs.Extents.x;
+		for (int i = 0; i < 3; i++)
+		{
+			int match = 0;
+			float best = 0;
+			for (int j = 0; j < 3; j++)
+			{
+				float alignment = fabsf(XMVectorGetX(XMVector3Dot(lhsAxes.r[i], rhsAxes.r[j])));
+				if (alignment > best)
+				{
+					best = alignment;
+					match = j;
+				}
+			}
+			if (best < 1.0f - tolerance || fabsf(lhsExtents[i] - rhsExtents[match]) > tolerance * rhsExtents[match])
+				return false;
+		}
+		return true;
+	}
+
+	TEST_CLASS(StreamingOrientedBoxTest)
+	{
+	public:
+
+		// On a box filled with points the moment based box is the one rebuilt from the points
+		TEST_METHOD(MatchesRebuiltBox)
+		{
+			XMFLOAT3 extents(0.2f, 0.1f, 0.05f);
+			XMVECTOR rotation = XMQuaternionRotationRollPitchYaw(0.3f, -0.7f, 1.1f);
+			XMVECTOR center = XMVectorSet(1.0f, 2.0f, -3.0f, 0);
+			auto points = BoxGrid(extents, rotation, center);
+			// Points which leave again must not change the box
+			auto outliers = ElongatedCloud(1000);
+
+			StreamingOrientedBox estimator;
+			estimator.Add(outliers.data(), outliers.size());
+			for (size_t i = 0; i < points.size(); i += 1000)
+				estimator.Add(&points[i], std::min<size_t>(1000, points.size() - i));
+			estimator.Remove(outliers.data(), outliers.size());
+			Assert::AreEqual(points.size(), estimator.Count(), L"Points were lost");
+
+			BoundingOrientedBox box, rebuilt;
+			estimator.GetBox(box);
+			CreateBoundingOrientedBoxFromPoints(rebuilt, points.size(), points.data(), sizeof(Vector3));
+
+			Assert::IsTrue(XMVector3NearEqual(XMLoadFloat3(&box.Center), XMLoadFloat3(&rebuilt.Center), XMVectorReplicate(1e-4f)), L"Centers differ");
+			Assert::IsTrue(box.Extents.x >= box.Extents.y && box.Extents.y >= box.Extents.z, L"Extents aren't sorted from bigger to smaller");
+			// A grid of 41 points per axis has sqrt(3) sigma 2.5% over the extent
+			Assert::IsTrue(SameAxes(box, rebuilt, 0.03f), L"Axes or extents differ from the rebuilt box");
+		}
+
+		// Sliding a window over the hand trace gives the box of the window's points added from scratch
+		TEST_METHOD(SlidingWindowMatchesFreshEstimator)
+		{
+			TraceWindow trace;
+			StreamingOrientedBox estimator;
+			for (size_t i = 0; i < 4 * TracePlotSize; i++)
+				PushTrace(trace, estimator, SyntheticHandFrame(i));
+
+			StreamingOrientedBox fresh;
+			for (size_t i = 0; i < trace.size(); i++)
+				fresh.Add(trace[i].data(), trace[i].size());
+			Assert::AreEqual(fresh.Count(), estimator.Count(), L"Window's point count differs");
+
+			BoundingOrientedBox box, reference;
+			estimator.GetBox(box);
+			fresh.GetBox(reference);
+			Assert::IsTrue(XMVector3NearEqual(XMLoadFloat3(&box.Center), XMLoadFloat3(&reference.Center), XMVectorReplicate(1e-4f)), L"Centers differ");
+			Assert::IsTrue(SameAxes(box, reference, 1e-3f), L"Axes or extents differ");
+		}
+	};
+}
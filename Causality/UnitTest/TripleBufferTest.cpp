@@ -0,0 +1,90 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\Common\TripleBuffer.h"
+#include <array>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Causality;
+
+namespace UnitTest
+{
+	// Every element holds the sequence number, a torn read shows up as a mismatch
+	struct Stamp
+	{
+		Stamp() { Values.fill(0); }
+		std::array<unsigned, 64> Values;
+	};
+
+	static bool IsWhole(const Stamp& stamp)
+	{
+		for (auto value : stamp.Values)
+		{
+			if (value != stamp.Values[0])
+				return false;
+		}
+		return true;
+	}
+
+	TEST_CLASS(TripleBufferTest)
+	{
+	public:
+
+		// Acquire only reports a value once, and always the latest one published
+		TEST_METHOD(AcquireReturnsLatestPublished)
+		{
+			TripleBuffer<int> buffer;
+			Assert::IsFalse(buffer.Acquire(), L"Acquired before anything was published");
+
+			buffer.Back() = 1;
+			buffer.Publish();
+			Assert::IsTrue(buffer.Acquire(), L"Published value wasn't acquired");
+			Assert::AreEqual(1, buffer.Front(), L"Acquired value isn't the published one");
+			Assert::IsFalse(buffer.Acquire(), L"Same value acquired twice");
+			Assert::AreEqual(1, buffer.Front(), L"Front changed without a new value");
+
+			// Values the consumer didn't pick up in time are overwritten
+			buffer.Back() = 2;
+			buffer.Publish();
+			buffer.Back() = 3;
+			buffer.Publish();
+			Assert::IsTrue(buffer.Acquire(), L"Published value wasn't acquired");
+			Assert::AreEqual(3, buffer.Front(), L"Acquired value isn't the latest one");
+			Assert::IsFalse(buffer.Acquire(), L"Overwritten value was acquired later");
+		}
+
+		// With the producer on another thread, the consumer sees whole values in publishing order
+		TEST_METHOD(ConcurrentHandoffIsWholeAndOrdered)
+		{
+			const unsigned publishCount = 200000;
+			TripleBuffer<Stamp> buffer;
+			std::thread producer([&buffer, publishCount]()
+			{
+				for (unsigned sequence = 1; sequence <= publishCount; sequence++)
+				{
+					buffer.Back().Values.fill(sequence);
+					buffer.Publish();
+				}
+			});
+
+			unsigned last = 0, acquired = 0;
+			bool whole = true, ordered = true;
+			while (last < publishCount)
+			{
+				if (!buffer.Acquire())
+					continue;
+				acquired++;
+				const auto& front = buffer.Front();
+				whole = whole && IsWhole(front);
+				ordered = ordered && front.Values[0] > last;
+				last = front.Values[0];
+			}
+			producer.join();
+
+			Assert::IsTrue(whole, L"Consumer saw a value while it was being written");
+			Assert::IsTrue(ordered, L"Consumer saw values out of order");
+			Assert::IsTrue(acquired > 0 && acquired <= publishCount, L"Acquire count is out of range");
+			Assert::IsFalse(buffer.Acquire(), L"Value acquired after the last one");
+		}
+	};
+}
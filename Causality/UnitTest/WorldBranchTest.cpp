@@ -0,0 +1,309 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\Benchmark\Fixtures.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Causality;
+using namespace Causality::Benchmark;
+using namespace DirectX;
+using namespace Platform;
+
+namespace UnitTest
+{
+	// Evolve the tree through frames [first, first + count) of the synthetic hand
+	static void EvolveTree(WorldBranch& tree, size_t first, size_t count)
+	{
+		for (size_t i = first; i < first + count; i++)
+		{
+			auto frame = SyntheticHandFrame(i);
+			tree.Evolution(StepTime, frame, XMLoadFloat4x4(&frame.ToWorld));
+		}
+	}
+
+	// Objects as the branch sees them, private or shared, must be in the same state
+	static bool SameObjectStates(const WorldBranch& lhs, const WorldBranch& rhs, size_t idBound)
+	{
+		for (unsigned id = 0; id < idBound; id++)
+		{
+			auto pLhs = lhs.GetItem(id);
+			auto pRhs = rhs.GetItem(id);
+			if (!pLhs || !pRhs)
+			{
+				if (pLhs != pRhs)
+					return false;
+				continue;
+			}
+			if (memcmp(&pLhs->GetPosition(), &pRhs->GetPosition(), sizeof(Vector3)) != 0
+				|| memcmp(&pLhs->GetOrientation(), &pRhs->GetOrientation(), sizeof(Quaternion)) != 0)
+				return false;
+			btVector3 lhsVelocity = pLhs->GetBulletRigid()->getLinearVelocity(), rhsVelocity = pRhs->GetBulletRigid()->getLinearVelocity();
+			if (lhsVelocity != rhsVelocity)
+				return false;
+		}
+		return true;
+	}
+
+	TEST_CLASS(WorldBranchTest)
+	{
+	public:
+
+		// A child starts from its parent's simulated state, with private copies of its private objects
+		TEST_METHOD(ForkedChildMatchesParent)
+		{
+			auto pTree = CreateBranchTree(SyntheticHandFrame(0));
+			EvolveTree(*pTree, 0, 60);
+
+			auto& parent = *pTree->leaves().begin();
+			AffineTransform subjectTransform;
+			subjectTransform.Scale = XMVectorReplicate(0.8f);
+			parent.Fork(std::vector<AffineTransform>(1, subjectTransform));
+			Assert::IsFalse(parent.is_leaf(), L"Fork added no child");
+			auto& child = *parent.children().begin();
+
+			Assert::IsTrue(child.IsEnabled, L"Forked child is disabled");
+			Assert::IsTrue(XMVector3Equal(child.SubjectTransform.Scale, subjectTransform.Scale), L"Forked child's subject transform isn't the one given");
+			Assert::IsTrue(child.StaticLayer == parent.StaticLayer, L"Forked child doesn't share the static layer");
+			Assert::IsTrue(child.SharedObjects == parent.SharedObjects, L"Forked child doesn't share the untouched objects");
+			Assert::IsTrue(SameObjectStates(child, parent, std::max(parent.Items.size(), parent.SharedObjects->IdBound())), L"Forked child's objects differ from the parent's");
+			for (size_t id = 0; id < parent.Items.size(); id++)
+			{
+				if (parent.Items[id])
+					Assert::IsTrue(id < child.Items.size() && child.Items[id] && child.Items[id].get() != parent.Items[id].get(), L"Private object isn't copied into the child");
+			}
+			Assert::AreEqual(parent.Subjects.size(), child.Subjects.size(), L"Forked child lost tracked hands");
+		}
+
+		// Objects are stored by their id, private copies in Items and untouched ones in the shared world
+		TEST_METHOD(ObjectsIndexedById)
+		{
+			auto shareUntouched = WorldBranch::ShareUntouchedObjects;
+			std::shared_ptr<btCollisionShape> pCube(new btBoxShape(btVector3(0.025f, 0.025f, 0.025f)));
+			const unsigned ids[] = { 5, 2 };
+			const Vector3 positions[] = { Vector3(0.1f, 0.2f, 0.3f), Vector3(-0.1f, 0.2f, -0.3f) };
+
+			for (int shared = 0; shared < 2; shared++)
+			{
+				WorldBranch::ShareUntouchedObjects = shared != 0;
+				auto pRoot = WorldBranch::DemandCreate("Root");
+				for (int i = 0; i < 2; i++)
+					pRoot->AddDynamicObject(ids[i], pCube, 1.0f, positions[i], Quaternion::Identity);
+
+				for (int i = 0; i < 2; i++)
+				{
+					auto pItem = pRoot->GetItem(ids[i]);
+					Assert::IsTrue(pItem != nullptr, L"Object isn't found by its id");
+					Assert::IsTrue(XMVector3NearEqual(pItem->GetPosition(), positions[i], XMVectorReplicate(1e-6f)), L"Object found by id is another one");
+				}
+				for (unsigned id : { 0u, 1u, 3u, 4u, 6u, 1000u })
+					Assert::IsTrue(pRoot->GetItem(id) == nullptr, L"An id which wasn't added has an object");
+
+				if (shared)
+				{
+					Assert::IsTrue(pRoot->Items.empty(), L"Untouched objects got private copies");
+					Assert::AreEqual((size_t) 6, pRoot->SharedObjects->IdBound(), L"Shared world isn't indexed by id");
+				}
+				else
+				{
+					Assert::AreEqual((size_t) 6, pRoot->Items.size(), L"Items aren't indexed by id");
+					Assert::IsTrue(pRoot->SharedObjects == nullptr, L"Private objects went to a shared world");
+				}
+				WorldBranch::Recycle(std::move(pRoot));
+			}
+			WorldBranch::ShareUntouchedObjects = shareUntouched;
+		}
+
+		// Concurrent demands grow the pool instead of failing, every branch is returned to it,
+		// and worlds are only built for branches which simulate something
+		TEST_METHOD(PoolGrowsUnderConcurrentDemand)
+		{
+			const size_t threadCount = 8, demandsPerThread = 20;
+			auto before = WorldBranch::PoolStatistics();
+
+			std::vector<std::thread> threads;
+			for (size_t t = 0; t < threadCount; t++)
+			{
+				threads.emplace_back([demandsPerThread]()
+				{
+					std::vector<std::unique_ptr<WorldBranch>> branches;
+					for (size_t i = 0; i < demandsPerThread; i++)
+						branches.push_back(WorldBranch::DemandCreate("Worker"));
+					for (auto& pBranch : branches)
+					{
+						if (pBranch)
+							WorldBranch::Recycle(std::move(pBranch));
+					}
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+
+			auto after = WorldBranch::PoolStatistics();
+			Assert::AreEqual(threadCount * demandsPerThread, (after.Hits + after.Misses) - (before.Hits + before.Misses), L"Demands were lost");
+			Assert::AreEqual(after.Misses - before.Misses, after.Growths - before.Growths, L"A miss didn't grow the pool");
+			Assert::AreEqual(after.Growths - before.Growths, after.Capacity - before.Capacity, L"Capacity doesn't follow growth");
+			Assert::AreEqual(before.Available + (after.Growths - before.Growths), after.Available, L"Branches weren't all returned to the pool");
+			Assert::AreEqual(before.WorldsCreated, after.WorldsCreated, L"Worlds were built for branches which never simulated");
+
+			// A recycled branch keeps its world for the next demand
+			auto shareUntouched = WorldBranch::ShareUntouchedObjects;
+			WorldBranch::ShareUntouchedObjects = false;
+			std::shared_ptr<btCollisionShape> pCube(new btBoxShape(btVector3(0.025f, 0.025f, 0.025f)));
+			for (int i = 0; i < 2; i++)
+			{
+				auto pBranch = WorldBranch::DemandCreate("Simulated");
+				pBranch->AddDynamicObject(1, pCube, 1.0f, Vector3(0, 0, 0), Quaternion::Identity);
+				WorldBranch::Recycle(std::move(pBranch));
+			}
+			WorldBranch::ShareUntouchedObjects = shareUntouched;
+			Assert::IsTrue(WorldBranch::PoolStatistics().WorldsCreated - after.WorldsCreated <= 1, L"Recycled branch rebuilt its world");
+		}
+
+		// Zero mass objects live once in a layer shared by the whole tree, an id already in it is kept
+		TEST_METHOD(StaticLayerSharedAndKeepsIds)
+		{
+			StaticCollisionLayer layer;
+			std::shared_ptr<btCollisionShape> pFloor(new btBoxShape(btVector3(1.0f, 0.01f, 1.0f)));
+			std::shared_ptr<btCollisionShape> pWall(new btBoxShape(btVector3(0.01f, 1.0f, 1.0f)));
+			Assert::IsTrue(layer.AddObject(3, pFloor, Vector3(0, -0.3f, 0)), L"New id was rejected");
+			Assert::IsFalse(layer.AddObject(3, pWall, Vector3(1.0f, 0, 0)), L"Duplicate id was accepted");
+			auto pObject = layer.GetCollisionObject(3);
+			Assert::IsTrue(pObject && pObject->getCollisionShape() == pFloor.get() && pObject->getWorldTransform().getOrigin().y() == -0.3f, L"Duplicate id replaced the existing object");
+			Assert::AreEqual((size_t) 4, layer.IdBound(), L"Layer isn't indexed by id");
+			Assert::IsTrue(layer.GetCollisionObject(0) == nullptr && layer.GetCollisionObject(4) == nullptr, L"An id which wasn't added has an object");
+
+			auto pTree = CreateBranchTree(SyntheticHandFrame(0));
+			auto pLayer = pTree->StaticLayer;
+			Assert::IsTrue(pLayer != nullptr, L"Static floor didn't go to the layer");
+			pTree->AddDynamicObject(0, pWall, 0, Vector3(1.0f, 0, 0), Quaternion::Identity);
+			Assert::IsTrue(pTree->StaticLayer == pLayer && pLayer->GetCollisionObject(0)->getCollisionShape() != pWall.get(), L"Duplicate static id replaced the floor");
+			for (auto& branch : pTree->nodes_in_tree())
+			{
+				Assert::IsTrue(branch.StaticLayer == pLayer, L"A branch doesn't share the static layer");
+				Assert::IsTrue(branch.GetItem(0) == nullptr, L"Static object has a dynamic copy");
+			}
+
+			// Without their own copy of the floor, the cubes still rest on it in every leaf
+			EvolveTree(*pTree, 0, 60);
+			float lowest = FLT_MAX;
+			for (auto& leaf : pTree->leaves())
+			{
+				for (unsigned id = 1; id < 33; id++)
+					lowest = std::min(lowest, leaf.GetItem(id)->GetPosition().y);
+			}
+			Assert::IsTrue(lowest > -0.32f, L"Objects fell through the static floor");
+		}
+
+		// An object every leaf holds privately goes back to the shared world once it sleeps in the same state everywhere
+		TEST_METHOD(SettledObjectIsShared)
+		{
+			auto shareUntouched = WorldBranch::ShareUntouchedObjects;
+			std::shared_ptr<btCollisionShape> pFloor(new btBoxShape(btVector3(1.0f, 0.01f, 1.0f)));
+			std::shared_ptr<btCollisionShape> pCube(new btBoxShape(btVector3(0.025f, 0.025f, 0.025f)));
+			auto pRoot = WorldBranch::DemandCreate("Root");
+			pRoot->AddDynamicObject(0, pFloor, 0, Vector3(0, -0.30f, -0.50f), Quaternion::Identity);
+			WorldBranch::ShareUntouchedObjects = true;
+			pRoot->AddDynamicObject(1, pCube, 1.0f, Vector3(0.5f, -0.26f, -0.50f), Quaternion::Identity);
+			WorldBranch::ShareUntouchedObjects = false;
+			pRoot->AddDynamicObject(2, pCube, 1.0f, Vector3(0, -0.25f, -0.50f), Quaternion::Identity);
+			WorldBranch::ShareUntouchedObjects = shareUntouched;
+
+			std::vector<AffineTransform> subjectTransforms(2);
+			subjectTransforms[1].Scale = Vector3(1.2f, 1.2f, 1.2f);
+			pRoot->Fork(subjectTransforms);
+			pRoot->Enable(AffineTransform::Identity());
+			Assert::AreEqual((size_t) 2, LeafCount(*pRoot), L"Fork didn't add two leaves");
+			for (auto& leaf : pRoot->leaves())
+				Assert::IsTrue(leaf.Items.size() > 2 && leaf.Items[2], L"Leaf has no private copy of the object");
+
+			// Without hands both leaves simulate the same fall, 5s is enough for Bullet to put the cube to sleep
+			HandFrame noHands;
+			for (int i = 0; i < 300; i++)
+				pRoot->Evolution(StepTime, noHands, XMLoadFloat4x4(&noHands.ToWorld));
+			Vector3 settled = pRoot->leaves().begin()->GetItem(2)->GetPosition();
+			pRoot->Collapse();
+
+			auto pShared = pRoot->SharedObjects->GetRigid(2);
+			Assert::IsTrue(pShared != nullptr, L"Settled object wasn't adopted by the shared world");
+			Assert::IsTrue(XMVector3NearEqual(pShared->GetPosition(), settled, XMVectorReplicate(1e-3f)), L"Shared object isn't where it settled");
+			for (auto& leaf : pRoot->leaves())
+			{
+				Assert::IsTrue(leaf.Items.size() <= 2 || !leaf.Items[2], L"Leaf kept its private copy");
+				Assert::IsTrue(leaf.GetItem(2) == pShared, L"Leaf doesn't see the shared object");
+			}
+			Assert::IsTrue(pRoot->SharedObjects->GetRigid(1) != nullptr, L"Untouched object left the shared world");
+		}
+
+		// Collapse keeps at most Beam.MaxLeaves leaves with weights summing to 1,
+		// and a parent whose children are all retired doesn't come back as a leaf
+		TEST_METHOD(CollapseBoundsBeam)
+		{
+			auto beam = WorldBranch::Beam;
+			WorldBranch::Beam.MaxLeaves = 5;
+
+			auto pTree = CreateBranchTree(SyntheticHandFrame(0));
+			// A second level under a few leaves, so some retired leaves are the last children of their parent
+			std::vector<WorldBranch*> parents;
+			for (auto& leaf : pTree->leaves())
+			{
+				if (parents.size() < 3)
+					parents.push_back(&leaf);
+			}
+			for (auto pParent : parents)
+			{
+				std::vector<AffineTransform> subjectTransforms(2);
+				subjectTransforms[0].Scale = pParent->SubjectTransform.Scale * 0.9f;
+				subjectTransforms[1].Scale = pParent->SubjectTransform.Scale * 0.8f;
+				pParent->Fork(subjectTransforms);
+			}
+			EvolveTree(*pTree, 0, 30);
+			pTree->Collapse();
+			WorldBranch::Beam = beam;
+
+			size_t leafCount = 0;
+			float totalWeight = 0;
+			for (auto& leaf : pTree->leaves())
+			{
+				leafCount++;
+				totalWeight += leaf.Weight();
+				Assert::IsTrue(leaf.IsEnabled, L"Disabled leaf left in the tree");
+				Assert::IsTrue(std::find(parents.begin(), parents.end(), &leaf) == parents.end(), L"Parent left without children came back as a leaf");
+			}
+			Assert::IsTrue(leafCount >= 1 && leafCount <= 5, L"Beam isn't bounded by MaxLeaves");
+			Assert::AreEqual(1.0f, totalWeight, 1e-5f, L"Survivor weights don't sum to 1");
+
+			// Collapsing a collapsed tree keeps it as it is
+			pTree->Collapse();
+			Assert::AreEqual(leafCount, LeafCount(*pTree), L"Second collapse changed the beam");
+		}
+
+		// Every object's clustered states are a distribution over the leaves, the static floor is certain
+		TEST_METHOD(SuperpositionIsDistribution)
+		{
+			auto pTree = CreateBranchTree(SyntheticHandFrame(0));
+			EvolveTree(*pTree, 0, 30);
+			SuperpositionTable superposition;
+			pTree->CaculateSuperposition(superposition);
+
+			Assert::IsTrue(superposition.ObjectCount() > 1, L"Objects are missing from the table");
+			Assert::AreEqual((size_t) 1, (size_t) superposition.Objects[0].Count, L"Static floor has more than one state");
+			Assert::IsTrue(superposition.Probabilities[superposition.Objects[0].Offset] == 1.0f, L"Static floor isn't certain");
+			uint32_t offset = 0;
+			for (const auto& range : superposition.Objects)
+			{
+				Assert::AreEqual(offset, range.Offset, L"States aren't packed in id order");
+				offset += range.Count;
+				if (range.Count == 0)
+					continue;
+				float total = 0;
+				for (uint32_t i = range.Offset; i < range.Offset + range.Count; i++)
+					total += superposition.Probabilities[i];
+				Assert::AreEqual(1.0f, total, 1e-4f, L"Object's probabilities don't sum to 1");
+			}
+			Assert::AreEqual(superposition.StateCount(), (size_t) offset, L"States are left over in the table");
+		}
+	};
+}
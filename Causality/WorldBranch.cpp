@@ -0,0 +1,1339 @@
+#include "pch_bullet.h"
+#include <iostream>
+#include <boost\format.hpp>
+#include <chrono>
+#include "WorldBranch.h"
+#include "Common\PrimitiveVisualizer.h"
+
+using namespace Causality;
+using namespace DirectX;
+using namespace DirectX::Scene;
+using namespace std;
+using namespace Platform;
+using namespace DirectX::Visualizers;
+
+std::mutex WorldBranch::BranchPoolMutex;
+std::vector<std::unique_ptr<WorldBranch>> WorldBranch::BranchPool;
+WorldBranch::BranchPoolStatistics WorldBranch::BranchPoolStats = {};
+bool WorldBranch::BranchPoolAutoExpand = true;
+bool WorldBranch::ShareUntouchedObjects = true;
+WorldBranch::BeamParameters WorldBranch::Beam;
+
+WorldBranch::BeamParameters::BeamParameters()
+	: MaxLeaves(20), MinLiklyhood(0.005f), PenetrationPenalty(200.0f), MergeScaleEpsilon(0.01f)
+{}
+
+const float fingerRadius = 0.006f;
+const float fingerLength = 0.02f;
+// Distance subjects and shared objects may close in on a body in one step, hands carry no velocity to predict with
+const float touchMargin = 0.02f;
+
+WorldBranch::WorldBranch()
+{
+	IsEnabled = false;
+	_Liklyhood = 0;
+	_Weight = 1.0f;
+	_StepTime = 0;
+	_WorkerAffinity = -1;
+}
+
+std::pair<DirectX::Vector3, DirectX::Quaternion> XM_CALLCONV CaculateCylinderTransform(FXMVECTOR P1, FXMVECTOR P2)
+{
+	std::pair<DirectX::Vector3, DirectX::Quaternion> trans;
+	auto center = XMVectorAdd(P1, P2);
+	center = XMVectorMultiply(center, g_XMOneHalf);
+	auto dir = XMVectorSubtract(P1, P2);
+	auto scale = XMVector3Length(dir);
+	XMVECTOR rot;
+	if (XMVector4Equal(dir, g_XMZero))
+		rot = XMQuaternionIdentity();
+	else
+		rot = XMQuaternionRotationVectorToVector(g_XMIdentityR1.v, dir);
+	trans.first = center;
+	trans.second = rot;
+	return trans;
+}
+
+XMMATRIX Causality::HandPhysicalModel::CaculateLocalMatrix(const HandState & hand, const DirectX::Matrix4x4 & leapTransform)
+{
+	XMVECTOR palmCenter = XMLoadFloat3(&hand.PalmPosition);
+	return XMMatrixScalingFromCenter(m_InheritTransform.Scale, palmCenter) * ((RigidTransform&) m_InheritTransform).TransformMatrix() * (XMMATRIX) leapTransform;
+
+}
+
+
+Causality::HandPhysicalModel::HandPhysicalModel
+(const std::shared_ptr<btDynamicsWorld> &pWorld,
+const HandState & hand, const DirectX::Matrix4x4 & leapTransform,
+const DirectX::AffineTransform &inheritTransform)
+: m_IsTracked(true), m_Hand(hand), m_LeapTransform(leapTransform)
+{
+	Id = hand.Id;
+	m_InheritTransform = inheritTransform;
+
+	LocalMatrix = CaculateLocalMatrix(hand, leapTransform);
+	XMMATRIX leap2world = LocalMatrix;
+	for (int j = 0; j < HandState::FingerCount; j++)
+	{
+		for (size_t i = 0; i < 4; i++)
+		{
+			const auto & bone = m_Hand.Bone(j, i);
+			XMVECTOR bJ = XMVector3Transform(XMLoadFloat3(&bone.PrevJoint), leap2world);
+			XMVECTOR eJ = XMVector3Transform(XMLoadFloat3(&bone.NextJoint), leap2world);
+			m_Bones[i + j * 4].first = bJ;
+			m_Bones[i + j * 4].second = eJ;
+
+			// Initalize rigid hand model
+			auto center = 0.5f * XMVectorAdd(bJ, eJ);
+			auto dir = XMVectorSubtract(eJ, bJ);
+			auto height = std::max(XMVectorGetX(XMVector3Length(dir)), fingerLength);
+			XMVECTOR rot;
+			if (XMVector4Equal(dir, g_XMZero))
+				rot = XMQuaternionIdentity();
+			else
+				rot = XMQuaternionRotationVectorToVector(g_XMIdentityR1, dir);
+			shared_ptr<btCapsuleShape> pShape(new btCapsuleShape(fingerRadius, height));
+
+			// Scaling in Y axis is encapsled in bJ and eJ
+			btVector3 scl = vector_cast<btVector3>(m_InheritTransform.Scale);
+			scl.setY(1.0f);
+			pShape->setLocalScaling(scl);
+
+			m_HandRigids.emplace_back(new PhysicalRigid());
+			const auto & pRigid = m_HandRigids.back();
+			//pRigid->GetBulletRigid()->setGravity({ 0,0,0 });
+			pRigid->InitializePhysics(nullptr, pShape, 0, center, rot);
+			const auto& body = pRigid->GetBulletRigid();
+			body->setFriction(1.0f);
+			body->setRestitution(0.0f);
+			body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
+			body->setActivationState(DISABLE_DEACTIVATION);
+			//body->setAngularFactor(0.0f); // Rotation Along Y not affact
+
+			pRigid->Enable(pWorld);
+		}
+	}
+
+	m_BoneField.Reset(m_Bones.data(), m_Bones.size());
+
+	//for (size_t i = 0; i < m_HandRigids.size(); i++)
+	//{
+	//	for (size_t j = 0; j < m_HandRigids.size(); j++)
+	//	{
+	//		if (i != j)
+	//			m_HandRigids[i]->GetBulletRigid()->setIgnoreCollisionCheck(m_HandRigids[j]->GetBulletRigid(), true);
+	//	}
+	//}
+
+}
+
+void Causality::FrameKinematics::Update(const HandFrame & frame, const DirectX::Matrix4x4 & leapTransform)
+{
+	LeapTransform = leapTransform;
+	XMVECTOR scale, rotation, translation;
+	if (!XMMatrixDecompose(&scale, &rotation, &translation, leapTransform))
+		rotation = XMQuaternionIdentity();
+	LeapRotation = rotation;
+
+	HandCount = 0;
+	for (const auto& hand : frame.hands())
+	{
+		auto& kinematics = Hands[HandCount++];
+		kinematics.State = &hand;
+		for (int i = 0; i < HandState::BoneCount; i++)
+		{
+			XMVECTOR dir = XMVectorSubtract(XMLoadFloat3(&hand.Bones[i].NextJoint), XMLoadFloat3(&hand.Bones[i].PrevJoint));
+			kinematics.Degenerated[i] = XMVector3Equal(dir, g_XMZero);
+			if (kinematics.Degenerated[i])
+				kinematics.BoneRotations[i] = XMQuaternionIdentity();
+			else
+				kinematics.BoneRotations[i] = XMQuaternionRotationVectorToVector(g_XMIdentityR1, dir);
+		}
+	}
+}
+
+const HandKinematics * Causality::FrameKinematics::Hand(int id) const
+{
+	for (unsigned i = 0; i < HandCount; i++)
+	{
+		if (Hands[i].State->Id == id)
+			return &Hands[i];
+	}
+	return nullptr;
+}
+
+bool Causality::HandPhysicalModel::Update(const FrameKinematics & kinematics)
+{
+	static_assert(sizeof(HandBone) == 2 * sizeof(XMFLOAT3) && sizeof(m_Bones) == HandKinematics::JointCount * sizeof(XMFLOAT3), "Bones must be packed joint streams");
+
+	auto pKinematics = kinematics.Hand(Id);
+	m_IsTracked = pKinematics != nullptr;
+	m_LeapTransform = kinematics.LeapTransform;
+
+	if (m_IsTracked)
+	{
+		m_Hand = *pKinematics->State;
+		XMMATRIX transform = CaculateLocalMatrix(m_Hand, m_LeapTransform);
+		LocalMatrix = transform;
+
+		LostFrames = 0;
+		// All joints in one batched transform
+		XMVector3TransformCoordStream(reinterpret_cast<XMFLOAT3*>(m_Bones.data()), sizeof(XMFLOAT3),
+			pKinematics->Joints(), sizeof(XMFLOAT3), HandKinematics::JointCount, transform);
+
+		// A uniform scale keeps bone directions, so only the subject and leap rotations are added to the device space ones
+		// Any other scale bends them, the rotation is then taken from the scaled bone itself
+		const auto& scale = m_InheritTransform.Scale;
+		bool uniformScale = scale.x == scale.y && scale.y == scale.z;
+		XMVECTOR subjectRotation = XMQuaternionMultiply(m_InheritTransform.Rotation, kinematics.LeapRotation);
+		for (int i = 0; i < HandState::BoneCount; i++)
+		{
+			auto & pRigid = m_HandRigids[i];
+			if (!pRigid->IsEnabled())
+				pRigid->Enable();
+			auto center = 0.5f * XMVectorAdd(m_Bones[i].first, m_Bones[i].second);
+			XMVECTOR rot;
+			if (pKinematics->Degenerated[i])
+				rot = XMQuaternionIdentity();
+			else if (uniformScale)
+				rot = XMQuaternionMultiply(pKinematics->BoneRotations[i], subjectRotation);
+			else
+				rot = XMQuaternionRotationVectorToVector(g_XMIdentityR1, XMVectorSubtract(m_Bones[i].second, m_Bones[i].first));
+			auto trans = btTransform(vector_cast<btQuaternion>(rot), vector_cast<btVector3>(center));
+			pRigid->GetBulletRigid()->getMotionState()->setWorldTransform(trans);
+		}
+		m_BoneField.Reset(m_Bones.data(), m_Bones.size());
+		return true;
+	}
+	else
+	{
+		for (auto& pRigid : m_HandRigids)
+		{
+			pRigid->Disable();
+		}
+		LostFrames++;
+		return false;
+	}
+}
+
+// Inherited via IModelNode
+
+void Causality::HandPhysicalModel::AppendCapsules(std::vector<SubjectCapsule>& capsules, float opticity) const
+{
+	for (const auto& pRigid : m_HandRigids)
+	{
+		SubjectCapsule capsule;
+		capsule.Center = pRigid->GetPosition();
+		capsule.Axis = XMVector3Rotate(g_XMIdentityR1, pRigid->GetOrientation());
+		capsule.Height = static_cast<btCapsuleShape*>(pRigid->GetBulletShape())->getHalfHeight() * 2;
+		capsule.Radius = fingerRadius * m_InheritTransform.Scale.x;
+		capsule.Opticity = opticity;
+		capsules.push_back(capsule);
+	}
+}
+
+void Causality::HandPhysicalModel::Render(ID3D11DeviceContext * pContext, DirectX::IEffect * pEffect)
+{
+	XMMATRIX leap2world = LocalMatrix;
+	//auto palmPosition = XMVector3Transform(m_Hand.palmPosition().toVector3<Vector3>(), leap2world);
+	//g_PrimitiveDrawer.DrawSphere(palmPosition, 0.02f, Colors::YellowGreen);
+	XMVECTOR color = Colors::LimeGreen;
+	color = XMVectorSetW(color, Opticity);
+
+	//g_PrimitiveDrawer.Begin();
+	//for (const auto& bone : m_Bones)
+	//{
+	//	//g_PrimitiveDrawer.DrawSphere(bone.second, fingerRadius, jC);
+	//	g_PrimitiveDrawer.DrawCylinder(bone.first, bone.second, fingerRadius * m_InheritTransform.Scale.x, color);
+	//}
+	//g_PrimitiveDrawer.End();
+
+	for (const auto& pRigid : m_HandRigids)
+	{
+		g_PrimitiveDrawer.DrawCylinder(
+			pRigid->GetPosition(),
+			XMVector3Rotate(g_XMIdentityR1, pRigid->GetOrientation()),
+			dynamic_cast<btCapsuleShape*>(pRigid->GetBulletShape())->getHalfHeight() * 2,
+			fingerRadius * m_InheritTransform.Scale.x,
+			color);
+	}
+
+	//for (const auto& finger : m_Hand.fingers())
+	//{
+	//	for (size_t i = 0; i < 4; i++)
+	//	{
+	//		const auto & bone = finger.bone((Leap::Bone::Type)i);
+	//		XMVECTOR bJ = XMVector3Transform(bone.prevJoint().toVector3<Vector3>(), leap2world);
+	//		XMVECTOR eJ = XMVector3Transform(bone.nextJoint().toVector3<Vector3>(), leap2world);
+	//		//g_PrimitiveDrawer.DrawLine(bJ, eJ, Colors::LimeGreen);
+	//		//g_PrimitiveDrawer.DrawCube(bJ, g_XMOne * 0.03, g_XMIdentityR3, Colors::Red);
+	//		g_PrimitiveDrawer.DrawCylinder(bJ, eJ,0.015f,Colors::LimeGreen);
+
+	//		//auto center = 0.5f * XMVectorAdd(bJ, eJ);
+	//		//auto dir = XMVectorSubtract(eJ, bJ);
+	//		//auto scale = XMVector3Length(dir);
+	//		//XMVECTOR rot;
+	//		//if (XMVector4LessOrEqual(XMVector3LengthSq(dir), XMVectorReplicate(0.01f)))
+	//		//	rot = XMQuaternionIdentity();
+	//		//else
+	//		//	rot = XMQuaternionRotationVectorToVector(g_XMIdentityR1, dir);
+	//		//XMMATRIX world = XMMatrixAffineTransformation(scale, g_XMZero, rot, center);
+	//		//s_pCylinder->Draw(world, ViewMatrix, ProjectionMatrix,Colors::LimeGreen);
+	//	}
+	//}
+}
+
+inline void debug_assert(bool condition)
+{
+#ifdef DEBUG
+	if (!condition)
+	{
+		_CrtDbgBreak();
+		//std::cout << "assert failed." << std::endl;
+	}
+#endif
+}
+
+// normalized feild intensity equalent charge
+XMVECTOR XM_CALLCONV Causality::FieldSegmentToPoint(FXMVECTOR P, FXMVECTOR L0, FXMVECTOR L1)
+{
+	if (XMVector4NearEqual(L0, L1, XMVectorReplicate(0.001f)))
+	{
+		XMVECTOR v = XMVectorAdd(L0, L1);
+		v = XMVectorMultiply(v, g_XMOneHalf);
+		v = XMVectorSubtract(v, P);
+		XMVECTOR d = XMVector3LengthSq(v);
+		v = XMVector3Normalize(v);
+		v /= d;
+		return v;
+	}
+
+	XMVECTOR s = XMVectorSubtract(L1, L0);
+	XMVECTOR v0 = XMVectorSubtract(L0, P);
+	XMVECTOR v1 = XMVectorSubtract(L1, P);
+
+	XMMATRIX Rot;
+	Rot.r[1] = XMVector3Normalize(s);
+	Rot.r[2] = XMVector3Cross(v0, v1);
+	Rot.r[2] = XMVector3Normalize(Rot.r[2]);
+	Rot.r[0] = XMVector3Cross(Rot.r[1], Rot.r[2]);
+	Rot.r[3] = g_XMIdentityR3;
+
+	// Rotated to standard question:
+	//  Y
+	//  ^     *y1
+	//  |     |
+	//--o-----|x0----->X
+	//  |     |
+	//	|     |
+	//	      *y0
+	// Close form solution of the intergral : f(y0,y1) = <-y/(x0*sqrt(x0^2+y^2)),1/sqrt(x0^2+y^2),0> | (y0,y1)
+	XMVECTOR Ds = XMVector3ReciprocalLength(s);
+	XMVECTOR Ps = XMVector3Dot(v0, s);
+	XMVECTOR Y0 = XMVectorMultiply(Ps, Ds);
+
+	Ps = XMVector3Dot(v1, s);
+	XMVECTOR Y1 = XMVectorMultiply(Ps, Ds);
+
+	XMVECTOR X0 = XMVector3LengthSq(v1);
+	Ps = XMVectorMultiply(Y1, Y1);
+	X0 = XMVectorSubtract(X0, Ps);
+	//debug_assert(XMVector4GreaterOrEqual(X0, XMVectorZero()));
+	XMVECTOR R0 = XMVectorMultiplyAdd(Y0, Y0, X0);
+	XMVECTOR R1 = XMVectorMultiplyAdd(Y1, Y1, X0);
+	R0 = XMVectorReciprocalSqrt(R0);
+	R1 = XMVectorReciprocalSqrt(R1);
+
+	XMVECTOR Ry = XMVectorSubtract(R1, R0);
+
+	R0 = XMVectorMultiply(R0, Y0);
+	R1 = XMVectorMultiply(R1, Y1);
+	XMVECTOR Rx = XMVectorSubtract(R0, R1);
+	X0 = XMVectorReciprocalSqrt(X0);
+	//debug_assert(!XMVectorGetIntX(XMVectorIsNaN(X0)));
+	Rx = XMVectorMultiply(Rx, X0);
+	Rx = XMVectorSelect(Rx, Ry, g_XMSelect0101);
+	// Field intensity in P centered coordinate
+	Rx = XMVectorAndInt(Rx, g_XMSelect1100);
+
+	Rx = XMVectorMultiply(Rx, Ds);
+	Rx = XMVector3Transform(Rx, Rot);
+
+	//debug_assert(!XMVectorGetIntX(XMVectorIsNaN(Rx)));
+	return Rx;
+}
+
+DirectX::XMVECTOR XM_CALLCONV Causality::HandPhysicalModel::FieldAtPoint(DirectX::FXMVECTOR P)
+{
+	// Palm push force 
+	//XMVECTOR palmP = m_Hand.palmPosition().toVector3<Vector3>();
+	//XMVECTOR palmN = m_Hand.palmNormal().toVector3<Vector3>();
+	//auto dis = XMVectorSubtract(P,palmP);
+	//auto mag = XMVectorReciprocal(XMVector3LengthSq(dis));
+	//dis = XMVector3Normalize(dis);
+	//auto fac = XMVector3Dot(dis, palmN);
+	//mag = XMVectorMultiply(fac, mag);
+	//return XMVectorMultiply(dis, mag);
+
+	XMVECTOR field = XMVectorZero();
+	for (const auto& bone : m_Bones)
+	{
+		XMVECTOR v0 = bone.first;
+		XMVECTOR v1 = bone.second;
+		XMVECTOR f = FieldSegmentToPoint(P, v0, v1);
+		field += f;
+		//XMVECTOR l = XMVector3LengthSq(XMVectorSubtract(v1,v0));
+	}
+	return field;
+}
+
+void Causality::HandPhysicalModel::FieldAtPoints(const Vector3 * points, Vector3 * fields, size_t count) const
+{
+	m_BoneField.Evaluate(points, fields, count);
+}
+
+void Causality::SegmentFieldBatch::Reset(const std::pair<Vector3, Vector3>* segments, size_t count)
+{
+	for (auto pArray : { &m_Sx, &m_Sy, &m_Sz, &m_Dx, &m_Dy, &m_Dz, &m_Length, &m_InvLength, &m_Cx, &m_Cy, &m_Cz })
+		pArray->clear();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		XMVECTOR L0 = segments[i].first;
+		XMVECTOR L1 = segments[i].second;
+		// Same degeneration test as FieldSegmentToPoint
+		if (XMVector4NearEqual(L0, L1, XMVectorReplicate(0.001f)))
+		{
+			XMVECTOR C = XMVectorMultiply(XMVectorAdd(L0, L1), g_XMOneHalf);
+			m_Cx.push_back(XMVectorGetX(C));
+			m_Cy.push_back(XMVectorGetY(C));
+			m_Cz.push_back(XMVectorGetZ(C));
+			continue;
+		}
+
+		XMVECTOR S = XMVectorSubtract(L1, L0);
+		float length = XMVectorGetX(XMVector3Length(S));
+		XMVECTOR D = XMVectorScale(S, 1.0f / length);
+		m_Sx.push_back(XMVectorGetX(L0));
+		m_Sy.push_back(XMVectorGetY(L0));
+		m_Sz.push_back(XMVectorGetZ(L0));
+		m_Dx.push_back(XMVectorGetX(D));
+		m_Dy.push_back(XMVectorGetY(D));
+		m_Dz.push_back(XMVectorGetZ(D));
+		m_Length.push_back(length);
+		m_InvLength.push_back(1.0f / length);
+	}
+}
+
+// Field at 4 points held in lanes of Px, Py, Pz
+// FieldSegmentToPoint rotates the segment onto the Y axis, here the rotated frame is expressed directly :
+// its Y axis is the segment direction D, its X axis is W/|W| with W the perpendicular from P to the segment's line
+void XM_CALLCONV Causality::SegmentFieldBatch::Evaluate4(FXMVECTOR Px, FXMVECTOR Py, FXMVECTOR Pz, XMVECTOR & Fx, XMVECTOR & Fy, XMVECTOR & Fz) const
+{
+	Fx = XMVectorZero();
+	Fy = XMVectorZero();
+	Fz = XMVectorZero();
+
+	for (size_t j = 0; j < m_Length.size(); j++)
+	{
+		XMVECTOR Dx = XMVectorReplicatePtr(&m_Dx[j]);
+		XMVECTOR Dy = XMVectorReplicatePtr(&m_Dy[j]);
+		XMVECTOR Dz = XMVectorReplicatePtr(&m_Dz[j]);
+		XMVECTOR L = XMVectorReplicatePtr(&m_Length[j]);
+
+		// v0 = L0 - P, v1 = L1 - P
+		XMVECTOR V0x = XMVectorSubtract(XMVectorReplicatePtr(&m_Sx[j]), Px);
+		XMVECTOR V0y = XMVectorSubtract(XMVectorReplicatePtr(&m_Sy[j]), Py);
+		XMVECTOR V0z = XMVectorSubtract(XMVectorReplicatePtr(&m_Sz[j]), Pz);
+		XMVECTOR V1x = XMVectorMultiplyAdd(Dx, L, V0x);
+		XMVECTOR V1y = XMVectorMultiplyAdd(Dy, L, V0y);
+		XMVECTOR V1z = XMVectorMultiplyAdd(Dz, L, V0z);
+
+		XMVECTOR Y0 = XMVectorMultiply(V0x, Dx);
+		Y0 = XMVectorMultiplyAdd(V0y, Dy, Y0);
+		Y0 = XMVectorMultiplyAdd(V0z, Dz, Y0);
+		XMVECTOR Y1 = XMVectorAdd(Y0, L);
+
+		XMVECTOR Wx = XMVectorNegativeMultiplySubtract(Y0, Dx, V0x);
+		XMVECTOR Wy = XMVectorNegativeMultiplySubtract(Y0, Dy, V0y);
+		XMVECTOR Wz = XMVectorNegativeMultiplySubtract(Y0, Dz, V0z);
+		XMVECTOR W2 = XMVectorMultiply(Wx, Wx);
+		W2 = XMVectorMultiplyAdd(Wy, Wy, W2);
+		W2 = XMVectorMultiplyAdd(Wz, Wz, W2);
+
+		// R0 = 1/sqrt(x0^2+y0^2) = 1/|v0|, R1 = 1/|v1|
+		XMVECTOR R0 = XMVectorMultiply(V0x, V0x);
+		R0 = XMVectorMultiplyAdd(V0y, V0y, R0);
+		R0 = XMVectorMultiplyAdd(V0z, V0z, R0);
+		R0 = XMVectorReciprocalSqrt(R0);
+		XMVECTOR R1 = XMVectorMultiply(V1x, V1x);
+		R1 = XMVectorMultiplyAdd(V1y, V1y, R1);
+		R1 = XMVectorMultiplyAdd(V1z, V1z, R1);
+		R1 = XMVectorReciprocalSqrt(R1);
+
+		XMVECTOR InvL = XMVectorReplicatePtr(&m_InvLength[j]);
+		// Rx is divided by x0 once more to normalize W
+		XMVECTOR Rx = XMVectorSubtract(XMVectorMultiply(R0, Y0), XMVectorMultiply(R1, Y1));
+		Rx = XMVectorMultiply(XMVectorDivide(Rx, W2), InvL);
+		XMVECTOR Ry = XMVectorMultiply(XMVectorSubtract(R1, R0), InvL);
+
+		Fx = XMVectorMultiplyAdd(Rx, Wx, Fx);
+		Fy = XMVectorMultiplyAdd(Rx, Wy, Fy);
+		Fz = XMVectorMultiplyAdd(Rx, Wz, Fz);
+		Fx = XMVectorMultiplyAdd(Ry, Dx, Fx);
+		Fy = XMVectorMultiplyAdd(Ry, Dy, Fy);
+		Fz = XMVectorMultiplyAdd(Ry, Dz, Fz);
+	}
+
+	// Point charges, v/|v|^3
+	for (size_t j = 0; j < m_Cx.size(); j++)
+	{
+		XMVECTOR Vx = XMVectorSubtract(XMVectorReplicatePtr(&m_Cx[j]), Px);
+		XMVECTOR Vy = XMVectorSubtract(XMVectorReplicatePtr(&m_Cy[j]), Py);
+		XMVECTOR Vz = XMVectorSubtract(XMVectorReplicatePtr(&m_Cz[j]), Pz);
+		XMVECTOR D = XMVectorMultiply(Vx, Vx);
+		D = XMVectorMultiplyAdd(Vy, Vy, D);
+		D = XMVectorMultiplyAdd(Vz, Vz, D);
+		XMVECTOR R = XMVectorDivide(XMVectorReciprocalSqrt(D), D);
+		Fx = XMVectorMultiplyAdd(R, Vx, Fx);
+		Fy = XMVectorMultiplyAdd(R, Vy, Fy);
+		Fz = XMVectorMultiplyAdd(R, Vz, Fz);
+	}
+}
+
+void Causality::SegmentFieldBatch::Evaluate(const Vector3 * points, Vector3 * fields, size_t count) const
+{
+	Vector3 tail[4];
+	for (size_t i = 0; i < count; i += 4)
+	{
+		size_t n = std::min<size_t>(4, count - i);
+		const Vector3* block = points + i;
+		if (n < 4)
+		{
+			// Pad the last block with its last point
+			for (size_t k = 0; k < 4; k++)
+				tail[k] = points[i + std::min(k, n - 1)];
+			block = tail;
+		}
+
+		// Transpose 4 points into X, Y, Z lanes
+		XMMATRIX P(XMLoadFloat3(&block[0]), XMLoadFloat3(&block[1]), XMLoadFloat3(&block[2]), XMLoadFloat3(&block[3]));
+		P = XMMatrixTranspose(P);
+		XMMATRIX F;
+		Evaluate4(P.r[0], P.r[1], P.r[2], F.r[0], F.r[1], F.r[2]);
+		F.r[3] = XMVectorZero();
+		F = XMMatrixTranspose(F);
+		for (size_t k = 0; k < n; k++)
+			XMStoreFloat3(&fields[i + k], F.r[k]);
+	}
+}
+
+namespace
+{
+	// Collects shared objects whose exact AABBs touch the query, Dbvt leaf volumes are padded
+	struct SharedObjectCollector : public btBroadphaseAabbCallback
+	{
+		btVector3										AabbMin, AabbMax;
+		const std::map<const btCollisionObject*, unsigned>*	pIds;
+		std::vector<unsigned>*							pResult;
+
+		virtual bool process(const btBroadphaseProxy* pProxy) override
+		{
+			if (!TestAabbAgainstAabb2(AabbMin, AabbMax, pProxy->m_aabbMin, pProxy->m_aabbMax))
+				return true;
+			auto itr = pIds->find(static_cast<const btCollisionObject*>(pProxy->m_clientObject));
+			if (itr != pIds->end())
+				pResult->push_back(itr->second);
+			return true;
+		}
+	};
+}
+
+Causality::SharedObjectWorld::SharedObjectWorld()
+{
+	m_pBroadphase.reset(new btDbvtBroadphase());
+	m_pCollisionConfiguration.reset(new btDefaultCollisionConfiguration());
+	m_pDispatcher.reset(new btCollisionDispatcher(m_pCollisionConfiguration.get()));
+	m_pSolver.reset(new btSequentialImpulseConstraintSolver());
+	m_pDynamicsWorld.reset(new BranchDynamicsWorld(m_pDispatcher.get(), m_pBroadphase.get(), m_pSolver.get(), m_pCollisionConfiguration.get()));
+	m_pDynamicsWorld->setGravity(btVector3(0, -1.0f, 0));
+}
+
+Causality::SharedObjectWorld::~SharedObjectWorld()
+{
+	// Bodies leave the world before it goes
+	m_Items.clear();
+}
+
+void Causality::SharedObjectWorld::AddObject(unsigned id, const std::shared_ptr<btCollisionShape>& pShape, float mass, const DirectX::Vector3 & Position, const DirectX::Quaternion & Orientation)
+{
+	if (m_Items.size() <= id)
+		m_Items.resize(id + 1);
+	auto& pObject = m_Items[id];
+	if (pObject)
+		m_Ids.erase(pObject->GetBulletRigid());
+	pObject.reset(new PhysicalRigid());
+	pObject->InitializePhysics(m_pDynamicsWorld, pShape, mass, Position, Orientation);
+	pObject->GetBulletRigid()->setFriction(1.0f);
+	pObject->GetBulletRigid()->setDamping(0.8f, 0.9f);
+	pObject->GetBulletRigid()->setRestitution(0.0);
+	m_Ids[pObject->GetBulletRigid()] = id;
+}
+
+void Causality::SharedObjectWorld::AdoptObject(unsigned id, const PhysicalRigid & prototype)
+{
+	if (m_Items.size() <= id)
+		m_Items.resize(id + 1);
+	auto& pObject = m_Items[id];
+	if (pObject && pObject->GetBulletShape() == prototype.GetBulletShape())
+	{
+		pObject->CopyStateFrom(prototype);
+		return;
+	}
+	if (pObject)
+		m_Ids.erase(pObject->GetBulletRigid());
+	pObject.reset(new PhysicalRigid());
+	pObject->InitializePhysics(m_pDynamicsWorld, prototype);
+	m_Ids[pObject->GetBulletRigid()] = id;
+}
+
+void Causality::SharedObjectWorld::SetStaticLayer(const StaticCollisionLayer * pLayer)
+{
+	static_cast<BranchDynamicsWorld*>(m_pDynamicsWorld.get())->SetStaticLayer(pLayer);
+}
+
+void Causality::SharedObjectWorld::Step(float timeStep)
+{
+	m_pDynamicsWorld->stepSimulation(timeStep, 10);
+}
+
+void Causality::SharedObjectWorld::Query(const btVector3 & aabbMin, const btVector3 & aabbMax, std::vector<unsigned>& ids) const
+{
+	SharedObjectCollector collector;
+	collector.AabbMin = aabbMin;
+	collector.AabbMax = aabbMax;
+	collector.pIds = &m_Ids;
+	collector.pResult = &ids;
+	m_pBroadphase->aabbTest(aabbMin, aabbMax, collector);
+}
+
+void Causality::WorldBranch::InitializeBranchPool(int size, bool autoExpandation)
+{
+	std::lock_guard<std::mutex> guard(BranchPoolMutex);
+	BranchPoolAutoExpand = autoExpandation;
+	BranchPool.reserve(size);
+	for (int i = BranchPoolStats.Capacity; i < size; i++)
+	{
+		BranchPool.emplace_back(new WorldBranch());
+	}
+	BranchPoolStats.Capacity = std::max<size_t>(BranchPoolStats.Capacity, size);
+}
+
+const std::shared_ptr<btDynamicsWorld>& Causality::WorldBranch::World()
+{
+	if (!pDynamicsWorld)
+	{
+		pBroadphase.reset(new btDbvtBroadphase());
+
+		// Set up the collision configuration and dispatcher
+		pCollisionConfiguration.reset(new btDefaultCollisionConfiguration());
+		pDispatcher.reset(new btCollisionDispatcher(pCollisionConfiguration.get()));
+
+		// The actual physics solver
+		pSolver.reset(new btSequentialImpulseConstraintSolver());
+		// The world.
+		auto pWorld = new BranchDynamicsWorld(pDispatcher.get(), pBroadphase.get(), pSolver.get(), pCollisionConfiguration.get());
+		pWorld->SetStaticLayer(StaticLayer.get());
+		pDynamicsWorld.reset(pWorld);
+		pDynamicsWorld->setGravity(btVector3(0, -1.0f, 0));
+
+		std::lock_guard<std::mutex> guard(BranchPoolMutex);
+		++BranchPoolStats.WorldsCreated;
+	}
+	return pDynamicsWorld;
+}
+
+void Causality::WorldBranch::SetStaticLayer(const std::shared_ptr<StaticCollisionLayer>& pLayer)
+{
+	StaticLayer = pLayer;
+	if (pDynamicsWorld)
+		static_cast<BranchDynamicsWorld*>(pDynamicsWorld.get())->SetStaticLayer(pLayer.get());
+}
+
+void Causality::WorldBranch::Reset()
+{
+	if (ItemArena.size() < Items.size())
+		ItemArena.resize(Items.size());
+	for (size_t id = 0; id < Items.size(); id++)
+	{
+		if (!Items[id])
+			continue;
+		Items[id]->Disable();
+		ItemArena[id] = std::move(Items[id]);
+	}
+	Items.clear();
+	Subjects.clear();
+	SharedObjects = nullptr;
+	SetStaticLayer(nullptr);
+}
+
+void Causality::WorldBranch::Collapse()
+{
+	NormalizeLiklyhood(CaculateLiklyhood());
+
+	std::vector<WorldBranch*> candidates;
+	for (auto& branch : leaves())
+	{
+		if (&branch != this && branch.IsEnabled)
+			candidates.push_back(&branch);
+	}
+	if (candidates.size() <= 1)
+	{
+		ShareSettledObjects();
+		return;
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const WorldBranch* lhs, const WorldBranch* rhs) {
+		return lhs->_Liklyhood > rhs->_Liklyhood;
+	});
+
+	// A parent left without children would come back as an enabled leaf in its state at the fork, so it is retired too
+	auto retire = [this](WorldBranch* pBranch)
+	{
+		auto pParent = pBranch->parent();
+		pBranch->Retire();
+		while (pParent && pParent != this && pParent->is_leaf())
+		{
+			pBranch = pParent;
+			pParent = pBranch->parent();
+			pBranch->Retire();
+		}
+	};
+
+	// The most likely leaf always survives, so the tree never runs empty
+	std::vector<WorldBranch*> beam;
+	beam.push_back(candidates.front());
+	for (size_t i = 1; i < candidates.size(); i++)
+	{
+		auto pBranch = candidates[i];
+		auto itrDup = std::find_if(beam.begin(), beam.end(), [pBranch](const WorldBranch* pKept) {
+			return pKept->IsNearDuplicate(*pBranch);
+		});
+
+		if (itrDup != beam.end())
+		{
+			(*itrDup)->_Weight += pBranch->_Weight;
+			retire(pBranch);
+		}
+		else if (beam.size() >= Beam.MaxLeaves || pBranch->_Liklyhood < Beam.MinLiklyhood)
+		{
+			retire(pBranch);
+		}
+		else
+		{
+			beam.push_back(pBranch);
+		}
+	}
+
+	// Renormalize the survivors' evidence to keep the weights in float range
+	float total = 0;
+	for (auto pBranch : beam)
+		total += pBranch->_Weight;
+	for (auto pBranch : beam)
+		pBranch->_Weight /= total;
+
+	ShareSettledObjects();
+}
+
+bool Causality::WorldBranch::IsNearDuplicate(const WorldBranch & other) const
+{
+	Vector3 scaleDiff = SubjectTransform.Scale - other.SubjectTransform.Scale;
+	if (scaleDiff.LengthSquared() > Beam.MergeScaleEpsilon * Beam.MergeScaleEpsilon)
+		return false;
+	if (!((const RigidTransform&) SubjectTransform).NearEqual(other.SubjectTransform))
+		return false;
+	auto objectCount = std::max(Items.size(), other.Items.size());
+	if (SharedObjects)
+		objectCount = std::max(objectCount, SharedObjects->IdBound());
+
+	for (size_t id = 0; id < objectCount; id++)
+	{
+		auto pLhs = GetItem(id);
+		auto pRhs = other.GetItem(id);
+		if (!pLhs || !pRhs)
+		{
+			if (pLhs != pRhs)
+				return false;
+			continue;
+		}
+		RigidTransform lhs, rhs;
+		lhs.Translation = pLhs->GetPosition();
+		lhs.Rotation = pLhs->GetOrientation();
+		rhs.Translation = pRhs->GetPosition();
+		rhs.Rotation = pRhs->GetOrientation();
+		if (!lhs.NearEqual(rhs))
+			return false;
+	}
+	return true;
+}
+
+void Causality::WorldBranch::Retire()
+{
+	assert(is_leaf());
+	isolate();
+	Recycle(std::unique_ptr<WorldBranch>(this));
+}
+
+void Causality::WorldBranch::CaculateSuperposition(SuperpositionTable& superposition)
+{
+	NormalizeLiklyhood(CaculateLiklyhood());
+
+	_LeavesCache.clear();
+	for (auto& branch : leaves())
+	{
+		if (branch.IsEnabled)
+			_LeavesCache.push_back(&branch);
+	}
+
+	auto objectCount = Items.size();
+	if (StaticLayer)
+		objectCount = std::max(objectCount, StaticLayer->IdBound());
+	if (SharedObjects)
+		objectCount = std::max(objectCount, SharedObjects->IdBound());
+	if (_Clusterers.size() < objectCount)
+		_Clusterers.resize(objectCount);
+
+	const auto& leaves = _LeavesCache;
+	auto& clusterers = _Clusterers;
+	auto pStaticLayer = StaticLayer.get();
+	Scheduler().Dispatch(objectCount, [&leaves, &clusterers, pStaticLayer](size_t id)
+	{
+		auto& clusterer = clusterers[id];
+		clusterer.Reset(leaves.size());
+
+		// Static objects are certain, the same in every branch
+		auto pStatic = pStaticLayer ? pStaticLayer->GetCollisionObject(id) : nullptr;
+		if (pStatic)
+		{
+			ProblistiscAffineTransform tStatic;
+			tStatic.Translation = vector_cast<Vector3>(pStatic->getWorldTransform().getOrigin());
+			tStatic.Rotation = vector_cast<Quaternion>(pStatic->getWorldTransform().getRotation());
+			tStatic.Scale = vector_cast<Vector3>(pStatic->getCollisionShape()->getLocalScaling());
+			tStatic.Probability = 1.0f;
+			clusterer.Add(tStatic);
+			return;
+		}
+
+		for (auto pBranch : leaves)
+		{
+			// Leaves sharing the object add the same state, they accumulate into one cluster
+			auto pNew = pBranch->GetItem(id);
+			if (!pNew)
+				continue;
+
+			ProblistiscAffineTransform tNew;
+			tNew.Translation = pNew->GetPosition();
+			tNew.Rotation = pNew->GetOrientation();
+			tNew.Scale = pNew->GetScale();
+			tNew.Probability = pBranch->Liklyhood();
+			clusterer.Add(tNew);
+		}
+	});
+
+	// Scatter clusters into the table
+	size_t stateCount = 0;
+	for (size_t id = 0; id < objectCount; id++)
+		stateCount += clusterers[id].Clusters().size();
+	superposition.Resize(objectCount, stateCount);
+
+	uint32_t offset = 0;
+	for (size_t id = 0; id < objectCount; id++)
+	{
+		const auto& clusters = clusterers[id].Clusters();
+		superposition.Objects[id].Offset = offset;
+		superposition.Objects[id].Count = static_cast<uint32_t>(clusters.size());
+		for (const auto& state : clusters)
+		{
+			superposition.Positions[offset] = state.Translation;
+			superposition.Orientations[offset] = state.Rotation;
+			superposition.Scales[offset] = state.Scale;
+			superposition.Probabilities[offset] = state.Probability;
+			++offset;
+		}
+	}
+}
+
+void Causality::WorldBranch::InternalEvolution(float timeStep, const FrameKinematics & kinematics)
+{
+	auto& subjects = Subjects;
+
+	BoundingSphere sphere;
+
+	//if (!is_leaf()) return;
+	for (auto itr = subjects.begin(); itr != subjects.end(); )
+	{
+		bool result = itr->second->Update(kinematics);
+		// Remove hands lost track for 60+ frames
+		if (!result)
+		{
+			if (itr->second->LostFramesCount() > 60)
+				itr = subjects.erase(itr);
+		}
+		else
+		{
+			//std::vector<PhysicalRigid*> collideObjects;
+
+			//for (auto& item : Items)
+			//{
+			//	btVector3 c;
+			//	item.second->GetBulletShape()->getBoundingSphere(c, sphere.Radius);
+			//	sphere.Center = vector_cast<Vector3>(sphere.Center);
+			//	if (itr->second->OperatingFrustum().Contains(sphere) != ContainmentType::DISJOINT)
+			//	{
+			//		collideObjects.push_back(item.second.get());
+			//	}
+			//}
+			//if (collideObjects.size() > 0)
+			//{
+			//	Fork(collideObjects);
+			//}
+
+
+			//const auto &pHand = itr->second;
+			//for (auto& item : pFrame->Objects)
+			//{
+			//	const auto& pObj = item.second;
+			//	if (pObj->GetBulletRigid()->isStaticObject())
+			//		continue;
+			//	//pObj->GetBulletShape()->
+			//	auto force = pHand->FieldAtPoint(pObj->GetPosition()) * 0.00001f;
+			//	pObj->GetBulletRigid()->clearForces();
+			//	//vector_cast<btVector3>(force) * 0.01f
+			//	std::cout << item.first << " : " << Vector3(force) << std::endl;
+			//	pObj->GetBulletRigid()->applyCentralForce(vector_cast<btVector3>(force));
+			//	pObj->GetBulletRigid()->activate();
+			//}
+			++itr;
+		}
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	SpecializeTouchedObjects(timeStep);
+	World()->stepSimulation(timeStep, 10);
+	// A subject sinking into solid objects is poor evidence for this branch's subject transform
+	_Weight *= expf(-Beam.PenetrationPenalty * timeStep * CaculatePenetration());
+	_StepTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+float Causality::WorldBranch::CaculateLiklyhood()
+{
+	if (is_leaf())
+	{
+		if (IsEnabled)
+			_Liklyhood = _Weight;
+		else
+			_Liklyhood = 0;
+		return _Liklyhood;
+	}
+	else
+	{
+		_Liklyhood = 0;
+		for (auto& branch : children())
+		{
+			_Liklyhood += branch.CaculateLiklyhood();
+		}
+		return _Liklyhood;
+	}
+}
+
+float Causality::WorldBranch::CaculatePenetration() const
+{
+	float depth = 0;
+	if (!pDynamicsWorld)
+		return 0;
+	auto pDispatcher = pDynamicsWorld->getDispatcher();
+	int numManifolds = pDispatcher->getNumManifolds();
+	for (int i = 0; i < numManifolds; i++)
+	{
+		auto pManifold = pDispatcher->getManifoldByIndexInternal(i);
+		// Subjects are the only kinematic bodies in a branch
+		bool subject0 = pManifold->getBody0()->isKinematicObject();
+		bool subject1 = pManifold->getBody1()->isKinematicObject();
+		if (subject0 == subject1)
+			continue;
+		for (int j = 0; j < pManifold->getNumContacts(); j++)
+		{
+			float distance = pManifold->getContactPoint(j).getDistance();
+			if (distance < 0)
+				depth -= distance;
+		}
+	}
+	return depth;
+}
+
+void Causality::WorldBranch::NormalizeLiklyhood(float total)
+{
+	if (total <= 0)
+		return;
+	for (auto& branch : nodes_in_tree())
+	{
+		branch._Liklyhood /= total;
+	}
+}
+
+void Causality::WorldBranch::AddSubjectiveObject(const HandState & hand, const DirectX::Matrix4x4& leapTransform)
+{
+	if (!Subjects[hand.Id])
+	{
+		Subjects[hand.Id].reset(
+			new HandPhysicalModel(
+			World(),
+			hand, leapTransform,
+			SubjectTransform)
+			);
+		//for (const auto& itm : pFrame->Objects)
+		//{
+		//	const auto& pObj = itm.second;
+		//	if (!pObj->GetBulletRigid()->isStaticOrKinematicObject())
+		//	{
+		//		for (const auto& bone : subjects[hand.id()]->Rigids())
+		//			pObj->GetBulletRigid()->setIgnoreCollisionCheck(bone.get(), false);
+		//	}
+		//}
+	}
+}
+
+void Causality::WorldBranch::AddDynamicObject(unsigned id, const std::shared_ptr<btCollisionShape> &pShape, float mass, const DirectX::Vector3 & Position, const DirectX::Quaternion & Orientation)
+{
+	if (mass == 0)
+	{
+		// Built once, every branch world collides against the same layer
+		// Ids are never replaced in the layer, worlds' pair caches may still point at the old proxy
+		auto pLayer = StaticLayer ? StaticLayer : std::make_shared<StaticCollisionLayer>();
+		if (!pLayer->AddObject(id, pShape, Position, Orientation))
+			return;
+		for (auto& branch : nodes_in_tree())
+			branch.SetStaticLayer(pLayer);
+		if (SharedObjects)
+			SharedObjects->SetStaticLayer(pLayer.get());
+		return;
+	}
+
+	if (ShareUntouchedObjects)
+	{
+		auto pShared = SharedObjects;
+		if (!pShared)
+		{
+			pShared = std::make_shared<SharedObjectWorld>();
+			pShared->SetStaticLayer(StaticLayer.get());
+		}
+		pShared->AddObject(id, pShape, mass, Position, Orientation);
+		for (auto& branch : nodes_in_tree())
+			branch.SharedObjects = pShared;
+		return;
+	}
+
+	for (auto& branch : nodes_in_tree())
+	{
+		auto pObject = std::make_unique<PhysicalRigid>();
+		pObject->InitializePhysics(branch.World(), pShape, mass, Position, Orientation);
+		pObject->GetBulletRigid()->setFriction(1.0f);
+		pObject->GetBulletRigid()->setDamping(0.8f, 0.9f);
+		pObject->GetBulletRigid()->setRestitution(0.0);
+		if (branch.Items.size() <= id)
+			branch.Items.resize(id + 1);
+		branch.Items[id] = std::move(pObject);
+	}
+}
+
+// Worker the next new branch is dealt to, shared by all trees that evolve at once
+static std::atomic<unsigned> g_NextWorker(0);
+
+void Causality::WorldBranch::Evolution(float timeStep, const HandFrame & frame, const DirectX::Matrix4x4 & leapTransform)
+{
+	auto& scheduler = Scheduler();
+
+	_LeavesCache.clear();
+	_AffinityCache.clear();
+	for (auto& branch : leaves())
+	{
+		// New branches are dealt round-robin, then stay on their worker for cache locality
+		if (branch._WorkerAffinity < 0)
+			branch._WorkerAffinity = g_NextWorker++ % scheduler.WorkerCount();
+		_LeavesCache.push_back(&branch);
+		_AffinityCache.push_back(branch._WorkerAffinity);
+	}
+
+	// Bones are walked once here, leaves only apply their subject transform
+	_Kinematics.Update(frame, leapTransform);
+
+	auto& leaves = _LeavesCache;
+	auto& kinematics = _Kinematics;
+	scheduler.Dispatch(leaves.size(), [&leaves, timeStep, &kinematics](size_t i) {
+		leaves[i]->InternalEvolution(timeStep, kinematics);
+	}, _AffinityCache.data());
+
+	// Leaves took their private copies from the shared objects' state before this step, so it is advanced after them
+	if (SharedObjects)
+		SharedObjects->Step(timeStep);
+}
+
+BranchScheduler & Causality::WorldBranch::Scheduler()
+{
+	static BranchScheduler scheduler;
+	return scheduler;
+}
+
+void Causality::WorldBranch::Fork(const std::vector<PhysicalRigid*>& focusObjects)
+{
+	//int i = 0;
+	//for (const auto& obj : focusObjects)
+	//{
+	//	auto branch = DemandCreate((boost::format("%s/%d") % this->Name % i++).str());
+	//}
+}
+
+void Causality::WorldBranch::Fork(const std::vector<DirectX::AffineTransform>& subjectTransforms)
+{
+	for (int i = subjectTransforms.size() - 1; i >= 0; --i)
+	{
+		const auto& trans = subjectTransforms[i];
+		auto branch = Clone((boost::format("%s/%d") % this->Name % i).str(), trans);
+		if (!branch)
+			break;
+		append_children_front(branch.release());
+	}
+}
+
+std::unique_ptr<WorldBranch> Causality::WorldBranch::Clone(const std::string & branchName, const DirectX::AffineTransform & subjectTransform)
+{
+	auto branch = DemandCreate(branchName);
+	if (!branch)
+		return nullptr;
+	branch->Enable(subjectTransform);
+	branch->InheritState(*this);
+	branch->_Weight = _Weight;
+	return branch;
+}
+
+void Causality::WorldBranch::InheritState(const WorldBranch & source)
+{
+	SetStaticLayer(source.StaticLayer);
+	SharedObjects = source.SharedObjects;
+
+	auto objectCount = std::max(Items.size(), source.Items.size());
+	Items.resize(objectCount);
+	if (ItemArena.size() < objectCount)
+		ItemArena.resize(objectCount);
+
+	for (size_t id = 0; id < objectCount; id++)
+	{
+		const PhysicalRigid* pSource = id < source.Items.size() ? source.Items[id].get() : nullptr;
+		if (pSource)
+		{
+			AcquireItem(id, *pSource);
+		}
+		else if (Items[id])
+		{
+			Items[id]->Disable();
+			ItemArena[id] = std::move(Items[id]);
+		}
+	}
+
+	for (const auto& subject : source.Subjects)
+	{
+		if (subject.second && subject.second->IsTracked())
+			AddSubjectiveObject(subject.second->Hand(), subject.second->LeapTransform());
+	}
+}
+
+PhysicalRigid * Causality::WorldBranch::AcquireItem(unsigned id, const PhysicalRigid & source)
+{
+	if (Items.size() <= id)
+		Items.resize(id + 1);
+	if (ItemArena.size() < Items.size())
+		ItemArena.resize(Items.size());
+
+	auto& pRigid = Items[id];
+	if (!pRigid)
+		pRigid = std::move(ItemArena[id]);
+
+	if (pRigid && pRigid->GetBulletShape() == source.GetBulletShape())
+	{
+		pRigid->CopyStateFrom(source);
+		pRigid->Enable(World());
+	}
+	else
+	{
+		pRigid.reset(new PhysicalRigid());
+		pRigid->InitializePhysics(World(), source);
+	}
+	return pRigid.get();
+}
+
+const PhysicalRigid * Causality::WorldBranch::GetItem(unsigned id) const
+{
+	if (id < Items.size() && Items[id])
+		return Items[id].get();
+	return SharedObjects ? SharedObjects->GetRigid(id) : nullptr;
+}
+
+void Causality::WorldBranch::SpecializeTouchedObjects(float timeStep)
+{
+	if (!SharedObjects)
+		return;
+
+	// Subjects and private objects may reach shared objects in this step, or be reached by them
+	_TouchQueue.clear();
+	for (const auto& subject : Subjects)
+	{
+		if (!subject.second || !subject.second->IsTracked())
+			continue;
+		for (const auto& pRigid : subject.second->Rigids())
+		{
+			if (pRigid->IsEnabled())
+				_TouchQueue.push_back(pRigid->GetBulletRigid());
+		}
+	}
+	for (const auto& pRigid : Items)
+	{
+		if (pRigid && pRigid->IsEnabled())
+			_TouchQueue.push_back(pRigid->GetBulletRigid());
+	}
+
+	// Fresh private copies may reach further shared objects in turn
+	for (size_t i = 0; i < _TouchQueue.size(); i++)
+	{
+		auto pBody = _TouchQueue[i];
+		btTransform transform;
+		btVector3 reach(touchMargin, touchMargin, touchMargin);
+		if (pBody->isKinematicObject())
+		{
+			// Subjects are moved through their motion state, the body catches up in the step
+			pBody->getMotionState()->getWorldTransform(transform);
+		}
+		else
+		{
+			transform = pBody->getWorldTransform();
+			reach += pBody->getLinearVelocity().absolute() * timeStep;
+		}
+		btVector3 aabbMin, aabbMax;
+		pBody->getCollisionShape()->getAabb(transform, aabbMin, aabbMax);
+
+		_TouchedIds.clear();
+		SharedObjects->Query(aabbMin - reach, aabbMax + reach, _TouchedIds);
+		for (auto id : _TouchedIds)
+		{
+			if (id < Items.size() && Items[id])
+				continue;
+			auto pRigid = AcquireItem(id, *SharedObjects->GetRigid(id));
+			_TouchQueue.push_back(pRigid->GetBulletRigid());
+		}
+	}
+}
+
+void Causality::WorldBranch::ShareSettledObjects()
+{
+	if (!SharedObjects)
+		return;
+
+	_LeavesCache.clear();
+	size_t objectCount = 0;
+	for (auto& branch : leaves())
+	{
+		if (!branch.IsEnabled)
+			continue;
+		_LeavesCache.push_back(&branch);
+		objectCount = std::max(objectCount, branch.Items.size());
+	}
+
+	for (size_t id = 0; id < objectCount; id++)
+	{
+		// Every leaf must see the object asleep in the same state, within IsNearDuplicate's tolerance
+		const PhysicalRigid* pReference = SharedObjects->GetRigid(id);
+		if (pReference && pReference->GetBulletRigid()->isActive())
+			continue;
+		bool settled = true;
+		bool hasPrivate = false;
+		for (auto pBranch : _LeavesCache)
+		{
+			const PhysicalRigid* pRigid = id < pBranch->Items.size() ? pBranch->Items[id].get() : nullptr;
+			if (!pRigid)
+			{
+				settled = SharedObjects->GetRigid(id) != nullptr;
+			}
+			else
+			{
+				hasPrivate = true;
+				if (!pReference)
+					pReference = pRigid;
+				// Separate worlds rarely put a body to sleep in bit identical states
+				RigidTransform state, reference;
+				state.Translation = pRigid->GetPosition();
+				state.Rotation = pRigid->GetOrientation();
+				reference.Translation = pReference->GetPosition();
+				reference.Rotation = pReference->GetOrientation();
+				settled = !pRigid->GetBulletRigid()->isActive() && state.NearEqual(reference);
+			}
+			if (!settled)
+				break;
+		}
+		if (!settled || !hasPrivate)
+			continue;
+
+		if (pReference != SharedObjects->GetRigid(id))
+			SharedObjects->AdoptObject(id, *pReference);
+		for (auto pBranch : _LeavesCache)
+		{
+			if (id >= pBranch->Items.size() || !pBranch->Items[id])
+				continue;
+			if (pBranch->ItemArena.size() < pBranch->Items.size())
+				pBranch->ItemArena.resize(pBranch->Items.size());
+			pBranch->Items[id]->Disable();
+			pBranch->ItemArena[id] = std::move(pBranch->Items[id]);
+		}
+	}
+}
+std::unique_ptr<WorldBranch> Causality::WorldBranch::DemandCreate(const string& branchName)
+{
+	std::unique_ptr<WorldBranch> frame;
+	{
+		std::lock_guard<std::mutex> guard(BranchPoolMutex);
+		if (!BranchPool.empty())
+		{
+			// LIFO, the most recently recycled branch has the warmest world
+			frame = std::move(BranchPool.back());
+			BranchPool.pop_back();
+			++BranchPoolStats.Hits;
+		}
+		else
+		{
+			++BranchPoolStats.Misses;
+			if (!BranchPoolAutoExpand)
+				return nullptr;
+			++BranchPoolStats.Growths;
+			++BranchPoolStats.Capacity;
+		}
+	}
+
+	if (!frame)
+		frame.reset(new WorldBranch());
+	frame->Name = branchName;
+	return frame;
+}
+
+WorldBranch::BranchPoolStatistics Causality::WorldBranch::PoolStatistics()
+{
+	std::lock_guard<std::mutex> guard(BranchPoolMutex);
+	auto stats = BranchPoolStats;
+	stats.Available = BranchPool.size();
+	return stats;
+}
+
+void Causality::WorldBranch::Recycle(std::unique_ptr<WorldBranch>&& pFrame)
+{
+	pFrame->Reset();
+	pFrame->Disable();
+	pFrame->_WorkerAffinity = -1;
+	std::lock_guard<std::mutex> guard(BranchPoolMutex);
+	BranchPool.push_back(std::move(pFrame));
+}
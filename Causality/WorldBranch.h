@@ -0,0 +1,423 @@
+#pragma once
+#include "BulletPhysics.h"
+#include "HandFrame.h"
+#include "BranchScheduler.h"
+#include "StateClusterer.h"
+#include "Common\tree.h"
+#include <mutex>
+#include <map>
+#include <array>
+
+namespace Causality
+{
+	struct ProblistiscAffineTransform : public DirectX::AffineTransform
+	{
+		using DirectX::AffineTransform::AffineTransform;
+		float Probability;
+	};
+
+	// A super state which encode different states with probility
+	//struct ProblistiscState
+	//{
+	//public:
+	//	std::string	Name;
+	//	std::vector<ProblistiscAffineTransform> StatesDistribution;
+	//};
+
+	// Scalar reference : normalized field intensity at P of a uniformly charged segment L0-L1
+	DirectX::XMVECTOR XM_CALLCONV FieldSegmentToPoint(DirectX::FXMVECTOR P, DirectX::FXMVECTOR L0, DirectX::FXMVECTOR L1);
+
+	// Field of a set of charged segments, evaluated for many points at once
+	// Segments are kept in structure-of-arrays layout with their direction and length prepared in Reset,
+	// Evaluate runs 4 points per SIMD vector and matches summing FieldSegmentToPoint over segments
+	class SegmentFieldBatch
+	{
+	public:
+		void Reset(const std::pair<DirectX::Vector3, DirectX::Vector3>* segments, size_t count);
+
+		// fields[i] = field at points[i], points and fields may alias
+		void Evaluate(const DirectX::Vector3* points, DirectX::Vector3* fields, size_t count) const;
+
+		size_t SegmentCount() const { return m_Length.size() + m_Cx.size(); }
+
+	private:
+		void XM_CALLCONV Evaluate4(DirectX::FXMVECTOR Px, DirectX::FXMVECTOR Py, DirectX::FXMVECTOR Pz,
+			DirectX::XMVECTOR& Fx, DirectX::XMVECTOR& Fy, DirectX::XMVECTOR& Fz) const;
+
+		// Segments : start point, unit direction, length and its reciprocal
+		std::vector<float>	m_Sx, m_Sy, m_Sz;
+		std::vector<float>	m_Dx, m_Dy, m_Dz;
+		std::vector<float>	m_Length, m_InvLength;
+		// Degenerated segments, as point charges at their center
+		std::vector<float>	m_Cx, m_Cy, m_Cz;
+	};
+
+	// A subject bone capsule as the simulation left it, drawn by the render thread
+	struct SubjectCapsule
+	{
+		DirectX::Vector3	Center;
+		DirectX::Vector3	Axis;
+		float				Height;
+		float				Radius;
+		float				Opticity;
+	};
+
+	// Branch independent part of a hand's bones, computed once per frame and shared by all branches
+	struct HandKinematics
+	{
+		enum { JointCount = 2 * Platform::HandState::BoneCount };
+
+		// Hand in the frame, its bones are the joint stream PrevJoint, NextJoint, PrevJoint...
+		const Platform::HandState*	State;
+		// Rotation from +Y to each bone in device space, identity for zero length bones
+		DirectX::Quaternion			BoneRotations[Platform::HandState::BoneCount];
+		bool						Degenerated[Platform::HandState::BoneCount];
+
+		const DirectX::XMFLOAT3* Joints() const { return &State->Bones[0].PrevJoint; }
+	};
+
+	struct FrameKinematics
+	{
+		void Update(const Platform::HandFrame& frame, const DirectX::Matrix4x4& leapTransform);
+
+		const HandKinematics* Hand(int id) const;
+
+		DirectX::Matrix4x4	LeapTransform;
+		// Rotation part of LeapTransform
+		DirectX::Quaternion	LeapRotation;
+		unsigned			HandCount;
+		HandKinematics		Hands[Platform::HandFrame::MaxHands];
+	};
+
+	struct HandPhysicalModel : public DirectX::Scene::IModelNode
+	{
+		HandPhysicalModel(const std::shared_ptr<btDynamicsWorld> &pWorld,
+			const Platform::HandState & hand, const DirectX::Matrix4x4 & leapTransform,
+			const DirectX::AffineTransform &inheritTransform);
+
+		DirectX::XMMATRIX CaculateLocalMatrix(const Platform::HandState & hand, const DirectX::Matrix4x4 & leapTransform);
+
+		inline const std::vector<std::unique_ptr<PhysicalRigid>>& Rigids()
+		{
+			return m_HandRigids;
+		}
+
+		// Apply this branch's subject transform to the frame's hand kinematics
+		bool Update(const FrameKinematics& kinematics);
+
+		bool IsTracked() const
+		{
+			return m_IsTracked;
+		}
+		int LostFramesCount() const { return LostFrames; }
+		const Platform::HandState& Hand() const { return m_Hand; }
+		const DirectX::Matrix4x4& LeapTransform() const { return m_LeapTransform; }
+		// Inherited via IModelNode
+		virtual void Render(ID3D11DeviceContext * pContext, DirectX::IEffect * pEffect) override;
+		// Bone capsules as Render draws them, for drawing outside the simulation thread
+		void AppendCapsules(std::vector<SubjectCapsule>& capsules, float opticity) const;
+
+		DirectX::XMVECTOR XM_CALLCONV FieldAtPoint(DirectX::FXMVECTOR P);
+		// Batched FieldAtPoint over count points
+		void FieldAtPoints(const DirectX::Vector3* points, DirectX::Vector3* fields, size_t count) const;
+
+		const DirectX::BoundingFrustum& OperatingFrustum() const
+		{
+			return m_HandFrustum;
+		}
+
+	public:
+		float		Opticity;
+
+	private:
+		int			Id;
+		int			LostFrames;
+		bool		m_IsTracked;
+		Platform::HandState m_Hand;
+		DirectX::Matrix4x4 m_LeapTransform;
+		DirectX::AffineTransform m_InheritTransform;
+		std::array<std::pair<DirectX::Vector3, DirectX::Vector3>, 20> m_Bones;
+		SegmentFieldBatch									m_BoneField;
+		std::vector<std::unique_ptr<PhysicalRigid>>			m_HandRigids;
+
+		//std::unique_ptr<Bullet::GhostObject>				m_HandFrustrum;
+		DirectX::BoundingFrustum							m_HandFrustum;
+		//static std::unique_ptr<DirectX::GeometricPrimitive> s_pCylinder;
+		//static std::unique_ptr<DirectX::GeometricPrimitive> s_pSphere;
+	};
+
+	// Dynamic objects no branch has touched evolve identically in every branch,
+	// so they live once in this world, which is stepped once per frame instead of once per branch
+	// A branch takes a private copy of an object when its subjects or private objects reach it, see WorldBranch::SpecializeTouchedObjects
+	// Only read while branches evolve, objects are added, adopted and stepped between evolutions
+	class SharedObjectWorld
+	{
+	public:
+		SharedObjectWorld();
+		~SharedObjectWorld();
+
+		SharedObjectWorld(const SharedObjectWorld&) = delete;
+		SharedObjectWorld& operator=(const SharedObjectWorld&) = delete;
+
+		void AddObject(unsigned id, const std::shared_ptr<btCollisionShape> &pShape, float mass, const DirectX::Vector3 & Position, const DirectX::Quaternion & Orientation);
+		// Share the state of a branch's private copy again
+		void AdoptObject(unsigned id, const PhysicalRigid& prototype);
+		// nullptr if id is not shared
+		const PhysicalRigid* GetRigid(unsigned id) const
+		{
+			return id < m_Items.size() ? m_Items[id].get() : nullptr;
+		}
+		// One past the largest id added
+		size_t IdBound() const { return m_Items.size(); }
+
+		void SetStaticLayer(const StaticCollisionLayer* pLayer);
+		void Step(float timeStep);
+
+		// Append ids of shared objects whose AABBs touch [aabbMin, aabbMax], thread safe while not stepping
+		void Query(const btVector3& aabbMin, const btVector3& aabbMax, std::vector<unsigned>& ids) const;
+
+	private:
+		std::shared_ptr<btBroadphaseInterface>					m_pBroadphase;
+		std::shared_ptr<btDefaultCollisionConfiguration>		m_pCollisionConfiguration;
+		std::shared_ptr<btCollisionDispatcher>					m_pDispatcher;
+		std::shared_ptr<btSequentialImpulseConstraintSolver>	m_pSolver;
+		std::shared_ptr<btDynamicsWorld>						m_pDynamicsWorld;
+		// Indexed by object id, null for objects which are not shared
+		std::vector<std::unique_ptr<PhysicalRigid>>				m_Items;
+		std::map<const btCollisionObject*, unsigned>			m_Ids;
+	};
+
+	// Structure-of-arrays storage of all objects' superposed states
+	// States of the object with id i are [Objects[i].Offset, Objects[i].Offset + Objects[i].Count)
+	struct SuperpositionTable
+	{
+		struct Range
+		{
+			uint32_t Offset;
+			uint32_t Count;
+		};
+
+		std::vector<Range>					Objects;
+		std::vector<DirectX::Vector3>		Positions;
+		std::vector<DirectX::Quaternion>	Orientations;
+		std::vector<DirectX::Vector3>		Scales;
+		std::vector<float>					Probabilities;
+
+		size_t ObjectCount() const { return Objects.size(); }
+		size_t StateCount() const { return Probabilities.size(); }
+
+		// Resize to hold stateCount states, capacity is kept across frames
+		void Resize(size_t objectCount, size_t stateCount)
+		{
+			Objects.resize(objectCount);
+			Positions.resize(stateCount);
+			Orientations.resize(stateCount);
+			Scales.resize(stateCount);
+			Probabilities.resize(stateCount);
+		}
+
+		DirectX::XMMATRIX TransformMatrix(size_t state) const
+		{
+			using namespace DirectX;
+			XMMATRIX M = XMMatrixScalingFromVector(Scales[state]);
+			M *= XMMatrixRotationQuaternion(Orientations[state]);
+			M.r[3] = XMVectorSelect(g_XMIdentityR3.v, Positions[state], g_XMSelect1110.v);
+			return M;
+		}
+	};
+
+	// One problistic frame for current state
+	class WorldBranch : public stree::tree_node<WorldBranch, false>
+	{
+	public:
+
+		enum CollisionGroupEnum : short
+		{
+			Group_Focused_Object = 0x1,
+			Group_Unfocused_Object = 0x2,
+			Group_Subject = 0x4,
+			Mask_Focused_Object = 0x7,
+			Mask_Unfocused_Object = 0x3,
+			Mask_Subject = 0x1,
+		};
+
+		// Bounds the live leaves kept by Collapse
+		struct BeamParameters
+		{
+			BeamParameters();
+			// Maximum number of live leaves after collapse
+			unsigned	MaxLeaves;
+			// Leaves with normalized liklyhood below this are recycled
+			float		MinLiklyhood;
+			// Evidence decay per meter of hand-object penetration, per second
+			float		PenetrationPenalty;
+			// Leaves whose subject scale differ less than this and items are near equal are merged
+			float		MergeScaleEpsilon;
+		};
+
+		static BeamParameters Beam;
+
+		struct BranchPoolStatistics
+		{
+			// Demands served from pooled branches
+			size_t	Hits;
+			// Demands the pool could not serve from pooled branches
+			size_t	Misses;
+			// Branches created beyond the configured capacity
+			size_t	Growths;
+			// Physics worlds actually constructed
+			size_t	WorldsCreated;
+			size_t	Capacity;
+			size_t	Available;
+		};
+
+	public:
+		// Pre-allocate size branch shells, physics worlds are built on first use
+		// With autoExpandation, DemandCreate grows the pool instead of returning nullptr
+		static void InitializeBranchPool(int size, bool autoExpandation = true);
+		// Thread safe
+		static std::unique_ptr<WorldBranch> DemandCreate(const std::string& branchName);
+		// Thread safe, the branch keeps its physics world for the next demand
+		static void Recycle(std::unique_ptr<WorldBranch>&&);
+		static BranchPoolStatistics PoolStatistics();
+
+	private:
+		static std::mutex								BranchPoolMutex;
+		static std::vector<std::unique_ptr<WorldBranch>>	BranchPool;
+		static BranchPoolStatistics						BranchPoolStats;
+		static bool										BranchPoolAutoExpand;
+
+	public:
+		void Reset();
+
+		float Liklyhood() const
+		{
+			return _Liklyhood;
+		}
+
+		// Evidence accumulated since the fork, the leaves Collapse keeps sum to 1
+		float Weight() const
+		{
+			return _Weight;
+		}
+
+		// Wall time (milliseconds) spent in last InternalEvolution of this branch
+		float StepTime() const
+		{
+			return _StepTime;
+		}
+
+		// Persistent pool which evolves the leaves, shared by all branch trees
+		static BranchScheduler& Scheduler();
+
+		WorldBranch();
+
+		void Enable(const DirectX::AffineTransform& subjectTransform)
+		{
+			IsEnabled = true;
+			SubjectTransform = subjectTransform;
+			_Weight = 1.0f;
+		}
+
+		void Disable()
+		{
+			IsEnabled = false;
+		}
+
+		//copy / move sementic is deleted for use with pointer
+		WorldBranch(const WorldBranch& other) = delete;
+		WorldBranch& operator=(const WorldBranch& other) = delete;
+		WorldBranch(WorldBranch&& other) = delete;
+		WorldBranch& operator=(const WorldBranch&& other) = delete;
+
+		void AddSubjectiveObject(const Platform::HandState& hand, const DirectX::Matrix4x4& leapTransform);
+		void AddDynamicObject(unsigned id, const std::shared_ptr<btCollisionShape> &pShape, float mass, const DirectX::Vector3 & Position, const DirectX::Quaternion & Orientation);
+		void Evolution(float timeStep, const Platform::HandFrame & frame, const DirectX::Matrix4x4 & leapTransform);
+		void Fork(const std::vector<PhysicalRigid*>& focusObjects);
+		void Fork(const std::vector<DirectX::AffineTransform>& subjectTransform);
+		// Demand a branch from pool which starts from this branch's current simulated state
+		std::unique_ptr<WorldBranch> Clone(const std::string& branchName, const DirectX::AffineTransform& subjectTransform);
+		// Copy rigid states from source in one ordered pass, re-using bodies kept in the item arena
+		void InheritState(const WorldBranch& source);
+		void Collapse();
+		// Object id as this branch sees it, its private copy or the shared one
+		const PhysicalRigid* GetItem(unsigned id) const;
+		// Refresh superposition in place, the table's storage is reused across frames
+		void CaculateSuperposition(SuperpositionTable& superposition);
+
+	protected:
+		float CaculateLiklyhood();
+		void NormalizeLiklyhood(float total);
+		// Physics world of this branch, constructed on first call
+		const std::shared_ptr<btDynamicsWorld>& World();
+		void SetStaticLayer(const std::shared_ptr<StaticCollisionLayer>& pLayer);
+		// Enable a private copy of source as object id, re-using the body kept in the item arena
+		PhysicalRigid* AcquireItem(unsigned id, const PhysicalRigid& source);
+		// Take private copies of the shared objects this branch's subjects and private objects may reach in timeStep
+		void SpecializeTouchedObjects(float timeStep);
+		// Return private copies which settled in the same state in every leaf to the shared world
+		void ShareSettledObjects();
+		// Total penetration depth between subjects and objects in current contacts
+		float CaculatePenetration() const;
+		bool IsNearDuplicate(const WorldBranch& other) const;
+		// Detach this leaf from the tree and return it to the pool
+		void Retire();
+	public:
+		// Internal evolution algorithm as-if this branch is a "Leaf"
+		void InternalEvolution(float timeStep, const FrameKinematics & kinematics);
+
+	public:
+		std::string												Name;
+
+	protected:
+		float													_Liklyhood;
+		// Un-normalized evidence accumulated by this leaf since it was forked
+		float													_Weight;
+		float													_StepTime;
+		// Worker this branch sticks to across frames, -1 before first evolution
+		int														_WorkerAffinity;
+
+		// Leaves gathered for scheduling, kept to avoid per-frame allocation
+		std::vector<WorldBranch*>								_LeavesCache;
+		std::vector<unsigned>									_AffinityCache;
+		std::vector<StateClusterer<ProblistiscAffineTransform>>	_Clusterers;
+		// Hand bones of the current frame, computed by the root once for all leaves
+		FrameKinematics											_Kinematics;
+		// Bodies to test against the shared world and the shared objects they reach, kept to avoid per-frame allocation
+		std::vector<const btRigidBody*>							_TouchQueue;
+		std::vector<unsigned>									_TouchedIds;
+	protected:
+		// Evolution caculation object
+		std::shared_ptr<btBroadphaseInterface>					pBroadphase = nullptr;
+		// Set up the collision configuration and dispatcher
+		std::shared_ptr<btDefaultCollisionConfiguration>		pCollisionConfiguration = nullptr;
+		std::shared_ptr<btCollisionDispatcher>					pDispatcher = nullptr;
+		// The actual physics solver
+		std::shared_ptr<btSequentialImpulseConstraintSolver>	pSolver = nullptr;
+		std::shared_ptr<btDynamicsWorld>						pDynamicsWorld = nullptr;
+
+	public:
+		// Object states evolution with time and interaction subjects, indexed by object id
+		std::vector<std::unique_ptr<PhysicalRigid>>				Items;
+
+		// Disabled rigids kept alive across recycles, so forks don't re-create bodies
+		std::vector<std::unique_ptr<PhysicalRigid>>				ItemArena;
+
+		// Objects with zero mass, shared by all branches of the tree instead of living in Items
+		std::shared_ptr<StaticCollisionLayer>					StaticLayer;
+
+		// Dynamic objects not touched in any branch yet, Items only holds this branch's private copies
+		std::shared_ptr<SharedObjectWorld>						SharedObjects;
+		// Put new dynamic objects into SharedObjects, otherwise every branch simulates its own copy
+		static bool												ShareUntouchedObjects;
+
+		// Interactive subjects
+		std::map<int, std::shared_ptr<HandPhysicalModel>>		Subjects;
+
+		DirectX::AffineTransform								SubjectTransform;
+
+
+		bool													IsDirty;
+		bool													IsEnabled;
+	};
+}